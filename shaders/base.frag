@@ -38,7 +38,7 @@ global_uniform;
 
 
 #ifdef HAS_BASE_COLOR_TEXTURE
-layout (set = 1, binding = 10 ) uniform sampler2D global_textures[];
+#include "material_textures.h"
 #endif
 
 // Push constants come with a limitation in the size of data.
@@ -94,7 +94,7 @@ void main(void)
 
 #ifdef HAS_BASE_COLOR_TEXTURE
 	//base_color = texture(base_color_texture, in_uv);
-	base_color = texture(global_textures[nonuniformEXT(pbr_material_uniform.texture_indices.x)], in_uv);
+	base_color = sample_material_texture(pbr_material_uniform.texture_indices.x, in_uv);
 #else
 	base_color = pbr_material_uniform.base_color_factor;
 #endif
@@ -19,7 +19,7 @@ layout(set = 0, binding = 1) uniform GlobalUniform {
     vec3 camera_position;
 } global_uniform;
 
-layout (set = 1, binding = 10 ) uniform sampler2D global_textures[];
+#include "material_textures.h"
 
 layout(push_constant, std430) uniform PBRMaterialUniform {
     // x = diffuse index, y = metallic_roughness_occlusion_texture, z = normal index, w = emissive index
@@ -35,23 +35,23 @@ void main(void)
     vec4 base_color = vec4(1.0, 0.0, 0.0, 1.0);
 
 #ifdef HAS_BASE_COLOR_TEXTURE
-    base_color = texture(global_textures[nonuniformEXT(pbr_material_uniform.texture_indices.x)], in_uv);
+    base_color = sample_material_texture(pbr_material_uniform.texture_indices.x, in_uv);
 #else
     base_color = pbr_material_uniform.base_color_factor;
 #endif
 
 #ifdef HAS_METALLIC_ROUGHNESS_TEXTURE
-    base_color.w = texture(global_textures[nonuniformEXT(pbr_material_uniform.texture_indices.y)], in_uv).y;
-    o_normal.w = texture(global_textures[nonuniformEXT(pbr_material_uniform.texture_indices.y)], in_uv).z;
+    base_color.w = sample_material_texture(pbr_material_uniform.texture_indices.y, in_uv).y;
+    o_normal.w = sample_material_texture(pbr_material_uniform.texture_indices.y, in_uv).z;
 #else
-    base_color.w = texture(global_textures[nonuniformEXT(pbr_material_uniform.texture_indices.y)], in_uv).y;
-    o_normal.w = texture(global_textures[nonuniformEXT(pbr_material_uniform.texture_indices.y)], in_uv).z;
+    base_color.w = sample_material_texture(pbr_material_uniform.texture_indices.y, in_uv).y;
+    o_normal.w = sample_material_texture(pbr_material_uniform.texture_indices.y, in_uv).z;
 //    base_color.w = pbr_material_uniform.roughness_factor;
 //    o_normal.w = pbr_material_uniform.metallic_factor;
 #endif
 
 #ifdef HAS_EMISSIVE_TEXTURE
-    o_emissive = texture(global_textures[nonuniformEXT(pbr_material_uniform.texture_indices.w)], in_uv);
+    o_emissive = sample_material_texture(pbr_material_uniform.texture_indices.w, in_uv);
 #else
     o_emissive = vec4(0.0);
 #endif
@@ -62,8 +62,10 @@ void main(void)
     mat3 TBN = mat3(T, B, N);
 
 #ifdef HAS_NORMAL_TEXTURE
-    vec3 normalMap = texture(global_textures[nonuniformEXT(pbr_material_uniform.texture_indices.z)], in_uv).rgb;
-    normalMap = normalMap * 2.0 - 1.0;
+    // Only XY are kept by two channel compressed formats, Z is reconstructed
+    vec3 normalMap;
+    normalMap.xy = sample_material_texture(pbr_material_uniform.texture_indices.z, in_uv).rg * 2.0 - 1.0;
+    normalMap.z  = sqrt(max(1.0 - dot(normalMap.xy, normalMap.xy), 0.0));
     N = normalize(TBN * normalMap);
 #endif
 
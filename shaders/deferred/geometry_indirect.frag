@@ -24,7 +24,7 @@ layout (std430, binding = 3) readonly buffer MeshDrawBuffer
     MeshDraw mesh_draws[];
 };
 
-layout (set = 1, binding = 10 ) uniform sampler2D global_textures[];
+#include "material_textures.h"
 
 void main(void)
 {
@@ -34,7 +34,7 @@ void main(void)
 
 	vec4 base_color = vec4(1.0, 0.0, 0.0, 1.0);
 #ifdef HAS_BASE_COLOR_TEXTURE
-    base_color = texture(global_textures[nonuniformEXT(mesh_draws[v_in.mesh_draw_index].texture_indices.x)], v_in.uv);
+    base_color = sample_material_texture(mesh_draws[v_in.mesh_draw_index].texture_indices.x, v_in.uv);
 #else
     base_color = mesh_draws[v_in.mesh_draw_index].base_color_factor;
 #endif
@@ -30,7 +30,7 @@ layout (location = 0) in PerVertexData
 layout (location = 0) out vec4 o_albedo;
 layout (location = 1) out vec4 o_normal;
 
-layout (set = 1, binding = 10 ) uniform sampler2D global_textures[];
+#include "material_textures.h"
 
 layout(push_constant, std430) uniform PBRMaterialUniform {
     // x = diffuse index, y = roughness index, z = normal index, w = occlusion index.
@@ -49,7 +49,7 @@ void main(void)
 
 	vec4 base_color = vec4(1.0, 0.0, 0.0, 1.0);
 #ifdef HAS_BASE_COLOR_TEXTURE
-    base_color = texture(global_textures[nonuniformEXT(pbr_material_uniform.texture_indices.x)], v_in.uv);
+    base_color = sample_material_texture(pbr_material_uniform.texture_indices.x, v_in.uv);
 #else
     base_color = pbr_material_uniform.base_color_factor;
 #endif
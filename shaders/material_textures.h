@@ -0,0 +1,22 @@
+// Bindless material textures, GL_EXT_nonuniform_qualifier must be enabled
+
+layout (set = 1, binding = 10 ) uniform sampler2D global_textures[];
+
+// Small textures packed at import are layers of arrays bound to the same slots, see TexturePacker.
+// Their index holds the slot in the lower 16 bits and the layer plus one in the upper 16 bits.
+layout (set = 1, binding = 10 ) uniform sampler2DArray global_texture_arrays[];
+
+vec4 sample_material_texture(uint index, vec2 uv)
+{
+	// Taken before branching, derivatives are undefined in non uniform control flow
+	vec2 uv_dx = dFdx(uv);
+	vec2 uv_dy = dFdy(uv);
+
+	uint slot  = index & 0xFFFFu;
+	uint layer = index >> 16u;
+	if (layer == 0u)
+	{
+		return textureGrad(global_textures[nonuniformEXT(slot)], uv, uv_dx, uv_dy);
+	}
+	return textureGrad(global_texture_arrays[nonuniformEXT(slot)], vec3(uv, float(layer - 1u)), uv_dx, uv_dy);
+}
@@ -143,8 +143,11 @@ vec3 normal()
 	mat3 TBN    = mat3(T, B, N);
 
 #ifdef HAS_NORMAL_TEXTURE
-	vec3 n = texture(normal_texture, in_uv).rgb;
-	return normalize(TBN * (2.0 * n - 1.0));
+	// Only XY are kept by two channel compressed formats, Z is reconstructed
+	vec3 n;
+	n.xy = texture(normal_texture, in_uv).rg * 2.0 - 1.0;
+	n.z  = sqrt(max(1.0 - dot(n.xy, n.xy), 0.0));
+	return normalize(TBN * n);
 #else
 	return normalize(TBN[2].xyz);
 #endif
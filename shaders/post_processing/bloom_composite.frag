@@ -6,6 +6,7 @@ layout(set = 0, binding = 1) uniform sampler2D bloom_tex;
 layout(push_constant) uniform Registers {
     float bloom_strength;    
     float exposure;         
+    vec2 uv_scale;
 } registers;
 
 vec3 reinhard_extended(vec3 hdr_color, float max_white) {
@@ -14,8 +15,12 @@ vec3 reinhard_extended(vec3 hdr_color, float max_white) {
 }
 
 void main() {
-    vec3 hdr = textureLod(hdr_tex, in_uv, 0.0).rgb * registers.exposure;
-    vec3 bloom = textureLod(bloom_tex, in_uv, 0.0).rgb * registers.exposure;
+    // Upscales the rendered sub-rect, clamped so filtering does not read past its edge
+    vec2 hdr_uv = min(in_uv * registers.uv_scale, registers.uv_scale - 0.5 / vec2(textureSize(hdr_tex, 0)));
+    vec2 bloom_uv = min(in_uv * registers.uv_scale, registers.uv_scale - 0.5 / vec2(textureSize(bloom_tex, 0)));
+
+    vec3 hdr = textureLod(hdr_tex, hdr_uv, 0.0).rgb * registers.exposure;
+    vec3 bloom = textureLod(bloom_tex, bloom_uv, 0.0).rgb * registers.exposure;
     
     vec3 combined = hdr + bloom * registers.bloom_strength;
     
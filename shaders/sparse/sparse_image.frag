@@ -9,6 +9,18 @@ layout(binding = 2) uniform SettingsData {
 	int  max_lod;
 } settings;
 
+// Page layout of the levels in front of the mip tail, x: first page, y: page columns, zw: extent of the level
+layout(binding = 3) uniform PageLayout {
+	uvec4 mips[16];
+	uvec2 page_extent;
+	uint  mip_count;
+} page_layout;
+
+// Nonzero for each page a fragment requested, read back by the page manager once the frame completed
+layout(std430, binding = 4) buffer Feedback {
+	uint requested[];
+} feedback;
+
 layout(location = 0) in vec2 texcoord;
 layout(location = 0) out vec4 out_color;
 
@@ -21,21 +33,39 @@ vec3 color_blend_table[5] =
 	{0.20, 0.20, 0.20},
 };
 
+void write_feedback(int lod)
+{
+	if (lod >= int(page_layout.mip_count))
+	{
+		// The mip tail is always resident
+		return;
+	}
+
+	uvec4 mip   = page_layout.mips[lod];
+	uvec2 texel = min(uvec2(clamp(texcoord, 0.0, 1.0) * vec2(mip.zw)), mip.zw - 1);
+	uvec2 page  = texel / page_layout.page_extent;
+
+	feedback.requested[mip.x + page.y * mip.y + page.x] = 1;
+}
+
 void main()
 {
 	vec4 color = vec4(0.0);
 
-	int lod = settings.min_lod;
-	int residency_code = sparseTextureLodARB(tex, texcoord, lod, color);
+	int lod = max(settings.min_lod, int(textureQueryLod(tex, texcoord).y));
+	write_feedback(lod);
 
-	for(++lod; (lod <= settings.max_lod) && !sparseTexelsResidentARB(residency_code); ++lod)
+	// Falls back to coarser levels until a resident one, the mip tail always is
+	int residency_code = sparseTextureLodARB(tex, texcoord, lod, color);
+	while (!sparseTexelsResidentARB(residency_code) && lod < settings.max_lod)
 	{
+		++lod;
 		residency_code = sparseTextureLodARB(tex, texcoord, lod, color);
 	}
 
 	if(settings.color_highlight)
 	{
-		color.rgb *= color_blend_table[lod - 1];
+		color.rgb *= color_blend_table[min(lod, 4)];
 	}
 	out_color = color;
 }
\ No newline at end of file
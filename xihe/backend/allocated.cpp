@@ -1,10 +1,48 @@
 #include "allocated.h"
 
+#include <array>
+#include <atomic>
+#include <fstream>
+
 #include "backend/device.h"
 #include "common/error.h"
 
 namespace xihe::backend::allocated
 {
+namespace
+{
+struct CategoryCounters
+{
+	std::atomic<uint64_t> allocation_count{0};
+	std::atomic<uint64_t> allocation_bytes{0};
+};
+
+std::array<CategoryCounters, static_cast<size_t>(MemoryCategory::kCount)> &get_category_counters()
+{
+	static std::array<CategoryCounters, static_cast<size_t>(MemoryCategory::kCount)> counters;
+	return counters;
+}
+}        // namespace
+
+const char *to_string(MemoryCategory category)
+{
+	switch (category)
+	{
+		case MemoryCategory::kRenderGraph:
+			return "render graph";
+		case MemoryCategory::kGpuScene:
+			return "gpu scene";
+		case MemoryCategory::kTexture:
+			return "texture";
+		case MemoryCategory::kStaging:
+			return "staging";
+		case MemoryCategory::kBufferPool:
+			return "buffer pool";
+		default:
+			return "other";
+	}
+}
+
 VmaAllocator &get_memory_allocator()
 {
 	static VmaAllocator memory_allocator = VK_NULL_HANDLE;
@@ -24,6 +62,51 @@ void shutdown()
 	}
 }
 
+CategoryStatistics get_category_statistics(MemoryCategory category)
+{
+	const auto &counters = get_category_counters()[static_cast<size_t>(category)];
+	return {counters.allocation_count.load(std::memory_order_relaxed), counters.allocation_bytes.load(std::memory_order_relaxed)};
+}
+
+HeapBudget get_device_local_budget()
+{
+	const VmaAllocator &allocator = get_memory_allocator();
+
+	const VkPhysicalDeviceMemoryProperties *memory_properties = nullptr;
+	vmaGetMemoryProperties(allocator, &memory_properties);
+
+	std::vector<VmaBudget> budgets(memory_properties->memoryHeapCount);
+	vmaGetHeapBudgets(allocator, budgets.data());
+
+	HeapBudget result;
+	for (uint32_t i = 0; i < memory_properties->memoryHeapCount; ++i)
+	{
+		if (memory_properties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+		{
+			result.usage += budgets[i].usage;
+			result.budget += budgets[i].budget;
+		}
+	}
+	return result;
+}
+
+void write_detailed_map(const std::string &path)
+{
+	std::ofstream file{path, std::ios::out | std::ios::trunc};
+	if (!file.is_open())
+	{
+		LOGE("Failed to open {} for writing", path);
+		return;
+	}
+
+	char *stats_string = nullptr;
+	vmaBuildStatsString(get_memory_allocator(), &stats_string, VK_TRUE);
+	file << stats_string;
+	vmaFreeStatsString(get_memory_allocator(), stats_string);
+
+	LOGI("Wrote the device memory map to {}", path);
+}
+
 AllocatedBase::AllocatedBase(const VmaAllocationCreateInfo &alloc_create_info) :
     alloc_create_info_(alloc_create_info)
 {}
@@ -31,6 +114,8 @@ AllocatedBase::AllocatedBase(const VmaAllocationCreateInfo &alloc_create_info) :
 AllocatedBase::AllocatedBase(AllocatedBase &&other) noexcept :
     alloc_create_info_(std::exchange(other.alloc_create_info_, {})),
     allocation_(std::exchange(other.allocation_, {})),
+    memory_category_(std::exchange(other.memory_category_, {})),
+    allocation_size_(std::exchange(other.allocation_size_, {})),
     mapped_data_(std::exchange(other.mapped_data_, {})),
     coherent_(std::exchange(other.coherent_, {})),
     persistent_(std::exchange(other.persistent_, {}))
@@ -62,6 +147,13 @@ bool AllocatedBase::mapped() const
 	return mapped_data_ != nullptr;
 }
 
+bool AllocatedBase::is_host_visible() const
+{
+	VkMemoryPropertyFlags memory_properties;
+	vmaGetAllocationMemoryProperties(get_memory_allocator(), allocation_, &memory_properties);
+	return (memory_properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+}
+
 uint8_t *AllocatedBase::map()
 {
 	if (!persistent_ && !mapped())
@@ -103,6 +195,23 @@ size_t AllocatedBase::update(const void *data, size_t size, size_t offset)
 	return update(reinterpret_cast<const uint8_t *>(data), size, offset);
 }
 
+void AllocatedBase::read_back(uint8_t *data, size_t size, size_t offset) const
+{
+	VK_CHECK(vmaInvalidateAllocation(get_memory_allocator(), allocation_, offset, size));
+
+	if (persistent_)
+	{
+		std::copy_n(mapped_data_ + offset, size, data);
+		return;
+	}
+
+	// Mappings are reference counted by VMA, so this leaves a mapping made with map() in place
+	void *mapped_data = nullptr;
+	VK_CHECK(vmaMapMemory(get_memory_allocator(), allocation_, &mapped_data));
+	std::copy_n(static_cast<const uint8_t *>(mapped_data) + offset, size, data);
+	vmaUnmapMemory(get_memory_allocator(), allocation_);
+}
+
 void AllocatedBase::post_create(VmaAllocationInfo const &allocation_info)
 {
 	VkMemoryPropertyFlags memory_properties;
@@ -111,6 +220,15 @@ void AllocatedBase::post_create(VmaAllocationInfo const &allocation_info)
 	coherent_    = (memory_properties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
 	mapped_data_ = static_cast<uint8_t *>(allocation_info.pMappedData);
 	persistent_  = mapped();
+
+	// Shows up in the detailed map, the debug name is only known to the Vulkan object
+	vmaSetAllocationName(get_memory_allocator(), allocation_, to_string(memory_category_));
+
+	allocation_size_ = allocation_info.size;
+
+	auto &counters = get_category_counters()[static_cast<size_t>(memory_category_)];
+	counters.allocation_count.fetch_add(1, std::memory_order_relaxed);
+	counters.allocation_bytes.fetch_add(allocation_size_, std::memory_order_relaxed);
 }
 
 vk::Buffer AllocatedBase::create_buffer(vk::BufferCreateInfo const &create_info)
@@ -165,11 +283,22 @@ void AllocatedBase::destroy_image(vk::Image image)
 
 void AllocatedBase::clear()
 {
+	auto &counters = get_category_counters()[static_cast<size_t>(memory_category_)];
+	counters.allocation_count.fetch_sub(1, std::memory_order_relaxed);
+	counters.allocation_bytes.fetch_sub(allocation_size_, std::memory_order_relaxed);
+
+	allocation_size_   = 0;
 	mapped_data_       = nullptr;
 	persistent_        = false;
 	alloc_create_info_ = {};
 }
 
+void AllocatedBase::set_memory_category(MemoryCategory category)
+{
+	assert(allocation_ == VK_NULL_HANDLE && "The category must be set before allocating");
+	memory_category_ = category;
+}
+
 void init(const VmaAllocatorCreateInfo &create_info)
 {
 	VkResult result = vmaCreateAllocator(&create_info, &get_memory_allocator());
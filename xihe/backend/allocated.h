@@ -14,12 +14,45 @@ class Device;
 
 namespace allocated
 {
+/**
+ * \brief What an allocation is used for, totals are kept per category to see where device memory goes
+ */
+enum class MemoryCategory
+{
+	kOther,
+	kRenderGraph,
+	kGpuScene,
+	kTexture,
+	kStaging,
+	kBufferPool,
+
+	kCount
+};
+
+const char *to_string(MemoryCategory category);
+
+struct CategoryStatistics
+{
+	uint64_t allocation_count{0};
+	uint64_t allocation_bytes{0};
+};
+
+/**
+ * \brief Usage and budget of a memory heap, in bytes
+ */
+struct HeapBudget
+{
+	vk::DeviceSize usage{0};
+	vk::DeviceSize budget{0};
+};
+
 template <typename BuilderType,
           typename CreateInfoType>
 struct Builder
 {
 	VmaAllocationCreateInfo allocation_create_info{};
 	std::string             debug_name;
+	MemoryCategory          memory_category{MemoryCategory::kOther};
 	CreateInfoType          create_info;
 
   protected:
@@ -37,6 +70,12 @@ struct Builder
 		return static_cast<BuilderType &>(*this);
 	}
 
+	BuilderType &with_memory_category(MemoryCategory category)
+	{
+		memory_category = category;
+		return static_cast<BuilderType &>(*this);
+	}
+
 	BuilderType &with_vma_usage(VmaMemoryUsage usage)
 	{
 		allocation_create_info.usage = usage;
@@ -106,6 +145,20 @@ VmaAllocator &get_memory_allocator();
 
 void shutdown();
 
+CategoryStatistics get_category_statistics(MemoryCategory category);
+
+/**
+ * \brief Usage and budget summed over the device local heaps. Both come from VK_EXT_memory_budget when it is enabled,
+ *        otherwise VMA estimates them from its own allocations and 80% of the heap sizes
+ */
+HeapBudget get_device_local_budget();
+
+/**
+ * \brief Writes the detailed map of the allocator as JSON: every heap, memory type, block and allocation,
+ *        allocations are named after their category
+ */
+void write_detailed_map(const std::string &path);
+
 class AllocatedBase
 {
   public:
@@ -127,6 +180,8 @@ class AllocatedBase
 
 	bool mapped() const;
 
+	bool is_host_visible() const;
+
 	uint8_t *map();
 
 	void unmap();
@@ -153,6 +208,11 @@ class AllocatedBase
 		return update(reinterpret_cast<const uint8_t *>(&object), sizeof(T), offset);
 	}
 
+	/**
+	 * @brief Copies from HOST_VISIBLE memory, which is mapped for the copy if it is not persistently mapped
+	 */
+	void read_back(uint8_t *data, size_t size, size_t offset = 0) const;
+
   protected:
 	virtual void             post_create(VmaAllocationInfo const &allocation_info);
 	[[nodiscard]] vk::Buffer create_buffer(vk::BufferCreateInfo const &create_info);
@@ -161,8 +221,13 @@ class AllocatedBase
 	void                     destroy_image(vk::Image image);
 	void                     clear();
 
+	/// Must be set before the buffer or image is created
+	void set_memory_category(MemoryCategory category);
+
 	VmaAllocationCreateInfo alloc_create_info_{};
 	VmaAllocation           allocation_{VK_NULL_HANDLE};
+	MemoryCategory          memory_category_{MemoryCategory::kOther};
+	vk::DeviceSize          allocation_size_{0};
 	uint8_t                *mapped_data_{nullptr};
 	bool                    coherent_{false};
 	bool                    persistent_{false};        // Whether the buffer is persistently mapped or not
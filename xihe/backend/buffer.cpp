@@ -19,6 +19,7 @@ Buffer Buffer::create_staging_buffer(Device &device, vk::DeviceSize size, const
 	BufferBuilder builder{size};
 	builder.with_usage(vk::BufferUsageFlagBits::eTransferSrc);
 	builder.with_vma_flags(VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+	builder.with_memory_category(allocated::MemoryCategory::kStaging);
 	auto staging_buffer = builder.build(device);
 
 	if (data != nullptr)
@@ -30,8 +31,10 @@ Buffer Buffer::create_staging_buffer(Device &device, vk::DeviceSize size, const
 
 Buffer::Buffer(Device &device, BufferBuilder const &builder) :
 Parent{builder.allocation_create_info, nullptr, &device},
-size_{builder.create_info.size}
+size_{builder.create_info.size},
+usage_{builder.create_info.usage}
 {
+	set_memory_category(builder.memory_category);
 	get_handle() = create_buffer(builder.create_info);
 
 	if (!builder.debug_name.empty())
@@ -42,7 +45,8 @@ size_{builder.create_info.size}
 
 Buffer::Buffer(Buffer &&other) noexcept:
     Allocated{static_cast<Allocated &&>(other)},
-    size_(std::exchange(other.size_, {}))
+    size_(std::exchange(other.size_, {})),
+    usage_(std::exchange(other.usage_, {}))
 {}
 
 Buffer::~Buffer()
@@ -59,4 +63,9 @@ vk::DeviceSize Buffer::get_size() const
 {
 	return size_;
 }
+
+vk::BufferUsageFlags Buffer::get_usage() const
+{
+	return usage_;
+}
 }
@@ -98,8 +98,11 @@ class Buffer : public allocated::Allocated<vk::Buffer>
 
 	vk::DeviceSize get_size() const;
 
+	vk::BufferUsageFlags get_usage() const;
+
   private:
-	vk::DeviceSize size_{0};
+	vk::DeviceSize       size_{0};
+	vk::BufferUsageFlags usage_;
 };
 
 }        // namespace xihe::backend
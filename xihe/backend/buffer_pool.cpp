@@ -52,6 +52,7 @@ BufferBlock::BufferBlock(Device &device, vk::DeviceSize size, vk::BufferUsageFla
 	BufferBuilder builder{size};
 	builder.with_usage(usage);
 	builder.with_vma_usage(memory_usage);
+	builder.with_memory_category(allocated::MemoryCategory::kBufferPool);
 	buffer_ = builder.build_unique(device);
 
 	if (usage == vk::BufferUsageFlagBits::eUniformBuffer)
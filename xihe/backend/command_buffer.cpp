@@ -2,6 +2,8 @@
 
 #include "backend/command_pool.h"
 #include "backend/device.h"
+#include "backend/query_pool.h"
+#include "rendering/frame_capture.h"
 #include "rendering/render_frame.h"
 #include "vulkan/vulkan_format_traits.hpp"
 
@@ -50,7 +52,7 @@ vk::Result CommandBuffer::begin(vk::CommandBufferUsageFlags flags, CommandBuffer
 }
 
 
-void CommandBuffer::begin_rendering(rendering::RenderTarget &render_target, const std::vector<vk::ClearValue> &clear_values)
+void CommandBuffer::begin_rendering(rendering::RenderTarget &render_target, const std::vector<vk::ClearValue> &clear_values, const vk::Extent2D &render_area)
 {
 	pipeline_state_.reset();
 
@@ -92,11 +94,20 @@ void CommandBuffer::begin_rendering(rendering::RenderTarget &render_target, cons
 		}
 	}
 
-	set_attachments_state(attachments_state);
+	pipeline_state_.set_attachments_state(attachments_state);
 
 	auto blend_state = pipeline_state_.get_color_blend_state();
 	blend_state.attachments.resize(color_attachments_.size());
-	set_color_blend_state(blend_state);
+	pipeline_state_.set_color_blend_state(blend_state);
+
+	if (capture_)
+	{
+		for (const auto &view : render_target.get_views())
+		{
+			capture_->mark_written(view.get_image());
+		}
+		capture_->record(rendering::CaptureCommand::kBeginRendering, capture_->add_resource(render_target), clear_values, render_area);
+	}
 
 	vk::RenderingAttachmentInfo *p_depth_attachment = nullptr;
 	if (depth_attachment_.has_value())
@@ -106,7 +117,7 @@ void CommandBuffer::begin_rendering(rendering::RenderTarget &render_target, cons
 
 	vk::RenderingInfo rendering_info(
 	    {},                                                     // flags
-	    {{}, render_target.get_extent()},                       // renderArea
+	    {{}, render_area.width != 0 ? render_area : render_target.get_extent()},        // renderArea
 	    layer_count,                                             // layerCount
 	    0,                                                      // viewMask
 	    static_cast<uint32_t>(color_attachments_.size()),        // colorAttachmentCount
@@ -134,16 +145,31 @@ void CommandBuffer::execute_commands(std::vector<CommandBuffer *> &secondary_com
 
 void CommandBuffer::end_rendering()
 {
+	if (capture_)
+	{
+		capture_->record(rendering::CaptureCommand::kEndRendering);
+	}
+
 	get_handle().endRendering();
 }
 
 void CommandBuffer::set_specialization_constant(uint32_t constant_id, const std::vector<uint8_t> &data)
 {
+	if (capture_)
+	{
+		capture_->record(rendering::CaptureCommand::kSetSpecializationConstant, constant_id, data);
+	}
+
 	pipeline_state_.set_specialization_constant(constant_id, data);
 }
 
 void CommandBuffer::push_constants(const std::vector<uint8_t> &values)
 {
+	if (capture_)
+	{
+		capture_->record(rendering::CaptureCommand::kPushConstants, values);
+	}
+
 	uint32_t size = to_u32(stored_push_constants_.size() + values.size());
 
 	if (size > max_push_constants_size_)
@@ -157,26 +183,51 @@ void CommandBuffer::push_constants(const std::vector<uint8_t> &values)
 
 void CommandBuffer::bind_buffer(const backend::Buffer &buffer, VkDeviceSize offset, VkDeviceSize range, uint32_t set, uint32_t binding, uint32_t array_element)
 {
+	if (capture_)
+	{
+		capture_->record(rendering::CaptureCommand::kBindBuffer, capture_->add_resource(buffer), offset, range, set, binding, array_element);
+	}
+
 	resource_binding_state_.bind_buffer(buffer, offset, range, set, binding, array_element);
 }
 
 void CommandBuffer::bind_image(const backend::ImageView &image_view, const backend::Sampler &sampler, uint32_t set, uint32_t binding, uint32_t array_element)
 {
+	if (capture_)
+	{
+		capture_->record(rendering::CaptureCommand::kBindImage, capture_->add_resource(image_view), capture_->add_resource(sampler), set, binding, array_element);
+	}
+
 	resource_binding_state_.bind_image(image_view, sampler, set, binding, array_element);
 }
 
 void CommandBuffer::bind_image(const backend::ImageView &image_view, uint32_t set, uint32_t binding, uint32_t array_element)
 {
+	if (capture_)
+	{
+		capture_->record(rendering::CaptureCommand::kBindImageWithoutSampler, capture_->add_resource(image_view), set, binding, array_element);
+	}
+
 	resource_binding_state_.bind_image(image_view, set, binding, array_element);
 }
 
 void CommandBuffer::bind_input(const backend::ImageView &image_view, uint32_t set, uint32_t binding, uint32_t array_element)
 {
+	if (capture_)
+	{
+		capture_->record(rendering::CaptureCommand::kBindInput, capture_->add_resource(image_view), set, binding, array_element);
+	}
+
 	resource_binding_state_.bind_input(image_view, set, binding, array_element);
 }
 
 void CommandBuffer::bind_index_buffer(const backend::Buffer &buffer, vk::DeviceSize offset, vk::IndexType index_type)
 {
+	if (capture_)
+	{
+		capture_->record(rendering::CaptureCommand::kBindIndexBuffer, capture_->add_resource(buffer), offset, index_type);
+	}
+
 	get_handle().bindIndexBuffer(buffer.get_handle(), offset, index_type);
 }
 
@@ -186,14 +237,29 @@ vk::Result CommandBuffer::end()
 	return vk::Result::eSuccess;
 }
 
+CommandPool &CommandBuffer::get_command_pool() const
+{
+	return command_pool_;
+}
+
 void CommandBuffer::draw(uint32_t vertex_count, uint32_t instance_count, uint32_t first_vertex, uint32_t first_instance)
 {
+	if (capture_)
+	{
+		capture_->record(rendering::CaptureCommand::kDraw, vertex_count, instance_count, first_vertex, first_instance);
+	}
+
 	flush(vk::PipelineBindPoint::eGraphics);
 	get_handle().draw(vertex_count, instance_count, first_vertex, first_instance);
 }
 
 void CommandBuffer::draw_indexed(uint32_t index_count, uint32_t instance_count, uint32_t first_index, int32_t vertex_offset, uint32_t first_instance)
 {
+	if (capture_)
+	{
+		capture_->record(rendering::CaptureCommand::kDrawIndexed, index_count, instance_count, first_index, vertex_offset, first_instance);
+	}
+
 	flush(vk::PipelineBindPoint::eGraphics);
 
 	get_handle().drawIndexed(index_count, instance_count, first_index, vertex_offset, first_instance);
@@ -201,6 +267,11 @@ void CommandBuffer::draw_indexed(uint32_t index_count, uint32_t instance_count,
 
 void CommandBuffer::draw_indexed_indirect(const backend::Buffer &buffer, vk::DeviceSize offset, uint32_t draw_count, uint32_t stride)
 {
+	if (capture_)
+	{
+		capture_->record(rendering::CaptureCommand::kDrawIndexedIndirect, capture_->add_resource(buffer), offset, draw_count, stride);
+	}
+
 	flush(vk::PipelineBindPoint::eGraphics);
 
 	get_handle().drawIndexedIndirect(buffer.get_handle(), offset, draw_count, stride);
@@ -208,6 +279,11 @@ void CommandBuffer::draw_indexed_indirect(const backend::Buffer &buffer, vk::Dev
 
 void CommandBuffer::dispatch(uint32_t group_count_x, uint32_t group_count_y, uint32_t group_count_z)
 {
+	if (capture_)
+	{
+		capture_->record(rendering::CaptureCommand::kDispatch, group_count_x, group_count_y, group_count_z);
+	}
+
 	flush(vk::PipelineBindPoint::eCompute);
 
 	get_handle().dispatch(group_count_x, group_count_y, group_count_z);
@@ -215,6 +291,11 @@ void CommandBuffer::dispatch(uint32_t group_count_x, uint32_t group_count_y, uin
 
 void CommandBuffer::dispatch_indirect(const backend::Buffer &buffer, vk::DeviceSize offset)
 {
+	if (capture_)
+	{
+		capture_->record(rendering::CaptureCommand::kDispatchIndirect, capture_->add_resource(buffer), offset);
+	}
+
 	flush(vk::PipelineBindPoint::eCompute);
 
 	get_handle().dispatchIndirect(buffer.get_handle(), offset);
@@ -222,6 +303,11 @@ void CommandBuffer::dispatch_indirect(const backend::Buffer &buffer, vk::DeviceS
 
 void CommandBuffer::draw_mesh_tasks(uint32_t group_count_x, uint32_t group_count_y, uint32_t group_count_z)
 {
+	if (capture_)
+	{
+		capture_->record(rendering::CaptureCommand::kDrawMeshTasks, group_count_x, group_count_y, group_count_z);
+	}
+
 	flush(vk::PipelineBindPoint::eGraphics);
 
 	get_handle().drawMeshTasksEXT(group_count_x, group_count_y, group_count_z);
@@ -229,58 +315,118 @@ void CommandBuffer::draw_mesh_tasks(uint32_t group_count_x, uint32_t group_count
 
 void CommandBuffer::draw_mesh_tasks_indirect(const backend::Buffer &buffer, vk::DeviceSize offset, uint32_t draw_count, uint32_t stride)
 {
+	if (capture_)
+	{
+		capture_->record(rendering::CaptureCommand::kDrawMeshTasksIndirect, capture_->add_resource(buffer), offset, draw_count, stride);
+	}
+
 	flush(vk::PipelineBindPoint::eGraphics);
 	get_handle().drawMeshTasksIndirectEXT(buffer.get_handle(), offset, draw_count, stride);
 }
 
 void CommandBuffer::draw_mesh_tasks_indirect_count(const backend::Buffer &buffer, vk::DeviceSize offset, const backend::Buffer &count_buffer, vk::DeviceSize count_buffer_offset, uint32_t max_draw_count, uint32_t stride)
 {
+	if (capture_)
+	{
+		capture_->record(rendering::CaptureCommand::kDrawMeshTasksIndirectCount, capture_->add_resource(buffer), offset, capture_->add_resource(count_buffer), count_buffer_offset, max_draw_count, stride);
+	}
+
 	flush(vk::PipelineBindPoint::eGraphics);
 	get_handle().drawMeshTasksIndirectCountEXT(buffer.get_handle(), offset, count_buffer.get_handle(), count_buffer_offset, max_draw_count, stride);
 }
 
 void CommandBuffer::update_buffer(const backend::Buffer &buffer, vk::DeviceSize offset, const std::vector<uint8_t> &data)
 {
+	if (capture_)
+	{
+		capture_->record(rendering::CaptureCommand::kUpdateBuffer, capture_->add_resource(buffer), offset, data);
+	}
+
 	get_handle().updateBuffer(buffer.get_handle(), offset, data.size(), data.data());
 }
 
 void CommandBuffer::clear_buffer(const backend::Buffer &buffer)
 {
+	if (capture_)
+	{
+		capture_->record(rendering::CaptureCommand::kClearBuffer, capture_->add_resource(buffer));
+	}
+
 	get_handle().fillBuffer(buffer.get_handle(), 0, buffer.get_size(), 0);
 }
 
 void CommandBuffer::blit_image(const backend::Image &src_img, const backend::Image &dst_img, const std::vector<vk::ImageBlit> &regions)
 {
+	if (capture_)
+	{
+		capture_->mark_written(dst_img);
+		capture_->record(rendering::CaptureCommand::kBlitImage, capture_->add_resource(src_img), capture_->add_resource(dst_img), regions);
+	}
+
 	get_handle().blitImage(src_img.get_handle(), vk::ImageLayout::eTransferSrcOptimal, dst_img.get_handle(), vk::ImageLayout::eTransferDstOptimal, regions, vk::Filter::eLinear);
 }
 
 void CommandBuffer::resolve_image(const backend::Image &src_img, const backend::Image &dst_img, const std::vector<vk::ImageResolve> &regions)
 {
+	if (capture_)
+	{
+		capture_->mark_written(dst_img);
+		capture_->record(rendering::CaptureCommand::kResolveImage, capture_->add_resource(src_img), capture_->add_resource(dst_img), regions);
+	}
+
 	get_handle().resolveImage(src_img.get_handle(), vk::ImageLayout::eTransferSrcOptimal, dst_img.get_handle(), vk::ImageLayout::eTransferDstOptimal, regions);
 }
 
 void CommandBuffer::copy_buffer(const backend::Buffer &src_buffer, const backend::Buffer &dst_buffer, vk::DeviceSize size)
 {
+	if (capture_)
+	{
+		capture_->record(rendering::CaptureCommand::kCopyBuffer, capture_->add_resource(src_buffer), capture_->add_resource(dst_buffer), size);
+	}
+
 	get_handle().copyBuffer(src_buffer.get_handle(), dst_buffer.get_handle(), vk::BufferCopy(0, 0, size));
 }
 
 void CommandBuffer::copy_image(const backend::Image &src_img, const backend::Image &dst_img, const std::vector<vk::ImageCopy> &regions)
 {
+	if (capture_)
+	{
+		capture_->mark_written(dst_img);
+		capture_->record(rendering::CaptureCommand::kCopyImage, capture_->add_resource(src_img), capture_->add_resource(dst_img), regions);
+	}
+
 	get_handle().copyImage(src_img.get_handle(), vk::ImageLayout::eTransferSrcOptimal, dst_img.get_handle(), vk::ImageLayout::eTransferDstOptimal, regions);
 }
 
 void CommandBuffer::copy_buffer_to_image(const backend::Buffer &buffer, const backend::Image &image, const std::vector<vk::BufferImageCopy> &regions)
 {
+	if (capture_)
+	{
+		capture_->mark_written(image);
+		capture_->record(rendering::CaptureCommand::kCopyBufferToImage, capture_->add_resource(buffer), capture_->add_resource(image), regions);
+	}
+
 	get_handle().copyBufferToImage(buffer.get_handle(), image.get_handle(), vk::ImageLayout::eTransferDstOptimal, regions);
 }
 
 void CommandBuffer::copy_image_to_buffer(const backend::Image &image, vk::ImageLayout image_layout, const backend::Buffer &buffer, const std::vector<vk::BufferImageCopy> &regions)
 {
+	if (capture_)
+	{
+		capture_->record(rendering::CaptureCommand::kCopyImageToBuffer, capture_->add_resource(image), image_layout, capture_->add_resource(buffer), regions);
+	}
+
 	get_handle().copyImageToBuffer(image.get_handle(), image_layout, buffer.get_handle(), regions);
 }
 
 void CommandBuffer::image_memory_barrier(const backend::ImageView &image_view, const common::ImageMemoryBarrier &memory_barrier) const
 {
+	if (capture_)
+	{
+		capture_->track_layout(image_view.get_image().get_handle(), memory_barrier.old_layout, memory_barrier.new_layout);
+		capture_->record(rendering::CaptureCommand::kImageMemoryBarrier, capture_->add_resource(image_view), memory_barrier);
+	}
+
 	auto subresource_range = image_view.get_subresource_range();
 	auto format            = image_view.get_format();
 
@@ -299,6 +445,11 @@ void CommandBuffer::image_memory_barrier(const backend::ImageView &image_view, c
 
 void CommandBuffer::buffer_memory_barrier(const backend::Buffer &buffer, vk::DeviceSize offset, vk::DeviceSize size, const common::BufferMemoryBarrier &memory_barrier)
 {
+	if (capture_)
+	{
+		capture_->record(rendering::CaptureCommand::kBufferMemoryBarrier, capture_->add_resource(buffer), offset, size, memory_barrier);
+	}
+
 	vk::BufferMemoryBarrier2 buffer_memory_barrier{
 	    memory_barrier.src_stage_mask,
 	    memory_barrier.src_access_mask,
@@ -314,13 +465,70 @@ void CommandBuffer::buffer_memory_barrier(const backend::Buffer &buffer, vk::Dev
 	get_handle().pipelineBarrier2(dependency_info);
 }
 
+void CommandBuffer::pipeline_barrier(const std::vector<vk::ImageMemoryBarrier2> &image_barriers, const std::vector<vk::BufferMemoryBarrier2> &buffer_barriers)
+{
+	if (capture_)
+	{
+		for (const auto &barrier : image_barriers)
+		{
+			capture_->track_layout(barrier.image, barrier.oldLayout, barrier.newLayout);
+		}
+		capture_->record(rendering::CaptureCommand::kPipelineBarrier, image_barriers, buffer_barriers);
+	}
+
+	vk::DependencyInfo dependency_info{};
+	dependency_info.setImageMemoryBarriers(image_barriers);
+	dependency_info.setBufferMemoryBarriers(buffer_barriers);
+	get_handle().pipelineBarrier2(dependency_info);
+}
+
 void CommandBuffer::set_update_after_bind(bool update_after_bind)
 {
+	if (capture_)
+	{
+		capture_->record(rendering::CaptureCommand::kSetUpdateAfterBind, update_after_bind);
+	}
+
 	update_after_bind_ = update_after_bind;
 }
 
+void CommandBuffer::set_frame_capture(rendering::FrameCapture *capture)
+{
+	capture_ = capture;
+}
+
+void CommandBuffer::reset_query_pool(const QueryPool &query_pool, uint32_t first_query, uint32_t query_count)
+{
+	get_handle().resetQueryPool(query_pool.get_handle(), first_query, query_count);
+}
+
+void CommandBuffer::begin_query(const QueryPool &query_pool, uint32_t query, vk::QueryControlFlags flags)
+{
+	get_handle().beginQuery(query_pool.get_handle(), query, flags);
+}
+
+void CommandBuffer::end_query(const QueryPool &query_pool, uint32_t query)
+{
+	get_handle().endQuery(query_pool.get_handle(), query);
+}
+
+void CommandBuffer::write_timestamp(vk::PipelineStageFlagBits2 pipeline_stage, const QueryPool &query_pool, uint32_t query)
+{
+	get_handle().writeTimestamp2(pipeline_stage, query_pool.get_handle(), query);
+}
+
 void CommandBuffer::bind_vertex_buffers(uint32_t first_binding, const std::vector<std::reference_wrapper<const backend::Buffer>> &buffers, const std::vector<vk::DeviceSize> &offsets)
 {
+	if (capture_)
+	{
+		std::vector<uint64_t> buffer_keys;
+		for (const backend::Buffer &buffer : buffers)
+		{
+			buffer_keys.push_back(capture_->add_resource(buffer));
+		}
+		capture_->record(rendering::CaptureCommand::kBindVertexBuffers, first_binding, buffer_keys, offsets);
+	}
+
 	std::vector<vk::Buffer> buffer_handles(buffers.size(), nullptr);
 
 	std::ranges::transform(buffers, buffer_handles.begin(), [](const backend::Buffer &buffer) { return buffer.get_handle(); });
@@ -342,81 +550,161 @@ vk::Result CommandBuffer::reset(ResetMode reset_mode)
 
 void CommandBuffer::set_viewport_state(const ViewportState &state_info)
 {
+	if (capture_)
+	{
+		capture_->record(rendering::CaptureCommand::kSetViewportState, state_info);
+	}
+
 	pipeline_state_.set_viewport_state(state_info);
 }
 
 void CommandBuffer::set_attachments_state(const AttachmentsState &state_info)
 {
+	if (capture_)
+	{
+		capture_->record(rendering::CaptureCommand::kSetAttachmentsState, state_info.color_attachment_formats, state_info.depth_attachment_format, state_info.stencil_attachment_format);
+	}
+
 	pipeline_state_.set_attachments_state(state_info);
 }
 
 void CommandBuffer::set_vertex_input_state(const VertexInputState &state_info)
 {
+	if (capture_)
+	{
+		capture_->record(rendering::CaptureCommand::kSetVertexInputState, state_info.bindings, state_info.attributes);
+	}
+
 	pipeline_state_.set_vertex_input_state(state_info);
 }
 
 void CommandBuffer::set_input_assembly_state(const InputAssemblyState &state_info)
 {
+	if (capture_)
+	{
+		capture_->record(rendering::CaptureCommand::kSetInputAssemblyState, state_info);
+	}
+
 	pipeline_state_.set_input_assembly_state(state_info);
 }
 
 void CommandBuffer::set_rasterization_state(const RasterizationState &state_info)
 {
+	if (capture_)
+	{
+		capture_->record(rendering::CaptureCommand::kSetRasterizationState, state_info);
+	}
+
 	pipeline_state_.set_rasterization_state(state_info);
 }
 
 void CommandBuffer::set_multisample_state(const MultisampleState &state_info)
 {
+	if (capture_)
+	{
+		capture_->record(rendering::CaptureCommand::kSetMultisampleState, state_info);
+	}
+
 	pipeline_state_.set_multisample_state(state_info);
 }
 
 void CommandBuffer::set_depth_stencil_state(const DepthStencilState &state_info)
 {
+	if (capture_)
+	{
+		capture_->record(rendering::CaptureCommand::kSetDepthStencilState, state_info);
+	}
+
 	pipeline_state_.set_depth_stencil_state(state_info);
 }
 
 void CommandBuffer::set_color_blend_state(const ColorBlendState &state_info)
 {
+	if (capture_)
+	{
+		capture_->record(rendering::CaptureCommand::kSetColorBlendState, state_info.logic_op_enable, state_info.logic_op, state_info.attachments);
+	}
+
 	pipeline_state_.set_color_blend_state(state_info);
 }
 
 void CommandBuffer::set_viewport(uint32_t first_viewport, const std::vector<vk::Viewport> &viewports)
 {
+	if (capture_)
+	{
+		capture_->record(rendering::CaptureCommand::kSetViewport, first_viewport, viewports);
+	}
+
 	get_handle().setViewport(first_viewport, viewports);
 }
 
 void CommandBuffer::set_scissor(uint32_t first_scissor, const std::vector<vk::Rect2D> &scissors)
 {
+	if (capture_)
+	{
+		capture_->record(rendering::CaptureCommand::kSetScissor, first_scissor, scissors);
+	}
+
 	get_handle().setScissor(first_scissor, scissors);
 }
 
 void CommandBuffer::set_line_width(float line_width)
 {
+	if (capture_)
+	{
+		capture_->record(rendering::CaptureCommand::kSetLineWidth, line_width);
+	}
+
 	get_handle().setLineWidth(line_width);
 }
 
 void CommandBuffer::set_depth_bias(float depth_bias_constant_factor, float depth_bias_clamp, float depth_bias_slope_factor)
 {
+	if (capture_)
+	{
+		capture_->record(rendering::CaptureCommand::kSetDepthBias, depth_bias_constant_factor, depth_bias_clamp, depth_bias_slope_factor);
+	}
+
 	get_handle().setDepthBias(depth_bias_constant_factor, depth_bias_clamp, depth_bias_slope_factor);
 }
 
 void CommandBuffer::set_blend_constants(const std::array<float, 4> &blend_constants)
 {
+	if (capture_)
+	{
+		capture_->record(rendering::CaptureCommand::kSetBlendConstants, blend_constants);
+	}
+
 	get_handle().setBlendConstants(blend_constants.data());
 }
 
 void CommandBuffer::set_depth_bounds(float min_depth_bounds, float max_depth_bounds)
 {
+	if (capture_)
+	{
+		capture_->record(rendering::CaptureCommand::kSetDepthBounds, min_depth_bounds, max_depth_bounds);
+	}
+
 	get_handle().setDepthBounds(min_depth_bounds, max_depth_bounds);
 }
 
 void CommandBuffer::set_has_mesh_shader(bool has_mesh_shader)
 {
+	if (capture_)
+	{
+		capture_->record(rendering::CaptureCommand::kSetHasMeshShader, has_mesh_shader);
+	}
+
 	pipeline_state_.set_has_mesh_shader(has_mesh_shader);
 }
 
 void CommandBuffer::bind_pipeline_layout(PipelineLayout &pipeline_layout)
 {
+	if (capture_)
+	{
+		capture_->record(rendering::CaptureCommand::kBindPipelineLayout, capture_->add_resource(pipeline_layout));
+	}
+
 	pipeline_state_.set_pipeline_layout(pipeline_layout);
 }
 
@@ -14,12 +14,14 @@ struct LightingState;
 
 namespace rendering
 {
+class FrameCapture;
 class Subpass;
 }
 
 namespace backend
 {
 class CommandPool;
+class QueryPool;
 class DescriptorSetLayout;
 class BindlessDescriptorSet;
 
@@ -45,8 +47,12 @@ class CommandBuffer : public VulkanResource<vk::CommandBuffer>
 
 	vk::Result begin(vk::CommandBufferUsageFlags flags, CommandBuffer *primary_cmd_buf = nullptr);
 
-	void begin_rendering(rendering::RenderTarget     &render_target,
-	                     const std::vector<vk::ClearValue> &clear_values = {});
+	/**
+	 * \param render_area Area of the attachments rendered to, from the origin, the whole render target if empty
+	 */
+	void begin_rendering(rendering::RenderTarget           &render_target,
+	                     const std::vector<vk::ClearValue> &clear_values = {},
+	                     const vk::Extent2D                &render_area  = {});
 
 
 	void execute_commands(CommandBuffer &secondary_command_buffer);
@@ -57,6 +63,8 @@ class CommandBuffer : public VulkanResource<vk::CommandBuffer>
 
 	vk::Result end();
 
+	CommandPool &get_command_pool() const;
+
 	template <class T>
 	void set_specialization_constant(uint32_t constant_id, const T &data)
 	{
@@ -70,17 +78,7 @@ class CommandBuffer : public VulkanResource<vk::CommandBuffer>
 	template <typename T>
 	void push_constants(const T &value)
 	{
-		auto data = to_bytes(value);
-
-		uint32_t size = to_u32(stored_push_constants_.size() + data.size());
-
-		if (size > max_push_constants_size_)
-		{
-			LOGE("Push constant limit exceeded ({} / {} bytes)", size, max_push_constants_size_);
-			throw std::runtime_error("Cannot overflow push constant limit");
-		}
-
-		stored_push_constants_.insert(stored_push_constants_.end(), data.begin(), data.end());
+		push_constants(to_bytes(value));
 	}
 
 	void bind_buffer(const backend::Buffer &buffer, VkDeviceSize offset, VkDeviceSize range, uint32_t set, uint32_t binding, uint32_t array_element);
@@ -171,15 +169,24 @@ class CommandBuffer : public VulkanResource<vk::CommandBuffer>
 
 	void buffer_memory_barrier(const backend::Buffer &buffer, vk::DeviceSize offset, vk::DeviceSize size, const common::BufferMemoryBarrier &memory_barrier);
 
+	/// Barriers batched by the render graph, submitted with a single vkCmdPipelineBarrier2
+	void pipeline_barrier(const std::vector<vk::ImageMemoryBarrier2> &image_barriers, const std::vector<vk::BufferMemoryBarrier2> &buffer_barriers);
+
 	void set_update_after_bind(bool update_after_bind);
 
-	/*void reset_query_pool(const QueryPool &query_pool, uint32_t first_query, uint32_t query_count);
+	/**
+	 * \brief Records the commands issued through this command buffer into the capture until it is unset,
+	 *        query commands are not recorded
+	 */
+	void set_frame_capture(rendering::FrameCapture *capture);
+
+	void reset_query_pool(const QueryPool &query_pool, uint32_t first_query, uint32_t query_count);
 
 	void begin_query(const QueryPool &query_pool, uint32_t query, vk::QueryControlFlags flags);
 
 	void end_query(const QueryPool &query_pool, uint32_t query);
 
-	void write_timestamp(vk::PipelineStageFlagBits pipeline_stage, const QueryPool &query_pool, uint32_t query);*/
+	void write_timestamp(vk::PipelineStageFlagBits2 pipeline_stage, const QueryPool &query_pool, uint32_t query);
 
   private:
 	void flush(vk::PipelineBindPoint pipeline_bind_point);
@@ -206,6 +213,8 @@ class CommandBuffer : public VulkanResource<vk::CommandBuffer>
 	bool update_after_bind_ = false;
 
 	std::unordered_map<uint32_t, DescriptorSetLayout const *> descriptor_set_layout_binding_state_;
+
+	rendering::FrameCapture *capture_{nullptr};
 };
 }        // namespace backend
 }        // namespace xihe
@@ -231,9 +231,10 @@ BindlessDescriptorSet::BindlessDescriptorSet(Device &device) :
 	    vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool,
 	    bindings};
 
+	// Slots are written while frames in flight sample the others, see allocate
 	std::vector<vk::DescriptorBindingFlags> binding_flags = {
-	    vk::DescriptorBindingFlagBits::eUpdateAfterBind | vk::DescriptorBindingFlagBits::ePartiallyBound,
-	    vk::DescriptorBindingFlagBits::eUpdateAfterBind | vk::DescriptorBindingFlagBits::ePartiallyBound};
+	    vk::DescriptorBindingFlagBits::eUpdateAfterBind | vk::DescriptorBindingFlagBits::ePartiallyBound | vk::DescriptorBindingFlagBits::eUpdateUnusedWhilePending,
+	    vk::DescriptorBindingFlagBits::eUpdateAfterBind | vk::DescriptorBindingFlagBits::ePartiallyBound | vk::DescriptorBindingFlagBits::eUpdateUnusedWhilePending};
 
 	vk::DescriptorSetLayoutBindingFlagsCreateInfoEXT extended_info{
 	    binding_flags};
@@ -282,6 +283,43 @@ void BindlessDescriptorSet::update(uint32_t index, vk::DescriptorImageInfo image
 {
 	assert(index == next_image_index_);
 	next_image_index_++;
+	write(index, image_info);
+}
+
+uint32_t BindlessDescriptorSet::update(vk::DescriptorImageInfo image_info)
+{
+	assert(next_image_index_ < max_bindless_resources_);
+	const auto index = next_image_index_;
+	update(index, image_info);
+	return index;
+}
+
+uint32_t BindlessDescriptorSet::allocate(vk::DescriptorImageInfo image_info)
+{
+	if (free_image_indices_.empty())
+	{
+		return update(image_info);
+	}
+
+	const auto index = free_image_indices_.back();
+	free_image_indices_.pop_back();
+	write(index, image_info);
+	return index;
+}
+
+void BindlessDescriptorSet::release(uint32_t index)
+{
+	assert(index < next_image_index_);
+	free_image_indices_.push_back(index);
+}
+
+uint32_t BindlessDescriptorSet::get_available_count() const
+{
+	return static_cast<uint32_t>(free_image_indices_.size()) + max_bindless_resources_ - next_image_index_;
+}
+
+void BindlessDescriptorSet::write(uint32_t index, vk::DescriptorImageInfo image_info)
+{
 	vk::WriteDescriptorSet write_descriptor_set{
 	    handle_,
 	    bindless_texture_binding_,
@@ -294,14 +332,6 @@ void BindlessDescriptorSet::update(uint32_t index, vk::DescriptorImageInfo image
 	device_.get_handle().updateDescriptorSets({write_descriptor_set}, {});
 }
 
-uint32_t BindlessDescriptorSet::update(vk::DescriptorImageInfo image_info)
-{
-	assert(next_image_index_ < max_bindless_resources_);
-	const auto index = next_image_index_;
-	update(index, image_info);
-	return index;
-}
-
 uint32_t BindlessDescriptorSet::update(vk::DescriptorBufferInfo buffer_info)
 {
 	assert(next_buffer_index_ < max_bindless_resources_);
@@ -323,5 +353,6 @@ uint32_t BindlessDescriptorSet::update(vk::DescriptorBufferInfo buffer_info)
 void BindlessDescriptorSet::reset_index()
 {
 	next_image_index_ = 0;
+	free_image_indices_.clear();
 }
 }        // namespace xihe::backend
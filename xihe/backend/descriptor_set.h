@@ -88,6 +88,18 @@ class BindlessDescriptorSet
 
 	uint32_t update(vk::DescriptorBufferInfo buffer_info);
 
+	/**
+	 * \brief Writes the image to a slot no frame samples, a released one or the next one, for images replaced while
+	 *        the slots of their previous views are still sampled by frames in flight
+	 */
+	uint32_t allocate(vk::DescriptorImageInfo image_info);
+
+	/// Makes the slot available to allocate, once the frames that sampled it retired
+	void release(uint32_t index);
+
+	/// Image slots left to allocate
+	uint32_t get_available_count() const;
+
 	void reset_index();
 
 	static constexpr uint32_t bindless_texture_binding_ = 10;
@@ -96,6 +108,8 @@ class BindlessDescriptorSet
 	static constexpr uint32_t max_bindless_resources_   = 1024;
 
   private:
+	void write(uint32_t index, vk::DescriptorImageInfo image_info);
+
 	Device                 &device_;
 	vk::DescriptorSet       handle_{VK_NULL_HANDLE};
 	vk::DescriptorPool      descriptor_pool_;
@@ -103,6 +117,8 @@ class BindlessDescriptorSet
 
 	uint32_t next_image_index_ = 0;
 	uint32_t next_buffer_index_ = 0;
+
+	std::vector<uint32_t> free_image_indices_;
 };
 
 }        // namespace xihe::backend
@@ -43,6 +43,7 @@ Image::Image(Device                 &device,
     Allocated{handle, &device}
 {
 	create_info_.samples     = sample_count;
+	create_info_.usage       = image_usage;
 	create_info_.format      = format;
 	create_info_.extent      = extent;
 	create_info_.imageType   = find_image_type(extent);
@@ -55,7 +56,16 @@ Image::Image(Device                 &device,
 Image::Image(Device &device, ImageBuilder const &builder) :
     Allocated{builder.allocation_create_info, nullptr, &device}, create_info_{builder.create_info}
 {
-	get_handle()            = create_image(create_info_);
+	set_memory_category(builder.memory_category);
+	if (create_info_.flags & vk::ImageCreateFlagBits::eSparseBinding)
+	{
+		// Sparse images have no allocation, their owner binds memory to them page by page
+		get_handle() = device.get_handle().createImage(create_info_);
+	}
+	else
+	{
+		get_handle() = create_image(create_info_);
+	}
 	subresource_.arrayLayer = create_info_.arrayLayers;
 	subresource_.mipLevel   = create_info_.mipLevels;
 	if (!builder.debug_name.empty())
@@ -103,6 +113,11 @@ Image::Image(Image &&other) noexcept:
 
 Image::~Image()
 {
+	if ((create_info_.flags & vk::ImageCreateFlagBits::eSparseBinding) && get_handle())
+	{
+		get_device().get_handle().destroyImage(get_handle());
+		return;
+	}
 	destroy_image(get_handle());
 }
 
@@ -140,6 +155,11 @@ vk::ImageTiling Image::get_tiling() const
 	return create_info_.tiling;
 }
 
+vk::ImageCreateFlags Image::get_flags() const
+{
+	return create_info_.flags;
+}
+
 vk::SampleCountFlagBits Image::get_sample_count() const
 {
 	return create_info_.samples;
@@ -135,6 +135,7 @@ class Image : public allocated::Allocated<vk::Image>
 	vk::SampleCountFlagBits          get_sample_count() const;
 	vk::ImageUsageFlags              get_usage() const;
 	vk::ImageTiling                  get_tiling() const;
+	vk::ImageCreateFlags             get_flags() const;
 	vk::ImageSubresource             get_subresource() const;
 	uint32_t                         get_array_layer_count() const;
 	std::unordered_set<ImageView *> &get_views();
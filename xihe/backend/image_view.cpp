@@ -9,6 +9,7 @@ namespace xihe::backend
 ImageView::ImageView(Image &image, vk::ImageViewType view_type, vk::Format format, uint32_t base_mip_level, uint32_t base_array_layer, uint32_t n_mip_levels, uint32_t n_array_layers) :
     VulkanResource{nullptr, &image.get_device()},
     image_{&image},
+    view_type_{view_type},
     format_{format}
 {
 	if (format == vk::Format::eUndefined)
@@ -35,6 +36,7 @@ ImageView::ImageView(Image &image, vk::ImageViewType view_type, vk::Format forma
 ImageView::ImageView(ImageView &&other):
     VulkanResource{std::move(other)},
     image_{other.image_},
+    view_type_{other.view_type_},
     format_{other.format_},
     subresource_range_{other.subresource_range_}
 {
@@ -56,6 +58,11 @@ vk::Format ImageView::get_format() const
 	return format_;
 }
 
+vk::ImageViewType ImageView::get_view_type() const
+{
+	return view_type_;
+}
+
 Image const &ImageView::get_image() const
 {
 	assert(image_ && "Image view has no image");
@@ -22,6 +22,7 @@ class ImageView : public VulkanResource<vk::ImageView>
 	~ImageView() override;
 
 	vk::Format                 get_format() const;
+	vk::ImageViewType          get_view_type() const;
 	Image const               &get_image() const;
 	void                       set_image(Image &image);
 	vk::ImageSubresourceLayers get_subresource_layers() const;
@@ -29,6 +30,7 @@ class ImageView : public VulkanResource<vk::ImageView>
 
   private:
 	Image                    *image_{nullptr};
+	vk::ImageViewType         view_type_;
 	vk::Format                format_;
 	vk::ImageSubresourceRange subresource_range_;
 };
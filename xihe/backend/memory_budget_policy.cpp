@@ -0,0 +1,117 @@
+#include "memory_budget_policy.h"
+
+#include <algorithm>
+
+#include "common/logging.h"
+
+namespace xihe::backend
+{
+MemoryBudgetPolicy::MemoryBudgetPolicy(const MemoryBudgetConfig &config)
+{
+	set_config(config);
+}
+
+uint32_t MemoryBudgetPolicy::add_resource(StreamableResource resource)
+{
+	assert(resource.release && "Streamable resources must be able to release memory");
+
+	resources_.emplace(next_id_, std::move(resource));
+	return next_id_++;
+}
+
+void MemoryBudgetPolicy::remove_resource(uint32_t id)
+{
+	resources_.erase(id);
+}
+
+void MemoryBudgetPolicy::set_config(const MemoryBudgetConfig &config)
+{
+	assert(config.target <= config.downsize_threshold && config.downsize_threshold <= config.evict_threshold &&
+	       "Thresholds must be ordered as target <= downsize <= evict");
+	config_ = config;
+}
+
+const MemoryBudgetConfig &MemoryBudgetPolicy::get_config() const
+{
+	return config_;
+}
+
+void MemoryBudgetPolicy::update()
+{
+	update(allocated::get_device_local_budget());
+}
+
+void MemoryBudgetPolicy::update(const allocated::HeapBudget &budget)
+{
+	pressure_ = evaluate_pressure(budget);
+
+	if (cooldown_ > 0)
+	{
+		--cooldown_;
+		return;
+	}
+
+	if (pressure_ == MemoryPressure::kNone || resources_.empty())
+	{
+		return;
+	}
+
+	const auto target = static_cast<vk::DeviceSize>(static_cast<double>(budget.budget) * config_.target);
+	const auto excess = budget.usage - target;
+
+	std::vector<StreamableResource *> resources;
+	resources.reserve(resources_.size());
+	for (auto &[id, resource] : resources_)
+	{
+		resources.push_back(&resource);
+	}
+	std::ranges::stable_sort(resources, {}, &StreamableResource::priority);
+
+	vk::DeviceSize released       = 0;
+	uint32_t       resource_count = 0;
+	for (auto *resource : resources)
+	{
+		const auto bytes = resource->release(pressure_, excess - released);
+		if (bytes > 0)
+		{
+			released += bytes;
+			++resource_count;
+		}
+
+		if (released >= excess)
+		{
+			break;
+		}
+	}
+
+	LOGW("Device memory at {:.1f}% of the budget ({} MiB), {} {} MiB from {} streamable resources",
+	     100.0 * static_cast<double>(budget.usage) / static_cast<double>(budget.budget), budget.budget >> 20,
+	     pressure_ == MemoryPressure::kEvict ? "evicted" : "downsized", released >> 20, resource_count);
+
+	cooldown_ = config_.cooldown_frames;
+}
+
+MemoryPressure MemoryBudgetPolicy::get_pressure() const
+{
+	return pressure_;
+}
+
+MemoryPressure MemoryBudgetPolicy::evaluate_pressure(const allocated::HeapBudget &budget) const
+{
+	if (!config_.enabled || budget.budget == 0)
+	{
+		return MemoryPressure::kNone;
+	}
+
+	const double usage = static_cast<double>(budget.usage) / static_cast<double>(budget.budget);
+	if (usage >= config_.evict_threshold)
+	{
+		return MemoryPressure::kEvict;
+	}
+	if (usage >= config_.downsize_threshold)
+	{
+		return MemoryPressure::kDownsize;
+	}
+	return MemoryPressure::kNone;
+}
+}        // namespace xihe::backend
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <string>
+
+#include "backend/allocated.h"
+
+namespace xihe::backend
+{
+enum class MemoryPressure
+{
+	kNone,
+
+	// Usage is close to the budget, streamable resources drop detail they can stream back in, such as their top mips
+	kDownsize,
+
+	// Usage is at the budget, streamable resources are released entirely
+	kEvict
+};
+
+struct MemoryBudgetConfig
+{
+	bool enabled{true};
+
+	/// Fractions of the device local budget at which the pressure levels start
+	float downsize_threshold{0.85f};
+	float evict_threshold{0.95f};
+
+	/// Fraction of the budget resources are trimmed down to once a threshold is crossed
+	float target{0.75f};
+
+	/// Frames to wait after trimming before checking again, memory is only freed once the frames in flight retire
+	uint32_t cooldown_frames{8};
+};
+
+/**
+ * \brief A resource that can give back device memory and stream it in again later
+ */
+struct StreamableResource
+{
+	std::string name;
+
+	/// Resources with lower priorities are trimmed first
+	int32_t priority{0};
+
+	/// Releases up to the requested bytes at the given pressure, returns the bytes actually released
+	std::function<vk::DeviceSize(MemoryPressure pressure, vk::DeviceSize bytes)> release;
+};
+
+/**
+ * \brief Checks the device local memory budget once per frame and trims the registered streamable resources
+ *        when usage approaches it
+ */
+class MemoryBudgetPolicy
+{
+  public:
+	explicit MemoryBudgetPolicy(const MemoryBudgetConfig &config = {});
+
+	/// \return An id to remove the resource with
+	uint32_t add_resource(StreamableResource resource);
+
+	void remove_resource(uint32_t id);
+
+	void set_config(const MemoryBudgetConfig &config);
+
+	const MemoryBudgetConfig &get_config() const;
+
+	void update();
+
+	void update(const allocated::HeapBudget &budget);
+
+	/// Pressure measured by the last update
+	MemoryPressure get_pressure() const;
+
+  private:
+	MemoryPressure evaluate_pressure(const allocated::HeapBudget &budget) const;
+
+	MemoryBudgetConfig config_;
+
+	std::map<uint32_t, StreamableResource> resources_;
+
+	uint32_t next_id_{0};
+
+	MemoryPressure pressure_{MemoryPressure::kNone};
+
+	uint32_t cooldown_{0};
+};
+}        // namespace xihe::backend
@@ -0,0 +1,33 @@
+#include "query_pool.h"
+
+#include "device.h"
+
+namespace xihe::backend
+{
+QueryPool::QueryPool(Device &device, const vk::QueryPoolCreateInfo &info) :
+    VulkanResource<vk::QueryPool>{device.get_handle().createQueryPool(info), &device}
+{}
+
+QueryPool::QueryPool(QueryPool &&pool) noexcept :
+    VulkanResource{std::move(pool)}
+{}
+
+QueryPool::~QueryPool()
+{
+	if (get_handle())
+	{
+		get_device().get_handle().destroyQueryPool(get_handle());
+	}
+}
+
+void QueryPool::host_reset(uint32_t first_query, uint32_t query_count)
+{
+	get_device().get_handle().resetQueryPool(get_handle(), first_query, query_count);
+}
+
+vk::Result QueryPool::get_results(uint32_t first_query, uint32_t query_count, size_t result_bytes, void *results, vk::DeviceSize stride, vk::QueryResultFlags flags)
+{
+	// Without eWait, eNotReady is an expected result rather than an error
+	return get_device().get_handle().getQueryPoolResults(get_handle(), first_query, query_count, result_bytes, results, stride, flags);
+}
+}        // namespace xihe::backend
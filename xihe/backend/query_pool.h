@@ -0,0 +1,29 @@
+#pragma once
+
+#include "backend/vulkan_resource.h"
+
+namespace xihe::backend
+{
+class QueryPool : public VulkanResource<vk::QueryPool>
+{
+  public:
+	QueryPool(Device &device, const vk::QueryPoolCreateInfo &info);
+
+	QueryPool(const QueryPool &) = delete;
+
+	QueryPool(QueryPool &&pool) noexcept;
+
+	~QueryPool() override;
+
+	QueryPool &operator=(const QueryPool &) = delete;
+
+	QueryPool &operator=(QueryPool &&) = delete;
+
+	/**
+	 * \brief Resets queries from the host, requires the hostQueryReset feature
+	 */
+	void host_reset(uint32_t first_query, uint32_t query_count);
+
+	vk::Result get_results(uint32_t first_query, uint32_t query_count, size_t result_bytes, void *results, vk::DeviceSize stride, vk::QueryResultFlags flags);
+};
+}        // namespace xihe::backend
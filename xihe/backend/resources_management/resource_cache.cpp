@@ -1,5 +1,8 @@
 #include "resource_cache.h"
 
+#include <ranges>
+
+#include "backend/device.h"
 #include "backend/resources_management/resource_caching.h"
 #include "backend/resources_management/resource_record.h"
 
@@ -17,6 +20,26 @@ T &request_resource(Device &device, ResourceRecord &record, std::mutex &resource
 
 	return res;
 }
+
+template <class T, class... A>
+bool contains_resource(std::mutex &resource_mutex, std::unordered_map<std::size_t, T> &resources, A &...args)
+{
+	std::lock_guard<std::mutex> guard(resource_mutex);
+
+	return find_resource(resources, args...) != nullptr;
+}
+
+template <class T, class... A>
+T &publish_resource(std::mutex &resource_mutex, std::unordered_map<std::size_t, T> &resources, T &&resource, A &...args)
+{
+	std::lock_guard<std::mutex> guard(resource_mutex);
+
+	std::size_t hash{0U};
+	hash_param(hash, args...);
+
+	// emplace does not overwrite, so a pipeline requested while this one was being built stays in place
+	return resources.emplace(hash, std::move(resource)).first->second;
+}
 }        // namespace
 
 ResourceCache::ResourceCache(Device &device) :
@@ -26,15 +49,55 @@ ResourceCache::ResourceCache(Device &device) :
 
 void ResourceCache::set_pipeline_cache(vk::PipelineCache pipeline_cache)
 {
+	std::lock_guard<std::mutex> guard(pipeline_cache_mutex_);
+
+	if (owns_pipeline_cache_)
+	{
+		device_.get_handle().destroyPipelineCache(pipeline_cache_);
+		owns_pipeline_cache_ = false;
+	}
 	pipeline_cache_ = pipeline_cache;
 }
 
+vk::PipelineCache ResourceCache::request_pipeline_cache()
+{
+	std::lock_guard<std::mutex> guard(pipeline_cache_mutex_);
+
+	if (!pipeline_cache_)
+	{
+		pipeline_cache_      = device_.get_handle().createPipelineCache({});
+		owns_pipeline_cache_ = true;
+	}
+	return pipeline_cache_;
+}
+
 ShaderModule &ResourceCache::request_shader_module(vk::ShaderStageFlagBits stage, const ShaderSource &glsl_source, const ShaderVariant &shader_variant)
 {
 	std::string entry_point{"main"};
 	return request_resource(device_, recorder_, shader_module_mutex_, state_.shader_modules, stage, glsl_source, entry_point, shader_variant);
 }
 
+std::vector<std::pair<vk::ShaderStageFlagBits, ShaderVariant>> ResourceCache::get_shader_variants(const std::string &filename)
+{
+	std::lock_guard<std::mutex> guard(shader_module_mutex_);
+
+	std::vector<std::pair<vk::ShaderStageFlagBits, ShaderVariant>> shader_variants;
+	for (const auto &shader_module : state_.shader_modules | std::views::values)
+	{
+		if (shader_module.get_source_filename() == filename)
+		{
+			shader_variants.emplace_back(shader_module.get_stage(), shader_module.get_shader_variant());
+		}
+	}
+	return shader_variants;
+}
+
+ShaderModule &ResourceCache::publish_shader_module(vk::ShaderStageFlagBits stage, const ShaderSource &glsl_source, const ShaderVariant &shader_variant, ShaderModule &&shader_module)
+{
+	std::string entry_point{"main"};
+	return publish_resource(shader_module_mutex_, state_.shader_modules, std::move(shader_module), stage, glsl_source, entry_point, shader_variant);
+}
+
 PipelineLayout &ResourceCache::request_pipeline_layout(const std::vector<ShaderModule *> &shader_modules, BindlessDescriptorSet *bindless_descriptor_set)
 {
 	return request_resource(device_, recorder_, pipeline_layout_mutex_, state_.pipeline_layouts, shader_modules, bindless_descriptor_set);
@@ -56,6 +119,26 @@ ComputePipeline &ResourceCache::request_compute_pipeline(PipelineState &pipeline
 	return request_resource(device_, recorder_, compute_pipeline_mutex_, state_.compute_pipelines, pipeline_cache_, pipeline_state);
 }
 
+bool ResourceCache::has_graphics_pipeline(PipelineState &pipeline_state)
+{
+	return contains_resource(graphics_pipeline_mutex_, state_.graphics_pipelines, pipeline_cache_, pipeline_state);
+}
+
+bool ResourceCache::has_compute_pipeline(PipelineState &pipeline_state)
+{
+	return contains_resource(compute_pipeline_mutex_, state_.compute_pipelines, pipeline_cache_, pipeline_state);
+}
+
+GraphicsPipeline &ResourceCache::publish_graphics_pipeline(PipelineState &pipeline_state, GraphicsPipeline &&pipeline)
+{
+	return publish_resource(graphics_pipeline_mutex_, state_.graphics_pipelines, std::move(pipeline), pipeline_cache_, pipeline_state);
+}
+
+ComputePipeline &ResourceCache::publish_compute_pipeline(PipelineState &pipeline_state, ComputePipeline &&pipeline)
+{
+	return publish_resource(compute_pipeline_mutex_, state_.compute_pipelines, std::move(pipeline), pipeline_cache_, pipeline_state);
+}
+
 DescriptorSet &ResourceCache::request_descriptor_set(DescriptorSetLayout &descriptor_set_layout, const BindingMap<vk::DescriptorBufferInfo> &buffer_infos, const BindingMap<vk::DescriptorImageInfo> &image_infos)
 {
 	auto &descriptor_pool = request_resource(device_, recorder_, descriptor_set_mutex_, state_.descriptor_pools, descriptor_set_layout);
@@ -76,6 +159,13 @@ void ResourceCache::clear()
 	state_.samplers.clear();
 	bindless_descriptor_set_.reset();
 	clear_pipelines();
+
+	if (owns_pipeline_cache_)
+	{
+		device_.get_handle().destroyPipelineCache(pipeline_cache_);
+		pipeline_cache_      = VK_NULL_HANDLE;
+		owns_pipeline_cache_ = false;
+	}
 }
 
 
@@ -51,8 +51,21 @@ class ResourceCache
 
 	void set_pipeline_cache(vk::PipelineCache pipeline_cache);
 
+	/**
+	 * \brief Returns the pipeline cache shared by every pipeline built through this cache.
+	 *        If none was set, one owned by the resource cache is created on first use.
+	 */
+	vk::PipelineCache request_pipeline_cache();
+
 	ShaderModule &request_shader_module(vk::ShaderStageFlagBits stage, const ShaderSource &glsl_source, const ShaderVariant &shader_variant = {});
 
+	/**
+	 * \brief Returns the stage and variant of every cached shader module compiled from the given file
+	 */
+	std::vector<std::pair<vk::ShaderStageFlagBits, ShaderVariant>> get_shader_variants(const std::string &filename);
+
+	ShaderModule &publish_shader_module(vk::ShaderStageFlagBits stage, const ShaderSource &glsl_source, const ShaderVariant &shader_variant, ShaderModule &&shader_module);
+
 	PipelineLayout &request_pipeline_layout(const std::vector<ShaderModule *> &shader_modules, BindlessDescriptorSet *bindless_descriptor_set = nullptr);
 
 	DescriptorSetLayout &request_descriptor_set_layout(const uint32_t                     set_index,
@@ -62,6 +75,16 @@ class ResourceCache
 	GraphicsPipeline &request_graphics_pipeline(PipelineState &pipeline_state);
 	ComputePipeline  &request_compute_pipeline(PipelineState &pipeline_state);
 
+	bool has_graphics_pipeline(PipelineState &pipeline_state);
+	bool has_compute_pipeline(PipelineState &pipeline_state);
+
+	/**
+	 * \brief Inserts a pipeline that was built outside of the cache, e.g. on a worker thread.
+	 *        If an equivalent pipeline was requested in the meantime, the existing one is kept and returned.
+	 */
+	GraphicsPipeline &publish_graphics_pipeline(PipelineState &pipeline_state, GraphicsPipeline &&pipeline);
+	ComputePipeline  &publish_compute_pipeline(PipelineState &pipeline_state, ComputePipeline &&pipeline);
+
 	DescriptorSet &request_descriptor_set(DescriptorSetLayout                        &descriptor_set_layout,
 	                                      const BindingMap<vk::DescriptorBufferInfo> &buffer_infos,
 	                                      const BindingMap<vk::DescriptorImageInfo>  &image_infos);
@@ -88,6 +111,9 @@ class ResourceCache
 
 	vk::PipelineCache pipeline_cache_{VK_NULL_HANDLE};
 
+	// Set when pipeline_cache_ was created by request_pipeline_cache and must be destroyed in clear()
+	bool owns_pipeline_cache_{false};
+
 	ResourceCacheState state_;
 
 	std::mutex descriptor_set_mutex_        = {};
@@ -96,7 +122,8 @@ class ResourceCache
 	std::mutex descriptor_set_layout_mutex_ = {};
 	std::mutex graphics_pipeline_mutex_     = {};
 	std::mutex compute_pipeline_mutex_      = {};
-	std::mutex sampler_mutex_           = {};
+	std::mutex sampler_mutex_               = {};
+	std::mutex pipeline_cache_mutex_        = {};
 };
 }        // namespace backend
 }        // namespace xihe
@@ -268,93 +268,109 @@ struct hash<xihe::rendering::Attachment>
 };
 
 template <>
-struct hash<xihe::PipelineState>
+struct hash<xihe::ColorBlendAttachmentState>
 {
-	std::size_t operator()(const xihe::PipelineState &pipeline_state) const noexcept
+	std::size_t operator()(const xihe::ColorBlendAttachmentState &color_blend_attachment) const
 	{
 		std::size_t result = 0;
 
-		hash_combine(result, pipeline_state.get_pipeline_layout().get_handle());
+		hash_combine(result, color_blend_attachment.alpha_blend_op);
+		hash_combine(result, color_blend_attachment.blend_enable);
+		hash_combine(result, color_blend_attachment.color_blend_op);
+		hash_combine(result, color_blend_attachment.color_write_mask);
+		hash_combine(result, color_blend_attachment.dst_alpha_blend_factor);
+		hash_combine(result, color_blend_attachment.dst_color_blend_factor);
+		hash_combine(result, color_blend_attachment.src_alpha_blend_factor);
+		hash_combine(result, color_blend_attachment.src_color_blend_factor);
 
-		hash_combine(result, pipeline_state.get_specialization_constant_state());
+		return result;
+	}
+};
 
-		//hash_combine(result, pipeline_state.get_subpass_index());
+}        // namespace std
 
-		for (auto shader_module : pipeline_state.get_pipeline_layout().get_shader_modules())
-		{
-			hash_combine(result, shader_module->get_id());
-		}
+namespace xihe
+{
+/**
+ * \brief Hashes the specialization constants and the fixed function state of a pipeline state,
+ *        everything but the layout and its shader modules, which only exist with a device
+ */
+inline void hash_fixed_function_state(std::size_t &result, const PipelineState &pipeline_state)
+{
+	hash_combine(result, pipeline_state.get_specialization_constant_state());
 
-		// VkPipelineVertexInputStateCreateInfo
-		for (auto &attribute : pipeline_state.get_vertex_input_state().attributes)
-		{
-			hash_combine(result, attribute);
-		}
+	// VkPipelineVertexInputStateCreateInfo
+	for (auto &attribute : pipeline_state.get_vertex_input_state().attributes)
+	{
+		hash_combine(result, attribute);
+	}
 
-		for (auto &binding : pipeline_state.get_vertex_input_state().bindings)
-		{
-			hash_combine(result, binding);
-		}
+	for (auto &binding : pipeline_state.get_vertex_input_state().bindings)
+	{
+		hash_combine(result, binding);
+	}
 
-		hash_combine(result, pipeline_state.get_attachments_state().color_attachment_formats);
-		hash_combine(result, pipeline_state.get_attachments_state().depth_attachment_format);
-		hash_combine(result, pipeline_state.get_attachments_state().stencil_attachment_format);
-
-		hash_combine(result, pipeline_state.get_input_assembly_state().primitive_restart_enable);
-		hash_combine(result, pipeline_state.get_input_assembly_state().topology);
-
-		hash_combine(result, pipeline_state.get_viewport_state().viewport_count);
-		hash_combine(result, pipeline_state.get_viewport_state().scissor_count);
-
-		hash_combine(result, pipeline_state.get_rasterization_state().cull_mode);
-		hash_combine(result, pipeline_state.get_rasterization_state().depth_bias_enable);
-		hash_combine(result, pipeline_state.get_rasterization_state().depth_clamp_enable);
-		hash_combine(result, pipeline_state.get_rasterization_state().front_face);
-		hash_combine(result, pipeline_state.get_rasterization_state().polygon_mode);
-		hash_combine(result, pipeline_state.get_rasterization_state().rasterizer_discard_enable);
-
-		hash_combine(result, pipeline_state.get_multisample_state().alpha_to_coverage_enable);
-		hash_combine(result, pipeline_state.get_multisample_state().alpha_to_one_enable);
-		hash_combine(result, pipeline_state.get_multisample_state().min_sample_shading);
-		hash_combine(result, pipeline_state.get_multisample_state().rasterization_samples);
-		hash_combine(result, pipeline_state.get_multisample_state().sample_shading_enable);
-		hash_combine(result, pipeline_state.get_multisample_state().sample_mask);
-
-		hash_combine(result, pipeline_state.get_depth_stencil_state().back);
-		hash_combine(result, pipeline_state.get_depth_stencil_state().depth_bounds_test_enable);
-		hash_combine(result, pipeline_state.get_depth_stencil_state().depth_compare_op);
-		hash_combine(result, pipeline_state.get_depth_stencil_state().depth_test_enable);
-		hash_combine(result, pipeline_state.get_depth_stencil_state().depth_write_enable);
-		hash_combine(result, pipeline_state.get_depth_stencil_state().front);
-		hash_combine(result, pipeline_state.get_depth_stencil_state().stencil_test_enable);
-
-		hash_combine(result, pipeline_state.get_color_blend_state().logic_op);
-		hash_combine(result, pipeline_state.get_color_blend_state().logic_op_enable);
-
-		for (auto &attachment : pipeline_state.get_color_blend_state().attachments)
-		{
-			hash_combine(result, attachment);
-		}
+	hash_combine(result, pipeline_state.get_attachments_state().color_attachment_formats);
+	hash_combine(result, pipeline_state.get_attachments_state().depth_attachment_format);
+	hash_combine(result, pipeline_state.get_attachments_state().stencil_attachment_format);
 
-		return result;
+	hash_combine(result, pipeline_state.get_input_assembly_state().primitive_restart_enable);
+	hash_combine(result, pipeline_state.get_input_assembly_state().topology);
+
+	hash_combine(result, pipeline_state.get_viewport_state().viewport_count);
+	hash_combine(result, pipeline_state.get_viewport_state().scissor_count);
+
+	hash_combine(result, pipeline_state.get_rasterization_state().cull_mode);
+	hash_combine(result, pipeline_state.get_rasterization_state().depth_bias_enable);
+	hash_combine(result, pipeline_state.get_rasterization_state().depth_clamp_enable);
+	hash_combine(result, pipeline_state.get_rasterization_state().front_face);
+	hash_combine(result, pipeline_state.get_rasterization_state().polygon_mode);
+	hash_combine(result, pipeline_state.get_rasterization_state().rasterizer_discard_enable);
+
+	hash_combine(result, pipeline_state.get_multisample_state().alpha_to_coverage_enable);
+	hash_combine(result, pipeline_state.get_multisample_state().alpha_to_one_enable);
+	hash_combine(result, pipeline_state.get_multisample_state().min_sample_shading);
+	hash_combine(result, pipeline_state.get_multisample_state().rasterization_samples);
+	hash_combine(result, pipeline_state.get_multisample_state().sample_shading_enable);
+	hash_combine(result, pipeline_state.get_multisample_state().sample_mask);
+
+	hash_combine(result, pipeline_state.get_depth_stencil_state().back);
+	hash_combine(result, pipeline_state.get_depth_stencil_state().depth_bounds_test_enable);
+	hash_combine(result, pipeline_state.get_depth_stencil_state().depth_compare_op);
+	hash_combine(result, pipeline_state.get_depth_stencil_state().depth_test_enable);
+	hash_combine(result, pipeline_state.get_depth_stencil_state().depth_write_enable);
+	hash_combine(result, pipeline_state.get_depth_stencil_state().front);
+	hash_combine(result, pipeline_state.get_depth_stencil_state().stencil_test_enable);
+
+	hash_combine(result, pipeline_state.get_color_blend_state().logic_op);
+	hash_combine(result, pipeline_state.get_color_blend_state().logic_op_enable);
+
+	for (auto &attachment : pipeline_state.get_color_blend_state().attachments)
+	{
+		hash_combine(result, attachment);
 	}
-};
+}
+}        // namespace xihe
 
+namespace std
+{
 template <>
-struct hash<xihe::ColorBlendAttachmentState>
+struct hash<xihe::PipelineState>
 {
-	std::size_t operator()(const xihe::ColorBlendAttachmentState &color_blend_attachment) const
+	std::size_t operator()(const xihe::PipelineState &pipeline_state) const noexcept
 	{
 		std::size_t result = 0;
 
-		hash_combine(result, color_blend_attachment.alpha_blend_op);
-		hash_combine(result, color_blend_attachment.blend_enable);
-		hash_combine(result, color_blend_attachment.color_blend_op);
-		hash_combine(result, color_blend_attachment.color_write_mask);
-		hash_combine(result, color_blend_attachment.dst_alpha_blend_factor);
-		hash_combine(result, color_blend_attachment.dst_color_blend_factor);
-		hash_combine(result, color_blend_attachment.src_alpha_blend_factor);
-		hash_combine(result, color_blend_attachment.src_color_blend_factor);
+		hash_combine(result, pipeline_state.get_pipeline_layout().get_handle());
+
+		//hash_combine(result, pipeline_state.get_subpass_index());
+
+		for (auto shader_module : pipeline_state.get_pipeline_layout().get_shader_modules())
+		{
+			hash_combine(result, shader_module->get_id());
+		}
+
+		xihe::hash_fixed_function_state(result, pipeline_state);
 
 		return result;
 	}
@@ -509,6 +525,31 @@ inline void hash_param(size_t &seed, const T &first_arg, const Args &...args)
 	hash_param(seed, args...);
 }
 
+/// The key a descriptor set is cached under. Pools are cached per layout, so the layout handle stands in for the pool too
+inline void hash_descriptor_set(size_t &seed, vk::DescriptorSetLayout descriptor_set_layout, const BindingMap<vk::DescriptorBufferInfo> &buffer_infos, const BindingMap<vk::DescriptorImageInfo> &image_infos)
+{
+	hash_combine(seed, descriptor_set_layout);
+	hash_param(seed, buffer_infos);
+	hash_param(seed, image_infos);
+}
+
+inline void hash_param(size_t &seed, const DescriptorSetLayout &descriptor_set_layout, const DescriptorPool & /*descriptor_pool*/, const BindingMap<vk::DescriptorBufferInfo> &buffer_infos, const BindingMap<vk::DescriptorImageInfo> &image_infos)
+{
+	hash_descriptor_set(seed, descriptor_set_layout.get_handle(), buffer_infos, image_infos);
+}
+
+/// The cache lookup shared by every request_* path, nullptr on a miss
+template <class T, class... A>
+T *find_resource(std::unordered_map<size_t, T> &resources, const A &...args)
+{
+	std::size_t hash{0U};
+	hash_param(hash, args...);
+
+	auto res_it = resources.find(hash);
+
+	return res_it != resources.end() ? &res_it->second : nullptr;
+}
+
 template <class T, class... A>
 struct RecordHelper
 {
@@ -570,14 +611,9 @@ T &request_resource(Device &device, ResourceRecord *recorder, std::unordered_map
 {
 	RecordHelper<T, A...> record_helper;
 
-	std::size_t hash{0U};
-	hash_param(hash, args...);
-
-	auto res_it = resources.find(hash);
-
-	if (res_it != resources.end())
+	if (T *resource = find_resource(resources, args...))
 	{
-		return res_it->second;
+		return *resource;
 	}
 
 	// If we do not have it already, create and cache it
@@ -585,9 +621,11 @@ T &request_resource(Device &device, ResourceRecord *recorder, std::unordered_map
 	size_t      res_id   = resources.size();
 
 	LOGD("Building #{} cache object ({})", res_id, res_type);
-	hash = 0;
+	std::size_t hash{0U};
 	hash_param(hash, args...);
 
+	auto res_it = resources.end();
+
 	// Only error handle in release
 #ifndef XH_DEBUG
 	try
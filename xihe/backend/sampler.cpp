@@ -5,11 +5,13 @@
 namespace xihe::backend
 {
 Sampler::Sampler(backend::Device &device, const vk::SamplerCreateInfo &info):
- VulkanResource<vk::Sampler>{device.get_handle().createSampler(info), &device}
+ VulkanResource<vk::Sampler>{device.get_handle().createSampler(info), &device},
+ create_info_{info}
 {}
 
 Sampler::Sampler(Sampler &&sampler) noexcept:
- VulkanResource{std::move(sampler)}
+ VulkanResource{std::move(sampler)},
+ create_info_{sampler.create_info_}
 {}
 
 Sampler::~Sampler()
@@ -19,4 +21,9 @@ Sampler::~Sampler()
 		get_device().get_handle().destroySampler(get_handle());
 	}
 }
+
+const vk::SamplerCreateInfo &Sampler::get_create_info() const
+{
+	return create_info_;
+}
 }
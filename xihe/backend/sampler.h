@@ -18,5 +18,10 @@ public:
 	Sampler &operator=(const Sampler &) = delete;
 
 	Sampler &operator=(Sampler &&) = delete;
+
+	const vk::SamplerCreateInfo &get_create_info() const;
+
+private:
+	vk::SamplerCreateInfo create_info_;
 };
 }
@@ -8,12 +8,34 @@
 #include "common/error.h"
 #include "common/logging.h"
 #include "common/strings.h"
+#include "common/trace.h"
 #include "platform/filesystem.h"
 
 namespace xihe::backend
 {
 
-inline std::vector<std::string> precompile_shader(const std::string &source)
+/**
+ * \brief Extracts the path of an `#include "..."` directive
+ * \return false if the line is not an include directive
+ */
+inline bool parse_include(const std::string &line, std::string &include_path)
+{
+	if (line.find("#include \"") != 0)
+	{
+		return false;
+	}
+
+	// Include paths are relative to the base shader directory
+	include_path            = line.substr(10);
+	const size_t last_quote = include_path.find('\"');
+	if (!include_path.empty() && last_quote != std::string::npos)
+	{
+		include_path = include_path.substr(0, last_quote);
+	}
+	return true;
+}
+
+std::vector<std::string> precompile_shader(const std::string &source)
 {
 	std::vector<std::string> final_file;
 
@@ -21,16 +43,9 @@ inline std::vector<std::string> precompile_shader(const std::string &source)
 
 	for (auto &line : lines)
 	{
-		if (line.find("#include \"") == 0)
+		std::string include_path;
+		if (parse_include(line, include_path))
 		{
-			// Include paths are relative to the base shader directory
-			std::string  include_path = line.substr(10);
-			const size_t last_quote   = include_path.find('\"');
-			if (!include_path.empty() && last_quote != std::string::npos)
-			{
-				include_path = include_path.substr(0, last_quote);
-			}
-
 			auto include_file = precompile_shader(fs::read_shader(include_path));
 			for (auto &include_file_line : include_file)
 			{
@@ -46,6 +61,30 @@ inline std::vector<std::string> precompile_shader(const std::string &source)
 	return final_file;
 }
 
+/**
+ * \brief Recursively collects the files included by a shader, each one once, and hashes their contents into id
+ */
+inline void collect_dependencies(const std::string &source, std::vector<std::string> &dependencies, size_t &id)
+{
+	constexpr std::hash<std::string> hasher{};
+
+	for (auto &line : split(source, '\n'))
+	{
+		std::string include_path;
+		if (!parse_include(line, include_path) || std::ranges::find(dependencies, include_path) != dependencies.end())
+		{
+			continue;
+		}
+
+		dependencies.push_back(include_path);
+
+		auto include_source = fs::read_shader(include_path);
+		id ^= hasher(include_source) + 0x9e3779b9 + (id << 6) + (id >> 2);
+
+		collect_dependencies(include_source, dependencies, id);
+	}
+}
+
 inline std::vector<uint8_t> convert_to_bytes(std::vector<std::string> &lines)
 {
 	std::vector<uint8_t> bytes;
@@ -184,6 +223,9 @@ ShaderSource::ShaderSource(const std::string &filename) :
 {
 	constexpr std::hash<std::string> hasher{};
 	id_ = hasher(source_);
+
+	// Included files are part of the id, so editing one of them yields a different shader module
+	collect_dependencies(source_, dependencies_, id_);
 }
 
 size_t ShaderSource::get_id() const
@@ -201,10 +243,22 @@ const std::string &ShaderSource::get_source() const
 	return source_;
 }
 
+const std::vector<std::string> &ShaderSource::get_dependencies() const
+{
+	return dependencies_;
+}
+
+bool ShaderSource::depends_on(const std::string &filename) const
+{
+	return filename_ == filename || std::ranges::find(dependencies_, filename) != dependencies_.end();
+}
+
 ShaderModule::ShaderModule(Device &device, vk::ShaderStageFlagBits stage, const ShaderSource &glsl_source, const std::string &entry_point, const ShaderVariant &shader_variant) :
     device_{device},
     stage_{stage},
-    entry_point_{entry_point}
+    entry_point_{entry_point},
+    source_filename_{glsl_source.get_filename()},
+    shader_variant_{shader_variant}
 {
 	debug_name_ = fmt::format("{} [variant {:X}] [entrypoint {}]",
 	                          glsl_source.get_filename(),
@@ -223,6 +277,8 @@ ShaderModule::ShaderModule(Device &device, vk::ShaderStageFlagBits stage, const
 		throw VulkanException{vk::Result::eErrorInitializationFailed};
 	}
 
+	XIHE_TRACE_ZONE(glsl_source.get_filename());
+
 	auto glsl_final_source = precompile_shader(source);
 
 	GlslCompiler glsl_compiler;
@@ -251,6 +307,8 @@ ShaderModule::ShaderModule(ShaderModule &&other) noexcept :
 	stage_{other.stage_},
 	entry_point_{std::move(other.entry_point_)},
 	debug_name_{std::move(other.debug_name_)},
+	source_filename_{std::move(other.source_filename_)},
+	shader_variant_{std::move(other.shader_variant_)},
 	spirv_{std::move(other.spirv_)},
 	resources_{std::move(other.resources_)},
 	info_log_{std::move(other.info_log_)}
@@ -273,6 +331,16 @@ const std::string & ShaderModule::get_entry_point() const
 	return entry_point_;
 }
 
+const std::string &ShaderModule::get_source_filename() const
+{
+	return source_filename_;
+}
+
+const ShaderVariant &ShaderModule::get_shader_variant() const
+{
+	return shader_variant_;
+}
+
 const std::vector<ShaderResource> & ShaderModule::get_resources() const
 {
 	return resources_;
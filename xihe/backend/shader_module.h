@@ -113,12 +113,26 @@ class ShaderSource
 	std::string        get_filename() const;
 	const std::string &get_source() const;
 
+	/// Files pulled in through #include, directly or transitively, relative to the shader directory
+	const std::vector<std::string> &get_dependencies() const;
+
+	/// True if filename is this source or one of its dependencies
+	bool depends_on(const std::string &filename) const;
+
   private:
 	size_t      id_;
 	std::string filename_;
 	std::string source_;
+
+	std::vector<std::string> dependencies_;
 };
 
+/**
+ * \brief Expands the `#include "..."` directives of a shader recursively, included files are read from the shader directory
+ * \return The lines of the expanded source
+ */
+std::vector<std::string> precompile_shader(const std::string &source);
+
 class ShaderModule
 {
   public:
@@ -140,6 +154,10 @@ class ShaderModule
 
 	const std::string &get_entry_point() const;
 
+	const std::string &get_source_filename() const;
+
+	const ShaderVariant &get_shader_variant() const;
+
 	const std::vector<ShaderResource> &get_resources() const;
 
 	const std::string &get_info_log() const;
@@ -167,6 +185,10 @@ class ShaderModule
 	std::string             entry_point_;
 	std::string             debug_name_;
 
+	// Kept so the module can be compiled again when its source changes
+	std::string   source_filename_;
+	ShaderVariant shader_variant_;
+
 	std::vector<uint32_t>       spirv_;
 	std::vector<ShaderResource> resources_;
 
@@ -0,0 +1,222 @@
+#include "sparse_page_pool.h"
+
+#include <algorithm>
+#include <bit>
+
+#include "backend/device.h"
+
+namespace xihe::backend
+{
+namespace
+{
+constexpr uint32_t kWordBits = 64;
+
+uint64_t get_bit(uint32_t index)
+{
+	return uint64_t{1} << (index % kWordBits);
+}
+}        // namespace
+
+PageBitmap::PageBitmap(uint32_t page_count)
+{
+	resize(page_count);
+}
+
+void PageBitmap::resize(uint32_t page_count)
+{
+	assert(page_count >= page_count_ && "The page bitmap only grows");
+
+	levels_.resize(1);
+
+	auto &leaves = levels_[0];
+	leaves.resize((page_count + kWordBits - 1) / kWordBits, 0);
+	for (auto page = page_count_; page < page_count; ++page)
+	{
+		leaves[page / kWordBits] |= get_bit(page);
+	}
+
+	free_count_ += page_count - page_count_;
+	page_count_ = page_count;
+
+	// The levels above are rebuilt, growing is rare next to allocating
+	while (levels_.back().size() > 1)
+	{
+		const auto           &below = levels_.back();
+		std::vector<uint64_t> level((below.size() + kWordBits - 1) / kWordBits, 0);
+		for (uint32_t i = 0; i < below.size(); ++i)
+		{
+			if (below[i] != 0)
+			{
+				level[i / kWordBits] |= get_bit(i);
+			}
+		}
+		levels_.push_back(std::move(level));
+	}
+}
+
+uint32_t PageBitmap::allocate()
+{
+	if (free_count_ == 0)
+	{
+		return kInvalidPage;
+	}
+
+	uint32_t index = 0;
+	for (auto level = levels_.rbegin(); level != levels_.rend(); ++level)
+	{
+		index = index * kWordBits + std::countr_zero((*level)[index]);
+	}
+
+	set_allocated(index);
+	return index;
+}
+
+void PageBitmap::free(uint32_t page)
+{
+	assert(page < page_count_ && !is_free(page) && "The page is not allocated");
+
+	set_free(page);
+}
+
+bool PageBitmap::is_free(uint32_t page) const
+{
+	return (levels_[0][page / kWordBits] & get_bit(page)) != 0;
+}
+
+uint32_t PageBitmap::get_page_count() const
+{
+	return page_count_;
+}
+
+uint32_t PageBitmap::get_free_count() const
+{
+	return free_count_;
+}
+
+void PageBitmap::set_free(uint32_t page)
+{
+	auto index = page;
+	for (auto &level : levels_)
+	{
+		auto      &word     = level[index / kWordBits];
+		const bool had_free = word != 0;
+		word |= get_bit(index);
+
+		// The levels above already see a free bit in this word
+		if (had_free)
+		{
+			break;
+		}
+		index /= kWordBits;
+	}
+
+	++free_count_;
+}
+
+void PageBitmap::set_allocated(uint32_t page)
+{
+	auto index = page;
+	for (auto &level : levels_)
+	{
+		auto &word = level[index / kWordBits];
+		word &= ~get_bit(index);
+
+		if (word != 0)
+		{
+			break;
+		}
+		index /= kWordBits;
+	}
+
+	--free_count_;
+}
+
+SparsePagePool::SparsePagePool(Device &device, vk::DeviceSize page_size, uint32_t memory_type_index, uint32_t pages_per_block) :
+    device_{device}, page_size_{page_size}, memory_type_index_{memory_type_index}, pages_per_block_{pages_per_block}
+{
+	assert(pages_per_block_ > 0);
+}
+
+SparsePagePool::~SparsePagePool()
+{
+	for (auto memory : blocks_)
+	{
+		if (memory)
+		{
+			device_.get_handle().freeMemory(memory);
+		}
+	}
+}
+
+uint32_t SparsePagePool::allocate()
+{
+	auto slot = bitmap_.allocate();
+	if (slot == PageBitmap::kInvalidPage)
+	{
+		bitmap_.resize(bitmap_.get_page_count() + pages_per_block_);
+		blocks_.emplace_back();
+		block_page_counts_.push_back(0);
+
+		slot = bitmap_.allocate();
+	}
+
+	const auto block = slot / pages_per_block_;
+	if (!blocks_[block])
+	{
+		vk::MemoryAllocateInfo memory_allocate_info{page_size_ * pages_per_block_, memory_type_index_};
+		blocks_[block] = device_.get_handle().allocateMemory(memory_allocate_info);
+	}
+
+	++block_page_counts_[block];
+	++allocated_count_;
+
+	return slot;
+}
+
+void SparsePagePool::free(uint32_t slot)
+{
+	bitmap_.free(slot);
+
+	--block_page_counts_[slot / pages_per_block_];
+	--allocated_count_;
+}
+
+SparsePagePool::Page SparsePagePool::get_page(uint32_t slot) const
+{
+	return {blocks_[slot / pages_per_block_], (slot % pages_per_block_) * page_size_};
+}
+
+vk::DeviceSize SparsePagePool::release_empty_blocks()
+{
+	vk::DeviceSize released = 0;
+
+	for (size_t block = 0; block < blocks_.size(); ++block)
+	{
+		if (blocks_[block] && block_page_counts_[block] == 0)
+		{
+			device_.get_handle().freeMemory(blocks_[block]);
+			blocks_[block] = nullptr;
+
+			released += page_size_ * pages_per_block_;
+		}
+	}
+
+	return released;
+}
+
+vk::DeviceSize SparsePagePool::get_page_size() const
+{
+	return page_size_;
+}
+
+uint32_t SparsePagePool::get_allocated_count() const
+{
+	return allocated_count_;
+}
+
+vk::DeviceSize SparsePagePool::get_memory_size() const
+{
+	const auto block_count = std::count_if(blocks_.begin(), blocks_.end(), [](vk::DeviceMemory memory) { return static_cast<bool>(memory); });
+	return block_count * page_size_ * pages_per_block_;
+}
+}        // namespace xihe::backend
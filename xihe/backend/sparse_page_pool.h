@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "common/vk_common.h"
+
+namespace xihe::backend
+{
+class Device;
+
+/**
+ * \brief Free pages kept as a hierarchy of 64-bit bitmaps. A set bit marks a free page in the leaf level and a word
+ *        with a free bit in each level above, the top level is a single word.
+ *
+ *        Allocation descends from the top word to the lowest free page and freeing walks back up, both touch one
+ *        word per level, which is 3 levels up to 262144 pages. It holds no Vulkan objects.
+ */
+class PageBitmap
+{
+  public:
+	static constexpr uint32_t kInvalidPage = ~0U;
+
+	explicit PageBitmap(uint32_t page_count = 0);
+
+	/// Grows the bitmap, the added pages are free
+	void resize(uint32_t page_count);
+
+	/// \return The lowest free page, kInvalidPage if all are allocated
+	uint32_t allocate();
+
+	void free(uint32_t page);
+
+	bool is_free(uint32_t page) const;
+
+	uint32_t get_page_count() const;
+
+	uint32_t get_free_count() const;
+
+  private:
+	void set_free(uint32_t page);
+
+	void set_allocated(uint32_t page);
+
+	// levels_[0] has a bit per page, each level above a bit per word of the level below
+	std::vector<std::vector<uint64_t>> levels_;
+
+	uint32_t page_count_{0};
+	uint32_t free_count_{0};
+};
+
+/**
+ * \brief Device memory for the pages of sparse resources, allocated in blocks of a fixed number of pages.
+ *        Pages are addressed by slot and handed out lowest first, so allocations stay packed in the front blocks
+ *        and the blocks at the back empty out and can be released.
+ */
+class SparsePagePool
+{
+  public:
+	struct Page
+	{
+		vk::DeviceMemory memory;
+		vk::DeviceSize   offset{0};
+	};
+
+	SparsePagePool(Device &device, vk::DeviceSize page_size, uint32_t memory_type_index, uint32_t pages_per_block);
+
+	~SparsePagePool();
+
+	SparsePagePool(const SparsePagePool &)            = delete;
+	SparsePagePool &operator=(const SparsePagePool &) = delete;
+
+	/// Allocates the memory of the block the slot is in if it has none
+	uint32_t allocate();
+
+	/// The page must have been unbound, its memory is only released with its block
+	void free(uint32_t slot);
+
+	Page get_page(uint32_t slot) const;
+
+	/**
+	 * \brief Frees the memory of the blocks without allocated pages, the unbinds of their pages must have completed
+	 * \return The bytes released
+	 */
+	vk::DeviceSize release_empty_blocks();
+
+	vk::DeviceSize get_page_size() const;
+
+	uint32_t get_allocated_count() const;
+
+	/// Memory of the blocks currently allocated
+	vk::DeviceSize get_memory_size() const;
+
+  private:
+	Device &device_;
+
+	vk::DeviceSize page_size_;
+	uint32_t       memory_type_index_;
+	uint32_t       pages_per_block_;
+
+	PageBitmap bitmap_;
+
+	std::vector<vk::DeviceMemory> blocks_;
+
+	// Allocated pages of each block
+	std::vector<uint32_t> block_page_counts_;
+
+	uint32_t allocated_count_{0};
+};
+}        // namespace xihe::backend
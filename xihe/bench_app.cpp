@@ -0,0 +1,280 @@
+#include "bench_app.h"
+
+#include <filesystem>
+#include <fstream>
+
+#include <fmt/ranges.h>
+
+#include "backend/allocated.h"
+#include "common/logging.h"
+#include "platform/filesystem.h"
+#include "scene_graph/components/light.h"
+#include "scene_graph/node.h"
+
+namespace xihe
+{
+namespace
+{
+glm::quat yaw(float degrees)
+{
+	return glm::angleAxis(glm::radians(degrees), glm::vec3{0.0f, 1.0f, 0.0f});
+}
+
+std::string format_summary(const stats::StatSummary &summary)
+{
+	return fmt::format("{{\"mean\": {}, \"p50\": {}, \"p95\": {}, \"p99\": {}, \"max\": {}}}",
+	                   summary.mean, summary.p50, summary.p95, summary.p99, summary.max);
+}
+}        // namespace
+
+BenchApp::BenchApp(BenchConfig config) :
+    SampleApp{config.scene_path}, config_{std::move(config)}
+{
+	if (config_.output_path.empty())
+	{
+		config_.output_path = fs::path::get(fs::path::Type::kStorage, "bench.json").string();
+	}
+
+	if (config_.stats_interval_ms > 0)
+	{
+		set_stats_sampling({stats::CounterSamplingMode::kContinuous, std::chrono::milliseconds{config_.stats_interval_ms}});
+	}
+}
+
+bool BenchApp::prepare(Window *window)
+{
+	Timer timer;
+
+	timer.start();
+	if (!XiheApp::prepare(window))
+	{
+		return false;
+	}
+	load_times_ms_["device"] = timer.stop<Timer::Milliseconds>();
+
+	timer.start();
+	load_assets();
+	load_times_ms_["scene"] = timer.stop<Timer::Milliseconds>();
+
+	add_transform_paths();
+
+	// Building the graph also compiles the shaders and the pipelines
+	timer.start();
+	add_passes(*window);
+	graph_builder_->build();
+	load_times_ms_["render_graph"] = timer.stop<Timer::Milliseconds>();
+
+	render_frame_users_.resize(render_context_->get_render_frame_count());
+	frames_.reserve(config_.frame_count);
+
+	LOGI("Benchmarking {} for {} frames after {} warmup frames", config_.scene_path, config_.frame_count, config_.warmup_frame_count);
+
+	frame_timer_.start();
+
+	return true;
+}
+
+void BenchApp::update(float delta_time)
+{
+	if (complete_)
+	{
+		return;
+	}
+
+	const double frame_ms = frame_timer_.tick<Timer::Milliseconds>();
+
+	Timer cpu_timer;
+	cpu_timer.start();
+	SampleApp::update(config_.frame_delta_time);
+	const double cpu_ms = cpu_timer.stop<Timer::Milliseconds>();
+
+	const uint32_t measure_end = config_.warmup_frame_count + config_.frame_count;
+	if (frame_index_ >= config_.warmup_frame_count && frame_index_ < measure_end)
+	{
+		FrameRecord record;
+		record.cpu_ms           = cpu_ms;
+		record.frame_ms         = frame_ms;
+		record.device_memory_mb = get_device_memory_usage_mb();
+		frames_.push_back(std::move(record));
+	}
+
+	record_gpu_timings();
+
+	++frame_index_;
+
+	// Keeps rendering until every render frame was reused once, so the timings of the last measured frames are read back
+	if (frame_index_ == measure_end + render_context_->get_render_frame_count())
+	{
+		write_report();
+		if (config_.stats_interval_ms > 0)
+		{
+			stats_->write_csv(std::filesystem::path{config_.output_path}.replace_extension(".stats.csv").string());
+		}
+		complete_ = true;
+		window_->close();
+	}
+}
+
+bool BenchApp::is_complete() const
+{
+	return complete_;
+}
+
+std::vector<sg::TransformPath::Keyframe> BenchApp::get_default_camera_path()
+{
+	// Flies down the nave of Sponza, turns around and comes back along the upper floor
+	return {
+	    {0.0f, {-1200.0f, 150.0f, -40.0f}, yaw(-90.0f)},
+	    {8.0f, {1100.0f, 150.0f, -40.0f}, yaw(-90.0f)},
+	    {9.0f, {1100.0f, 250.0f, -40.0f}, yaw(0.0f)},
+	    {10.0f, {1100.0f, 400.0f, -40.0f}, yaw(90.0f)},
+	    {18.0f, {-1200.0f, 400.0f, -40.0f}, yaw(90.0f)},
+	    {19.0f, {-1200.0f, 250.0f, -40.0f}, yaw(180.0f)},
+	    {20.0f, {-1200.0f, 150.0f, -40.0f}, yaw(270.0f)},
+	};
+}
+
+void BenchApp::add_transform_paths()
+{
+	std::map<std::string, std::vector<sg::TransformPath::Keyframe>> tracks;
+	if (!config_.path_file.empty())
+	{
+		tracks = sg::TransformPath::load_tracks(config_.path_file);
+	}
+	if (!tracks.contains("camera"))
+	{
+		tracks["camera"] = get_default_camera_path();
+	}
+
+	auto lights = scene_->get_components<sg::Light>();
+
+	for (auto &[track, keyframes] : tracks)
+	{
+		sg::Node *node = nullptr;
+		if (track == "camera")
+		{
+			node = camera_->get_node();
+		}
+		else if (track.starts_with("light:"))
+		{
+			const auto light_index = static_cast<size_t>(std::stoul(track.substr(6)));
+			if (light_index < lights.size())
+			{
+				node = lights[light_index]->get_node();
+			}
+		}
+
+		if (!node)
+		{
+			LOGW("Transform path track '{}' does not match the camera or a light, skipping it", track);
+			continue;
+		}
+
+		// Not bound to the node, so the free camera script keeps its slot and still handles resizes
+		scene_->add_component(std::make_unique<sg::TransformPath>(*node, std::move(keyframes)));
+	}
+}
+
+void BenchApp::record_gpu_timings()
+{
+	auto &user = render_frame_users_[render_context_->get_active_frame_index()];
+
+	if (user && *user >= config_.warmup_frame_count && *user - config_.warmup_frame_count < frames_.size())
+	{
+		auto &record = frames_[*user - config_.warmup_frame_count];
+
+		double gpu_ms = 0.0;
+		for (const auto &timing : render_context_->get_gpu_timings())
+		{
+			if (timing.depth == 0)
+			{
+				gpu_ms += timing.gpu_ms;
+			}
+			else
+			{
+				record.pass_gpu_ms[timing.name] += timing.gpu_ms;
+			}
+		}
+		record.gpu_ms = gpu_ms;
+	}
+
+	user = frame_index_;
+}
+
+double BenchApp::get_device_memory_usage_mb() const
+{
+	return static_cast<double>(backend::allocated::get_device_local_budget().usage) / (1024.0 * 1024.0);
+}
+
+void BenchApp::write_report() const
+{
+	std::ofstream file{config_.output_path, std::ios::out | std::ios::trunc};
+	if (!file.is_open())
+	{
+		LOGE("Failed to open {} for writing the benchmark report", config_.output_path);
+		return;
+	}
+
+	std::vector<float> cpu_ms;
+	std::vector<float> frame_ms;
+	std::vector<float> gpu_ms;
+	for (const auto &record : frames_)
+	{
+		cpu_ms.push_back(static_cast<float>(record.cpu_ms));
+		frame_ms.push_back(static_cast<float>(record.frame_ms));
+		if (record.gpu_ms)
+		{
+			gpu_ms.push_back(static_cast<float>(*record.gpu_ms));
+		}
+	}
+
+	const auto extent = render_context_->get_surface_extent();
+
+	file << "{\n";
+	file << fmt::format("  \"scene\": \"{}\",\n", config_.scene_path);
+	file << fmt::format("  \"device\": \"{}\",\n", std::string{device_->get_gpu().get_properties().deviceName.data()});
+	file << fmt::format("  \"extent\": [{}, {}],\n", extent.width, extent.height);
+	file << fmt::format("  \"warmup_frame_count\": {},\n", config_.warmup_frame_count);
+	file << fmt::format("  \"frame_delta_time\": {},\n", config_.frame_delta_time);
+
+	file << "  \"load_ms\": {";
+	bool first = true;
+	for (const auto &[name, ms] : load_times_ms_)
+	{
+		file << (first ? "" : ", ") << fmt::format("\"{}\": {}", name, ms);
+		first = false;
+	}
+	file << "},\n";
+
+	file << "  \"summary\": {\n";
+	file << fmt::format("    \"cpu_ms\": {},\n", format_summary(stats::summarize(std::move(cpu_ms))));
+	file << fmt::format("    \"frame_ms\": {},\n", format_summary(stats::summarize(std::move(frame_ms))));
+	file << fmt::format("    \"gpu_ms\": {}\n", format_summary(stats::summarize(std::move(gpu_ms))));
+	file << "  },\n";
+
+	file << "  \"frames\": [";
+	first = true;
+	for (const auto &record : frames_)
+	{
+		std::vector<std::string> passes;
+		for (const auto &[name, ms] : record.pass_gpu_ms)
+		{
+			passes.push_back(fmt::format("\"{}\": {}", name, ms));
+		}
+
+		file << (first ? "" : ",") << fmt::format(
+		    "\n    {{\"cpu_ms\": {}, \"frame_ms\": {}, \"gpu_ms\": {}, \"device_memory_mb\": {}, \"passes\": {{{}}}}}",
+		    record.cpu_ms, record.frame_ms, record.gpu_ms ? fmt::format("{}", *record.gpu_ms) : "null",
+		    record.device_memory_mb, fmt::join(passes, ", "));
+		first = false;
+	}
+	file << "\n  ]\n}\n";
+
+	LOGI("Wrote benchmark report of {} frames to {}", frames_.size(), config_.output_path);
+}
+
+void BenchApp::draw_gui()
+{
+	gui_->show_stats(*stats_);
+}
+}        // namespace xihe
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "sample_app.h"
+
+#include <map>
+#include <optional>
+
+#include "common/timer.h"
+#include "scene_graph/scripts/transform_path.h"
+
+namespace xihe
+{
+struct BenchConfig
+{
+	std::string scene_path{"scenes/sponza/Sponza01.gltf"};
+
+	/// Keyframes of the camera and lights, the built-in fly-through of Sponza is used if empty
+	std::string path_file;
+
+	std::string output_path;
+
+	uint32_t frame_count{600};
+
+	/// Frames rendered before measuring, so pipeline builds and the first uploads are not counted
+	uint32_t warmup_frame_count{60};
+
+	/// Every frame advances the animation by this much, whatever its actual duration
+	float frame_delta_time{1.0f / 60.0f};
+
+	/// Samples frame and GPU times on a thread at this interval if not 0, the samples are written next to the report as CSV
+	uint32_t stats_interval_ms{0};
+};
+
+/**
+ * \brief Renders the sample scene along a scripted camera path for a fixed number of frames
+ *        and writes per-frame CPU and GPU timings, memory usage and load times as JSON
+ */
+class BenchApp : public SampleApp
+{
+  public:
+	explicit BenchApp(BenchConfig config);
+	~BenchApp() override = default;
+
+	bool prepare(Window *window) override;
+
+	void update(float delta_time) override;
+
+	/// Whether all frames were rendered and the report was written
+	bool is_complete() const;
+
+  private:
+	struct FrameRecord
+	{
+		double cpu_ms{0.0};        // recording and submitting the frame
+		double frame_ms{0.0};      // between the starts of two frames, including waits for the GPU and the swapchain
+
+		// Sum over the submitted batches, empty if the frame's timestamps were never read back
+		std::optional<double>         gpu_ms;
+		std::map<std::string, double> pass_gpu_ms;
+
+		double device_memory_mb{0.0};
+	};
+
+	static std::vector<sg::TransformPath::Keyframe> get_default_camera_path();
+
+	void add_transform_paths();
+
+	/// Attributes the GPU timings read back at the start of this frame to the frame that last used its render frame
+	void record_gpu_timings();
+
+	double get_device_memory_usage_mb() const;
+
+	void write_report() const;
+
+	void draw_gui() override;
+
+	BenchConfig config_;
+
+	std::map<std::string, double> load_times_ms_;
+
+	uint32_t frame_index_{0};
+
+	// GPU timings of a frame are only read back once its render frame is reused, so each
+	// render frame remembers the frame index it was last used for
+	std::vector<std::optional<uint32_t>> render_frame_users_;
+
+	std::vector<FrameRecord> frames_;
+
+	Timer frame_timer_;
+
+	bool complete_{false};
+};
+}        // namespace xihe
@@ -0,0 +1,122 @@
+#include <iostream>
+#include <string>
+
+#include "bench_app.h"
+#include "platform/headless/headless_platform.h"
+#include "platform/windows/windows_platform.h"
+
+namespace
+{
+void print_usage()
+{
+	std::cout << "Usage: xihe_bench [options]\n"
+	             "  --scene <path>     glTF scene relative to the assets directory\n"
+	             "  --path <file>      keyframes of the camera and lights, see sg::TransformPath::load_tracks\n"
+	             "  --frames <count>   frames to measure\n"
+	             "  --warmup <count>   frames to render before measuring\n"
+	             "  --output <file>    JSON report, defaults to bench.json in the storage directory\n"
+	             "  --width <pixels>\n"
+	             "  --height <pixels>\n"
+	             "  --stats-interval <ms>  samples frame and GPU times continuously, written next to the report as CSV\n"
+	             "  --headless         render without a window through VK_EXT_headless_surface\n";
+}
+}        // namespace
+
+int main(int argc, char *argv[])
+{
+	xihe::BenchConfig                config;
+	xihe::Window::OptionalProperties properties{};
+	properties.title     = "Xi He Bench";
+	properties.vsync     = xihe::Window::Vsync::OFF;
+	properties.resizable = false;
+
+	bool headless = false;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+
+		if (arg == "--headless")
+		{
+			headless = true;
+			continue;
+		}
+
+		if (i + 1 >= argc)
+		{
+			print_usage();
+			return 1;
+		}
+		const std::string value = argv[++i];
+
+		if (arg == "--scene")
+		{
+			config.scene_path = value;
+		}
+		else if (arg == "--path")
+		{
+			config.path_file = value;
+		}
+		else if (arg == "--frames")
+		{
+			config.frame_count = static_cast<uint32_t>(std::stoul(value));
+		}
+		else if (arg == "--warmup")
+		{
+			config.warmup_frame_count = static_cast<uint32_t>(std::stoul(value));
+		}
+		else if (arg == "--output")
+		{
+			config.output_path = value;
+		}
+		else if (arg == "--width")
+		{
+			properties.extent.width = static_cast<uint32_t>(std::stoul(value));
+		}
+		else if (arg == "--height")
+		{
+			properties.extent.height = static_cast<uint32_t>(std::stoul(value));
+		}
+		else if (arg == "--stats-interval")
+		{
+			config.stats_interval_ms = static_cast<uint32_t>(std::stoul(value));
+		}
+		else
+		{
+			print_usage();
+			return 1;
+		}
+	}
+
+	std::unique_ptr<xihe::Platform> platform;
+	if (headless)
+	{
+		properties.mode = xihe::Window::Mode::kHeadless;
+		platform        = std::make_unique<xihe::HeadlessPlatform>();
+	}
+	else
+	{
+		platform = std::make_unique<xihe::WindowsPlatform>();
+	}
+	platform->set_window_properties(properties);
+
+	xihe::BenchApp *bench_app = nullptr;
+
+	const auto code = platform->initialize();
+	const bool started = code == xihe::ExitCode::kSuccess && platform->start_app("xihe_bench", [&]() {
+		auto app  = std::make_unique<xihe::BenchApp>(config);
+		bench_app = app.get();
+		return app;
+	});
+
+	bool complete = false;
+	if (started)
+	{
+		platform->main_loop();
+		complete = bench_app && bench_app->is_complete();
+	}
+
+	platform->terminate(code);
+
+	return complete ? 0 : 1;
+}
@@ -0,0 +1,231 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <unordered_map>
+
+#include "common/logging.h"
+
+namespace xihe::trace
+{
+namespace
+{
+struct Registry
+{
+	std::mutex mutex;
+
+	// Buffers stay registered after their thread exits, so zones of finished workers still end up in a dump
+	std::vector<std::shared_ptr<ZoneBuffer>> buffers;
+
+	std::unordered_map<std::string, std::shared_ptr<ZoneBuffer>> named_tracks;
+};
+
+Registry &get_registry()
+{
+	static Registry registry;
+	return registry;
+}
+
+std::shared_ptr<ZoneBuffer> register_buffer(std::string name)
+{
+	auto &registry = get_registry();
+
+	std::lock_guard<std::mutex> lock{registry.mutex};
+
+	auto buffer = std::make_shared<ZoneBuffer>(static_cast<uint32_t>(registry.buffers.size()), std::move(name));
+	registry.buffers.push_back(buffer);
+	return buffer;
+}
+
+void copy_name(char (&dst)[sizeof(Zone::name)], std::string_view name)
+{
+	const size_t length = std::min(name.size(), sizeof(Zone::name) - 1);
+	std::memcpy(dst, name.data(), length);
+	dst[length] = '\0';
+}
+
+void write_escaped(std::ofstream &file, const char *str)
+{
+	for (; *str != '\0'; ++str)
+	{
+		if (*str == '"' || *str == '\\')
+		{
+			file << '\\';
+		}
+		file << *str;
+	}
+}
+}        // namespace
+
+ZoneBuffer::ZoneBuffer(uint32_t track_id, std::string name) :
+    track_id_{track_id}, name_{std::move(name)}, zones_{std::make_unique<Zone[]>(kCapacity)}
+{}
+
+void ZoneBuffer::push(std::string_view name, uint64_t begin_ns, uint64_t end_ns)
+{
+	Zone zone;
+	copy_name(zone.name, name);
+	zone.begin_ns = begin_ns;
+	zone.end_ns   = end_ns;
+
+	push(zone);
+}
+
+void ZoneBuffer::push(const Zone &zone)
+{
+	const uint64_t head = head_.load(std::memory_order_relaxed);
+
+	zones_[head % kCapacity] = zone;
+
+	// Publishes the zone to snapshot()
+	head_.store(head + 1, std::memory_order_release);
+}
+
+std::vector<Zone> ZoneBuffer::snapshot() const
+{
+	const uint64_t head  = head_.load(std::memory_order_acquire);
+	const uint64_t first = head > kCapacity ? head - kCapacity : 0;
+
+	std::vector<Zone> zones;
+	zones.reserve(head - first);
+	for (uint64_t i = first; i < head; ++i)
+	{
+		zones.push_back(zones_[i % kCapacity]);
+	}
+
+	// The owner may have wrapped around while copying, the slots it wrote to since are not trustworthy
+	const uint64_t new_head = head_.load(std::memory_order_acquire);
+	if (new_head > first + kCapacity)
+	{
+		const uint64_t overwritten = std::min<uint64_t>(new_head - first - kCapacity, zones.size());
+		zones.erase(zones.begin(), zones.begin() + static_cast<std::ptrdiff_t>(overwritten));
+	}
+
+	return zones;
+}
+
+uint32_t ZoneBuffer::get_track_id() const
+{
+	return track_id_;
+}
+
+std::string ZoneBuffer::get_name() const
+{
+	std::lock_guard<std::mutex> lock{name_mutex_};
+	return name_;
+}
+
+void ZoneBuffer::set_name(std::string name)
+{
+	std::lock_guard<std::mutex> lock{name_mutex_};
+	name_ = std::move(name);
+}
+
+uint64_t now()
+{
+	static const auto epoch = std::chrono::steady_clock::now();
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count());
+}
+
+ZoneBuffer &get_thread_buffer()
+{
+	thread_local std::shared_ptr<ZoneBuffer> buffer = register_buffer({});
+	return *buffer;
+}
+
+ZoneBuffer &get_track_buffer(const std::string &name)
+{
+	auto &registry = get_registry();
+
+	{
+		std::lock_guard<std::mutex> lock{registry.mutex};
+
+		auto it = registry.named_tracks.find(name);
+		if (it != registry.named_tracks.end())
+		{
+			return *it->second;
+		}
+	}
+
+	auto buffer = register_buffer(name);
+
+	std::lock_guard<std::mutex> lock{registry.mutex};
+	return *registry.named_tracks.emplace(name, std::move(buffer)).first->second;
+}
+
+void set_thread_name(std::string name)
+{
+	get_thread_buffer().set_name(std::move(name));
+}
+
+bool write_chrome_trace(const std::string &path)
+{
+	std::vector<std::shared_ptr<ZoneBuffer>> buffers;
+	{
+		auto &registry = get_registry();
+
+		std::lock_guard<std::mutex> lock{registry.mutex};
+		buffers = registry.buffers;
+	}
+
+	std::ofstream file{path, std::ios::out | std::ios::trunc};
+	if (!file.is_open())
+	{
+		LOGE("Failed to open {} for writing the trace", path);
+		return false;
+	}
+
+	// Microseconds with nanosecond precision, the default formatting switches to exponents for long captures
+	file << std::fixed << std::setprecision(3);
+
+	size_t zone_count = 0;
+
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"Xihe\"}}";
+
+	for (const auto &buffer : buffers)
+	{
+		const uint32_t tid = buffer->get_track_id();
+
+		file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << tid << ",\"args\":{\"name\":\"";
+		auto name = buffer->get_name();
+		write_escaped(file, name.empty() ? fmt::format("Thread {}", tid).c_str() : name.c_str());
+		file << "\"}}";
+
+		// Keeps the tracks in registration order, the main thread registers first
+		file << ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":0,\"tid\":" << tid << ",\"args\":{\"sort_index\":" << tid << "}}";
+
+		const auto zones = buffer->snapshot();
+		for (const auto &zone : zones)
+		{
+			file << ",\n{\"name\":\"";
+			write_escaped(file, zone.name);
+			file << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << tid
+			     << ",\"ts\":" << static_cast<double>(zone.begin_ns) / 1e3
+			     << ",\"dur\":" << static_cast<double>(zone.end_ns - zone.begin_ns) / 1e3 << "}";
+		}
+
+		zone_count += zones.size();
+	}
+
+	file << "\n]}\n";
+
+	LOGI("Wrote {} zones on {} tracks to {}", zone_count, buffers.size(), path);
+	return true;
+}
+
+ScopedZone::ScopedZone(std::string_view name)
+{
+	copy_name(zone_.name, name);
+	zone_.begin_ns = now();
+}
+
+ScopedZone::~ScopedZone()
+{
+	zone_.end_ns = now();
+	get_thread_buffer().push(zone_);
+}
+}        // namespace xihe::trace
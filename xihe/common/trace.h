@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace xihe::trace
+{
+struct Zone
+{
+	// Zone names are copied, so names built on the fly are fine, longer names get truncated
+	char name[48];
+
+	uint64_t begin_ns;
+	uint64_t end_ns;
+};
+
+/**
+ * \brief Ring buffer of finished zones on one track, a thread or a GPU queue.
+ *        Only one thread pushes to a buffer, so pushing takes no lock, the oldest zones are overwritten once it is full.
+ */
+class ZoneBuffer
+{
+  public:
+	static constexpr uint32_t kCapacity = 16384;
+
+	ZoneBuffer(uint32_t track_id, std::string name);
+
+	ZoneBuffer(const ZoneBuffer &)            = delete;
+	ZoneBuffer &operator=(const ZoneBuffer &) = delete;
+
+	void push(std::string_view name, uint64_t begin_ns, uint64_t end_ns);
+
+	void push(const Zone &zone);
+
+	/**
+	 * \brief Copies the zones in the buffer, can be called from any thread while the owner keeps pushing.
+	 *        Zones overwritten during the copy are left out.
+	 */
+	std::vector<Zone> snapshot() const;
+
+	uint32_t get_track_id() const;
+
+	std::string get_name() const;
+
+	void set_name(std::string name);
+
+  private:
+	uint32_t track_id_;
+
+	// Renaming is rare, but may race with a dump
+	mutable std::mutex name_mutex_;
+	std::string        name_;
+
+	std::unique_ptr<Zone[]> zones_;
+
+	// Number of zones ever pushed, the next one goes to head_ % kCapacity
+	std::atomic<uint64_t> head_{0};
+};
+
+/// Nanoseconds since the first call, all CPU and GPU zones share this time base
+uint64_t now();
+
+/// The buffer of the calling thread, created and registered on first use
+ZoneBuffer &get_thread_buffer();
+
+/// A track that is not bound to a thread, e.g. a GPU queue, created and registered on first use
+ZoneBuffer &get_track_buffer(const std::string &name);
+
+/// Names the track of the calling thread in the trace
+void set_thread_name(std::string name);
+
+/**
+ * \brief Writes all registered tracks as complete events of the Chrome trace event format,
+ *        which chrome://tracing and Perfetto open directly
+ */
+bool write_chrome_trace(const std::string &path);
+
+/**
+ * \brief Pushes a zone from its construction to its destruction to the buffer of the calling thread
+ */
+class ScopedZone
+{
+  public:
+	explicit ScopedZone(std::string_view name);
+
+	~ScopedZone();
+
+	ScopedZone(const ScopedZone &)            = delete;
+	ScopedZone &operator=(const ScopedZone &) = delete;
+
+  private:
+	// The name is copied right away, so a temporary string can name the zone
+	Zone zone_;
+};
+}        // namespace xihe::trace
+
+#define XIHE_TRACE_CONCAT_INNER(a, b) a##b
+#define XIHE_TRACE_CONCAT(a, b) XIHE_TRACE_CONCAT_INNER(a, b)
+
+#ifndef XIHE_DISABLE_TRACE
+#	define XIHE_TRACE_ZONE(name) ::xihe::trace::ScopedZone XIHE_TRACE_CONCAT(trace_zone_, __LINE__){name}
+#	define XIHE_TRACE_THREAD_NAME(name) ::xihe::trace::set_thread_name(name)
+#else
+#	define XIHE_TRACE_ZONE(name)
+#	define XIHE_TRACE_THREAD_NAME(name)
+#endif
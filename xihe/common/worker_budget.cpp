@@ -0,0 +1,76 @@
+#include "worker_budget.h"
+
+#include <algorithm>
+#include <thread>
+#include <utility>
+
+namespace xihe
+{
+WorkerBudget::Lease::Lease(WorkerBudget &budget, uint32_t extra_thread_count) :
+    budget_{&budget}, extra_thread_count_{extra_thread_count}
+{}
+
+WorkerBudget::Lease::~Lease()
+{
+	release();
+}
+
+WorkerBudget::Lease::Lease(Lease &&other) noexcept :
+    budget_{std::exchange(other.budget_, nullptr)}, extra_thread_count_{std::exchange(other.extra_thread_count_, 0)}
+{}
+
+WorkerBudget::Lease &WorkerBudget::Lease::operator=(Lease &&other) noexcept
+{
+	if (this != &other)
+	{
+		release();
+		budget_             = std::exchange(other.budget_, nullptr);
+		extra_thread_count_ = std::exchange(other.extra_thread_count_, 0);
+	}
+	return *this;
+}
+
+uint32_t WorkerBudget::Lease::get_thread_count() const
+{
+	return extra_thread_count_ + 1;
+}
+
+void WorkerBudget::Lease::release()
+{
+	if (budget_ && extra_thread_count_ > 0)
+	{
+		budget_->free_threads_.fetch_add(extra_thread_count_, std::memory_order_relaxed);
+	}
+	budget_             = nullptr;
+	extra_thread_count_ = 0;
+}
+
+WorkerBudget::WorkerBudget(uint32_t thread_count) :
+    thread_count_{std::max(1u, thread_count)}, free_threads_{thread_count_ - 1}
+{}
+
+WorkerBudget &WorkerBudget::get()
+{
+	static WorkerBudget budget{std::thread::hardware_concurrency()};
+	return budget;
+}
+
+WorkerBudget::Lease WorkerBudget::acquire(uint32_t thread_count)
+{
+	const uint32_t wanted = std::max(1u, thread_count) - 1;
+
+	uint32_t free_threads = free_threads_.load(std::memory_order_relaxed);
+	uint32_t taken        = std::min(wanted, free_threads);
+	while (taken > 0 && !free_threads_.compare_exchange_weak(free_threads, free_threads - taken, std::memory_order_relaxed))
+	{
+		taken = std::min(wanted, free_threads);
+	}
+
+	return Lease{*this, taken};
+}
+
+uint32_t WorkerBudget::get_thread_count() const
+{
+	return thread_count_;
+}
+}        // namespace xihe
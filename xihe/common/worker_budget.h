@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace xihe
+{
+/**
+ * \brief Threads that parallel work may run on, shared by the whole process.
+ *        The asset loader takes its pool from here, the decoders and encoders it runs take extra threads from what is left
+ *        and give them back when done, so nested parallelism never goes past the core count.
+ */
+class WorkerBudget
+{
+  public:
+	/**
+	 * \brief Threads taken from the budget, returned when the lease is destroyed.
+	 *        The thread that took the lease is always part of it, so a lease never has less than one thread.
+	 */
+	class Lease
+	{
+	  public:
+		Lease() = default;
+
+		Lease(WorkerBudget &budget, uint32_t extra_thread_count);
+
+		~Lease();
+
+		Lease(const Lease &)            = delete;
+		Lease &operator=(const Lease &) = delete;
+
+		Lease(Lease &&other) noexcept;
+		Lease &operator=(Lease &&other) noexcept;
+
+		uint32_t get_thread_count() const;
+
+	  private:
+		void release();
+
+		WorkerBudget *budget_{nullptr};
+
+		uint32_t extra_thread_count_{0};
+	};
+
+	explicit WorkerBudget(uint32_t thread_count);
+
+	/// Sized to the hardware concurrency
+	static WorkerBudget &get();
+
+	/**
+	 * \brief Takes up to thread_count threads, the calling thread included, as many as are free
+	 */
+	Lease acquire(uint32_t thread_count);
+
+	uint32_t get_thread_count() const;
+
+  private:
+	const uint32_t thread_count_;
+
+	// The calling thread of a lease is never counted, so this starts one below the thread count
+	std::atomic<uint32_t> free_threads_;
+};
+}        // namespace xihe
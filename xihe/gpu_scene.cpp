@@ -2,6 +2,7 @@
 
 #include "meshoptimizer.h"
 
+#include "common/trace.h"
 #include "scene_graph/components/material.h"
 #include "scene_graph/components/mesh.h"
 #include "scene_graph/node.h"
@@ -202,6 +203,8 @@ GpuScene::GpuScene(backend::Device &device): device_{device}
 
 void GpuScene::initialize(sg::Scene &scene)
 {
+	XIHE_TRACE_ZONE("Initialize GPU scene");
+
 	auto meshes = scene.get_components<sg::Mesh>();
 
 	std::vector<MeshDraw> mesh_draws;
@@ -267,7 +270,8 @@ void GpuScene::initialize(sg::Scene &scene)
 	{
 		backend::BufferBuilder buffer_builder{packed_vertices.size() * sizeof(PackedVertex)};
 		buffer_builder.with_usage(vk::BufferUsageFlagBits::eStorageBuffer)
-		    .with_vma_usage(VMA_MEMORY_USAGE_CPU_TO_GPU);
+		    .with_vma_usage(VMA_MEMORY_USAGE_CPU_TO_GPU)
+		    .with_memory_category(backend::allocated::MemoryCategory::kGpuScene);
 		global_vertex_buffer_ = std::make_unique<backend::Buffer>(device_, buffer_builder);
 		global_vertex_buffer_->set_debug_name("global vertex buffer");
 		global_vertex_buffer_->update(packed_vertices);
@@ -275,7 +279,8 @@ void GpuScene::initialize(sg::Scene &scene)
 	{
 		backend::BufferBuilder buffer_builder{meshlets.size() * sizeof(Meshlet)};
 		buffer_builder.with_usage(vk::BufferUsageFlagBits::eStorageBuffer)
-		    .with_vma_usage(VMA_MEMORY_USAGE_CPU_TO_GPU);
+		    .with_vma_usage(VMA_MEMORY_USAGE_CPU_TO_GPU)
+		    .with_memory_category(backend::allocated::MemoryCategory::kGpuScene);
 		global_meshlet_buffer_ = std::make_unique<backend::Buffer>(device_, buffer_builder);
 		global_meshlet_buffer_->set_debug_name("global meshlet buffer");
 		global_meshlet_buffer_->update(meshlets);
@@ -283,7 +288,8 @@ void GpuScene::initialize(sg::Scene &scene)
 	{
 		backend::BufferBuilder buffer_builder{meshlet_vertices.size() * sizeof(uint32_t)};
 		buffer_builder.with_usage(vk::BufferUsageFlagBits::eStorageBuffer)
-		    .with_vma_usage(VMA_MEMORY_USAGE_CPU_TO_GPU);
+		    .with_vma_usage(VMA_MEMORY_USAGE_CPU_TO_GPU)
+		    .with_memory_category(backend::allocated::MemoryCategory::kGpuScene);
 		global_meshlet_vertices_buffer_ = std::make_unique<backend::Buffer>(device_, buffer_builder);
 		global_meshlet_vertices_buffer_->set_debug_name("global meshlet vertices buffer");
 		global_meshlet_vertices_buffer_->update(meshlet_vertices);
@@ -291,25 +297,23 @@ void GpuScene::initialize(sg::Scene &scene)
 		{
 		backend::BufferBuilder buffer_builder{meshlet_triangles.size() * sizeof(uint32_t)};
 		buffer_builder.with_usage(vk::BufferUsageFlagBits::eStorageBuffer)
-		    .with_vma_usage(VMA_MEMORY_USAGE_CPU_TO_GPU);
+		    .with_vma_usage(VMA_MEMORY_USAGE_CPU_TO_GPU)
+		    .with_memory_category(backend::allocated::MemoryCategory::kGpuScene);
 		global_packed_meshlet_indices_buffer_ = std::make_unique<backend::Buffer>(device_, buffer_builder);
 		global_packed_meshlet_indices_buffer_->set_debug_name("global packed meshlet indices buffer");
 		global_packed_meshlet_indices_buffer_->update(meshlet_triangles);
 	}
 	{
-		backend::BufferBuilder buffer_builder{mesh_draws.size() * sizeof(MeshDraw)};
-		buffer_builder.with_usage(vk::BufferUsageFlagBits::eStorageBuffer)
-		    .with_vma_usage(VMA_MEMORY_USAGE_CPU_TO_GPU);
-		mesh_draws_buffer_ = std::make_unique<backend::Buffer>(device_, buffer_builder);
-		mesh_draws_buffer_->set_debug_name("mesh draws buffer");
-		mesh_draws_buffer_->update(mesh_draws);
+		mesh_draws_ = std::move(mesh_draws);
+		create_mesh_draws_buffer();
 	}
 	{
-		assert(mesh_bounds.size() == mesh_draws.size());
+		assert(mesh_bounds.size() == mesh_draws_.size());
 
 		backend::BufferBuilder buffer_builder{mesh_bounds.size() * sizeof(glm::vec4)};
 		buffer_builder.with_usage(vk::BufferUsageFlagBits::eStorageBuffer)
-		    .with_vma_usage(VMA_MEMORY_USAGE_CPU_TO_GPU);
+		    .with_vma_usage(VMA_MEMORY_USAGE_CPU_TO_GPU)
+		    .with_memory_category(backend::allocated::MemoryCategory::kGpuScene);
 		mesh_bounds_buffer_ = std::make_unique<backend::Buffer>(device_, buffer_builder);
 		mesh_bounds_buffer_->set_debug_name("mesh bounds buffer");
 		mesh_bounds_buffer_->update(mesh_bounds);
@@ -317,7 +321,8 @@ void GpuScene::initialize(sg::Scene &scene)
 	{
 		backend::BufferBuilder buffer_builder{sizeof(uint32_t)};
 		buffer_builder.with_usage(vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer)
-		    .with_vma_usage(VMA_MEMORY_USAGE_CPU_TO_GPU);
+		    .with_vma_usage(VMA_MEMORY_USAGE_CPU_TO_GPU)
+		    .with_memory_category(backend::allocated::MemoryCategory::kGpuScene);
 		draw_counts_buffer_ = std::make_unique<backend::Buffer>(device_, buffer_builder);
 		draw_counts_buffer_->set_debug_name("draw counts buffer");
 		draw_counts_buffer_->update(std::vector<uint32_t>{0});
@@ -325,7 +330,8 @@ void GpuScene::initialize(sg::Scene &scene)
 	{
 		backend::BufferBuilder buffer_builder{instance_draws.size() * sizeof(MeshInstanceDraw)};
 		buffer_builder.with_usage(vk::BufferUsageFlagBits::eStorageBuffer)
-		    .with_vma_usage(VMA_MEMORY_USAGE_CPU_TO_GPU);
+		    .with_vma_usage(VMA_MEMORY_USAGE_CPU_TO_GPU)
+		    .with_memory_category(backend::allocated::MemoryCategory::kGpuScene);
 		instance_buffer_ = std::make_unique<backend::Buffer>(device_, buffer_builder);
 		instance_buffer_->set_debug_name("instance buffer");
 		instance_buffer_->update(instance_draws);
@@ -334,13 +340,51 @@ void GpuScene::initialize(sg::Scene &scene)
 	{
 		backend::BufferBuilder buffer_builder{instance_draws.size() * sizeof(MeshDrawCommand)};
 		buffer_builder.with_usage(vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer)
-		    .with_vma_usage(VMA_MEMORY_USAGE_CPU_TO_GPU);
+		    .with_vma_usage(VMA_MEMORY_USAGE_CPU_TO_GPU)
+		    .with_memory_category(backend::allocated::MemoryCategory::kGpuScene);
 		draw_command_buffer_ = std::make_unique<backend::Buffer>(device_, buffer_builder);
 		draw_command_buffer_->set_debug_name("draw command buffer");
 		draw_command_buffer_->update(std::vector<MeshDrawCommand>(instance_draws.size()));
 	}
 }
 
+std::unique_ptr<backend::Buffer> GpuScene::remap_texture_indices(const std::unordered_map<uint32_t, uint32_t> &indices)
+{
+	bool changed = false;
+	for (auto &mesh_draw : mesh_draws_)
+	{
+		for (glm::length_t i = 0; i < mesh_draw.texture_indices.length(); ++i)
+		{
+			auto it = indices.find(mesh_draw.texture_indices[i]);
+			if (it != indices.end())
+			{
+				mesh_draw.texture_indices[i] = it->second;
+				changed                      = true;
+			}
+		}
+	}
+
+	if (!changed)
+	{
+		return nullptr;
+	}
+
+	auto replaced = std::move(mesh_draws_buffer_);
+	create_mesh_draws_buffer();
+	return replaced;
+}
+
+void GpuScene::create_mesh_draws_buffer()
+{
+	backend::BufferBuilder buffer_builder{mesh_draws_.size() * sizeof(MeshDraw)};
+	buffer_builder.with_usage(vk::BufferUsageFlagBits::eStorageBuffer)
+	    .with_vma_usage(VMA_MEMORY_USAGE_CPU_TO_GPU)
+	    .with_memory_category(backend::allocated::MemoryCategory::kGpuScene);
+	mesh_draws_buffer_ = std::make_unique<backend::Buffer>(device_, buffer_builder);
+	mesh_draws_buffer_->set_debug_name("mesh draws buffer");
+	mesh_draws_buffer_->update(mesh_draws_);
+}
+
 backend::Buffer &GpuScene::get_instance_buffer() const
 {
 	if (!instance_buffer_)
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <unordered_map>
+
 #include "backend/buffer.h"
 #include "backend/device.h"
 #include "scene_graph/geometry_data.h"
@@ -88,6 +90,13 @@ class GpuScene
 
 	void initialize(sg::Scene &scene);
 
+	/**
+	 * \brief Remaps the bindless texture indices of the mesh draws. Frames in flight still read the current buffer, so the
+	 *        remapped draws go to a new one
+	 * \return The replaced buffer, to release once the frames in flight retired, or nullptr when no draw changed
+	 */
+	std::unique_ptr<backend::Buffer> remap_texture_indices(const std::unordered_map<uint32_t, uint32_t> &indices);
+
 	backend::Buffer &get_instance_buffer() const;
 	backend::Buffer &get_mesh_draws_buffer() const;
 	backend::Buffer &get_mesh_bounds_buffer() const;
@@ -104,10 +113,14 @@ class GpuScene
 	backend::Device &get_device() const;
 
   private:
+	void create_mesh_draws_buffer();
+
 	backend::Device &device_;
 
 	uint32_t instance_count_{};
 
+	std::vector<MeshDraw> mesh_draws_;
+
 	std::unique_ptr<backend::Buffer> global_vertex_buffer_;
 	std::unique_ptr<backend::Buffer> global_meshlet_buffer_;
 	std::unique_ptr<backend::Buffer> global_meshlet_vertices_buffer_;
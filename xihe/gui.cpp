@@ -133,8 +133,9 @@ Gui::Gui(XiheApp &app, Window &window, const stats::Stats *stats, const float fo
 
 	backend::ImageBuilder image_builder{font_extent};
 	image_builder.with_format(vk::Format::eR8G8B8A8Unorm)
-	    .with_usage(vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst)
-	    .with_vma_flags(VMA_MEMORY_USAGE_GPU_ONLY);
+	    .with_usage(vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eTransferSrc)
+	    .with_vma_flags(VMA_MEMORY_USAGE_GPU_ONLY)
+	    .with_memory_category(backend::allocated::MemoryCategory::kTexture);
 	font_image_ = image_builder.build_unique(device);
 	font_image_->set_debug_name("GUI font image");
 
@@ -570,7 +571,7 @@ void Gui::show_stats(const stats::Stats &stats)
 		assert(it != stats_view_.graph_map.end() && "StatIndex not implemented in gui graph_map");
 
 		auto       &graph_data     = it->second;
-		const auto &graph_elements = stats.get_data(stat_index);
+		const auto  graph_elements = stats.get_data(stat_index);
 		float       graph_min      = 0.0f;
 		float      &graph_max      = graph_data.max_value;
 
@@ -596,6 +597,18 @@ void Gui::show_stats(const stats::Stats &stats)
 			std::string text = fmt::format(fmt::runtime(graph_label.str()), avg * graph_data.scale_factor);
 			ImGui::PlotLines(text.c_str(), graph_elements.data(), static_cast<int>(graph_elements.size()), 0, nullptr, graph_min, graph_max, graph_size);
 
+			// The graph is smoothed, spikes only show in the distribution of the raw samples
+			if (ImGui::IsItemHovered())
+			{
+				const auto summary      = stats.get_summary(stat_index);
+				auto       format_value = [&graph_data](float value) { return fmt::format(fmt::runtime(graph_data.format), value * graph_data.scale_factor); };
+
+				std::string tooltip = fmt::format("{} samples\nmin {}\nmean {}\np50 {}\np95 {}\np99 {}\nmax {}", summary.count,
+				                                  format_value(summary.min), format_value(summary.mean), format_value(summary.p50),
+				                                  format_value(summary.p95), format_value(summary.p99), format_value(summary.max));
+				ImGui::SetTooltip("%s", tooltip.c_str());
+			}
+
 			ImGui::Text(text.c_str());
 			ImGui::Separator(); 
 		}
@@ -605,6 +618,22 @@ void Gui::show_stats(const stats::Stats &stats)
 			ImGui::Text("%s", graph_label.str().c_str());
 		}
 	}
+
+	// Passes are indented below the batch they were submitted in
+	for (const auto &timing : stats.get_gpu_timings())
+	{
+		std::string text = fmt::format("{:{}}{}: {:.2f} ms", "", timing.depth * 2, timing.name, timing.gpu_ms);
+		ImGui::Text("%s", text.c_str());
+
+		if (!timing.pipeline_statistics.empty() && ImGui::IsItemHovered())
+		{
+			const auto &statistics = timing.pipeline_statistics;
+			ImGui::SetTooltip("Vertices: %llu\nVertex invocations: %llu\nClipping primitives: %llu\nFragment invocations: %llu\nCompute invocations: %llu",
+			                  static_cast<unsigned long long>(statistics[0]), static_cast<unsigned long long>(statistics[1]),
+			                  static_cast<unsigned long long>(statistics[2]), static_cast<unsigned long long>(statistics[3]),
+			                  static_cast<unsigned long long>(statistics[4]));
+		}
+	}
 	ImGui::End();
 }
 
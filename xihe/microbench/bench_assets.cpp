@@ -0,0 +1,186 @@
+#include "microbench/microbench.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+#include "backend/shader_module.h"
+#include "platform/filesystem.h"
+#include "scene_graph/components/image.h"
+#include "scene_graph/components/mshader_mesh.h"
+#include "scene_graph/gltf_loader.h"
+
+namespace xihe::microbench
+{
+namespace
+{
+struct GridVertex
+{
+	float position[3];
+	float normal[3];
+	float uv[2];
+};
+
+/**
+ * \brief A glTF model with one primitive, a side x side grid of interleaved vertices indexed with 32 bit indices,
+ *        laid out the way exporters usually write meshes
+ */
+tinygltf::Model create_grid_model(uint32_t side)
+{
+	const uint32_t vertex_count = side * side;
+
+	std::vector<GridVertex> vertices;
+	vertices.reserve(vertex_count);
+	for (uint32_t y = 0; y < side; ++y)
+	{
+		for (uint32_t x = 0; x < side; ++x)
+		{
+			const float u = static_cast<float>(x) / static_cast<float>(side - 1);
+			const float v = static_cast<float>(y) / static_cast<float>(side - 1);
+			vertices.push_back({{u * 100.0f, std::sin(u * 20.0f) * std::cos(v * 20.0f), v * 100.0f}, {0.0f, 1.0f, 0.0f}, {u, v}});
+		}
+	}
+
+	std::vector<uint32_t> indices;
+	indices.reserve((side - 1) * (side - 1) * 6);
+	for (uint32_t y = 0; y + 1 < side; ++y)
+	{
+		for (uint32_t x = 0; x + 1 < side; ++x)
+		{
+			const uint32_t i = y * side + x;
+			indices.insert(indices.end(), {i, i + side, i + 1, i + 1, i + side, i + side + 1});
+		}
+	}
+
+	const size_t vertex_bytes = vertices.size() * sizeof(GridVertex);
+	const size_t index_bytes  = indices.size() * sizeof(uint32_t);
+
+	tinygltf::Model model;
+
+	auto &buffer = model.buffers.emplace_back();
+	buffer.data.resize(vertex_bytes + index_bytes);
+	std::memcpy(buffer.data.data(), vertices.data(), vertex_bytes);
+	std::memcpy(buffer.data.data() + vertex_bytes, indices.data(), index_bytes);
+
+	auto &vertex_view      = model.bufferViews.emplace_back();
+	vertex_view.buffer     = 0;
+	vertex_view.byteLength = vertex_bytes;
+	vertex_view.byteStride = sizeof(GridVertex);
+
+	auto &index_view      = model.bufferViews.emplace_back();
+	index_view.buffer     = 0;
+	index_view.byteOffset = vertex_bytes;
+	index_view.byteLength = index_bytes;
+
+	const auto add_accessor = [&model](int buffer_view, size_t offset, int component_type, int type, size_t count) {
+		auto &accessor         = model.accessors.emplace_back();
+		accessor.bufferView    = buffer_view;
+		accessor.byteOffset    = offset;
+		accessor.componentType = component_type;
+		accessor.type          = type;
+		accessor.count         = count;
+		return static_cast<int>(model.accessors.size() - 1);
+	};
+
+	auto &primitive                    = model.meshes.emplace_back().primitives.emplace_back();
+	primitive.mode                     = TINYGLTF_MODE_TRIANGLES;
+	primitive.attributes["POSITION"]   = add_accessor(0, offsetof(GridVertex, position), TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC3, vertex_count);
+	primitive.attributes["NORMAL"]     = add_accessor(0, offsetof(GridVertex, normal), TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC3, vertex_count);
+	primitive.attributes["TEXCOORD_0"] = add_accessor(0, offsetof(GridVertex, uv), TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC2, vertex_count);
+	primitive.indices                  = add_accessor(1, 0, TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT, TINYGLTF_TYPE_SCALAR, indices.size());
+
+	return model;
+}
+
+void gltf_extract_primitive(State &state)
+{
+	const auto model = create_grid_model(static_cast<uint32_t>(state.get_arg()));
+
+	const auto &primitive = model.meshes[0].primitives[0];
+
+	while (state.keep_running())
+	{
+		do_not_optimize(GltfLoader::extract_primitive_data(model, primitive, "grid"));
+	}
+
+	state.set_bytes_processed(state.get_iteration_count() * model.buffers[0].data.size());
+}
+
+void build_meshlets(State &state)
+{
+	const auto side  = static_cast<uint32_t>(state.get_arg());
+	const auto model = create_grid_model(side);
+
+	auto primitive_data = GltfLoader::extract_primitive_data(model, model.meshes[0].primitives[0], "grid");
+
+	// Meshlets are built from tightly packed positions, as scenes exported with separate attribute buffers have them
+	auto &position = primitive_data.attributes.at("position");
+	std::vector<uint8_t> packed_positions(primitive_data.vertex_count * 3 * sizeof(float));
+	for (uint32_t i = 0; i < primitive_data.vertex_count; ++i)
+	{
+		std::memcpy(packed_positions.data() + i * 3 * sizeof(float), position.data.data() + i * position.stride, 3 * sizeof(float));
+	}
+	position.data   = std::move(packed_positions);
+	position.stride = 3 * sizeof(float);
+
+	while (state.keep_running())
+	{
+		do_not_optimize(sg::MshaderMesh::build_meshlets(primitive_data));
+	}
+
+	state.set_items_processed(state.get_iteration_count() * primitive_data.index_count / 3);
+}
+
+void generate_mipmaps(State &state)
+{
+	const auto size = static_cast<uint32_t>(state.get_arg());
+
+	std::vector<uint8_t> base_level(size * size * 4);
+	for (size_t i = 0; i < base_level.size(); ++i)
+	{
+		base_level[i] = static_cast<uint8_t>((i * 2654435761u) >> 24);
+	}
+
+	while (state.keep_running())
+	{
+		state.pause_timing();
+		sg::Mipmap mipmap{};
+		mipmap.extent = vk::Extent3D{size, size, 1};
+		sg::Image image{"microbench", std::vector<uint8_t>{base_level}, {mipmap}};
+		state.resume_timing();
+
+		image.generate_mipmaps();
+		do_not_optimize(image.get_mipmaps());
+	}
+
+	state.set_bytes_processed(state.get_iteration_count() * base_level.size());
+}
+
+/// Include expansion of the clustered lighting shader, which reads its includes from the shader directory
+void precompile_shader(State &state)
+{
+	std::string source;
+	try
+	{
+		source = fs::read_shader("deferred/clustered_lighting.frag");
+	}
+	catch (const std::exception &e)
+	{
+		state.skip(e.what());
+		return;
+	}
+
+	while (state.keep_running())
+	{
+		do_not_optimize(backend::precompile_shader(source));
+	}
+
+	state.set_items_processed(state.get_iteration_count());
+}
+}        // namespace
+
+XIHE_MICROBENCH(gltf_extract_primitive, 64, 256, 1024);
+XIHE_MICROBENCH(build_meshlets, 64, 256);
+XIHE_MICROBENCH(generate_mipmaps, 512, 2048);
+XIHE_MICROBENCH(precompile_shader);
+}        // namespace xihe::microbench
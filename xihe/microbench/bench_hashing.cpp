@@ -0,0 +1,174 @@
+#include "microbench/microbench.h"
+
+#include <mutex>
+#include <unordered_map>
+
+#include "backend/resources_management/resource_caching.h"
+
+namespace xihe::microbench
+{
+namespace
+{
+/// Handles are only hashed and compared here, never passed to Vulkan
+template <typename T>
+T fake_handle(uint64_t value)
+{
+	return T{(typename T::CType)(value)};
+}
+
+/// A G-buffer pass: three color targets and depth, interleaved and instanced vertex input, two specialization constants
+PipelineState create_gbuffer_pipeline_state()
+{
+	PipelineState pipeline_state;
+
+	AttachmentsState attachments_state;
+	attachments_state.color_attachment_formats = {vk::Format::eR8G8B8A8Srgb, vk::Format::eA2B10G10R10UnormPack32, vk::Format::eR16G16B16A16Sfloat};
+	attachments_state.depth_attachment_format  = vk::Format::eD32Sfloat;
+	pipeline_state.set_attachments_state(attachments_state);
+
+	VertexInputState vertex_input_state;
+	vertex_input_state.bindings   = {{0, 32, vk::VertexInputRate::eVertex}, {1, 64, vk::VertexInputRate::eInstance}};
+	vertex_input_state.attributes = {{0, 0, vk::Format::eR32G32B32Sfloat, 0},
+	                                 {1, 0, vk::Format::eR32G32B32Sfloat, 12},
+	                                 {2, 0, vk::Format::eR32G32Sfloat, 24},
+	                                 {3, 1, vk::Format::eR32G32B32A32Sfloat, 0}};
+	pipeline_state.set_vertex_input_state(vertex_input_state);
+
+	DepthStencilState depth_stencil_state;
+	depth_stencil_state.depth_test_enable  = true;
+	depth_stencil_state.depth_write_enable = true;
+	pipeline_state.set_depth_stencil_state(depth_stencil_state);
+
+	ColorBlendState color_blend_state;
+	color_blend_state.attachments.resize(attachments_state.color_attachment_formats.size());
+	pipeline_state.set_color_blend_state(color_blend_state);
+
+	pipeline_state.set_specialization_constant(0, to_bytes(1u));
+	pipeline_state.set_specialization_constant(1, to_bytes(64u));
+
+	return pipeline_state;
+}
+
+vk::SamplerCreateInfo create_sampler_info(uint32_t index)
+{
+	vk::SamplerCreateInfo info;
+	info.magFilter        = index % 2 == 0 ? vk::Filter::eLinear : vk::Filter::eNearest;
+	info.minFilter        = info.magFilter;
+	info.mipmapMode       = vk::SamplerMipmapMode::eLinear;
+	info.addressModeU     = index % 3 == 0 ? vk::SamplerAddressMode::eRepeat : vk::SamplerAddressMode::eClampToEdge;
+	info.addressModeV     = info.addressModeU;
+	info.addressModeW     = info.addressModeU;
+	info.anisotropyEnable = index % 4 == 0;
+	info.maxAnisotropy    = 16.0f;
+	info.maxLod           = static_cast<float>(index);
+	return info;
+}
+
+void pipeline_state_hash(State &state)
+{
+	const auto pipeline_state = create_gbuffer_pipeline_state();
+
+	// Stand-ins for the layout handle and the ids of its vertex and fragment shader modules
+	const auto   pipeline_layout = fake_handle<vk::PipelineLayout>(0x1000);
+	const size_t shader_ids[]    = {0x2000, 0x3000};
+
+	while (state.keep_running())
+	{
+		std::size_t result = 0;
+		hash_combine(result, pipeline_layout);
+		for (size_t shader_id : shader_ids)
+		{
+			hash_combine(result, shader_id);
+		}
+		hash_fixed_function_state(result, pipeline_state);
+
+		do_not_optimize(result);
+	}
+
+	state.set_items_processed(state.get_iteration_count());
+}
+
+/// The hit path of ResourceCache::request_sampler: lock, then the same find_resource lookup request_resource does
+void resource_cache_sampler_hit(State &state)
+{
+	const auto sampler_count = static_cast<uint32_t>(state.get_arg());
+
+	std::vector<vk::SamplerCreateInfo>   infos;
+	std::unordered_map<size_t, uint32_t> samplers;
+	for (uint32_t i = 0; i < sampler_count; ++i)
+	{
+		infos.push_back(create_sampler_info(i));
+
+		size_t hash = 0;
+		backend::hash_param(hash, infos.back());
+		samplers.emplace(hash, i);
+	}
+
+	std::mutex mutex;
+	uint32_t   index = 0;
+
+	while (state.keep_running())
+	{
+		std::lock_guard<std::mutex> lock{mutex};
+
+		auto *sampler = backend::find_resource(samplers, infos[index]);
+		if (!sampler)
+		{
+			state.fail("sampler lookup missed");
+			return;
+		}
+		do_not_optimize(sampler);
+
+		index = index + 1 == sampler_count ? 0 : index + 1;
+	}
+
+	state.set_items_processed(state.get_iteration_count());
+}
+
+/// The key RenderFrame::request_descriptor_set hashes for every bind, through the cache's own hash_descriptor_set
+void descriptor_set_key(State &state)
+{
+	const auto binding_count = static_cast<uint32_t>(state.get_arg());
+
+	BindingMap<vk::DescriptorBufferInfo> buffer_infos;
+	BindingMap<vk::DescriptorImageInfo>  image_infos;
+	for (uint32_t binding = 0; binding < binding_count; ++binding)
+	{
+		if (binding % 2 == 0)
+		{
+			buffer_infos[binding][0] = vk::DescriptorBufferInfo{fake_handle<vk::Buffer>(0x10000 + binding), 256ull * binding, 256};
+		}
+		else
+		{
+			image_infos[binding][0] = vk::DescriptorImageInfo{fake_handle<vk::Sampler>(0x20000), fake_handle<vk::ImageView>(0x30000 + binding),
+			                                                  vk::ImageLayout::eShaderReadOnlyOptimal};
+		}
+	}
+
+	const auto descriptor_set_layout = fake_handle<vk::DescriptorSetLayout>(0x40000);
+
+	// A frame's worth of cached descriptor sets to look the key up in, the one being bound among them
+	std::unordered_map<size_t, uint32_t> descriptor_sets;
+	for (uint32_t i = 0; i < 511; ++i)
+	{
+		descriptor_sets.emplace(i * 0x9e3779b97f4a7c15ull, i);
+	}
+	size_t bound_hash = 0;
+	backend::hash_descriptor_set(bound_hash, descriptor_set_layout, buffer_infos, image_infos);
+	descriptor_sets.emplace(bound_hash, 511);
+
+	while (state.keep_running())
+	{
+		size_t hash = 0;
+		backend::hash_descriptor_set(hash, descriptor_set_layout, buffer_infos, image_infos);
+		do_not_optimize(descriptor_sets.find(hash));
+	}
+
+	state.set_items_processed(state.get_iteration_count());
+}
+}        // namespace
+
+XIHE_MICROBENCH(pipeline_state_hash);
+XIHE_MICROBENCH(resource_cache_sampler_hit, 16, 256);
+XIHE_MICROBENCH(descriptor_set_key, 4, 16, 32);
+}        // namespace xihe::microbench
@@ -0,0 +1,365 @@
+#include "microbench/microbench.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <unordered_set>
+
+#include <fmt/format.h>
+
+#include "backend/sparse_page_pool.h"
+#include "rendering/passes/clustered_lighting_pass.h"
+#include "rendering/passes/render_pass.h"
+#include "rendering/render_graph/barrier_planner.h"
+#include "scene_graph/components/camera.h"
+#include "scene_graph/components/light.h"
+#include "scene_graph/node.h"
+#include "scene_graph/scene.h"
+#include "virtual_texture.h"
+
+namespace xihe::microbench
+{
+namespace
+{
+/// Bins point lights spread over the volume of Sponza for a 1080p frame looking down the nave
+void clustered_lighting(State &state)
+{
+	const auto light_count = static_cast<uint32_t>(state.get_arg());
+
+	sg::Scene scene{"microbench"};
+
+	std::mt19937                          random{42};
+	std::uniform_real_distribution<float> x{-1600.0f, 1200.0f};
+	std::uniform_real_distribution<float> y{8.0f, 600.0f};
+	std::uniform_real_distribution<float> z{-300.0f, 300.0f};
+
+	for (uint32_t i = 0; i < light_count; ++i)
+	{
+		sg::LightProperties props;
+		props.range = 700.0f;
+		sg::add_point_light(scene, {x(random), y(random), z(random)}, props);
+	}
+
+	sg::Node camera_node{0, "camera"};
+	camera_node.get_transform().set_translation({-1200.0f, 150.0f, -40.0f});
+	camera_node.get_transform().set_rotation(glm::angleAxis(glm::radians(-90.0f), glm::vec3{0.0f, 1.0f, 0.0f}));
+
+	sg::PerspectiveCamera camera{"camera"};
+	camera.set_aspect_ratio(1920.0f / 1080.0f);
+	camera.set_near_plane(1.0f);
+	camera.set_far_plane(4000.0f);
+	camera.set_node(camera_node);
+	camera_node.set_component(camera);
+
+	rendering::ClusteredLightingPass pass{scene.get_components<sg::Light>(), camera};
+
+	while (state.keep_running())
+	{
+		pass.generate_lighting_data(1920, 1080);
+	}
+
+	state.set_items_processed(state.get_iteration_count() * light_count);
+}
+
+/**
+ * \brief Plans the barriers of a frame in which a compute pass writes an image and a buffer, a fragment pass reads them,
+ *        a compute pass reads them and a second fragment pass reads them again. The compute read still needs the write
+ *        made visible to its stage, only the barriers of the last pass are dropped. The run fails if the counts differ.
+ */
+void barrier_planning(State &state)
+{
+	struct Access
+	{
+		vk::PipelineStageFlags2 stage_mask;
+		vk::AccessFlags2        access_mask;
+		vk::ImageLayout         layout;
+	};
+
+	const std::array<Access, 4> passes{{
+	    {vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderWrite, vk::ImageLayout::eGeneral},
+	    {vk::PipelineStageFlagBits2::eFragmentShader, vk::AccessFlagBits2::eShaderRead, vk::ImageLayout::eShaderReadOnlyOptimal},
+	    {vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderRead, vk::ImageLayout::eShaderReadOnlyOptimal},
+	    {vk::PipelineStageFlagBits2::eFragmentShader, vk::AccessFlagBits2::eShaderRead, vk::ImageLayout::eShaderReadOnlyOptimal},
+	}};
+	constexpr std::array<size_t, 4> kExpectedBarrierCounts{2, 2, 2, 0};
+
+	// Planning never dereferences the handles
+	const vk::Image                 image{reinterpret_cast<VkImage>(uintptr_t{1})};
+	const vk::Buffer                buffer{reinterpret_cast<VkBuffer>(uintptr_t{2})};
+	const vk::ImageSubresourceRange subresource_range{vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1};
+
+	rendering::BarrierPlanner planner;
+	std::array<size_t, 4>     barrier_counts{};
+
+	while (state.keep_running())
+	{
+		planner.reset_tracking();
+
+		Access previous{vk::PipelineStageFlagBits2::eNone, vk::AccessFlagBits2::eNone, vk::ImageLayout::eUndefined};
+		for (size_t i = 0; i < passes.size(); ++i)
+		{
+			common::ImageMemoryBarrier image_barrier;
+			image_barrier.src_stage_mask  = previous.stage_mask;
+			image_barrier.src_access_mask = previous.access_mask;
+			image_barrier.dst_stage_mask  = passes[i].stage_mask;
+			image_barrier.dst_access_mask = passes[i].access_mask;
+			image_barrier.old_layout      = previous.layout;
+			image_barrier.new_layout      = passes[i].layout;
+			planner.add_image_barrier(image, subresource_range, image_barrier);
+
+			common::BufferMemoryBarrier buffer_barrier;
+			buffer_barrier.src_stage_mask  = previous.stage_mask;
+			buffer_barrier.src_access_mask = previous.access_mask;
+			buffer_barrier.dst_stage_mask  = passes[i].stage_mask;
+			buffer_barrier.dst_access_mask = passes[i].access_mask;
+			planner.add_buffer_barrier(buffer, 0, 256, buffer_barrier);
+
+			barrier_counts[i] = planner.get_image_barriers().size() + planner.get_buffer_barriers().size();
+			planner.clear();
+
+			previous = passes[i];
+		}
+	}
+
+	if (barrier_counts != kExpectedBarrierCounts)
+	{
+		state.fail(fmt::format("planned {} {} {} {} barriers per pass, expected {} {} {} {}",
+		                       barrier_counts[0], barrier_counts[1], barrier_counts[2], barrier_counts[3],
+		                       kExpectedBarrierCounts[0], kExpectedBarrierCounts[1], kExpectedBarrierCounts[2], kExpectedBarrierCounts[3]));
+	}
+
+	state.set_items_processed(state.get_iteration_count() * passes.size() * 2);
+}
+
+/**
+ * \brief Drives the page residency of an 8K virtual texture with 128x128 pages from simulated feedback, as TestApp does
+ *        without sparse residency, while the camera flies towards a tilted quad and back. Every frame must stay within
+ *        the budget and upload limit and must not evict a page it requested, a still view must converge.
+ */
+void virtual_texture_residency(State &state)
+{
+	constexpr size_t   kResidentBudget  = 256;
+	constexpr size_t   kUploadsPerFrame = 16;
+	constexpr uint32_t kFeedbackBlocks  = 64;
+	constexpr float    kQuadSize        = 10.0f;
+	const vk::Extent3D page_extent{128, 128, 1};
+	const vk::Extent2D screen_extent{1920, 1080};
+
+	VirtualTexture virtual_texture;
+	virtual_texture.width  = 8192;
+	virtual_texture.height = 8192;
+
+	uint8_t mip_tail_first_lod = 0;
+	while ((virtual_texture.width >> mip_tail_first_lod) >= page_extent.width && (virtual_texture.height >> mip_tail_first_lod) >= page_extent.height)
+	{
+		++mip_tail_first_lod;
+	}
+	virtual_texture.create_page_layout(page_extent, mip_tail_first_lod, kResidentBudget, kUploadsPerFrame);
+	auto &residency = *virtual_texture.residency;
+
+	const glm::mat4 quad_transform = glm::rotate(glm::mat4(1.0f), glm::radians(-60.0f), glm::vec3(1.0f, 0.0f, 0.0f)) *
+	                                 glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(-kQuadSize * 0.5f, -kQuadSize * 0.5f, 0.0f)), glm::vec3(kQuadSize, kQuadSize, 1.0f));
+	const glm::mat4 projection     = rendering::vulkan_style_projection(glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 100.0f));
+
+	auto request_pages = [&](float distance) {
+		const glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, distance), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+		CalculateMipLevelData mip_data(projection * view * quad_transform, vk::Extent2D{static_cast<uint32_t>(virtual_texture.width), static_cast<uint32_t>(virtual_texture.height)},
+		                               screen_extent, kFeedbackBlocks, kFeedbackBlocks, virtual_texture.mip_levels);
+		mip_data.calculate_mesh_coordinates();
+		mip_data.calculate_mip_levels();
+
+		return simulate_feedback(mip_data, virtual_texture);
+	};
+
+	auto check_update = [&](const std::vector<PageIndex> &requests, const ResidencyUpdate &update) {
+		if (update.loads.size() > kUploadsPerFrame)
+		{
+			state.fail(fmt::format("{} pages loaded in one frame, the limit is {}", update.loads.size(), kUploadsPerFrame));
+			return false;
+		}
+		if (residency.get_resident_count() > kResidentBudget)
+		{
+			state.fail(fmt::format("{} pages resident, the budget is {}", residency.get_resident_count(), kResidentBudget));
+			return false;
+		}
+
+		const std::unordered_set<PageIndex> requested(requests.begin(), requests.end());
+		for (auto page : update.evictions)
+		{
+			if (requested.contains(page))
+			{
+				state.fail(fmt::format("page {} was evicted in a frame that requested it", page));
+				return false;
+			}
+		}
+		return true;
+	};
+
+	// A still view loads at the upload limit until everything it sees is resident or the budget is full
+	{
+		const auto requests = request_pages(6.0f);
+		if (requests.empty())
+		{
+			state.fail("the quad requested no pages");
+			return;
+		}
+
+		const size_t max_frames = virtual_texture.get_page_count() / kUploadsPerFrame + 1;
+		for (size_t frame = 0; frame < max_frames && (frame == 0 || residency.get_pending_count() > 0); ++frame)
+		{
+			if (!check_update(requests, residency.update(requests)))
+			{
+				return;
+			}
+		}
+		if (residency.get_pending_count() > 0 && residency.get_resident_count() < kResidentBudget)
+		{
+			state.fail(fmt::format("a still view left {} pages pending with {} of {} resident", residency.get_pending_count(), residency.get_resident_count(), kResidentBudget));
+			return;
+		}
+	}
+
+	// A page evicted, loaded again while still bound and evicted again stays bound for the frames in flight of the
+	// last eviction, the frames that sampled it after the reload may still run
+	{
+		constexpr uint32_t  kFramesInFlight = 2;
+		constexpr PageIndex kPage           = 0;
+		constexpr size_t    kLastEviction   = 3;
+
+		const std::vector<ResidencyUpdate> updates{{{kPage}, {}}, {{}, {kPage}}, {{kPage}, {}}, {{}, {kPage}}};
+		for (size_t update = 0; update <= kLastEviction + kFramesInFlight; ++update)
+		{
+			const auto bindings = virtual_texture.schedule_bindings(update < updates.size() ? updates[update] : ResidencyUpdate{}, kFramesInFlight);
+
+			const bool bound = std::ranges::find(bindings.binds, kPage) != bindings.binds.end();
+			if (bound != (update == 0))
+			{
+				state.fail(fmt::format("page {} was {} in update {}", kPage, bound ? "bound again" : "not bound", update));
+				return;
+			}
+
+			const bool unbound = std::ranges::find(bindings.unbinds, kPage) != bindings.unbinds.end();
+			if (unbound != (update == kLastEviction + kFramesInFlight))
+			{
+				state.fail(fmt::format("page {} was {} in update {}, evicted last in update {} with {} frames in flight",
+				                       kPage, unbound ? "unbound" : "still bound", update, kLastEviction, kFramesInFlight));
+				return;
+			}
+		}
+	}
+
+	uint64_t frame = 0;
+	while (state.keep_running())
+	{
+		const float distance = 1.5f + 9.0f * (1.0f + std::cos(static_cast<float>(frame++) * 0.05f));
+
+		const auto requests = request_pages(distance);
+		if (!check_update(requests, residency.update(requests)))
+		{
+			return;
+		}
+	}
+
+	state.set_items_processed(state.get_iteration_count());
+}
+
+/// A full page bitmap with a random half of its pages freed, the state a sparse page pool is left in by residency churn
+backend::PageBitmap create_fragmented_bitmap(uint32_t page_count, std::vector<uint32_t> &allocated)
+{
+	backend::PageBitmap bitmap{page_count};
+	for (uint32_t i = 0; i < page_count; ++i)
+	{
+		bitmap.allocate();
+	}
+
+	std::vector<uint32_t> pages(page_count);
+	std::iota(pages.begin(), pages.end(), 0U);
+	std::shuffle(pages.begin(), pages.end(), std::mt19937{42});
+	for (uint32_t i = 0; i < page_count / 2; ++i)
+	{
+		bitmap.free(pages[i]);
+	}
+
+	allocated.assign(pages.begin() + page_count / 2, pages.end());
+	return bitmap;
+}
+
+/// Frees a random allocated page and allocates one, the steady state of a resident budget that is full
+void page_bitmap_alloc_free(State &state)
+{
+	const auto page_count = static_cast<uint32_t>(state.get_arg());
+
+	std::vector<uint32_t> allocated;
+	auto                  bitmap = create_fragmented_bitmap(page_count, allocated);
+
+	std::mt19937                          random{7};
+	std::uniform_int_distribution<size_t> distribution{0, allocated.size() - 1};
+	std::array<size_t, 4096>              victims{};
+	std::generate(victims.begin(), victims.end(), [&]() { return distribution(random); });
+
+	size_t next = 0;
+	while (state.keep_running())
+	{
+		auto &page = allocated[victims[next]];
+		next       = (next + 1) % victims.size();
+
+		bitmap.free(page);
+		page = bitmap.allocate();
+		do_not_optimize(page);
+	}
+
+	state.set_items_processed(state.get_iteration_count() * 2);
+}
+
+/**
+ * \brief Refills a fragmented page bitmap. The pool releases its back blocks only if pages are handed out lowest first,
+ *        so the run fails unless the pages come back as the free pages in increasing order.
+ */
+void page_bitmap_fragmentation(State &state)
+{
+	const auto page_count = static_cast<uint32_t>(state.get_arg());
+
+	std::vector<uint32_t> allocated;
+	const auto            fragmented = create_fragmented_bitmap(page_count, allocated);
+
+	std::vector<uint32_t> expected;
+	for (uint32_t page = 0; page < page_count; ++page)
+	{
+		if (fragmented.is_free(page))
+		{
+			expected.push_back(page);
+		}
+	}
+
+	std::vector<uint32_t> pages(expected.size());
+	while (state.keep_running())
+	{
+		state.pause_timing();
+		auto bitmap = fragmented;
+		state.resume_timing();
+
+		for (auto &page : pages)
+		{
+			page = bitmap.allocate();
+		}
+		do_not_optimize(pages);
+	}
+
+	if (pages != expected)
+	{
+		state.fail("pages were not allocated lowest first");
+	}
+
+	state.set_items_processed(state.get_iteration_count() * expected.size());
+}
+}        // namespace
+
+XIHE_MICROBENCH(clustered_lighting, 32, 128, 256);
+XIHE_MICROBENCH(barrier_planning);
+XIHE_MICROBENCH(virtual_texture_residency);
+XIHE_MICROBENCH(page_bitmap_alloc_free, 4096, 262144);
+XIHE_MICROBENCH(page_bitmap_fragmentation, 4096, 262144);
+}        // namespace xihe::microbench
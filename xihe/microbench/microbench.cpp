@@ -0,0 +1,484 @@
+#include "microbench.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <thread>
+
+#include <fmt/format.h>
+
+namespace xihe::microbench
+{
+namespace
+{
+struct Benchmark
+{
+	std::string       name;
+	BenchmarkFunction function;
+	int64_t           arg{0};
+};
+
+struct Options
+{
+	std::string filter;
+	std::string output_path;
+	double      min_time{0.5};
+	uint32_t    repetitions{3};
+};
+
+struct Run
+{
+	std::string name;
+	uint64_t    iterations{0};
+
+	// Per iteration
+	double real_time_ns{0.0};
+	double cpu_time_ns{0.0};
+
+	double items_per_second{0.0};
+	double bytes_per_second{0.0};
+};
+
+constexpr uint64_t kMaxIterations = 1'000'000'000;
+
+std::vector<Benchmark> &get_benchmarks()
+{
+	static std::vector<Benchmark> benchmarks;
+	return benchmarks;
+}
+
+void print_usage()
+{
+	std::cout << "Usage: xihe_microbench [options]\n"
+	             "  --filter <text>        only runs benchmarks whose name contains the text\n"
+	             "  --out <file>           writes the results as Google Benchmark compatible JSON\n"
+	             "  --min_time <seconds>   minimum duration of each repetition, 0.5 by default\n"
+	             "  --repetitions <count>  runs of each benchmark, 3 by default\n"
+	             "  --list                 prints the benchmark names and exits\n";
+}
+
+std::string escape_json(const std::string &text)
+{
+	std::string escaped;
+	for (char c : text)
+	{
+		if (c == '\\' || c == '"')
+		{
+			escaped += '\\';
+		}
+		escaped += c;
+	}
+	return escaped;
+}
+
+Run make_run(const std::string &name, const State &state)
+{
+	Run run;
+	run.name       = name;
+	run.iterations = state.get_iteration_count();
+
+	const double iterations = static_cast<double>(run.iterations);
+	run.real_time_ns        = state.get_real_time_ns() / iterations;
+	run.cpu_time_ns         = state.get_cpu_time_ns() / iterations;
+
+	const double seconds = state.get_real_time_ns() / 1e9;
+	if (seconds > 0.0)
+	{
+		run.items_per_second = static_cast<double>(state.get_items_processed()) / seconds;
+		run.bytes_per_second = static_cast<double>(state.get_bytes_processed()) / seconds;
+	}
+
+	return run;
+}
+
+/// Mean, median and standard deviation of the repetitions, in the order Google Benchmark reports them
+std::vector<std::pair<std::string, Run>> aggregate(const std::vector<Run> &runs)
+{
+	const auto reduce = [&runs](auto &&reduce_values) {
+		Run result = runs.front();
+
+		const auto values = [&runs](double Run::*member) {
+			std::vector<double> values;
+			for (const auto &run : runs)
+			{
+				values.push_back(run.*member);
+			}
+			return values;
+		};
+
+		result.real_time_ns     = reduce_values(values(&Run::real_time_ns));
+		result.cpu_time_ns      = reduce_values(values(&Run::cpu_time_ns));
+		result.items_per_second = reduce_values(values(&Run::items_per_second));
+		result.bytes_per_second = reduce_values(values(&Run::bytes_per_second));
+		return result;
+	};
+
+	const auto mean = [](const std::vector<double> &values) {
+		return std::accumulate(values.begin(), values.end(), 0.0) / static_cast<double>(values.size());
+	};
+
+	const auto median = [](std::vector<double> values) {
+		std::ranges::sort(values);
+		const size_t middle = values.size() / 2;
+		return values.size() % 2 == 0 ? (values[middle - 1] + values[middle]) / 2.0 : values[middle];
+	};
+
+	const auto stddev = [&mean](const std::vector<double> &values) {
+		if (values.size() < 2)
+		{
+			return 0.0;
+		}
+		const double average  = mean(values);
+		double       variance = 0.0;
+		for (double value : values)
+		{
+			variance += (value - average) * (value - average);
+		}
+		return std::sqrt(variance / static_cast<double>(values.size() - 1));
+	};
+
+	return {{"mean", reduce(mean)}, {"median", reduce(median)}, {"stddev", reduce(stddev)}};
+}
+
+std::string format_run_json(const Run &run, const std::string &run_type, const std::string &aggregate_name,
+                            uint32_t repetitions, uint32_t repetition_index)
+{
+	std::string json = fmt::format("    {{\n      \"name\": \"{}\",\n      \"run_name\": \"{}\",\n      \"run_type\": \"{}\",\n",
+	                               aggregate_name.empty() ? run.name : run.name + "_" + aggregate_name, run.name, run_type);
+	json += fmt::format("      \"repetitions\": {},\n", repetitions);
+	if (aggregate_name.empty())
+	{
+		json += fmt::format("      \"repetition_index\": {},\n", repetition_index);
+	}
+	else
+	{
+		json += fmt::format("      \"aggregate_name\": \"{}\",\n", aggregate_name);
+	}
+	json += fmt::format("      \"threads\": 1,\n      \"iterations\": {},\n      \"real_time\": {},\n      \"cpu_time\": {},\n      \"time_unit\": \"ns\"",
+	                    run.iterations, run.real_time_ns, run.cpu_time_ns);
+	if (run.items_per_second > 0.0)
+	{
+		json += fmt::format(",\n      \"items_per_second\": {}", run.items_per_second);
+	}
+	if (run.bytes_per_second > 0.0)
+	{
+		json += fmt::format(",\n      \"bytes_per_second\": {}", run.bytes_per_second);
+	}
+	json += "\n    }";
+	return json;
+}
+
+bool write_json(const std::string &path, const std::string &executable, const std::vector<std::string> &entries)
+{
+	std::ofstream file{path, std::ios::out | std::ios::trunc};
+	if (!file.is_open())
+	{
+		std::cerr << "Failed to open " << path << " for writing the results\n";
+		return false;
+	}
+
+	const std::time_t now = std::time(nullptr);
+	char              date[32];
+	std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+#ifdef XH_DEBUG
+	constexpr const char *build_type = "debug";
+#else
+	constexpr const char *build_type = "release";
+#endif
+
+	file << "{\n  \"context\": {\n";
+	file << fmt::format("    \"date\": \"{}\",\n", date);
+	file << fmt::format("    \"executable\": \"{}\",\n", escape_json(executable));
+	file << fmt::format("    \"num_cpus\": {},\n", std::thread::hardware_concurrency());
+	file << fmt::format("    \"library_build_type\": \"{}\"\n", build_type);
+	file << "  },\n  \"benchmarks\": [\n";
+
+	for (size_t i = 0; i < entries.size(); ++i)
+	{
+		file << entries[i] << (i + 1 < entries.size() ? ",\n" : "\n");
+	}
+
+	file << "  ]\n}\n";
+	return true;
+}
+}        // namespace
+
+State::State(uint64_t iteration_count, int64_t arg) :
+    iteration_count_{iteration_count}, remaining_{iteration_count}, arg_{arg}
+{}
+
+bool State::keep_running()
+{
+	if (!started_)
+	{
+		started_ = true;
+		start_timer();
+	}
+
+	if (remaining_ > 0 && !skipped_)
+	{
+		--remaining_;
+		return true;
+	}
+
+	if (timing_)
+	{
+		stop_timer();
+	}
+	return false;
+}
+
+void State::pause_timing()
+{
+	stop_timer();
+}
+
+void State::resume_timing()
+{
+	start_timer();
+}
+
+int64_t State::get_arg() const
+{
+	return arg_;
+}
+
+uint64_t State::get_iteration_count() const
+{
+	return iteration_count_;
+}
+
+void State::set_items_processed(uint64_t items)
+{
+	items_processed_ = items;
+}
+
+void State::set_bytes_processed(uint64_t bytes)
+{
+	bytes_processed_ = bytes;
+}
+
+void State::skip(std::string reason)
+{
+	skipped_     = true;
+	skip_reason_ = std::move(reason);
+}
+
+void State::fail(std::string reason)
+{
+	failed_ = true;
+	skip(std::move(reason));
+}
+
+double State::get_real_time_ns() const
+{
+	return real_time_ns_;
+}
+
+double State::get_cpu_time_ns() const
+{
+	return cpu_time_ns_;
+}
+
+uint64_t State::get_items_processed() const
+{
+	return items_processed_;
+}
+
+uint64_t State::get_bytes_processed() const
+{
+	return bytes_processed_;
+}
+
+bool State::is_skipped() const
+{
+	return skipped_;
+}
+
+bool State::is_failed() const
+{
+	return failed_;
+}
+
+const std::string &State::get_skip_reason() const
+{
+	return skip_reason_;
+}
+
+void State::start_timer()
+{
+	timing_     = true;
+	real_start_ = Clock::now();
+	cpu_start_  = std::clock();
+}
+
+void State::stop_timer()
+{
+	timing_ = false;
+	real_time_ns_ += std::chrono::duration<double, std::nano>(Clock::now() - real_start_).count();
+	cpu_time_ns_ += static_cast<double>(std::clock() - cpu_start_) * 1e9 / CLOCKS_PER_SEC;
+}
+
+bool register_benchmark(const std::string &name, BenchmarkFunction function, std::vector<int64_t> args)
+{
+	auto &benchmarks = get_benchmarks();
+
+	if (args.empty())
+	{
+		benchmarks.push_back({name, std::move(function), 0});
+		return true;
+	}
+
+	for (int64_t arg : args)
+	{
+		benchmarks.push_back({fmt::format("{}/{}", name, arg), function, arg});
+	}
+	return true;
+}
+
+int run(int argc, char *argv[])
+{
+	Options options;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+
+		if (arg == "--help")
+		{
+			print_usage();
+			return 0;
+		}
+		if (arg == "--list")
+		{
+			for (const auto &benchmark : get_benchmarks())
+			{
+				std::cout << benchmark.name << '\n';
+			}
+			return 0;
+		}
+
+		if (i + 1 >= argc)
+		{
+			print_usage();
+			return 1;
+		}
+		const std::string value = argv[++i];
+
+		if (arg == "--filter")
+		{
+			options.filter = value;
+		}
+		else if (arg == "--out")
+		{
+			options.output_path = value;
+		}
+		else if (arg == "--min_time")
+		{
+			options.min_time = std::stod(value);
+		}
+		else if (arg == "--repetitions")
+		{
+			options.repetitions = std::max(1u, static_cast<uint32_t>(std::stoul(value)));
+		}
+		else
+		{
+			print_usage();
+			return 1;
+		}
+	}
+
+	std::vector<std::string> json_entries;
+	uint32_t                 skipped_count = 0;
+	uint32_t                 failed_count  = 0;
+
+	std::cout << fmt::format("{:<48} {:>12} {:>14} {:>14} {:>14}\n", "Benchmark", "Iterations", "Time (ns)", "CPU (ns)", "Items/s");
+
+	for (const auto &benchmark : get_benchmarks())
+	{
+		if (!options.filter.empty() && benchmark.name.find(options.filter) == std::string::npos)
+		{
+			continue;
+		}
+
+		// Grows the iteration count until one run lasts min_time, the same way Google Benchmark does
+		uint64_t    iterations = 1;
+		std::string skip_reason;
+		bool        failed = false;
+		while (true)
+		{
+			State state{iterations, benchmark.arg};
+			benchmark.function(state);
+
+			if (state.is_skipped())
+			{
+				skip_reason = state.get_skip_reason();
+				failed      = state.is_failed();
+				break;
+			}
+
+			const double min_time_ns = options.min_time * 1e9;
+			if (state.get_real_time_ns() >= min_time_ns || iterations >= kMaxIterations)
+			{
+				break;
+			}
+
+			const double multiplier = std::clamp(min_time_ns * 1.4 / std::max(state.get_real_time_ns(), 1.0), 2.0, 100.0);
+			iterations              = std::min(kMaxIterations, static_cast<uint64_t>(static_cast<double>(iterations) * multiplier));
+		}
+
+		if (!skip_reason.empty())
+		{
+			std::cout << fmt::format("{:<48} {}: {}\n", benchmark.name, failed ? "failed" : "skipped", skip_reason);
+			json_entries.push_back(fmt::format("    {{\n      \"name\": \"{0}\",\n      \"run_name\": \"{0}\",\n      \"run_type\": \"iteration\",\n"
+			                                   "      \"error_occurred\": true,\n      \"error_message\": \"{1}\"\n    }}",
+			                                   benchmark.name, escape_json(skip_reason)));
+			++(failed ? failed_count : skipped_count);
+			continue;
+		}
+
+		std::vector<Run> runs;
+		for (uint32_t repetition = 0; repetition < options.repetitions; ++repetition)
+		{
+			State state{iterations, benchmark.arg};
+			benchmark.function(state);
+
+			runs.push_back(make_run(benchmark.name, state));
+			json_entries.push_back(format_run_json(runs.back(), "iteration", "", options.repetitions, repetition));
+
+			std::cout << fmt::format("{:<48} {:>12} {:>14.1f} {:>14.1f} {:>14.4g}\n",
+			                         benchmark.name, runs.back().iterations, runs.back().real_time_ns, runs.back().cpu_time_ns, runs.back().items_per_second);
+		}
+
+		if (runs.size() > 1)
+		{
+			for (const auto &[aggregate_name, run] : aggregate(runs))
+			{
+				json_entries.push_back(format_run_json(run, "aggregate", aggregate_name, options.repetitions, 0));
+
+				std::cout << fmt::format("{:<48} {:>12} {:>14.1f} {:>14.1f} {:>14.4g}\n",
+				                         benchmark.name + "_" + aggregate_name, run.iterations, run.real_time_ns, run.cpu_time_ns, run.items_per_second);
+			}
+		}
+	}
+
+	if (!options.output_path.empty() && !write_json(options.output_path, argv[0], json_entries))
+	{
+		return 1;
+	}
+
+	if (failed_count > 0)
+	{
+		return 1;
+	}
+	return skipped_count == 0 ? 0 : 2;
+}
+}        // namespace xihe::microbench
+
+int main(int argc, char *argv[])
+{
+	return xihe::microbench::run(argc, argv);
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace xihe::microbench
+{
+/**
+ * \brief Drives the timed loop of one benchmark run, the body is measured while keep_running() returns true:
+ *
+ *        while (state.keep_running())
+ *        {
+ *            do_not_optimize(work());
+ *        }
+ */
+class State
+{
+  public:
+	State(uint64_t iteration_count, int64_t arg);
+
+	/// Starts the timer on the first call and stops it once the iterations of this run are done
+	bool keep_running();
+
+	/// Excludes per iteration setup from the measurement, such as resetting the input
+	void pause_timing();
+	void resume_timing();
+
+	/// The argument the benchmark was registered with, 0 if none
+	int64_t get_arg() const;
+
+	uint64_t get_iteration_count() const;
+
+	/// Items and bytes processed over the whole run, reported as throughput
+	void set_items_processed(uint64_t items);
+	void set_bytes_processed(uint64_t bytes);
+
+	/// Marks the benchmark as unable to run, such as when its input files are missing
+	void skip(std::string reason);
+
+	/// Marks the benchmark as failed, such as when a check on the result of the measured work does not hold
+	void fail(std::string reason);
+
+	double get_real_time_ns() const;
+	double get_cpu_time_ns() const;
+
+	uint64_t get_items_processed() const;
+	uint64_t get_bytes_processed() const;
+
+	bool is_skipped() const;
+
+	bool is_failed() const;
+
+	const std::string &get_skip_reason() const;
+
+  private:
+	using Clock = std::chrono::steady_clock;
+
+	void start_timer();
+	void stop_timer();
+
+	uint64_t iteration_count_;
+	uint64_t remaining_;
+	int64_t  arg_;
+
+	bool started_{false};
+	bool timing_{false};
+
+	Clock::time_point real_start_;
+	std::clock_t      cpu_start_{0};
+
+	double real_time_ns_{0.0};
+	double cpu_time_ns_{0.0};
+
+	uint64_t items_processed_{0};
+	uint64_t bytes_processed_{0};
+
+	bool        skipped_{false};
+	bool        failed_{false};
+	std::string skip_reason_;
+};
+
+using BenchmarkFunction = std::function<void(State &)>;
+
+/// Registers a benchmark once per argument, or once without one if args is empty
+bool register_benchmark(const std::string &name, BenchmarkFunction function, std::vector<int64_t> args = {});
+
+/// Runs the registered benchmarks, see the usage printed by --help for the arguments
+int run(int argc, char *argv[]);
+
+/// Keeps the compiler from discarding a value that is never read
+template <typename T>
+inline void do_not_optimize(const T &value)
+{
+	static volatile const void *sink;
+	sink = &value;
+	std::atomic_signal_fence(std::memory_order_seq_cst);
+}
+}        // namespace xihe::microbench
+
+#define XIHE_MICROBENCH_CONCAT_IMPL(a, b) a##b
+#define XIHE_MICROBENCH_CONCAT(a, b) XIHE_MICROBENCH_CONCAT_IMPL(a, b)
+
+/// Registers function(State &) under its name, once per optional argument
+#define XIHE_MICROBENCH(function, ...) \
+	static const bool XIHE_MICROBENCH_CONCAT(microbench_registered_, __LINE__) = ::xihe::microbench::register_benchmark(#function, function, {__VA_ARGS__})
@@ -26,4 +26,7 @@ bool Application::resize(const uint32_t width, const uint32_t height)
 
 void Application::input_event(const InputEvent &input_event)
 {}
+
+void Application::wait_before_input()
+{}
 }        // namespace xihe
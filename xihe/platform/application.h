@@ -28,6 +28,9 @@ class Application
 
 	virtual void input_event(const InputEvent &input_event);
 
+	/// Called before the window processes input events, so the application can delay sampling input until it is needed
+	virtual void wait_before_input();
+
 	bool should_close() const
 	{
 		return requested_close_;
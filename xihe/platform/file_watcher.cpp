@@ -0,0 +1,181 @@
+#include "file_watcher.h"
+
+#ifdef __linux__
+#	include <poll.h>
+#	include <sys/inotify.h>
+#	include <unistd.h>
+#endif
+
+#include "common/logging.h"
+
+namespace xihe::fs
+{
+FileWatcher::FileWatcher(const Path &root, std::chrono::milliseconds poll_interval) :
+    root_{root}, poll_interval_{poll_interval}
+{
+#ifdef __linux__
+	inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotify_fd_ >= 0)
+	{
+		add_inotify_watches(root_);
+	}
+	else
+	{
+		LOGW("inotify is not available, polling {} for changes instead", root_.string());
+		poll_write_times(false);
+	}
+#else
+	poll_write_times(false);
+#endif
+
+	thread_ = std::thread(&FileWatcher::run, this);
+}
+
+FileWatcher::~FileWatcher()
+{
+	running_ = false;
+
+	if (thread_.joinable())
+	{
+		thread_.join();
+	}
+
+#ifdef __linux__
+	if (inotify_fd_ >= 0)
+	{
+		close(inotify_fd_);
+	}
+#endif
+}
+
+std::vector<std::string> FileWatcher::take_changes()
+{
+	std::lock_guard<std::mutex> guard(changes_mutex_);
+
+	std::vector<std::string> changes{changes_.begin(), changes_.end()};
+	changes_.clear();
+
+	return changes;
+}
+
+void FileWatcher::run()
+{
+	while (running_)
+	{
+#ifdef __linux__
+		if (inotify_fd_ >= 0)
+		{
+			// Wake up regularly so the destructor does not have to wait for a file event
+			pollfd poll_fd{inotify_fd_, POLLIN, 0};
+			if (poll(&poll_fd, 1, static_cast<int>(poll_interval_.count())) <= 0)
+			{
+				continue;
+			}
+
+			alignas(inotify_event) char buffer[4096];
+
+			ssize_t length;
+			while ((length = read(inotify_fd_, buffer, sizeof(buffer))) > 0)
+			{
+				for (char *ptr = buffer; ptr < buffer + length;)
+				{
+					const auto *event = reinterpret_cast<const inotify_event *>(ptr);
+					ptr += sizeof(inotify_event) + event->len;
+
+					auto it = watch_directories_.find(event->wd);
+					if (it == watch_directories_.end() || event->len == 0)
+					{
+						continue;
+					}
+
+					Path path = it->second / event->name;
+
+					if (event->mask & IN_ISDIR)
+					{
+						add_inotify_watches(path);
+					}
+					else
+					{
+						add_change(path);
+					}
+				}
+			}
+			continue;
+		}
+#endif
+		std::this_thread::sleep_for(poll_interval_);
+
+		poll_write_times(true);
+	}
+}
+
+void FileWatcher::poll_write_times(bool report_changes)
+{
+	std::error_code error;
+
+	for (const auto &entry : std::filesystem::recursive_directory_iterator(root_, error))
+	{
+		if (!entry.is_regular_file(error))
+		{
+			continue;
+		}
+
+		auto write_time = entry.last_write_time(error);
+		if (error)
+		{
+			continue;
+		}
+
+		auto [it, inserted] = write_times_.try_emplace(entry.path().generic_string(), write_time);
+		if (!inserted)
+		{
+			if (it->second == write_time)
+			{
+				continue;
+			}
+			it->second = write_time;
+		}
+
+		if (report_changes)
+		{
+			add_change(entry.path());
+		}
+	}
+}
+
+void FileWatcher::add_change(const Path &path)
+{
+	std::error_code error;
+	auto            relative_path = std::filesystem::relative(path, root_, error);
+	if (error)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> guard(changes_mutex_);
+	changes_.insert(relative_path.generic_string());
+}
+
+#ifdef __linux__
+void FileWatcher::add_inotify_watches(const Path &directory)
+{
+	// Editors often save through a temporary file that is renamed over the original, hence IN_MOVED_TO
+	int watch_descriptor = inotify_add_watch(inotify_fd_, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+	if (watch_descriptor < 0)
+	{
+		LOGW("Failed to watch directory {}", directory.string());
+		return;
+	}
+	watch_directories_[watch_descriptor] = directory;
+
+	std::error_code error;
+	for (const auto &entry : std::filesystem::directory_iterator(directory, error))
+	{
+		if (entry.is_directory(error))
+		{
+			add_inotify_watches(entry.path());
+		}
+	}
+}
+#endif
+}        // namespace xihe::fs
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "platform/filesystem.h"
+
+namespace xihe::fs
+{
+/**
+ * \brief Watches a directory tree on a background thread and collects the files that were modified.
+ *        Uses inotify on Linux and falls back to polling modification times on other platforms.
+ */
+class FileWatcher
+{
+  public:
+	explicit FileWatcher(const Path &root, std::chrono::milliseconds poll_interval = std::chrono::milliseconds{500});
+
+	~FileWatcher();
+
+	FileWatcher(const FileWatcher &)            = delete;
+	FileWatcher &operator=(const FileWatcher &) = delete;
+	FileWatcher(FileWatcher &&)                 = delete;
+	FileWatcher &operator=(FileWatcher &&)      = delete;
+
+	/**
+	 * \brief Returns the files modified since the last call, relative to the root and with '/' separators
+	 */
+	std::vector<std::string> take_changes();
+
+  private:
+	void run();
+
+	/**
+	 * \brief Compares the modification times of all files against the last poll
+	 * \param report_changes false on the first poll, which only records the initial state
+	 */
+	void poll_write_times(bool report_changes);
+
+	void add_change(const Path &path);
+
+#ifdef __linux__
+	void add_inotify_watches(const Path &directory);
+
+	int inotify_fd_{-1};
+
+	std::unordered_map<int, Path> watch_directories_;
+#endif
+
+	Path root_;
+
+	std::chrono::milliseconds poll_interval_;
+
+	std::unordered_map<std::string, std::filesystem::file_time_type> write_times_;
+
+	std::mutex            changes_mutex_;
+	std::set<std::string> changes_;
+
+	std::atomic<bool> running_{true};
+	std::thread       thread_;
+};
+}        // namespace xihe::fs
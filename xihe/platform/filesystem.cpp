@@ -3,8 +3,11 @@
 #include <cassert>
 #include <filesystem>
 #include <fstream>
+#include <random>
+#include <thread>
 #include <vector>
 
+#include "common/logging.h"
 #include "platform/platform.h"
 
 namespace xihe::fs
@@ -17,6 +20,7 @@ const std::unordered_map<Type, Path> kRelativePaths = {
     {Type::kStorage, "output/"},
     {Type::kScreenshots, "output/images"},
     {Type::kLogs, "output/logs"},
+    {Type::kCache, "output/cache"},
 };
 }
 
@@ -120,4 +124,40 @@ std::vector<uint8_t> read_binary_file(const Path &path)
 
 	return data;
 }
+
+bool write_file_atomic(const Path &path, const std::function<bool(const Path &)> &write)
+{
+	std::error_code error;
+	std::filesystem::create_directories(path.parent_path(), error);
+
+	// Unique per writer, so threads or runs writing the same file at once each rename a complete one into place
+	auto temp_path = path;
+	temp_path += fmt::format(".{:x}_{:08x}.tmp", std::hash<std::thread::id>{}(std::this_thread::get_id()), std::random_device{}());
+
+	if (!write(temp_path))
+	{
+		LOGW("Failed to write {}", path.string());
+		std::filesystem::remove(temp_path, error);
+		return false;
+	}
+
+	std::filesystem::rename(temp_path, path, error);
+	if (error)
+	{
+		LOGW("Failed to write {}: {}", path.string(), error.message());
+		std::filesystem::remove(temp_path, error);
+		return false;
+	}
+
+	return true;
+}
+
+bool write_file_atomic(const Path &path, const std::vector<uint8_t> &data)
+{
+	return write_file_atomic(path, [&data](const Path &temp_path) {
+		std::ofstream file{temp_path, std::ios::binary | std::ios::trunc};
+		file.write(reinterpret_cast<const char *>(data.data()), static_cast<std::streamsize>(data.size()));
+		return static_cast<bool>(file);
+	});
+}
 }        // namespace xihe::fs
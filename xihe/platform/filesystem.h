@@ -1,6 +1,7 @@
 #pragma once
 #include <string>
 #include <filesystem>
+#include <functional>
 #include <unordered_map>
 
 namespace xihe::fs
@@ -18,6 +19,7 @@ enum Type
 	kStorage,
 	kScreenshots,
 	kLogs,
+	kCache,
 	/* NewFolder */
 	kTotalRelativePathTypes,
 
@@ -37,6 +39,16 @@ std::string read_text_file(const Path &path);
 
 std::vector<uint8_t> read_binary_file(const Path &path);
 
+/**
+ * @brief Writes a file under a temporary name and renames it into place, so a process reading it at the same time
+ *        never sees a partial file. Failures are logged, for the caches that are written again on the next run.
+ * @param write Writes the content to the path it is given, returns false on failure
+ * @return Whether the file was written
+ */
+bool write_file_atomic(const Path &path, const std::function<bool(const Path &)> &write);
+
+bool write_file_atomic(const Path &path, const std::vector<uint8_t> &data);
+
 std::string read_shader(const Path &path);
 
 std::vector<uint8_t> read_asset(const Path &path);
@@ -0,0 +1,11 @@
+#include "headless_platform.h"
+
+#include "platform/headless_window.h"
+
+namespace xihe
+{
+void HeadlessPlatform::create_window(const Window::Properties &properties)
+{
+	window_ = std::make_unique<HeadlessWindow>(properties);
+}
+}
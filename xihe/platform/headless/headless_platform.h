@@ -0,0 +1,12 @@
+#pragma once
+
+#include "platform/platform.h"
+
+namespace xihe
+{
+	class HeadlessPlatform : public Platform
+	{
+	protected:
+		void create_window(const Window::Properties &properties) override;
+	};
+}
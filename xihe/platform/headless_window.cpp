@@ -0,0 +1,48 @@
+#include "headless_window.h"
+
+#include <volk.h>
+
+#include "common/logging.h"
+
+namespace xihe
+{
+HeadlessWindow::HeadlessWindow(const Window::Properties &properties) :
+    Window(properties)
+{}
+
+VkSurfaceKHR HeadlessWindow::create_surface(backend::Instance &instance)
+{
+	VkInstance vk_instance = instance.get_handle();
+	if (vk_instance == VK_NULL_HANDLE)
+	{
+		return VK_NULL_HANDLE;
+	}
+
+	VkHeadlessSurfaceCreateInfoEXT create_info{VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT};
+
+	VkSurfaceKHR surface;
+
+	VkResult result = vkCreateHeadlessSurfaceEXT(vk_instance, &create_info, nullptr, &surface);
+	if (result != VK_SUCCESS)
+	{
+		LOGE("Failed to create headless surface ({})", vk::to_string(static_cast<vk::Result>(result)));
+		return VK_NULL_HANDLE;
+	}
+	return surface;
+}
+
+std::vector<const char *> HeadlessWindow::get_required_surface_extensions() const
+{
+	return {VK_KHR_SURFACE_EXTENSION_NAME, VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME};
+}
+
+bool HeadlessWindow::should_close()
+{
+	return closed_;
+}
+
+void HeadlessWindow::close()
+{
+	closed_ = true;
+}
+}        // namespace xihe
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "platform/window.h"
+
+namespace xihe
+{
+/**
+ * \brief Window without anything on screen, presents to a VK_EXT_headless_surface.
+ *        Swapchains and frame pacing behave as with a real window, which keeps headless runs comparable.
+ */
+class HeadlessWindow : public Window
+{
+  public:
+	HeadlessWindow(const Window::Properties &properties);
+
+	virtual ~HeadlessWindow() = default;
+
+	VkSurfaceKHR create_surface(backend::Instance &instance) override;
+
+	std::vector<const char *> get_required_surface_extensions() const override;
+
+	bool should_close() override;
+
+	void close() override;
+
+  private:
+	bool closed_{false};
+};
+}        // namespace xihe
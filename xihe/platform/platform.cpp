@@ -83,6 +83,11 @@ ExitCode Platform::main_loop()
 				application_->finish();
 			}
 
+			if (application_)
+			{
+				application_->wait_before_input();
+			}
+
 			window_->process_events();
 #ifndef XH_DEBUG
 		}
@@ -22,6 +22,9 @@ class PreprocessApp : public XiheApp
   private:
 	void draw_gui() override;
 
+	/// Renders the IBL outputs with fragment passes and writes them to the cache, for devices that cannot bake them
+	void render_ibl();
+
 	std::unique_ptr<AssetLoader> asset_loader_;
 
 	std::unique_ptr<sg::Mesh> sky_box_;
@@ -30,11 +33,10 @@ class PreprocessApp : public XiheApp
 	{
 		sg::Texture       *environment_cube;
 		rendering::Texture empty;
-		rendering::Texture lut_brdf;
-		rendering::Texture irradiance_cube;
-		rendering::Texture prefiltered_cube;
 	} textures_;
 
+	std::unique_ptr<rendering::IblBaker> ibl_baker_;
+
 	std::unique_ptr<sg::SubMesh> skybox_mesh_;
 };
 }        // namespace xihe
@@ -0,0 +1,94 @@
+#include "dynamic_resolution.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace xihe::rendering
+{
+namespace
+{
+// Stay slightly under the target so small variations do not push the frame over it
+constexpr double kHeadroom = 0.95;
+
+// Fractions of the distance to the desired scale covered per frame
+constexpr float kDecreaseRate = 0.5f;
+constexpr float kIncreaseRate = 0.1f;
+
+// Changes smaller than this are ignored, so the scale settles instead of drifting by tiny amounts
+constexpr float kMinScaleStep = 1.0f / 128.0f;
+}        // namespace
+
+void DynamicResolution::set_enabled(bool enabled)
+{
+	if (enabled_ == enabled)
+	{
+		return;
+	}
+
+	enabled_ = enabled;
+	if (!enabled_)
+	{
+		scale_       = max_scale_;
+		filtered_ms_ = 0.0;
+	}
+}
+
+bool DynamicResolution::is_enabled() const
+{
+	return enabled_;
+}
+
+void DynamicResolution::set_target_gpu_time(float target_ms)
+{
+	target_ms_ = target_ms;
+}
+
+float DynamicResolution::get_target_gpu_time() const
+{
+	return target_ms_;
+}
+
+void DynamicResolution::set_scale_range(float min_scale, float max_scale)
+{
+	assert(min_scale > 0.0f && min_scale <= max_scale && max_scale <= 1.0f);
+
+	min_scale_ = min_scale;
+	max_scale_ = max_scale;
+	scale_     = std::clamp(scale_, min_scale_, max_scale_);
+}
+
+float DynamicResolution::update(double gpu_ms)
+{
+	if (!enabled_ || gpu_ms <= 0.0)
+	{
+		return scale_;
+	}
+
+	// Spikes are followed at once, drops are smoothed over a few frames
+	filtered_ms_ = filtered_ms_ == 0.0 || gpu_ms > filtered_ms_ ? gpu_ms : filtered_ms_ * 0.8 + gpu_ms * 0.2;
+
+	const float desired_scale = std::clamp(scale_ * static_cast<float>(std::sqrt(target_ms_ * kHeadroom / filtered_ms_)), min_scale_, max_scale_);
+
+	const float rate      = desired_scale < scale_ ? kDecreaseRate : kIncreaseRate;
+	const float new_scale = std::clamp(scale_ + (desired_scale - scale_) * rate, min_scale_, max_scale_);
+
+	if (std::abs(new_scale - scale_) >= kMinScaleStep || new_scale == min_scale_ || new_scale == max_scale_)
+	{
+		scale_ = new_scale;
+	}
+
+	return scale_;
+}
+
+float DynamicResolution::get_scale() const
+{
+	return scale_;
+}
+
+vk::Extent2D scale_extent(const vk::Extent2D &extent, float scale)
+{
+	return {std::max(1u, static_cast<uint32_t>(std::ceil(static_cast<float>(extent.width) * scale))),
+	        std::max(1u, static_cast<uint32_t>(std::ceil(static_cast<float>(extent.height) * scale)))};
+}
+}        // namespace xihe::rendering
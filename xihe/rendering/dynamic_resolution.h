@@ -0,0 +1,53 @@
+#pragma once
+
+#include "common/vk_common.h"
+
+namespace xihe::rendering
+{
+/**
+ * \brief Chooses the scale graph targets marked with ExtentDescriptor::DynamicRelative are rendered at, so the
+ *        GPU time of a frame stays under a target. The targets are allocated at the largest scale and rendered
+ *        into a sub-rect of them, so changing the scale never allocates.
+ *
+ *        The GPU time is assumed to be proportional to the number of pixels, the scale is moved towards the
+ *        one that would meet the target, quickly when over it and slowly when under it to avoid oscillating.
+ */
+class DynamicResolution
+{
+  public:
+	/// Disabled, the scale stays at the largest one
+	void set_enabled(bool enabled);
+
+	bool is_enabled() const;
+
+	void set_target_gpu_time(float target_ms);
+
+	float get_target_gpu_time() const;
+
+	/// Scales of the width and height, the largest is at most 1 since the targets are allocated at that size
+	void set_scale_range(float min_scale, float max_scale);
+
+	/**
+	 * \brief Feeds the GPU time of a completed frame
+	 * \return Scale for the next frame
+	 */
+	float update(double gpu_ms);
+
+	float get_scale() const;
+
+  private:
+	bool enabled_{false};
+
+	float target_ms_{16.0f};
+
+	float min_scale_{0.5f};
+	float max_scale_{1.0f};
+
+	float scale_{1.0f};
+
+	double filtered_ms_{0.0};
+};
+
+/// Extent of the sub-rect rendered at the scale, at least one pixel
+vk::Extent2D scale_extent(const vk::Extent2D &extent, float scale);
+}        // namespace xihe::rendering
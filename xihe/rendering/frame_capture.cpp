@@ -0,0 +1,1185 @@
+#include "frame_capture.h"
+
+#include <algorithm>
+#include <cassert>
+#include <fstream>
+
+#include <vulkan/vulkan_format_traits.hpp>
+
+#include "backend/buffer.h"
+#include "backend/command_buffer.h"
+#include "backend/command_pool.h"
+#include "backend/device.h"
+#include "backend/fence_pool.h"
+#include "backend/image_view.h"
+#include "backend/pipeline_layout.h"
+#include "backend/sampler.h"
+#include "common/logging.h"
+#include "rendering/render_context.h"
+#include "rendering/render_frame.h"
+#include "rendering/render_target.h"
+
+namespace xihe::rendering
+{
+namespace
+{
+template <typename T>
+uint64_t to_key(T handle)
+{
+	return (uint64_t) (static_cast<typename T::CType>(handle));
+}
+
+void write_strings(std::ostringstream &os, const std::vector<std::string> &values)
+{
+	write(os, values.size());
+	for (const auto &value : values)
+	{
+		write(os, value);
+	}
+}
+
+void read_strings(std::istringstream &is, std::vector<std::string> &values)
+{
+	std::size_t size;
+	read(is, size);
+	values.resize(size);
+	for (auto &value : values)
+	{
+		read(is, value);
+	}
+}
+
+/// One region per mip level with all layers, tightly packed in the order of the levels
+std::vector<vk::BufferImageCopy> get_copy_regions(const backend::Image &image, vk::DeviceSize &size)
+{
+	const auto  block_extent = vk::blockExtent(image.get_format());
+	const auto  block_size   = vk::blockSize(image.get_format());
+	const auto &extent       = image.get_extent();
+	const auto  layer_count  = image.get_array_layer_count();
+
+	std::vector<vk::BufferImageCopy> regions;
+	size = 0;
+	for (uint32_t level = 0; level < image.get_subresource().mipLevel; ++level)
+	{
+		const vk::Extent3D level_extent{std::max(extent.width >> level, 1u), std::max(extent.height >> level, 1u), std::max(extent.depth >> level, 1u)};
+
+		regions.emplace_back(size, 0, 0, vk::ImageSubresourceLayers{vk::ImageAspectFlagBits::eColor, level, 0, layer_count}, vk::Offset3D{}, level_extent);
+
+		const vk::DeviceSize block_count = static_cast<vk::DeviceSize>((level_extent.width + block_extent[0] - 1) / block_extent[0]) *
+		                                   ((level_extent.height + block_extent[1] - 1) / block_extent[1]) *
+		                                   ((level_extent.depth + block_extent[2] - 1) / block_extent[2]);
+		size += block_count * block_size * layer_count;
+	}
+	return regions;
+}
+
+vk::ImageSubresourceRange get_full_range(const backend::Image &image)
+{
+	vk::ImageAspectFlags aspect_mask = vk::ImageAspectFlagBits::eColor;
+	if (common::is_depth_only_format(image.get_format()))
+	{
+		aspect_mask = vk::ImageAspectFlagBits::eDepth;
+	}
+	else if (common::is_depth_stencil_format(image.get_format()))
+	{
+		aspect_mask = vk::ImageAspectFlagBits::eDepth | vk::ImageAspectFlagBits::eStencil;
+	}
+	return {aspect_mask, 0, image.get_subresource().mipLevel, 0, image.get_array_layer_count()};
+}
+
+void transition(backend::CommandBuffer &command_buffer, const backend::Image &image, vk::ImageLayout old_layout, vk::ImageLayout new_layout)
+{
+	common::ImageMemoryBarrier barrier{};
+	barrier.old_layout      = old_layout;
+	barrier.new_layout      = new_layout;
+	barrier.src_stage_mask  = vk::PipelineStageFlagBits2::eAllCommands;
+	barrier.src_access_mask = vk::AccessFlagBits2::eMemoryWrite;
+	barrier.dst_stage_mask  = vk::PipelineStageFlagBits2::eAllCommands;
+	barrier.dst_access_mask = vk::AccessFlagBits2::eMemoryRead | vk::AccessFlagBits2::eMemoryWrite;
+
+	common::image_layout_transition(command_buffer.get_handle(), image.get_handle(), barrier, get_full_range(image));
+}
+
+void submit_and_wait(backend::Device &device, backend::CommandBuffer &command_buffer)
+{
+	const auto &queue = device.get_queue_by_flags(vk::QueueFlagBits::eGraphics, 0);
+	queue.submit(command_buffer, device.request_fence());
+
+	device.get_fence_pool().wait();
+	device.get_fence_pool().reset();
+	device.get_command_pool().reset_pool();
+}
+
+/// The swapchain image is replaced by an image that cannot be presented
+vk::ImageLayout to_replay_layout(vk::ImageLayout layout)
+{
+	return layout == vk::ImageLayout::ePresentSrcKHR ? vk::ImageLayout::eTransferSrcOptimal : layout;
+}
+
+/**
+ * \brief All batches are replayed on the graphics queue, so an ownership transfer is not replayed as such.
+ *        Its release half, the one with no destination stages, is dropped, otherwise the layout transition would run twice.
+ *        The acquire becomes a plain barrier, which then has to wait on the writes the release made available.
+ * \return false if the barrier is a release and must be skipped
+ */
+bool to_replay_queue_families(uint32_t &old_queue_family, uint32_t &new_queue_family, vk::PipelineStageFlags2 &src_stage_mask, vk::AccessFlags2 &src_access_mask, vk::PipelineStageFlags2 dst_stage_mask)
+{
+	if (old_queue_family == new_queue_family)
+	{
+		return true;
+	}
+
+	if (dst_stage_mask == vk::PipelineStageFlagBits2::eNone)
+	{
+		return false;
+	}
+
+	old_queue_family = VK_QUEUE_FAMILY_IGNORED;
+	new_queue_family = VK_QUEUE_FAMILY_IGNORED;
+	src_stage_mask   = vk::PipelineStageFlagBits2::eAllCommands;
+	src_access_mask  = vk::AccessFlagBits2::eMemoryWrite;
+	return true;
+}
+}        // namespace
+
+FrameCapture::FrameCapture(backend::Device &device) :
+    device_{device}
+{}
+
+uint64_t FrameCapture::add_resource(const backend::Buffer &buffer)
+{
+	const uint64_t key = to_key(buffer.get_handle());
+	buffers_.try_emplace(key, BufferRecord{&buffer});
+	return key;
+}
+
+uint64_t FrameCapture::add_resource(const backend::Image &image)
+{
+	const uint64_t key = to_key(image.get_handle());
+	images_.try_emplace(key, ImageRecord{&image});
+	return key;
+}
+
+uint64_t FrameCapture::add_resource(const backend::ImageView &image_view)
+{
+	const uint64_t key = to_key(image_view.get_handle());
+	if (!image_views_.contains(key))
+	{
+		image_views_.emplace(key, CapturedImageView{add_resource(image_view.get_image()), image_view.get_view_type(), image_view.get_format(), image_view.get_subresource_range()});
+	}
+	return key;
+}
+
+uint64_t FrameCapture::add_resource(const backend::Sampler &sampler)
+{
+	const uint64_t key = to_key(sampler.get_handle());
+
+	auto [it, inserted] = samplers_.try_emplace(key, sampler.get_create_info());
+	if (inserted)
+	{
+		it->second.pNext = nullptr;
+	}
+	return key;
+}
+
+uint64_t FrameCapture::add_resource(const backend::PipelineLayout &pipeline_layout)
+{
+	const uint64_t key = to_key(pipeline_layout.get_handle());
+	if (pipeline_layouts_.contains(key))
+	{
+		return key;
+	}
+
+	PipelineLayoutRecord record;
+	record.bindless = static_cast<bool>(pipeline_layout.get_bindless_descriptor_set());
+
+	for (const auto *shader_module : pipeline_layout.get_shader_modules())
+	{
+		const auto &variant = shader_module->get_shader_variant();
+
+		ShaderModuleRecord module_record;
+		module_record.stage               = shader_module->get_stage();
+		module_record.filename            = shader_module->get_source_filename();
+		module_record.preamble            = variant.get_preamble();
+		module_record.processes           = variant.get_processes();
+		module_record.runtime_array_sizes = {variant.get_runtime_array_sizes().begin(), variant.get_runtime_array_sizes().end()};
+
+		// Passes change resource modes on the cached modules after requesting them
+		for (const auto &resource : shader_module->get_resources())
+		{
+			if (resource.mode != backend::ShaderResourceMode::kStatic)
+			{
+				module_record.resource_modes[resource.name] = resource.mode;
+			}
+		}
+
+		record.shader_modules.push_back(std::move(module_record));
+	}
+
+	pipeline_layouts_.emplace(key, std::move(record));
+	return key;
+}
+
+std::vector<uint64_t> FrameCapture::add_resource(RenderTarget &render_target)
+{
+	std::vector<uint64_t> keys;
+	for (const auto &view : render_target.get_views())
+	{
+		keys.push_back(add_resource(view));
+	}
+	return keys;
+}
+
+void FrameCapture::add_bindless_texture(uint32_t index, const backend::ImageView &image_view, const backend::Sampler &sampler)
+{
+	bindless_textures_.push_back({index, add_resource(image_view), add_resource(sampler)});
+}
+
+void FrameCapture::track_layout(vk::Image image, vk::ImageLayout old_layout, vk::ImageLayout new_layout)
+{
+	auto [it, inserted] = layouts_.try_emplace(to_key(image), LayoutRecord{old_layout, new_layout});
+	if (!inserted)
+	{
+		it->second.final_layout = new_layout;
+	}
+}
+
+void FrameCapture::mark_written(const backend::Image &image)
+{
+	written_images_.insert(to_key(image.get_handle()));
+}
+
+void FrameCapture::read_back_contents()
+{
+	auto &command_buffer = device_.request_command_buffer();
+	command_buffer.begin(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+
+	// The frame completed, its writes only have to be made visible to the copies
+	vk::MemoryBarrier2 memory_barrier{vk::PipelineStageFlagBits2::eAllCommands, vk::AccessFlagBits2::eMemoryWrite,
+	                                  vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferRead};
+	command_buffer.get_handle().pipelineBarrier2(vk::DependencyInfo{}.setMemoryBarriers(memory_barrier));
+
+	std::vector<std::pair<std::vector<uint8_t> *, backend::Buffer>> read_backs;
+
+	const auto create_read_back_buffer = [this](vk::DeviceSize size) {
+		backend::BufferBuilder builder{size};
+		builder.with_usage(vk::BufferUsageFlagBits::eTransferDst)
+		    .with_vma_usage(VMA_MEMORY_USAGE_GPU_TO_CPU)
+		    .with_memory_category(backend::allocated::MemoryCategory::kStaging);
+		return builder.build(device_);
+	};
+
+	uint32_t skipped_count = 0;
+
+	for (auto &[key, record] : buffers_)
+	{
+		const auto &buffer = *record.buffer;
+
+		record.host_visible = buffer.is_host_visible();
+		if (record.host_visible)
+		{
+			record.content.resize(buffer.get_size());
+			buffer.read_back(record.content.data(), record.content.size());
+		}
+		else if (buffer.get_usage() & vk::BufferUsageFlagBits::eTransferSrc)
+		{
+			auto read_back_buffer = create_read_back_buffer(buffer.get_size());
+			command_buffer.copy_buffer(buffer, read_back_buffer, buffer.get_size());
+			read_backs.emplace_back(&record.content, std::move(read_back_buffer));
+		}
+		else
+		{
+			++skipped_count;
+		}
+	}
+
+	for (auto &[key, record] : images_)
+	{
+		const auto &image = *record.image;
+
+		if (written_images_.contains(key) || (image.get_usage() & vk::ImageUsageFlagBits::eStorage) || common::is_depth_format(image.get_format()))
+		{
+			continue;
+		}
+
+		if (!(image.get_usage() & vk::ImageUsageFlagBits::eTransferSrc))
+		{
+			++skipped_count;
+			continue;
+		}
+
+		// Images the frame does not transition are textures, which are kept ready to be sampled
+		const auto      layout_it = layouts_.find(key);
+		const auto      layout    = layout_it != layouts_.end() ? layout_it->second.final_layout : vk::ImageLayout::eShaderReadOnlyOptimal;
+		vk::DeviceSize  size;
+		const auto      regions          = get_copy_regions(image, size);
+		auto            read_back_buffer = create_read_back_buffer(size);
+
+		transition(command_buffer, image, layout, vk::ImageLayout::eTransferSrcOptimal);
+		command_buffer.copy_image_to_buffer(image, vk::ImageLayout::eTransferSrcOptimal, read_back_buffer, regions);
+		transition(command_buffer, image, vk::ImageLayout::eTransferSrcOptimal, layout);
+
+		read_backs.emplace_back(&record.content, std::move(read_back_buffer));
+	}
+
+	command_buffer.end();
+	submit_and_wait(device_, command_buffer);
+
+	for (auto &[content, read_back_buffer] : read_backs)
+	{
+		content->resize(read_back_buffer.get_size());
+		read_back_buffer.read_back(content->data(), content->size());
+	}
+
+	if (skipped_count > 0)
+	{
+		LOGW("{} resources of the captured frame have no transfer source usage, they are left empty on replay", skipped_count);
+	}
+}
+
+void FrameCapture::save(const std::string &path) const
+{
+	std::ostringstream os;
+	write(os, kMagic, kVersion);
+
+	write(os, images_.size());
+	for (const auto &[key, record] : images_)
+	{
+		const auto &image  = *record.image;
+		const auto  layout = layouts_.contains(key) ? layouts_.at(key) : LayoutRecord{};
+		write(os, key, image.get_flags(), image.get_type(), image.get_format(), image.get_extent(), image.get_subresource().mipLevel,
+		      image.get_array_layer_count(), image.get_sample_count(), image.get_tiling(), image.get_usage(),
+		      layout.initial_layout, layout.final_layout, record.content);
+	}
+
+	write(os, buffers_.size());
+	for (const auto &[key, record] : buffers_)
+	{
+		write(os, key, record.buffer->get_size(), record.buffer->get_usage(), record.host_visible, record.content);
+	}
+
+	write(os, image_views_.size());
+	for (const auto &[key, image_view] : image_views_)
+	{
+		write(os, key, image_view);
+	}
+
+	write(os, samplers_.size());
+	for (const auto &[key, create_info] : samplers_)
+	{
+		write(os, key, create_info);
+	}
+
+	write(os, pipeline_layouts_.size());
+	for (const auto &[key, record] : pipeline_layouts_)
+	{
+		write(os, key, record.bindless, record.shader_modules.size());
+		for (const auto &module_record : record.shader_modules)
+		{
+			write(os, module_record.stage, module_record.filename, module_record.preamble);
+			write_strings(os, module_record.processes);
+			write(os, module_record.runtime_array_sizes, module_record.resource_modes);
+		}
+	}
+
+	write(os, bindless_textures_);
+
+	write(os, command_count_, commands_.str());
+
+	std::ofstream file{path, std::ios::out | std::ios::binary | std::ios::trunc};
+	if (!file.is_open())
+	{
+		LOGE("Failed to open {} for writing the frame capture", path);
+		return;
+	}
+
+	const auto data = os.str();
+	file.write(data.data(), static_cast<std::streamsize>(data.size()));
+
+	LOGI("Wrote frame capture of {} commands, {} images and {} buffers to {}", command_count_, images_.size(), buffers_.size(), path);
+}
+
+uint32_t FrameCapture::get_command_count() const
+{
+	return command_count_;
+}
+
+FrameReplayer::FrameReplayer(backend::Device &device) :
+    device_{device}
+{}
+
+FrameReplayer::~FrameReplayer() = default;
+
+void FrameReplayer::load(const std::string &path)
+{
+	std::ifstream file{path, std::ios::in | std::ios::binary};
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Failed to open frame capture " + path);
+	}
+
+	std::istringstream is{std::string{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}}};
+
+	uint32_t magic   = 0;
+	uint32_t version = 0;
+	read(is, magic, version);
+	if (magic != FrameCapture::kMagic || version != FrameCapture::kVersion)
+	{
+		throw std::runtime_error(fmt::format("{} is not a version {} frame capture", path, FrameCapture::kVersion));
+	}
+
+	auto &command_buffer = device_.request_command_buffer();
+	command_buffer.begin(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+
+	// Kept alive until the uploads completed
+	std::vector<backend::Buffer> staging_buffers;
+
+	std::size_t image_count;
+	read(is, image_count);
+	for (std::size_t i = 0; i < image_count; ++i)
+	{
+		uint64_t                key;
+		vk::ImageCreateFlags    flags;
+		vk::ImageType           type;
+		vk::Format              format;
+		vk::Extent3D            extent;
+		uint32_t                mip_levels;
+		uint32_t                array_layers;
+		vk::SampleCountFlagBits sample_count;
+		vk::ImageTiling         tiling;
+		vk::ImageUsageFlags     usage;
+		vk::ImageLayout         initial_layout;
+		vk::ImageLayout         final_layout;
+		std::vector<uint8_t>    content;
+		read(is, key, flags, type, format, extent, mip_levels, array_layers, sample_count, tiling, usage, initial_layout, final_layout, content);
+
+		auto &state          = images_[key];
+		state.initial_layout = to_replay_layout(initial_layout);
+		state.final_layout   = to_replay_layout(final_layout);
+
+		backend::ImageBuilder image_builder{extent};
+		image_builder.with_image_type(type)
+		    .with_format(format)
+		    .with_mip_levels(mip_levels)
+		    .with_array_layers(array_layers)
+		    .with_sample_count(sample_count)
+		    .with_tiling(tiling)
+		    .with_flags(flags)
+		    .with_usage(usage | vk::ImageUsageFlagBits::eTransferDst)
+		    .with_vma_usage(VMA_MEMORY_USAGE_GPU_ONLY);
+		state.image = image_builder.build_unique(device_);
+
+		if (!content.empty())
+		{
+			vk::DeviceSize size;
+			const auto     regions = get_copy_regions(*state.image, size);
+			if (size != content.size())
+			{
+				throw std::runtime_error(fmt::format("Content of image {:#x} in {} does not match its size", key, path));
+			}
+
+			staging_buffers.push_back(backend::Buffer::create_staging_buffer(device_, content));
+
+			const auto layout = state.initial_layout != vk::ImageLayout::eUndefined ? state.initial_layout : vk::ImageLayout::eShaderReadOnlyOptimal;
+
+			transition(command_buffer, *state.image, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
+			command_buffer.copy_buffer_to_image(staging_buffers.back(), *state.image, regions);
+			transition(command_buffer, *state.image, vk::ImageLayout::eTransferDstOptimal, layout);
+
+			state.current_layout = layout;
+		}
+		else if (state.initial_layout != vk::ImageLayout::eUndefined)
+		{
+			transition(command_buffer, *state.image, vk::ImageLayout::eUndefined, state.initial_layout);
+			state.current_layout = state.initial_layout;
+		}
+	}
+
+	std::size_t buffer_count;
+	read(is, buffer_count);
+	for (std::size_t i = 0; i < buffer_count; ++i)
+	{
+		uint64_t             key;
+		vk::DeviceSize       size;
+		vk::BufferUsageFlags usage;
+		bool                 host_visible;
+		std::vector<uint8_t> content;
+		read(is, key, size, usage, host_visible, content);
+
+		// Buffers the CPU wrote stay in host visible memory, as the GPU may read them differently from device local memory
+		backend::BufferBuilder buffer_builder{size};
+		buffer_builder.with_usage(usage | vk::BufferUsageFlagBits::eTransferDst)
+		    .with_vma_usage(host_visible ? VMA_MEMORY_USAGE_CPU_TO_GPU : VMA_MEMORY_USAGE_GPU_ONLY);
+		auto buffer = buffer_builder.build_unique(device_);
+
+		if (content.empty())
+		{
+			command_buffer.clear_buffer(*buffer);
+		}
+		else if (host_visible)
+		{
+			buffer->update(content);
+		}
+		else
+		{
+			staging_buffers.push_back(backend::Buffer::create_staging_buffer(device_, content));
+			command_buffer.copy_buffer(staging_buffers.back(), *buffer, size);
+		}
+
+		buffers_.emplace(key, std::move(buffer));
+	}
+
+	vk::MemoryBarrier2 memory_barrier{vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
+	                                  vk::PipelineStageFlagBits2::eAllCommands, vk::AccessFlagBits2::eMemoryRead | vk::AccessFlagBits2::eMemoryWrite};
+	command_buffer.get_handle().pipelineBarrier2(vk::DependencyInfo{}.setMemoryBarriers(memory_barrier));
+
+	command_buffer.end();
+	submit_and_wait(device_, command_buffer);
+
+	std::size_t image_view_count;
+	read(is, image_view_count);
+	for (std::size_t i = 0; i < image_view_count; ++i)
+	{
+		uint64_t          key;
+		CapturedImageView record;
+		read(is, key, record);
+
+		const auto &range = record.subresource_range;
+		image_views_.emplace(key, std::make_unique<backend::ImageView>(get_image(record.image), record.view_type, record.format,
+		                                                               range.baseMipLevel, range.baseArrayLayer, range.levelCount, range.layerCount));
+		view_records_.emplace(key, record);
+	}
+
+	std::size_t sampler_count;
+	read(is, sampler_count);
+	for (std::size_t i = 0; i < sampler_count; ++i)
+	{
+		uint64_t              key;
+		vk::SamplerCreateInfo create_info;
+		read(is, key, create_info);
+
+		create_info.pNext = nullptr;
+		samplers_.emplace(key, std::make_unique<backend::Sampler>(device_, create_info));
+	}
+
+	auto &resource_cache = device_.get_resource_cache();
+
+	std::size_t pipeline_layout_count;
+	read(is, pipeline_layout_count);
+	for (std::size_t i = 0; i < pipeline_layout_count; ++i)
+	{
+		uint64_t    key;
+		bool        bindless;
+		std::size_t shader_module_count;
+		read(is, key, bindless, shader_module_count);
+
+		std::vector<backend::ShaderModule *> shader_modules;
+		for (std::size_t j = 0; j < shader_module_count; ++j)
+		{
+			vk::ShaderStageFlagBits                            stage;
+			std::string                                        filename;
+			std::string                                        preamble;
+			std::vector<std::string>                           processes;
+			std::map<std::string, size_t>                      runtime_array_sizes;
+			std::map<std::string, backend::ShaderResourceMode> resource_modes;
+			read(is, stage, filename, preamble);
+			read_strings(is, processes);
+			read(is, runtime_array_sizes, resource_modes);
+
+			backend::ShaderVariant variant{std::move(preamble), std::move(processes)};
+			variant.set_runtime_array_sizes({runtime_array_sizes.begin(), runtime_array_sizes.end()});
+
+			auto &shader_module = resource_cache.request_shader_module(stage, backend::ShaderSource{filename}, variant);
+			for (const auto &[name, mode] : resource_modes)
+			{
+				shader_module.set_resource_mode(name, mode);
+			}
+			shader_modules.push_back(&shader_module);
+		}
+
+		pipeline_layouts_.emplace(key, &resource_cache.request_pipeline_layout(shader_modules, bindless ? &resource_cache.request_bindless_descriptor_set() : nullptr));
+	}
+
+	std::vector<CapturedBindlessTexture> bindless_textures;
+	read(is, bindless_textures);
+	std::ranges::sort(bindless_textures, {}, &CapturedBindlessTexture::index);
+	for (const auto &texture : bindless_textures)
+	{
+		vk::DescriptorImageInfo image_info{get_sampler(texture.sampler).get_handle(), get_image_view(texture.image_view).get_handle(), vk::ImageLayout::eShaderReadOnlyOptimal};
+		resource_cache.request_bindless_descriptor_set().update(texture.index, image_info);
+	}
+
+	read(is, command_count_, commands_);
+
+	LOGI("Loaded frame capture {} with {} commands, {} images and {} buffers", path, command_count_, images_.size(), buffers_.size());
+}
+
+void FrameReplayer::execute(RenderContext &render_context)
+{
+	render_context.begin_frame();
+
+	auto &gpu_profiler = render_context.get_active_frame().get_gpu_profiler();
+
+	std::vector<backend::CommandBuffer *> command_buffers;
+	backend::CommandBuffer               *command_buffer = nullptr;
+	uint32_t                              batch_scope    = 0;
+
+	std::istringstream is{commands_};
+	for (uint32_t i = 0; i < command_count_; ++i)
+	{
+		CaptureCommand command;
+		read(is, command);
+
+		if (command == CaptureCommand::kBeginBatch)
+		{
+			std::string name;
+			read(is, name);
+
+			command_buffer = &render_context.request_graphics_command_buffer(backend::CommandBuffer::ResetMode::kResetPool, vk::CommandBufferLevel::ePrimary, 0);
+			command_buffer->begin(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+
+			if (command_buffers.empty())
+			{
+				restore_layouts(*command_buffer);
+
+				// Nothing draws to the acquired image, it only has to be presentable
+				common::ImageMemoryBarrier present_barrier{};
+				present_barrier.new_layout     = vk::ImageLayout::ePresentSrcKHR;
+				present_barrier.src_stage_mask = vk::PipelineStageFlagBits2::eColorAttachmentOutput;
+				present_barrier.dst_stage_mask = vk::PipelineStageFlagBits2::eBottomOfPipe;
+				command_buffer->image_memory_barrier(render_context.get_active_frame().get_render_target().get_views()[0], present_barrier);
+			}
+
+			batch_scope = gpu_profiler.begin_scope(*command_buffer, name, 0);
+			command_buffers.push_back(command_buffer);
+		}
+		else if (command == CaptureCommand::kEndBatch)
+		{
+			gpu_profiler.end_scope(*command_buffer, batch_scope);
+			command_buffer->end();
+			command_buffer = nullptr;
+		}
+		else
+		{
+			assert(command_buffer && "Captured commands are recorded in batches");
+			replay_command(command, is, *command_buffer, gpu_profiler);
+		}
+	}
+
+	uint64_t signal_semaphore_value = 0;
+	render_context.graphics_submit(command_buffers, signal_semaphore_value, 0, {}, true, true);
+
+	for (auto &[key, state] : images_)
+	{
+		if (state.final_layout != vk::ImageLayout::eUndefined)
+		{
+			state.current_layout = state.final_layout;
+		}
+	}
+}
+
+void FrameReplayer::restore_layouts(backend::CommandBuffer &command_buffer)
+{
+	// The previous iteration left the images in the layouts the frame ends with
+	for (auto &[key, state] : images_)
+	{
+		if (state.initial_layout == vk::ImageLayout::eUndefined || state.current_layout == state.initial_layout)
+		{
+			continue;
+		}
+
+		transition(command_buffer, *state.image, state.current_layout, state.initial_layout);
+		state.current_layout = state.initial_layout;
+	}
+}
+
+void FrameReplayer::replay_command(CaptureCommand command, std::istringstream &is, backend::CommandBuffer &command_buffer, GpuProfiler &gpu_profiler)
+{
+	switch (command)
+	{
+		case CaptureCommand::kBeginPass:
+		{
+			std::string name;
+			read(is, name);
+			pass_scope_ = gpu_profiler.begin_scope(command_buffer, name, 1);
+			break;
+		}
+		case CaptureCommand::kEndPass:
+			gpu_profiler.end_scope(command_buffer, pass_scope_);
+			break;
+		case CaptureCommand::kBeginRendering:
+		{
+			std::vector<uint64_t>       image_views;
+			std::vector<vk::ClearValue> clear_values;
+			vk::Extent2D                render_area;
+			read(is, image_views, clear_values, render_area);
+			command_buffer.begin_rendering(request_render_target(image_views), clear_values, render_area);
+			break;
+		}
+		case CaptureCommand::kEndRendering:
+			command_buffer.end_rendering();
+			break;
+		case CaptureCommand::kSetSpecializationConstant:
+		{
+			uint32_t             constant_id;
+			std::vector<uint8_t> data;
+			read(is, constant_id, data);
+			command_buffer.set_specialization_constant(constant_id, data);
+			break;
+		}
+		case CaptureCommand::kPushConstants:
+		{
+			std::vector<uint8_t> values;
+			read(is, values);
+			command_buffer.push_constants(values);
+			break;
+		}
+		case CaptureCommand::kBindBuffer:
+		{
+			uint64_t       buffer;
+			vk::DeviceSize offset;
+			vk::DeviceSize range;
+			uint32_t       set;
+			uint32_t       binding;
+			uint32_t       array_element;
+			read(is, buffer, offset, range, set, binding, array_element);
+			command_buffer.bind_buffer(get_buffer(buffer), offset, range, set, binding, array_element);
+			break;
+		}
+		case CaptureCommand::kBindImage:
+		{
+			uint64_t image_view;
+			uint64_t sampler;
+			uint32_t set;
+			uint32_t binding;
+			uint32_t array_element;
+			read(is, image_view, sampler, set, binding, array_element);
+			command_buffer.bind_image(get_image_view(image_view), get_sampler(sampler), set, binding, array_element);
+			break;
+		}
+		case CaptureCommand::kBindImageWithoutSampler:
+		{
+			uint64_t image_view;
+			uint32_t set;
+			uint32_t binding;
+			uint32_t array_element;
+			read(is, image_view, set, binding, array_element);
+			command_buffer.bind_image(get_image_view(image_view), set, binding, array_element);
+			break;
+		}
+		case CaptureCommand::kBindInput:
+		{
+			uint64_t image_view;
+			uint32_t set;
+			uint32_t binding;
+			uint32_t array_element;
+			read(is, image_view, set, binding, array_element);
+			command_buffer.bind_input(get_image_view(image_view), set, binding, array_element);
+			break;
+		}
+		case CaptureCommand::kBindVertexBuffers:
+		{
+			uint32_t                    first_binding;
+			std::vector<uint64_t>       buffer_keys;
+			std::vector<vk::DeviceSize> offsets;
+			read(is, first_binding, buffer_keys, offsets);
+
+			std::vector<std::reference_wrapper<const backend::Buffer>> buffers;
+			for (const auto key : buffer_keys)
+			{
+				buffers.emplace_back(get_buffer(key));
+			}
+			command_buffer.bind_vertex_buffers(first_binding, buffers, offsets);
+			break;
+		}
+		case CaptureCommand::kBindIndexBuffer:
+		{
+			uint64_t       buffer;
+			vk::DeviceSize offset;
+			vk::IndexType  index_type;
+			read(is, buffer, offset, index_type);
+			command_buffer.bind_index_buffer(get_buffer(buffer), offset, index_type);
+			break;
+		}
+		case CaptureCommand::kSetViewportState:
+		{
+			ViewportState state;
+			read(is, state);
+			command_buffer.set_viewport_state(state);
+			break;
+		}
+		case CaptureCommand::kSetAttachmentsState:
+		{
+			AttachmentsState state;
+			read(is, state.color_attachment_formats, state.depth_attachment_format, state.stencil_attachment_format);
+			command_buffer.set_attachments_state(state);
+			break;
+		}
+		case CaptureCommand::kSetVertexInputState:
+		{
+			VertexInputState state;
+			read(is, state.bindings, state.attributes);
+			command_buffer.set_vertex_input_state(state);
+			break;
+		}
+		case CaptureCommand::kSetInputAssemblyState:
+		{
+			InputAssemblyState state;
+			read(is, state);
+			command_buffer.set_input_assembly_state(state);
+			break;
+		}
+		case CaptureCommand::kSetRasterizationState:
+		{
+			RasterizationState state;
+			read(is, state);
+			command_buffer.set_rasterization_state(state);
+			break;
+		}
+		case CaptureCommand::kSetMultisampleState:
+		{
+			MultisampleState state;
+			read(is, state);
+			command_buffer.set_multisample_state(state);
+			break;
+		}
+		case CaptureCommand::kSetDepthStencilState:
+		{
+			DepthStencilState state;
+			read(is, state);
+			command_buffer.set_depth_stencil_state(state);
+			break;
+		}
+		case CaptureCommand::kSetColorBlendState:
+		{
+			ColorBlendState state;
+			read(is, state.logic_op_enable, state.logic_op, state.attachments);
+			command_buffer.set_color_blend_state(state);
+			break;
+		}
+		case CaptureCommand::kSetViewport:
+		{
+			uint32_t                  first_viewport;
+			std::vector<vk::Viewport> viewports;
+			read(is, first_viewport, viewports);
+			command_buffer.set_viewport(first_viewport, viewports);
+			break;
+		}
+		case CaptureCommand::kSetScissor:
+		{
+			uint32_t                first_scissor;
+			std::vector<vk::Rect2D> scissors;
+			read(is, first_scissor, scissors);
+			command_buffer.set_scissor(first_scissor, scissors);
+			break;
+		}
+		case CaptureCommand::kSetLineWidth:
+		{
+			float line_width;
+			read(is, line_width);
+			command_buffer.set_line_width(line_width);
+			break;
+		}
+		case CaptureCommand::kSetDepthBias:
+		{
+			float constant_factor;
+			float clamp;
+			float slope_factor;
+			read(is, constant_factor, clamp, slope_factor);
+			command_buffer.set_depth_bias(constant_factor, clamp, slope_factor);
+			break;
+		}
+		case CaptureCommand::kSetBlendConstants:
+		{
+			std::array<float, 4> blend_constants;
+			read(is, blend_constants);
+			command_buffer.set_blend_constants(blend_constants);
+			break;
+		}
+		case CaptureCommand::kSetDepthBounds:
+		{
+			float min_depth_bounds;
+			float max_depth_bounds;
+			read(is, min_depth_bounds, max_depth_bounds);
+			command_buffer.set_depth_bounds(min_depth_bounds, max_depth_bounds);
+			break;
+		}
+		case CaptureCommand::kSetHasMeshShader:
+		{
+			bool has_mesh_shader;
+			read(is, has_mesh_shader);
+			command_buffer.set_has_mesh_shader(has_mesh_shader);
+			break;
+		}
+		case CaptureCommand::kBindPipelineLayout:
+		{
+			uint64_t pipeline_layout;
+			read(is, pipeline_layout);
+			command_buffer.bind_pipeline_layout(*pipeline_layouts_.at(pipeline_layout));
+			break;
+		}
+		case CaptureCommand::kSetUpdateAfterBind:
+		{
+			bool update_after_bind;
+			read(is, update_after_bind);
+			command_buffer.set_update_after_bind(update_after_bind);
+			break;
+		}
+		case CaptureCommand::kDraw:
+		{
+			uint32_t vertex_count;
+			uint32_t instance_count;
+			uint32_t first_vertex;
+			uint32_t first_instance;
+			read(is, vertex_count, instance_count, first_vertex, first_instance);
+			command_buffer.draw(vertex_count, instance_count, first_vertex, first_instance);
+			break;
+		}
+		case CaptureCommand::kDrawIndexed:
+		{
+			uint32_t index_count;
+			uint32_t instance_count;
+			uint32_t first_index;
+			int32_t  vertex_offset;
+			uint32_t first_instance;
+			read(is, index_count, instance_count, first_index, vertex_offset, first_instance);
+			command_buffer.draw_indexed(index_count, instance_count, first_index, vertex_offset, first_instance);
+			break;
+		}
+		case CaptureCommand::kDrawIndexedIndirect:
+		{
+			uint64_t       buffer;
+			vk::DeviceSize offset;
+			uint32_t       draw_count;
+			uint32_t       stride;
+			read(is, buffer, offset, draw_count, stride);
+			command_buffer.draw_indexed_indirect(get_buffer(buffer), offset, draw_count, stride);
+			break;
+		}
+		case CaptureCommand::kDispatch:
+		{
+			uint32_t group_count_x;
+			uint32_t group_count_y;
+			uint32_t group_count_z;
+			read(is, group_count_x, group_count_y, group_count_z);
+			command_buffer.dispatch(group_count_x, group_count_y, group_count_z);
+			break;
+		}
+		case CaptureCommand::kDispatchIndirect:
+		{
+			uint64_t       buffer;
+			vk::DeviceSize offset;
+			read(is, buffer, offset);
+			command_buffer.dispatch_indirect(get_buffer(buffer), offset);
+			break;
+		}
+		case CaptureCommand::kDrawMeshTasks:
+		{
+			uint32_t group_count_x;
+			uint32_t group_count_y;
+			uint32_t group_count_z;
+			read(is, group_count_x, group_count_y, group_count_z);
+			command_buffer.draw_mesh_tasks(group_count_x, group_count_y, group_count_z);
+			break;
+		}
+		case CaptureCommand::kDrawMeshTasksIndirect:
+		{
+			uint64_t       buffer;
+			vk::DeviceSize offset;
+			uint32_t       draw_count;
+			uint32_t       stride;
+			read(is, buffer, offset, draw_count, stride);
+			command_buffer.draw_mesh_tasks_indirect(get_buffer(buffer), offset, draw_count, stride);
+			break;
+		}
+		case CaptureCommand::kDrawMeshTasksIndirectCount:
+		{
+			uint64_t       buffer;
+			vk::DeviceSize offset;
+			uint64_t       count_buffer;
+			vk::DeviceSize count_buffer_offset;
+			uint32_t       max_draw_count;
+			uint32_t       stride;
+			read(is, buffer, offset, count_buffer, count_buffer_offset, max_draw_count, stride);
+			command_buffer.draw_mesh_tasks_indirect_count(get_buffer(buffer), offset, get_buffer(count_buffer), count_buffer_offset, max_draw_count, stride);
+			break;
+		}
+		case CaptureCommand::kUpdateBuffer:
+		{
+			uint64_t             buffer;
+			vk::DeviceSize       offset;
+			std::vector<uint8_t> data;
+			read(is, buffer, offset, data);
+			command_buffer.update_buffer(get_buffer(buffer), offset, data);
+			break;
+		}
+		case CaptureCommand::kClearBuffer:
+		{
+			uint64_t buffer;
+			read(is, buffer);
+			command_buffer.clear_buffer(get_buffer(buffer));
+			break;
+		}
+		case CaptureCommand::kBlitImage:
+		{
+			uint64_t                   src_image;
+			uint64_t                   dst_image;
+			std::vector<vk::ImageBlit> regions;
+			read(is, src_image, dst_image, regions);
+			command_buffer.blit_image(get_image(src_image), get_image(dst_image), regions);
+			break;
+		}
+		case CaptureCommand::kResolveImage:
+		{
+			uint64_t                      src_image;
+			uint64_t                      dst_image;
+			std::vector<vk::ImageResolve> regions;
+			read(is, src_image, dst_image, regions);
+			command_buffer.resolve_image(get_image(src_image), get_image(dst_image), regions);
+			break;
+		}
+		case CaptureCommand::kCopyBuffer:
+		{
+			uint64_t       src_buffer;
+			uint64_t       dst_buffer;
+			vk::DeviceSize size;
+			read(is, src_buffer, dst_buffer, size);
+			command_buffer.copy_buffer(get_buffer(src_buffer), get_buffer(dst_buffer), size);
+			break;
+		}
+		case CaptureCommand::kCopyImage:
+		{
+			uint64_t                   src_image;
+			uint64_t                   dst_image;
+			std::vector<vk::ImageCopy> regions;
+			read(is, src_image, dst_image, regions);
+			command_buffer.copy_image(get_image(src_image), get_image(dst_image), regions);
+			break;
+		}
+		case CaptureCommand::kCopyBufferToImage:
+		{
+			uint64_t                         buffer;
+			uint64_t                         image;
+			std::vector<vk::BufferImageCopy> regions;
+			read(is, buffer, image, regions);
+			command_buffer.copy_buffer_to_image(get_buffer(buffer), get_image(image), regions);
+			break;
+		}
+		case CaptureCommand::kCopyImageToBuffer:
+		{
+			uint64_t                         image;
+			vk::ImageLayout                  image_layout;
+			uint64_t                         buffer;
+			std::vector<vk::BufferImageCopy> regions;
+			read(is, image, image_layout, buffer, regions);
+			command_buffer.copy_image_to_buffer(get_image(image), to_replay_layout(image_layout), get_buffer(buffer), regions);
+			break;
+		}
+		case CaptureCommand::kImageMemoryBarrier:
+		{
+			uint64_t                   image_view;
+			common::ImageMemoryBarrier barrier;
+			read(is, image_view, barrier);
+
+			if (!to_replay_queue_families(barrier.old_queue_family, barrier.new_queue_family, barrier.src_stage_mask, barrier.src_access_mask, barrier.dst_stage_mask))
+			{
+				break;
+			}
+			barrier.old_layout = to_replay_layout(barrier.old_layout);
+			barrier.new_layout = to_replay_layout(barrier.new_layout);
+			command_buffer.image_memory_barrier(get_image_view(image_view), barrier);
+			break;
+		}
+		case CaptureCommand::kBufferMemoryBarrier:
+		{
+			uint64_t                    buffer;
+			vk::DeviceSize              offset;
+			vk::DeviceSize              size;
+			common::BufferMemoryBarrier barrier;
+			read(is, buffer, offset, size, barrier);
+
+			if (!to_replay_queue_families(barrier.old_queue_family, barrier.new_queue_family, barrier.src_stage_mask, barrier.src_access_mask, barrier.dst_stage_mask))
+			{
+				break;
+			}
+			command_buffer.buffer_memory_barrier(get_buffer(buffer), offset, size, barrier);
+			break;
+		}
+		case CaptureCommand::kPipelineBarrier:
+		{
+			std::vector<vk::ImageMemoryBarrier2>  image_barriers;
+			std::vector<vk::BufferMemoryBarrier2> buffer_barriers;
+			read(is, image_barriers, buffer_barriers);
+
+			// Barriers on resources the frame never used otherwise were not captured
+			std::erase_if(image_barriers, [this](const vk::ImageMemoryBarrier2 &barrier) { return !images_.contains(to_key(barrier.image)); });
+			std::erase_if(buffer_barriers, [this](const vk::BufferMemoryBarrier2 &barrier) { return !buffers_.contains(to_key(barrier.buffer)); });
+
+			std::erase_if(image_barriers, [](vk::ImageMemoryBarrier2 &barrier) {
+				return !to_replay_queue_families(barrier.srcQueueFamilyIndex, barrier.dstQueueFamilyIndex, barrier.srcStageMask, barrier.srcAccessMask, barrier.dstStageMask);
+			});
+			std::erase_if(buffer_barriers, [](vk::BufferMemoryBarrier2 &barrier) {
+				return !to_replay_queue_families(barrier.srcQueueFamilyIndex, barrier.dstQueueFamilyIndex, barrier.srcStageMask, barrier.srcAccessMask, barrier.dstStageMask);
+			});
+
+			for (auto &barrier : image_barriers)
+			{
+				barrier.pNext     = nullptr;
+				barrier.image     = get_image(to_key(barrier.image)).get_handle();
+				barrier.oldLayout = to_replay_layout(barrier.oldLayout);
+				barrier.newLayout = to_replay_layout(barrier.newLayout);
+			}
+			for (auto &barrier : buffer_barriers)
+			{
+				barrier.pNext  = nullptr;
+				barrier.buffer = get_buffer(to_key(barrier.buffer)).get_handle();
+			}
+
+			command_buffer.pipeline_barrier(image_barriers, buffer_barriers);
+			break;
+		}
+		default:
+			throw std::runtime_error(fmt::format("Unexpected command {} in frame capture", static_cast<uint32_t>(command)));
+	}
+}
+
+RenderTarget &FrameReplayer::request_render_target(const std::vector<uint64_t> &image_views)
+{
+	auto it = render_targets_.find(image_views);
+	if (it != render_targets_.end())
+	{
+		return *it->second;
+	}
+
+	// The render target owns its views, they are created again from the captured ones
+	std::vector<backend::ImageView> views;
+	for (const auto key : image_views)
+	{
+		const auto &record = view_records_.at(key);
+		const auto &range  = record.subresource_range;
+		views.emplace_back(get_image(record.image), record.view_type, record.format, range.baseMipLevel, range.baseArrayLayer, range.levelCount, range.layerCount);
+	}
+
+	return *render_targets_.emplace(image_views, std::make_unique<RenderTarget>(std::move(views))).first->second;
+}
+
+backend::Image &FrameReplayer::get_image(uint64_t key) const
+{
+	return *images_.at(key).image;
+}
+
+backend::Buffer &FrameReplayer::get_buffer(uint64_t key) const
+{
+	return *buffers_.at(key);
+}
+
+backend::ImageView &FrameReplayer::get_image_view(uint64_t key) const
+{
+	return *image_views_.at(key);
+}
+
+backend::Sampler &FrameReplayer::get_sampler(uint64_t key) const
+{
+	return *samplers_.at(key);
+}
+}        // namespace xihe::rendering
@@ -0,0 +1,273 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "backend/shader_module.h"
+#include "common/helpers.h"
+#include "common/vk_common.h"
+
+namespace xihe
+{
+namespace backend
+{
+class Buffer;
+class CommandBuffer;
+class Device;
+class Image;
+class ImageView;
+class PipelineLayout;
+class Sampler;
+}        // namespace backend
+
+namespace rendering
+{
+class GpuProfiler;
+class RenderContext;
+class RenderTarget;
+
+/**
+ * \brief Commands of a captured frame, each is followed by the arguments of the CommandBuffer call it records.
+ *        Resources are referenced by the value of their Vulkan handle at capture time.
+ */
+enum class CaptureCommand : uint32_t
+{
+	kBeginBatch,
+	kEndBatch,
+	kBeginPass,
+	kEndPass,
+	kBeginRendering,
+	kEndRendering,
+	kSetSpecializationConstant,
+	kPushConstants,
+	kBindBuffer,
+	kBindImage,
+	kBindImageWithoutSampler,
+	kBindInput,
+	kBindVertexBuffers,
+	kBindIndexBuffer,
+	kSetViewportState,
+	kSetAttachmentsState,
+	kSetVertexInputState,
+	kSetInputAssemblyState,
+	kSetRasterizationState,
+	kSetMultisampleState,
+	kSetDepthStencilState,
+	kSetColorBlendState,
+	kSetViewport,
+	kSetScissor,
+	kSetLineWidth,
+	kSetDepthBias,
+	kSetBlendConstants,
+	kSetDepthBounds,
+	kSetHasMeshShader,
+	kBindPipelineLayout,
+	kSetUpdateAfterBind,
+	kDraw,
+	kDrawIndexed,
+	kDrawIndexedIndirect,
+	kDispatch,
+	kDispatchIndirect,
+	kDrawMeshTasks,
+	kDrawMeshTasksIndirect,
+	kDrawMeshTasksIndirectCount,
+	kUpdateBuffer,
+	kClearBuffer,
+	kBlitImage,
+	kResolveImage,
+	kCopyBuffer,
+	kCopyImage,
+	kCopyBufferToImage,
+	kCopyImageToBuffer,
+	kImageMemoryBarrier,
+	kBufferMemoryBarrier,
+	kPipelineBarrier,
+};
+
+/// An image view the captured frame used, its image is referenced by handle value as well
+struct CapturedImageView
+{
+	uint64_t                  image{0};
+	vk::ImageViewType         view_type{};
+	vk::Format                format{};
+	vk::ImageSubresourceRange subresource_range{};
+};
+
+struct CapturedBindlessTexture
+{
+	uint32_t index{0};
+	uint64_t image_view{0};
+	uint64_t sampler{0};
+};
+
+/**
+ * \brief Records the commands a frame's render graph issues through backend::CommandBuffer, together with
+ *        the resources they use, so the frame can be replayed without the scene and the application.
+ *
+ *        Buffer contents are read back at the end of the frame. Image contents are only kept for the images
+ *        the frame does not write, such as textures, the others are produced again by the replay.
+ */
+class FrameCapture
+{
+  public:
+	static constexpr uint32_t kMagic   = 0x50414358;        // "XCAP"
+	static constexpr uint32_t kVersion = 2;
+
+	explicit FrameCapture(backend::Device &device);
+
+	template <typename... Args>
+	void record(CaptureCommand command, const Args &...args)
+	{
+		write(commands_, command, args...);
+		++command_count_;
+	}
+
+	/// Each returns the key the command stream refers to the resource with
+	uint64_t add_resource(const backend::Buffer &buffer);
+	uint64_t add_resource(const backend::Image &image);
+	uint64_t add_resource(const backend::ImageView &image_view);
+	uint64_t add_resource(const backend::Sampler &sampler);
+	uint64_t add_resource(const backend::PipelineLayout &pipeline_layout);
+
+	/// Image views of the attachments, the render target itself is recreated from them on replay
+	std::vector<uint64_t> add_resource(RenderTarget &render_target);
+
+	/// Textures the bindless descriptor set holds, they are not bound through the command buffer
+	void add_bindless_texture(uint32_t index, const backend::ImageView &image_view, const backend::Sampler &sampler);
+
+	/// Follows the layout of the image, the replay starts each iteration from the first layout the frame expects
+	void track_layout(vk::Image image, vk::ImageLayout old_layout, vk::ImageLayout new_layout);
+
+	/// Images the frame writes are not read back, the replay produces their contents again
+	void mark_written(const backend::Image &image);
+
+	/**
+	 * \brief Copies the contents of the buffers and of the images that are not written to the host,
+	 *        the captured frame must have completed on the GPU
+	 */
+	void read_back_contents();
+
+	void save(const std::string &path) const;
+
+	uint32_t get_command_count() const;
+
+  private:
+	struct ImageRecord
+	{
+		const backend::Image *image{nullptr};
+		std::vector<uint8_t>  content;
+	};
+
+	struct BufferRecord
+	{
+		const backend::Buffer *buffer{nullptr};
+		bool                   host_visible{false};
+		std::vector<uint8_t>   content;
+	};
+
+	struct ShaderModuleRecord
+	{
+		vk::ShaderStageFlagBits                            stage{};
+		std::string                                        filename;
+		std::string                                        preamble;
+		std::vector<std::string>                           processes;
+		std::map<std::string, size_t>                      runtime_array_sizes;
+		std::map<std::string, backend::ShaderResourceMode> resource_modes;
+	};
+
+	struct PipelineLayoutRecord
+	{
+		std::vector<ShaderModuleRecord> shader_modules;
+		bool                            bindless{false};
+	};
+
+	struct LayoutRecord
+	{
+		vk::ImageLayout initial_layout{vk::ImageLayout::eUndefined};
+		vk::ImageLayout final_layout{vk::ImageLayout::eUndefined};
+	};
+
+	backend::Device &device_;
+
+	std::ostringstream commands_;
+	uint32_t           command_count_{0};
+
+	std::unordered_map<uint64_t, ImageRecord>           images_;
+	std::unordered_map<uint64_t, BufferRecord>          buffers_;
+	std::unordered_map<uint64_t, CapturedImageView>     image_views_;
+	std::unordered_map<uint64_t, vk::SamplerCreateInfo> samplers_;
+	std::unordered_map<uint64_t, PipelineLayoutRecord>  pipeline_layouts_;
+
+	std::unordered_map<uint64_t, LayoutRecord> layouts_;
+	std::unordered_set<uint64_t>               written_images_;
+
+	std::vector<CapturedBindlessTexture> bindless_textures_;
+};
+
+/**
+ * \brief Recreates the resources of a frame capture and records its commands again, all batches are
+ *        serialized on the graphics queue. Shaders are compiled from the shader directory, so changes
+ *        to them can be measured on a fixed frame.
+ */
+class FrameReplayer
+{
+  public:
+	explicit FrameReplayer(backend::Device &device);
+
+	~FrameReplayer();
+
+	/// Throws if the file is not a capture of this version
+	void load(const std::string &path);
+
+	/**
+	 * \brief Replays the frame as one frame of the render context, each batch and pass gets a GPU scope
+	 *        named as in the captured frame. The acquired swapchain image is presented without being drawn to.
+	 */
+	void execute(RenderContext &render_context);
+
+  private:
+	struct ImageState
+	{
+		std::unique_ptr<backend::Image> image;
+		vk::ImageLayout                 initial_layout{vk::ImageLayout::eUndefined};
+		vk::ImageLayout                 final_layout{vk::ImageLayout::eUndefined};
+		vk::ImageLayout                 current_layout{vk::ImageLayout::eUndefined};
+	};
+
+	void restore_layouts(backend::CommandBuffer &command_buffer);
+
+	void replay_command(CaptureCommand command, std::istringstream &is, backend::CommandBuffer &command_buffer, GpuProfiler &gpu_profiler);
+
+	RenderTarget &request_render_target(const std::vector<uint64_t> &image_views);
+
+	backend::Image &get_image(uint64_t key) const;
+
+	backend::Buffer &get_buffer(uint64_t key) const;
+
+	backend::ImageView &get_image_view(uint64_t key) const;
+
+	backend::Sampler &get_sampler(uint64_t key) const;
+
+	backend::Device &device_;
+
+	std::string commands_;
+	uint32_t    command_count_{0};
+
+	uint32_t pass_scope_{0};
+
+	std::unordered_map<uint64_t, ImageState>                          images_;
+	std::unordered_map<uint64_t, std::unique_ptr<backend::Buffer>>    buffers_;
+	std::unordered_map<uint64_t, CapturedImageView>                   view_records_;
+	std::unordered_map<uint64_t, std::unique_ptr<backend::ImageView>> image_views_;
+	std::unordered_map<uint64_t, std::unique_ptr<backend::Sampler>>   samplers_;
+	std::unordered_map<uint64_t, backend::PipelineLayout *>           pipeline_layouts_;
+
+	std::map<std::vector<uint64_t>, std::unique_ptr<RenderTarget>> render_targets_;
+};
+}        // namespace rendering
+}        // namespace xihe
@@ -0,0 +1,161 @@
+#include "frame_pacer.h"
+
+#include "backend/device.h"
+#include "common/logging.h"
+#include "common/trace.h"
+
+namespace xihe::rendering
+{
+namespace
+{
+// Long enough for any frame to reach the display, a present that never completes must not hang the application
+constexpr uint64_t kWaitTimeoutNs = 1'000'000'000;
+
+double to_ms(std::chrono::steady_clock::duration duration)
+{
+	return std::chrono::duration<double, std::milli>(duration).count();
+}
+}        // namespace
+
+FramePacer::FramePacer(backend::Device &device, vk::Semaphore graphics_semaphore) :
+    device_{device}, graphics_semaphore_{graphics_semaphore}
+{}
+
+void FramePacer::set_present_wait_enabled(bool enabled)
+{
+	present_wait_enabled_ = enabled;
+}
+
+bool FramePacer::is_present_wait_enabled() const
+{
+	return present_wait_enabled_;
+}
+
+void FramePacer::set_max_queued_frames(uint32_t count)
+{
+	max_queued_frames_ = count;
+}
+
+uint32_t FramePacer::get_max_queued_frames() const
+{
+	return max_queued_frames_;
+}
+
+void FramePacer::wait_before_input()
+{
+	XIHE_TRACE_ZONE("Wait before input");
+
+	completed_frames_.clear();
+
+	while (!pending_frames_.empty() && wait_for(pending_frames_.front(), 0))
+	{
+		complete_front(Clock::now());
+	}
+
+	while (max_queued_frames_ > 0 && pending_frames_.size() > max_queued_frames_)
+	{
+		if (!wait_for(pending_frames_.front(), kWaitTimeoutNs))
+		{
+			LOGW("Frame {} did not complete within a second, sampling input without waiting for it", pending_frames_.front().frame_id);
+			break;
+		}
+		complete_front(Clock::now());
+	}
+
+	input_time_ = Clock::now();
+}
+
+void FramePacer::begin_frame()
+{
+	if (!input_time_)
+	{
+		completed_frames_.clear();
+		input_time_ = Clock::now();
+	}
+
+	while (!pending_frames_.empty() && wait_for(pending_frames_.front(), 0))
+	{
+		complete_front(Clock::now());
+	}
+}
+
+uint64_t FramePacer::end_frame(vk::SwapchainKHR swapchain, uint64_t timeline_value)
+{
+	const auto now = Clock::now();
+
+	PendingFrame frame;
+	frame.frame_id       = next_frame_id_++;
+	frame.timeline_value = timeline_value;
+	frame.swapchain      = swapchain;
+	frame.input_time     = input_time_.value_or(now);
+	frame.submit_time    = now;
+	if (present_wait_enabled_ && swapchain)
+	{
+		frame.present_id = next_present_id_++;
+	}
+
+	input_time_.reset();
+	pending_frames_.push_back(frame);
+
+	return frame.present_id;
+}
+
+void FramePacer::on_swapchain_recreated()
+{
+	for (auto &frame : pending_frames_)
+	{
+		frame.present_id = 0;
+		frame.swapchain  = nullptr;
+	}
+}
+
+const std::vector<FrameLatency> &FramePacer::get_completed_frames() const
+{
+	return completed_frames_;
+}
+
+std::optional<FrameLatency> FramePacer::get_last_latency() const
+{
+	return last_latency_;
+}
+
+bool FramePacer::wait_for(PendingFrame &frame, uint64_t timeout_ns) const
+{
+	if (frame.present_id != 0)
+	{
+		try
+		{
+			return device_.get_handle().waitForPresentKHR(frame.swapchain, frame.present_id, timeout_ns) != vk::Result::eTimeout;
+		}
+		catch (vk::SystemError &)
+		{
+			// The surface changed or was lost, the present may never complete
+			frame.present_id = 0;
+		}
+	}
+
+	if (timeout_ns == 0)
+	{
+		return device_.get_handle().getSemaphoreCounterValue(graphics_semaphore_) >= frame.timeline_value;
+	}
+
+	const vk::SemaphoreWaitInfo wait_info{{}, graphics_semaphore_, frame.timeline_value};
+	return device_.get_handle().waitSemaphores(wait_info, timeout_ns) == vk::Result::eSuccess;
+}
+
+void FramePacer::complete_front(Clock::time_point time)
+{
+	const auto &frame = pending_frames_.front();
+
+	FrameLatency latency;
+	latency.frame_id                   = frame.frame_id;
+	latency.input_to_submit_ms         = to_ms(frame.submit_time - frame.input_time);
+	latency.input_to_complete_ms       = to_ms(time - frame.input_time);
+	latency.measured_with_present_wait = frame.present_id != 0;
+
+	completed_frames_.push_back(latency);
+	last_latency_ = latency;
+
+	pending_frames_.pop_front();
+}
+}        // namespace xihe::rendering
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <optional>
+
+#include "common/vk_common.h"
+
+namespace xihe
+{
+namespace backend
+{
+class Device;
+}
+
+namespace rendering
+{
+/// Latency of one frame, measured from the moment its input was sampled
+struct FrameLatency
+{
+	uint64_t frame_id{0};
+
+	double input_to_submit_ms{0.0};
+
+	// Up to the image being displayed with present wait, up to the end of the frame's GPU work otherwise
+	double input_to_complete_ms{0.0};
+
+	bool measured_with_present_wait{false};
+};
+
+/**
+ * \brief Keeps the CPU from queuing frames too far ahead of the display, so the input of a frame is sampled as late
+ *        as possible, and measures the latency of each frame from input to display.
+ *
+ *        The completion of a frame is observed with VK_KHR_present_wait where it is enabled and with the graphics
+ *        timeline semaphore otherwise. Completion times are taken when the CPU observes them, which is exact while
+ *        wait_before_input blocks and at most a frame late when they are polled.
+ */
+class FramePacer
+{
+  public:
+	FramePacer(backend::Device &device, vk::Semaphore graphics_semaphore);
+
+	/// Requires the presentId and presentWait features, present ids are only attached to presents while enabled
+	void set_present_wait_enabled(bool enabled);
+
+	bool is_present_wait_enabled() const;
+
+	/**
+	 * \brief Frames that may still be waiting for the display when the input of the next frame is sampled
+	 * \param count 0 disables the wait, the CPU is then only limited by the frames in flight
+	 */
+	void set_max_queued_frames(uint32_t count);
+
+	uint32_t get_max_queued_frames() const;
+
+	/// Blocks until at most the max queued frames are pending, the input of the next frame is sampled right after
+	void wait_before_input();
+
+	/// Collects the frames completed since the last frame, the input time defaults to now if it was not waited for
+	void begin_frame();
+
+	/**
+	 * \brief Tracks the frame until it completes
+	 * \param timeline_value Value of the graphics timeline signaled by the last submission of the frame
+	 * \return Present id to chain to the present of the frame, 0 if present wait is disabled
+	 */
+	uint64_t end_frame(vk::SwapchainKHR swapchain, uint64_t timeline_value);
+
+	/// Present ids are per swapchain, the pending frames of the old one are only tracked through the timeline
+	void on_swapchain_recreated();
+
+	/// Frames that completed during the last frame, oldest first
+	const std::vector<FrameLatency> &get_completed_frames() const;
+
+	std::optional<FrameLatency> get_last_latency() const;
+
+  private:
+	using Clock = std::chrono::steady_clock;
+
+	struct PendingFrame
+	{
+		uint64_t          frame_id{0};
+		uint64_t          present_id{0};
+		uint64_t          timeline_value{0};
+		vk::SwapchainKHR  swapchain;
+		Clock::time_point input_time;
+		Clock::time_point submit_time;
+	};
+
+	/// Waits up to the timeout for the frame to complete, 0 polls. Falls back to the timeline if the present failed
+	bool wait_for(PendingFrame &frame, uint64_t timeout_ns) const;
+
+	void complete_front(Clock::time_point time);
+
+	backend::Device &device_;
+
+	vk::Semaphore graphics_semaphore_;
+
+	bool present_wait_enabled_{false};
+
+	uint32_t max_queued_frames_{1};
+
+	uint64_t next_frame_id_{0};
+	uint64_t next_present_id_{1};
+
+	std::optional<Clock::time_point> input_time_;
+
+	std::deque<PendingFrame> pending_frames_;
+
+	std::vector<FrameLatency> completed_frames_;
+
+	std::optional<FrameLatency> last_latency_;
+};
+}        // namespace rendering
+}        // namespace xihe
@@ -0,0 +1,194 @@
+#include "gpu_profiler.h"
+
+#include <algorithm>
+
+#include "backend/command_buffer.h"
+#include "backend/command_pool.h"
+#include "backend/device.h"
+#include "common/logging.h"
+#include "common/trace.h"
+
+namespace xihe::rendering
+{
+GpuProfiler::GpuProfiler(backend::Device &device, uint32_t max_scope_count) :
+    device_{device}, max_scope_count_{max_scope_count}
+{
+	const auto &gpu = device.get_gpu();
+
+	auto features = gpu.get_handle().getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceHostQueryResetFeatures>();
+	if (!features.get<vk::PhysicalDeviceHostQueryResetFeatures>().hostQueryReset)
+	{
+		LOGW("hostQueryReset is not supported, GPU timings are disabled");
+		return;
+	}
+
+	const auto &limits = gpu.get_properties().limits;
+
+	uint32_t graphics_valid_bits = device.get_suitable_graphics_queue().get_properties().timestampValidBits;
+	uint32_t compute_valid_bits  = device.get_queue(device.get_queue_family_index(vk::QueueFlagBits::eCompute), 0).get_properties().timestampValidBits;
+	if (graphics_valid_bits == 0 || (compute_valid_bits == 0 && !limits.timestampComputeAndGraphics))
+	{
+		LOGW("Timestamps are not supported on the graphics and compute queues, GPU timings are disabled");
+		return;
+	}
+
+	timestamp_period_ = limits.timestampPeriod;
+
+	vk::QueryPoolCreateInfo timestamp_info{{}, vk::QueryType::eTimestamp, max_scope_count_ * 2};
+	timestamp_pool_ = std::make_unique<backend::QueryPool>(device, timestamp_info);
+	timestamp_pool_->host_reset(0, max_scope_count_ * 2);
+
+	if (gpu.get_features().pipelineStatisticsQuery)
+	{
+		vk::QueryPoolCreateInfo statistics_info{{}, vk::QueryType::ePipelineStatistics, max_scope_count_, kPipelineStatistics};
+		pipeline_statistics_pool_ = std::make_unique<backend::QueryPool>(device, statistics_info);
+		pipeline_statistics_pool_->host_reset(0, max_scope_count_);
+	}
+}
+
+void GpuProfiler::resolve()
+{
+	// A frame that recorded nothing, e.g. after a failed acquire, keeps the previous results
+	if (scopes_.empty())
+	{
+		return;
+	}
+
+	const auto scope_count = static_cast<uint32_t>(scopes_.size());
+
+	// Every query is followed by its availability, scopes that were never submitted are skipped
+	std::vector<uint64_t> timestamps(scope_count * 2 * 2);
+	timestamp_pool_->get_results(0, scope_count * 2, timestamps.size() * sizeof(uint64_t), timestamps.data(), 2 * sizeof(uint64_t),
+	                             vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWithAvailability);
+
+	constexpr uint32_t    statistics_stride = kPipelineStatisticCount + 1;
+	std::vector<uint64_t> statistics;
+	if (pipeline_statistics_pool_)
+	{
+		statistics.resize(scope_count * statistics_stride);
+		pipeline_statistics_pool_->get_results(0, scope_count, statistics.size() * sizeof(uint64_t), statistics.data(), statistics_stride * sizeof(uint64_t),
+		                                       vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWithAvailability);
+	}
+
+	results_.clear();
+
+	for (uint32_t i = 0; i < scope_count; ++i)
+	{
+		const uint64_t begin = timestamps[i * 4];
+		const uint64_t end   = timestamps[i * 4 + 2];
+		if (timestamps[i * 4 + 1] == 0 || timestamps[i * 4 + 3] == 0)
+		{
+			continue;
+		}
+
+		GpuScopeTiming timing;
+		timing.name               = scopes_[i].name;
+		timing.depth              = scopes_[i].depth;
+		timing.queue_family_index = scopes_[i].queue_family_index;
+		timing.gpu_ms = end > begin ? static_cast<double>(end - begin) * timestamp_period_ / 1e6 : 0.0;
+
+		if (scopes_[i].has_pipeline_statistics && statistics[i * statistics_stride + kPipelineStatisticCount] != 0)
+		{
+			auto first = statistics.begin() + i * statistics_stride;
+			timing.pipeline_statistics.assign(first, first + kPipelineStatisticCount);
+		}
+
+		results_.push_back(std::move(timing));
+	}
+
+#ifndef XIHE_DISABLE_TRACE
+	push_trace_zones(timestamps);
+#endif
+
+	timestamp_pool_->host_reset(0, scope_count * 2);
+	if (pipeline_statistics_pool_)
+	{
+		pipeline_statistics_pool_->host_reset(0, scope_count);
+	}
+
+	scopes_.clear();
+}
+
+uint32_t GpuProfiler::begin_scope(backend::CommandBuffer &command_buffer, const std::string &name, uint32_t depth, bool pipeline_statistics)
+{
+	if (!is_supported() || scopes_.size() >= max_scope_count_)
+	{
+		return kInvalidScope;
+	}
+
+	const auto scope = static_cast<uint32_t>(scopes_.size());
+	if (scope == 0)
+	{
+		trace_anchor_ns_ = trace::now();
+	}
+
+	pipeline_statistics = pipeline_statistics && pipeline_statistics_pool_;
+	scopes_.push_back({name, depth, command_buffer.get_command_pool().get_queue_family_index(), pipeline_statistics});
+
+	command_buffer.write_timestamp(vk::PipelineStageFlagBits2::eTopOfPipe, *timestamp_pool_, scope * 2);
+
+	if (pipeline_statistics)
+	{
+		command_buffer.begin_query(*pipeline_statistics_pool_, scope, {});
+	}
+
+	return scope;
+}
+
+void GpuProfiler::end_scope(backend::CommandBuffer &command_buffer, uint32_t scope)
+{
+	if (scope == kInvalidScope)
+	{
+		return;
+	}
+
+	if (scopes_[scope].has_pipeline_statistics)
+	{
+		command_buffer.end_query(*pipeline_statistics_pool_, scope);
+	}
+
+	command_buffer.write_timestamp(vk::PipelineStageFlagBits2::eBottomOfPipe, *timestamp_pool_, scope * 2 + 1);
+}
+
+void GpuProfiler::push_trace_zones(const std::vector<uint64_t> &timestamps) const
+{
+	// Without calibrated timestamps the GPU clock cannot be mapped to the CPU one, so the frame is placed at the time
+	// its first scope was recorded. Zones within the frame are exact, their offset to the CPU zones is approximate.
+	uint64_t first_timestamp = ~0ULL;
+	for (size_t i = 0; i < scopes_.size(); ++i)
+	{
+		if (timestamps[i * 4 + 1] != 0 && timestamps[i * 4 + 3] != 0)
+		{
+			first_timestamp = std::min(first_timestamp, timestamps[i * 4]);
+		}
+	}
+
+	const uint32_t graphics_family = device_.get_suitable_graphics_queue().get_family_index();
+
+	for (size_t i = 0; i < scopes_.size(); ++i)
+	{
+		const uint64_t begin = timestamps[i * 4];
+		const uint64_t end   = timestamps[i * 4 + 2];
+		if (timestamps[i * 4 + 1] == 0 || timestamps[i * 4 + 3] == 0 || end < begin)
+		{
+			continue;
+		}
+
+		auto &track = trace::get_track_buffer(scopes_[i].queue_family_index == graphics_family ? "GPU graphics" : "GPU async compute");
+
+		const auto begin_ns = trace_anchor_ns_ + static_cast<uint64_t>(static_cast<double>(begin - first_timestamp) * timestamp_period_);
+		const auto end_ns   = trace_anchor_ns_ + static_cast<uint64_t>(static_cast<double>(end - first_timestamp) * timestamp_period_);
+		track.push(scopes_[i].name, begin_ns, end_ns);
+	}
+}
+
+bool GpuProfiler::is_supported() const
+{
+	return timestamp_pool_ != nullptr;
+}
+
+const std::vector<GpuScopeTiming> &GpuProfiler::get_results() const
+{
+	return results_;
+}
+}        // namespace xihe::rendering
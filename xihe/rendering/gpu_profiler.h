@@ -0,0 +1,105 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "backend/query_pool.h"
+
+namespace xihe
+{
+namespace backend
+{
+class CommandBuffer;
+class Device;
+}        // namespace backend
+
+namespace rendering
+{
+struct GpuScopeTiming
+{
+	std::string name;
+
+	uint32_t depth{0};        // 0 for submitted batches, 1 for the passes recorded in them
+
+	uint32_t queue_family_index{0};
+
+	double gpu_ms{0.0};
+
+	/// Only set for scopes recorded with pipeline statistics, in the order of GpuProfiler::kPipelineStatistics
+	std::vector<uint64_t> pipeline_statistics;
+};
+
+/**
+ * \brief Brackets scopes of a frame with timestamp and pipeline statistics queries.
+ *        Each RenderFrame owns one, and its results are read when the frame is reused,
+ *        after its fence was waited for, so reading them never stalls.
+ */
+class GpuProfiler
+{
+  public:
+	static constexpr vk::QueryPipelineStatisticFlags kPipelineStatistics = vk::QueryPipelineStatisticFlagBits::eInputAssemblyVertices |
+	                                                                       vk::QueryPipelineStatisticFlagBits::eVertexShaderInvocations |
+	                                                                       vk::QueryPipelineStatisticFlagBits::eClippingPrimitives |
+	                                                                       vk::QueryPipelineStatisticFlagBits::eFragmentShaderInvocations |
+	                                                                       vk::QueryPipelineStatisticFlagBits::eComputeShaderInvocations;
+
+	static constexpr uint32_t kPipelineStatisticCount = 5;
+
+	static constexpr uint32_t kInvalidScope = ~0U;
+
+	explicit GpuProfiler(backend::Device &device, uint32_t max_scope_count = 128);
+
+	GpuProfiler(const GpuProfiler &)            = delete;
+	GpuProfiler &operator=(const GpuProfiler &) = delete;
+
+	/**
+	 * \brief Reads the scopes recorded the last time this frame was used and resets their queries.
+	 *        Must only be called once the GPU is done with the frame.
+	 */
+	void resolve();
+
+	/**
+	 * \param pipeline_statistics Also count pipeline statistics, only valid in command buffers of a graphics queue
+	 * \return The scope to pass to end_scope, kInvalidScope if queries are not supported or all scopes are used
+	 */
+	uint32_t begin_scope(backend::CommandBuffer &command_buffer, const std::string &name, uint32_t depth, bool pipeline_statistics = false);
+
+	void end_scope(backend::CommandBuffer &command_buffer, uint32_t scope);
+
+	bool is_supported() const;
+
+	/// Scopes of the last resolved frame, in the order they were begun
+	const std::vector<GpuScopeTiming> &get_results() const;
+
+  private:
+	struct Scope
+	{
+		std::string name;
+		uint32_t    depth;
+		uint32_t    queue_family_index;
+		bool        has_pipeline_statistics;
+	};
+
+	void push_trace_zones(const std::vector<uint64_t> &timestamps) const;
+
+	backend::Device &device_;
+
+	uint32_t max_scope_count_;
+
+	// Nanoseconds per timestamp tick
+	double timestamp_period_{1.0};
+
+	std::unique_ptr<backend::QueryPool> timestamp_pool_;
+
+	std::unique_ptr<backend::QueryPool> pipeline_statistics_pool_;
+
+	std::vector<Scope> scopes_;
+
+	// CPU time of the first scope of the frame, where the GPU zones of the frame are placed in the trace
+	uint64_t trace_anchor_ns_{0};
+
+	std::vector<GpuScopeTiming> results_;
+};
+}        // namespace rendering
+}        // namespace xihe
@@ -0,0 +1,609 @@
+#include "ibl_baker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string_view>
+
+#include <ktx.h>
+#include <ktxvulkan.h>
+
+#include "backend/device.h"
+#include "common/logging.h"
+#include "platform/filesystem.h"
+#include "scene_graph/components/image.h"
+#include "scene_graph/components/texture.h"
+
+namespace xihe::rendering
+{
+namespace
+{
+// Bumped when the shaders change, so stale cache entries are baked again
+constexpr uint32_t kCacheVersion = 1;
+
+constexpr std::array kOutputNames{"irradiance", "prefiltered", "brdf_lut"};
+
+constexpr std::array kOutputDefines{"IRRADIANCE", "PREFILTERED", "BRDF_LUT"};
+
+constexpr std::array kOutputFormats{vk::Format::eR32G32B32A32Sfloat, vk::Format::eR16G16B16A16Sfloat, vk::Format::eR16G16Sfloat};
+
+// Matches the push constants of preprocess/ibl_bake.comp
+struct BakeRegisters
+{
+	uint32_t size;
+	uint32_t sample_count;
+	uint32_t batch;
+	uint32_t batch_count;
+	float    roughness;
+	float    environment_size;
+};
+
+uint32_t get_format_size(vk::Format format)
+{
+	switch (format)
+	{
+		case vk::Format::eR32G32B32A32Sfloat:
+			return 16;
+		case vk::Format::eR16G16B16A16Sfloat:
+			return 8;
+		case vk::Format::eR16G16Sfloat:
+			return 4;
+		default:
+			throw std::runtime_error("Unsupported format");
+	}
+}
+
+uint32_t get_full_mip_count(uint32_t size)
+{
+	return static_cast<uint32_t>(std::floor(std::log2(size))) + 1;
+}
+}        // namespace
+
+IblBaker::IblBaker(backend::Device &device, sg::Texture &environment_cube, const std::string &environment_file, const IblBakeSettings &settings) :
+    device_{device}, environment_cube_{environment_cube}, settings_{settings}
+{
+	// Storing to two channel formats needs the extended formats
+	compute_supported_ = device_.get_gpu().get_requested_features().shaderStorageImageExtendedFormats;
+	for (auto format : kOutputFormats)
+	{
+		compute_supported_ = compute_supported_ &&
+		                     static_cast<bool>(device_.get_gpu().get_format_properties(format).optimalTilingFeatures & vk::FormatFeatureFlagBits::eStorageImage);
+	}
+
+	create_output(kIrradiance, settings_.irradiance_size, kOutputFormats[kIrradiance], get_full_mip_count(settings_.irradiance_size), 6);
+	create_output(kPrefiltered, settings_.prefiltered_size, kOutputFormats[kPrefiltered], get_full_mip_count(settings_.prefiltered_size), 6);
+	create_output(kBrdfLut, settings_.brdf_lut_size, kOutputFormats[kBrdfLut], 1, 1);
+
+	// The cubes are keyed on the content of the environment, the LUT does not depend on it and is shared
+	const auto data             = fs::read_asset(environment_file);
+	const auto environment_hash = std::hash<std::string_view>{}(std::string_view{reinterpret_cast<const char *>(data.data()), data.size()});
+
+	const std::array keys{
+	    fmt::format("{}_{:016x}_{}_{}", kCacheVersion, environment_hash, settings_.irradiance_size, settings_.irradiance_samples),
+	    fmt::format("{}_{:016x}_{}_{}", kCacheVersion, environment_hash, settings_.prefiltered_size, settings_.prefilter_samples),
+	    fmt::format("{}_{}_{}", kCacheVersion, settings_.brdf_lut_size, settings_.brdf_lut_samples)};
+
+	for (uint32_t output = 0; output < kOutputCount; ++output)
+	{
+		cache_paths_[output] = fs::path::get(fs::path::Type::kCache, fmt::format("ibl_{}_{:016x}.ktx2", kOutputNames[output], std::hash<std::string>{}(keys[output])));
+		shader_variants_[output].add_define(kOutputDefines[output]);
+	}
+}
+
+IblBaker::~IblBaker() = default;
+
+bool IblBaker::load_cache()
+{
+	std::vector<backend::Buffer> staging_buffers;
+
+	auto &command_buffer = device_.request_command_buffer();
+	command_buffer.begin(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+
+	for (uint32_t output = 0; output < kOutputCount; ++output)
+	{
+		auto &texture = outputs_[output];
+
+		{
+			common::ImageMemoryBarrier memory_barrier{};
+			memory_barrier.old_layout      = vk::ImageLayout::eUndefined;
+			memory_barrier.new_layout      = vk::ImageLayout::eTransferDstOptimal;
+			memory_barrier.dst_access_mask = vk::AccessFlagBits2::eTransferWrite;
+			memory_barrier.src_stage_mask  = vk::PipelineStageFlagBits2::eHost;
+			memory_barrier.dst_stage_mask  = vk::PipelineStageFlagBits2::eTransfer;
+			command_buffer.image_memory_barrier(*texture.image_view, memory_barrier);
+		}
+
+		resident_[output] = load_output(static_cast<Output>(output), command_buffer, staging_buffers);
+		if (!resident_[output])
+		{
+			// Sampled as black until baked
+			command_buffer.get_handle().clearColorImage(texture.image->get_handle(), vk::ImageLayout::eTransferDstOptimal, vk::ClearColorValue{}, texture.image_view->get_subresource_range());
+		}
+
+		{
+			common::ImageMemoryBarrier memory_barrier{};
+			memory_barrier.old_layout      = vk::ImageLayout::eTransferDstOptimal;
+			memory_barrier.new_layout      = vk::ImageLayout::eShaderReadOnlyOptimal;
+			memory_barrier.src_access_mask = vk::AccessFlagBits2::eTransferWrite;
+			memory_barrier.dst_access_mask = vk::AccessFlagBits2::eShaderRead;
+			memory_barrier.src_stage_mask  = vk::PipelineStageFlagBits2::eTransfer;
+			memory_barrier.dst_stage_mask  = vk::PipelineStageFlagBits2::eFragmentShader | vk::PipelineStageFlagBits2::eComputeShader;
+			command_buffer.image_memory_barrier(*texture.image_view, memory_barrier);
+		}
+	}
+
+	command_buffer.end();
+
+	const auto &queue = device_.get_queue_by_flags(vk::QueueFlagBits::eGraphics, 0);
+	queue.submit(command_buffer, device_.request_fence());
+
+	device_.get_fence_pool().wait();
+	device_.get_fence_pool().reset();
+	device_.get_command_pool().reset_pool();
+
+	complete_ = std::ranges::all_of(resident_, [](bool resident) { return resident; });
+
+	if (complete_)
+	{
+		LOGI("Loaded IBL from cache");
+	}
+
+	return complete_;
+}
+
+bool IblBaker::is_compute_supported() const
+{
+	return compute_supported_;
+}
+
+bool IblBaker::is_complete() const
+{
+	return complete_;
+}
+
+void IblBaker::record(backend::CommandBuffer &command_buffer, RenderFrame &active_frame, const backend::ShaderSource &shader_source)
+{
+	assert(compute_supported_ && "The device cannot store to the IBL formats");
+
+	// Nothing is left to record while the read backs of the baked outputs are in flight
+	if (complete_ || pending_cache_writes_ > 0)
+	{
+		return;
+	}
+
+	if (steps_.empty())
+	{
+		plan_bake();
+	}
+
+	std::array<bool, kOutputCount> baking{};
+	for (const auto &unit : units_)
+	{
+		baking[unit.output] = true;
+	}
+
+	// Waits for the passes that sampled the outputs since the previous dispatches
+	for (uint32_t output = 0; output < kOutputCount; ++output)
+	{
+		if (baking[output])
+		{
+			common::ImageMemoryBarrier memory_barrier{};
+			memory_barrier.old_layout      = vk::ImageLayout::eShaderReadOnlyOptimal;
+			memory_barrier.new_layout      = vk::ImageLayout::eGeneral;
+			memory_barrier.src_access_mask = vk::AccessFlagBits2::eShaderRead;
+			memory_barrier.dst_access_mask = vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite;
+			memory_barrier.src_stage_mask  = vk::PipelineStageFlagBits2::eFragmentShader | vk::PipelineStageFlagBits2::eComputeShader;
+			memory_barrier.dst_stage_mask  = vk::PipelineStageFlagBits2::eComputeShader;
+			command_buffer.image_memory_barrier(*outputs_[output].image_view, memory_barrier);
+		}
+	}
+
+	const auto end_step = std::min(next_step_ + settings_.steps_per_frame, steps_.size());
+	for (; next_step_ < end_step; ++next_step_)
+	{
+		record_step(command_buffer, steps_[next_step_], shader_source);
+	}
+
+	for (uint32_t output = 0; output < kOutputCount; ++output)
+	{
+		if (baking[output])
+		{
+			common::ImageMemoryBarrier memory_barrier{};
+			memory_barrier.old_layout      = vk::ImageLayout::eGeneral;
+			memory_barrier.new_layout      = vk::ImageLayout::eShaderReadOnlyOptimal;
+			memory_barrier.src_access_mask = vk::AccessFlagBits2::eShaderStorageWrite;
+			memory_barrier.dst_access_mask = vk::AccessFlagBits2::eShaderRead;
+			memory_barrier.src_stage_mask  = vk::PipelineStageFlagBits2::eComputeShader;
+			memory_barrier.dst_stage_mask  = vk::PipelineStageFlagBits2::eFragmentShader | vk::PipelineStageFlagBits2::eComputeShader;
+			command_buffer.image_memory_barrier(*outputs_[output].image_view, memory_barrier);
+		}
+	}
+
+	if (next_step_ == steps_.size())
+	{
+		// The outputs are written to the cache once the frame is reused, without waiting for the GPU
+		for (uint32_t output = 0; output < kOutputCount; ++output)
+		{
+			if (baking[output])
+			{
+				resident_[output] = true;
+				++pending_cache_writes_;
+
+				active_frame.get_read_back_manager().read_back(
+				    command_buffer, *outputs_[output].image_view, vk::ImageLayout::eShaderReadOnlyOptimal,
+				    vk::PipelineStageFlagBits2::eFragmentShader | vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderRead,
+				    [this, output](const uint8_t *data, vk::DeviceSize size) {
+					    write_cache_entry(static_cast<Output>(output), data);
+					    complete_ = --pending_cache_writes_ == 0;
+
+					    // The read backs run once the frame retired, the last dispatches no longer use the storage views
+					    if (complete_)
+					    {
+						    units_.clear();
+					    }
+				    });
+			}
+		}
+
+		LOGI("Baked IBL in {} steps", steps_.size());
+	}
+}
+
+void IblBaker::write_cache()
+{
+	std::array<vk::DeviceSize, kOutputCount> offsets{};
+	vk::DeviceSize                           total_size = 0;
+	for (uint32_t output = 0; output < kOutputCount; ++output)
+	{
+		offsets[output] = total_size;
+		total_size += get_output_size(static_cast<Output>(output));
+	}
+
+	backend::BufferBuilder builder{total_size};
+	builder.with_usage(vk::BufferUsageFlagBits::eTransferDst)
+	    .with_vma_usage(VMA_MEMORY_USAGE_GPU_TO_CPU)
+	    .with_memory_category(backend::allocated::MemoryCategory::kStaging)
+	    .with_debug_name("IBL read back");
+	auto read_back_buffer = builder.build(device_);
+
+	auto &command_buffer = device_.request_command_buffer();
+	command_buffer.begin(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+
+	for (uint32_t output = 0; output < kOutputCount; ++output)
+	{
+		const auto &texture = outputs_[output];
+		const auto  range   = texture.image_view->get_subresource_range();
+
+		// Packed like the read backs of ReadBackManager, level by level with the faces of a level next to each other
+		std::vector<vk::BufferImageCopy> regions;
+		vk::DeviceSize                   offset = offsets[output];
+		for (uint32_t level = 0; level < range.levelCount; ++level)
+		{
+			const auto size = std::max(texture.image->get_extent().width >> level, 1u);
+
+			vk::BufferImageCopy copy_region{};
+			copy_region.bufferOffset     = offset;
+			copy_region.imageSubresource = {vk::ImageAspectFlagBits::eColor, level, 0, range.layerCount};
+			copy_region.imageExtent      = vk::Extent3D{size, size, 1};
+			regions.push_back(copy_region);
+
+			offset += get_format_size(texture.image->get_format()) * size * size * range.layerCount;
+		}
+
+		{
+			common::ImageMemoryBarrier memory_barrier{};
+			memory_barrier.old_layout      = vk::ImageLayout::eShaderReadOnlyOptimal;
+			memory_barrier.new_layout      = vk::ImageLayout::eTransferSrcOptimal;
+			memory_barrier.src_access_mask = vk::AccessFlagBits2::eShaderRead;
+			memory_barrier.dst_access_mask = vk::AccessFlagBits2::eTransferRead;
+			memory_barrier.src_stage_mask  = vk::PipelineStageFlagBits2::eFragmentShader | vk::PipelineStageFlagBits2::eComputeShader;
+			memory_barrier.dst_stage_mask  = vk::PipelineStageFlagBits2::eTransfer;
+			command_buffer.image_memory_barrier(*texture.image_view, memory_barrier);
+		}
+
+		command_buffer.copy_image_to_buffer(*texture.image, vk::ImageLayout::eTransferSrcOptimal, read_back_buffer, regions);
+
+		{
+			common::ImageMemoryBarrier memory_barrier{};
+			memory_barrier.old_layout      = vk::ImageLayout::eTransferSrcOptimal;
+			memory_barrier.new_layout      = vk::ImageLayout::eShaderReadOnlyOptimal;
+			memory_barrier.src_stage_mask  = vk::PipelineStageFlagBits2::eTransfer;
+			memory_barrier.dst_access_mask = vk::AccessFlagBits2::eShaderRead;
+			memory_barrier.dst_stage_mask  = vk::PipelineStageFlagBits2::eFragmentShader | vk::PipelineStageFlagBits2::eComputeShader;
+			command_buffer.image_memory_barrier(*texture.image_view, memory_barrier);
+		}
+	}
+
+	{
+		common::BufferMemoryBarrier memory_barrier{};
+		memory_barrier.src_access_mask = vk::AccessFlagBits2::eTransferWrite;
+		memory_barrier.dst_access_mask = vk::AccessFlagBits2::eHostRead;
+		memory_barrier.src_stage_mask  = vk::PipelineStageFlagBits2::eTransfer;
+		memory_barrier.dst_stage_mask  = vk::PipelineStageFlagBits2::eHost;
+		command_buffer.buffer_memory_barrier(read_back_buffer, 0, total_size, memory_barrier);
+	}
+
+	command_buffer.end();
+
+	const auto &queue = device_.get_queue_by_flags(vk::QueueFlagBits::eGraphics, 0);
+	queue.submit(command_buffer, device_.request_fence());
+
+	device_.get_fence_pool().wait();
+	device_.get_fence_pool().reset();
+	device_.get_command_pool().reset_pool();
+
+	std::vector<uint8_t> data(total_size);
+	read_back_buffer.read_back(data.data(), data.size());
+
+	for (uint32_t output = 0; output < kOutputCount; ++output)
+	{
+		resident_[output] = true;
+		write_cache_entry(static_cast<Output>(output), data.data() + offsets[output]);
+	}
+
+	complete_ = true;
+}
+
+Texture &IblBaker::get_irradiance_cube()
+{
+	return outputs_[kIrradiance];
+}
+
+Texture &IblBaker::get_prefiltered_cube()
+{
+	return outputs_[kPrefiltered];
+}
+
+Texture &IblBaker::get_brdf_lut()
+{
+	return outputs_[kBrdfLut];
+}
+
+uint32_t IblBaker::get_prefiltered_mip_count() const
+{
+	return outputs_[kPrefiltered].image_view->get_subresource_range().levelCount;
+}
+
+void IblBaker::create_output(Output output, uint32_t size, vk::Format format, uint32_t mip_count, uint32_t layers)
+{
+	auto usage = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eTransferSrc;
+	if (compute_supported_)
+	{
+		usage |= vk::ImageUsageFlagBits::eStorage;
+	}
+
+	backend::ImageBuilder image_builder(size, size);
+	image_builder.with_format(format)
+	    .with_usage(usage)
+	    .with_array_layers(layers)
+	    .with_mip_levels(mip_count)
+	    .with_vma_usage(VMA_MEMORY_USAGE_GPU_ONLY)
+	    .with_memory_category(backend::allocated::MemoryCategory::kTexture);
+	if (layers == 6)
+	{
+		image_builder.with_flags(vk::ImageCreateFlagBits::eCubeCompatible);
+	}
+
+	auto &texture = outputs_[output];
+	texture.image = image_builder.build_unique(device_);
+	texture.image->set_debug_name(fmt::format("IBL {}", kOutputNames[output]));
+	texture.image_view = std::make_unique<backend::ImageView>(*texture.image, layers == 6 ? vk::ImageViewType::eCube : vk::ImageViewType::e2D);
+
+	vk::SamplerCreateInfo sampler_info;
+	sampler_info.magFilter     = vk::Filter::eLinear;
+	sampler_info.minFilter     = vk::Filter::eLinear;
+	sampler_info.mipmapMode    = vk::SamplerMipmapMode::eLinear;
+	sampler_info.addressModeU  = vk::SamplerAddressMode::eClampToEdge;
+	sampler_info.addressModeV  = vk::SamplerAddressMode::eClampToEdge;
+	sampler_info.addressModeW  = vk::SamplerAddressMode::eClampToEdge;
+	sampler_info.minLod        = 0.0f;
+	sampler_info.maxLod        = static_cast<float>(mip_count);
+	sampler_info.maxAnisotropy = 1.0f;
+	sampler_info.borderColor   = vk::BorderColor::eFloatOpaqueWhite;
+	texture.sampler            = std::make_unique<backend::Sampler>(device_, sampler_info);
+}
+
+bool IblBaker::load_output(Output output, backend::CommandBuffer &command_buffer, std::vector<backend::Buffer> &staging_buffers)
+{
+	const auto &cache_path = cache_paths_[output];
+
+	std::error_code error;
+	if (!std::filesystem::exists(cache_path, error))
+	{
+		return false;
+	}
+
+	ktxTexture *texture;
+	if (ktxTexture_CreateFromNamedFile(cache_path.string().c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &texture) != KTX_SUCCESS)
+	{
+		LOGW("Ignoring unreadable IBL cache entry {}", cache_path.string());
+		return false;
+	}
+
+	const auto &image = *outputs_[output].image;
+	const auto  range = outputs_[output].image_view->get_subresource_range();
+
+	const bool matches = texture->classId == ktxTexture2_c &&
+	                     reinterpret_cast<ktxTexture2 *>(texture)->vkFormat == static_cast<uint32_t>(image.get_format()) &&
+	                     texture->baseWidth == image.get_extent().width && texture->numLevels == range.levelCount &&
+	                     texture->numFaces == range.layerCount;
+	if (!matches)
+	{
+		LOGW("Ignoring IBL cache entry {} written with other settings", cache_path.string());
+		ktxTexture_Destroy(texture);
+		return false;
+	}
+
+	std::vector<vk::BufferImageCopy> buffer_copy_regions;
+	for (uint32_t level = 0; level < range.levelCount; ++level)
+	{
+		const auto size = std::max(image.get_extent().width >> level, 1u);
+		for (uint32_t face = 0; face < range.layerCount; ++face)
+		{
+			ktx_size_t offset = 0;
+			ktxTexture_GetImageOffset(texture, level, 0, face, &offset);
+
+			vk::BufferImageCopy copy_region{};
+			copy_region.bufferOffset     = offset;
+			copy_region.imageSubresource = {vk::ImageAspectFlagBits::eColor, level, face, 1};
+			copy_region.imageExtent      = vk::Extent3D{size, size, 1};
+			buffer_copy_regions.push_back(copy_region);
+		}
+	}
+
+	staging_buffers.push_back(backend::Buffer::create_staging_buffer(device_, ktxTexture_GetDataSize(texture), ktxTexture_GetData(texture)));
+	command_buffer.copy_buffer_to_image(staging_buffers.back(), image, buffer_copy_regions);
+
+	ktxTexture_Destroy(texture);
+	return true;
+}
+
+uint32_t IblBaker::get_sample_count(Output output) const
+{
+	switch (output)
+	{
+		case kIrradiance:
+			return settings_.irradiance_samples;
+		case kPrefiltered:
+			return settings_.prefilter_samples;
+		default:
+			return settings_.brdf_lut_samples;
+	}
+}
+
+void IblBaker::plan_bake()
+{
+	uint32_t max_batch_count = 0;
+	for (uint32_t output = 0; output < kOutputCount; ++output)
+	{
+		if (resident_[output])
+		{
+			continue;
+		}
+
+		auto      &texture = outputs_[output];
+		const auto range   = texture.image_view->get_subresource_range();
+		for (uint32_t mip = 0; mip < range.levelCount; ++mip)
+		{
+			BakeUnit unit{static_cast<Output>(output), mip};
+			unit.batch_count  = (get_sample_count(unit.output) + settings_.samples_per_step - 1) / settings_.samples_per_step;
+			unit.storage_view = std::make_unique<backend::ImageView>(*texture.image, range.layerCount == 6 ? vk::ImageViewType::e2DArray : vk::ImageViewType::e2D,
+			                                                         vk::Format::eUndefined, mip, 0, 1, range.layerCount);
+
+			max_batch_count = std::max(max_batch_count, unit.batch_count);
+			units_.push_back(std::move(unit));
+		}
+	}
+
+	for (uint32_t batch = 0; batch < max_batch_count; ++batch)
+	{
+		for (uint32_t unit = 0; unit < units_.size(); ++unit)
+		{
+			if (batch < units_[unit].batch_count)
+			{
+				steps_.push_back({unit, batch});
+			}
+		}
+	}
+}
+
+void IblBaker::record_step(backend::CommandBuffer &command_buffer, const BakeStep &step, const backend::ShaderSource &shader_source)
+{
+	const auto &unit    = units_[step.unit];
+	const auto &texture = outputs_[unit.output];
+	const auto  range   = texture.image_view->get_subresource_range();
+	const auto  size    = std::max(texture.image->get_extent().width >> unit.mip, 1u);
+
+	auto &resource_cache  = device_.get_resource_cache();
+	auto &shader_module   = resource_cache.request_shader_module(vk::ShaderStageFlagBits::eCompute, shader_source, shader_variants_[unit.output]);
+	auto &pipeline_layout = resource_cache.request_pipeline_layout({&shader_module});
+	command_buffer.bind_pipeline_layout(pipeline_layout);
+
+	const auto &environment_view = environment_cube_.get_image()->get_vk_image_view();
+	if (unit.output != kBrdfLut)
+	{
+		command_buffer.bind_image(environment_view, environment_cube_.get_sampler()->vk_sampler_, 0, 0, 0);
+	}
+	command_buffer.bind_image(*unit.storage_view, 0, 1, 0);
+
+	BakeRegisters registers{};
+	registers.size             = size;
+	registers.sample_count     = get_sample_count(unit.output);
+	registers.batch            = step.batch;
+	registers.batch_count      = unit.batch_count;
+	registers.roughness        = unit.output == kPrefiltered ? static_cast<float>(unit.mip) / static_cast<float>(range.levelCount - 1) : 0.0f;
+	registers.environment_size = static_cast<float>(environment_view.get_image().get_extent().width);
+	command_buffer.push_constants(registers);
+
+	command_buffer.dispatch((size + 7) / 8, (size + 7) / 8, range.layerCount);
+
+	// The next batch of the level loads the running average this one stored
+	common::ImageMemoryBarrier memory_barrier{};
+	memory_barrier.old_layout      = vk::ImageLayout::eGeneral;
+	memory_barrier.new_layout      = vk::ImageLayout::eGeneral;
+	memory_barrier.src_access_mask = vk::AccessFlagBits2::eShaderStorageWrite;
+	memory_barrier.dst_access_mask = vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite;
+	memory_barrier.src_stage_mask  = vk::PipelineStageFlagBits2::eComputeShader;
+	memory_barrier.dst_stage_mask  = vk::PipelineStageFlagBits2::eComputeShader;
+	command_buffer.image_memory_barrier(*unit.storage_view, memory_barrier);
+}
+
+vk::DeviceSize IblBaker::get_output_size(Output output) const
+{
+	const auto &texture = outputs_[output];
+	const auto  range   = texture.image_view->get_subresource_range();
+
+	vk::DeviceSize size = 0;
+	for (uint32_t level = 0; level < range.levelCount; ++level)
+	{
+		const auto level_size = std::max(texture.image->get_extent().width >> level, 1u);
+		size += get_format_size(texture.image->get_format()) * level_size * level_size * range.layerCount;
+	}
+	return size;
+}
+
+void IblBaker::write_cache_entry(Output output, const uint8_t *data)
+{
+	const auto &texture = outputs_[output];
+	const auto  range   = texture.image_view->get_subresource_range();
+	const auto  extent  = texture.image->get_extent();
+
+	ktxTextureCreateInfo create_info{};
+	create_info.vkFormat        = static_cast<VkFormat>(texture.image->get_format());
+	create_info.baseWidth       = extent.width;
+	create_info.baseHeight      = extent.height;
+	create_info.baseDepth       = 1;
+	create_info.numDimensions   = 2;
+	create_info.numFaces        = range.layerCount;
+	create_info.numLevels       = range.levelCount;
+	create_info.numLayers       = 1;
+	create_info.isArray         = KTX_FALSE;
+	create_info.generateMipmaps = KTX_FALSE;
+
+	ktxTexture2 *ktx_texture = nullptr;
+	if (ktxTexture2_Create(&create_info, KTX_TEXTURE_CREATE_ALLOC_STORAGE, &ktx_texture) != KTX_SUCCESS)
+	{
+		LOGW("Failed to create IBL cache entry {}", cache_paths_[output].string());
+		return;
+	}
+
+	// The faces of a level are consecutive in the read back, as copied from the array layers
+	size_t offset = 0;
+	for (uint32_t level = 0; level < range.levelCount; ++level)
+	{
+		const auto size       = std::max(extent.width >> level, 1u);
+		const auto level_size = get_format_size(texture.image->get_format()) * size * size;
+
+		for (uint32_t face = 0; face < range.layerCount; ++face)
+		{
+			ktxTexture_SetImageFromMemory(reinterpret_cast<ktxTexture *>(ktx_texture), level, 0, face, data + offset, level_size);
+			offset += level_size;
+		}
+	}
+
+	// A run loading the cache at the same time never sees a partial entry
+	fs::write_file_atomic(cache_paths_[output], [ktx_texture](const fs::Path &path) {
+		return ktxTexture_WriteToNamedFile(reinterpret_cast<ktxTexture *>(ktx_texture), path.string().c_str()) == KTX_SUCCESS;
+	});
+	ktxTexture_Destroy(reinterpret_cast<ktxTexture *>(ktx_texture));
+}
+}        // namespace xihe::rendering
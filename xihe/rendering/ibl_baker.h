@@ -0,0 +1,162 @@
+#pragma once
+
+#include <array>
+#include <filesystem>
+
+#include "rendering/passes/render_pass.h"
+
+namespace xihe
+{
+namespace sg
+{
+class Texture;
+}
+
+namespace rendering
+{
+struct IblBakeSettings
+{
+	uint32_t irradiance_size{64};
+	uint32_t prefiltered_size{512};
+	uint32_t brdf_lut_size{512};
+
+	/// Cosine weighted samples per texel of the irradiance cube
+	uint32_t irradiance_samples{256};
+
+	/// GGX samples per texel of the prefiltered cube, each is a filtered lookup so few are needed
+	uint32_t prefilter_samples{64};
+
+	uint32_t brdf_lut_samples{1024};
+
+	/// Samples each texel takes per dispatch, the outputs converge as more dispatches complete
+	uint32_t samples_per_step{16};
+
+	/// Dispatches recorded per frame
+	uint32_t steps_per_frame{8};
+};
+
+/**
+ * \brief Owns the irradiance cube, the prefiltered environment cube and the BRDF LUT of an environment, and keeps
+ *        them in a disk cache keyed by the content of the environment file and the bake settings.
+ *
+ *        Outputs missing from the cache are baked with compute shaders that importance sample the environment and
+ *        read a mip level matching the solid angle of each sample, which needs far fewer samples than point lookups.
+ *        The samples are split in batches, each dispatch adds one to the running average of its texels, so the
+ *        outputs are usable from the first frame and refine over the next ones. Once the last dispatch completed,
+ *        the outputs are read back and written to the cache without stalling the frame.
+ */
+class IblBaker
+{
+  public:
+	IblBaker(backend::Device &device, sg::Texture &environment_cube, const std::string &environment_file, const IblBakeSettings &settings = {});
+
+	~IblBaker();
+
+	IblBaker(const IblBaker &)            = delete;
+	IblBaker &operator=(const IblBaker &) = delete;
+
+	/**
+	 * \brief Uploads the outputs found in the cache, waits for the device
+	 * \return true if nothing is left to bake
+	 */
+	bool load_cache();
+
+	/// The outputs are baked with compute if the device can store to their formats
+	bool is_compute_supported() const;
+
+	/// True once all outputs are resident and written to the cache
+	bool is_complete() const;
+
+	/**
+	 * \brief Records the next dispatches of the bake, called once per frame after load_cache until is_complete returns true.
+	 *        The outputs are left in shader read only layout for the passes sampling them.
+	 * \param shader_source preprocess/ibl_bake.comp, built in one variant per output
+	 */
+	void record(backend::CommandBuffer &command_buffer, RenderFrame &active_frame, const backend::ShaderSource &shader_source);
+
+	/**
+	 * \brief Reads all outputs back and writes them to the cache, waits for the device.
+	 *        Used when the outputs were rendered by other passes instead of baked.
+	 */
+	void write_cache();
+
+	Texture &get_irradiance_cube();
+
+	Texture &get_prefiltered_cube();
+
+	Texture &get_brdf_lut();
+
+	/// Levels of the prefiltered cube, from roughness 0 to 1
+	uint32_t get_prefiltered_mip_count() const;
+
+  private:
+	enum Output
+	{
+		kIrradiance,
+		kPrefiltered,
+		kBrdfLut,
+		kOutputCount
+	};
+
+	/// A dispatch over one level of an output, repeated once per batch of samples
+	struct BakeUnit
+	{
+		Output                              output;
+		uint32_t                            mip{0};
+		uint32_t                            batch_count{0};
+		std::unique_ptr<backend::ImageView> storage_view;
+	};
+
+	struct BakeStep
+	{
+		uint32_t unit{0};
+		uint32_t batch{0};
+	};
+
+	void create_output(Output output, uint32_t size, vk::Format format, uint32_t mip_count, uint32_t layers);
+
+	/// Records the upload of the cache entry of the output if there is a valid one
+	bool load_output(Output output, backend::CommandBuffer &command_buffer, std::vector<backend::Buffer> &staging_buffers);
+
+	uint32_t get_sample_count(Output output) const;
+
+	void plan_bake();
+
+	void record_step(backend::CommandBuffer &command_buffer, const BakeStep &step, const backend::ShaderSource &shader_source);
+
+	/// Bytes of all levels and faces of the output, tightly packed
+	vk::DeviceSize get_output_size(Output output) const;
+
+	/// Writes the levels of the output, packed level by level with the faces of a level next to each other
+	void write_cache_entry(Output output, const uint8_t *data);
+
+	backend::Device &device_;
+
+	sg::Texture &environment_cube_;
+
+	IblBakeSettings settings_;
+
+	bool compute_supported_{false};
+
+	std::array<Texture, kOutputCount> outputs_;
+
+	std::array<std::filesystem::path, kOutputCount> cache_paths_;
+
+	std::array<bool, kOutputCount> resident_{};
+
+	std::vector<BakeUnit> units_;
+
+	// Interleaved across units, so every texel gets a first batch before any gets a second one
+	std::vector<BakeStep> steps_;
+
+	size_t next_step_{0};
+
+	std::array<backend::ShaderVariant, kOutputCount> shader_variants_;
+
+	// Baked outputs whose read back did not reach the cache yet
+	uint32_t pending_cache_writes_{0};
+
+	bool complete_{false};
+};
+}        // namespace rendering
+}        // namespace xihe
@@ -1,5 +1,7 @@
 #include "bloom_pass.h"
 
+#include "rendering/dynamic_resolution.h"
+
 namespace xihe::rendering
 {
 namespace
@@ -34,11 +36,15 @@ void BloomComputePass::execute(backend::CommandBuffer &command_buffer, RenderFra
 	const auto extent     = dst.get_image().get_extent();
 	const auto src_extent = src.get_image().get_extent();
 
+	// Only the rendered sub-rect is processed. The source is scaled like the destination, so normalized
+	// coordinates of the whole destination address the rendered sub-rect of the source.
+	const auto rendered_extent = scale_extent({extent.width, extent.height}, render_scale_);
+
 	command_buffer.bind_image(src, resource_cache.request_sampler(get_linear_sampler()), 0, 0, 0);
 	command_buffer.bind_image(dst, 0, 1, 0);
 
 	CommonUniforms uniforms;
-	uniforms.resolution           = {extent.width, extent.height};
+	uniforms.resolution           = {rendered_extent.width, rendered_extent.height};
 	uniforms.inv_resolution       = {1.0f / static_cast<float>(extent.width), 1.0f / static_cast<float>(extent.height)};
 	uniforms.inv_input_resolution = {1.0f / static_cast<float>(src_extent.width), 1.0f / static_cast<float>(src_extent.height)};
 
@@ -46,7 +52,7 @@ void BloomComputePass::execute(backend::CommandBuffer &command_buffer, RenderFra
 	allocation.update(uniforms);
 	command_buffer.bind_buffer(allocation.get_buffer(), allocation.get_offset(), allocation.get_size(), 0, 2, 0);
 
-	command_buffer.dispatch((extent.width + 7) / 8, (extent.height + 7) / 8, 1);
+	command_buffer.dispatch((rendered_extent.width + 7) / 8, (rendered_extent.height + 7) / 8, 1);
 }
 
 void BloomExtractPass::execute(backend::CommandBuffer &command_buffer, RenderFrame &active_frame, std::vector<ShaderBindable> input_bindables)
@@ -84,7 +90,9 @@ void BloomCompositePass::execute(backend::CommandBuffer &command_buffer, RenderF
 	auto &original = input_bindables[0].image_view();
 	auto &blurred  = input_bindables[1].image_view();
 
+	// The inputs are rendered at the scale of the frame, the composite covers the whole swapchain image
 	CompositePush push;
+	push.uv_scale = glm::vec2{active_frame.get_render_scale()};
 
 	command_buffer.push_constants(push);
 
@@ -97,4 +105,20 @@ void BloomCompositePass::execute(backend::CommandBuffer &command_buffer, RenderF
 
 	command_buffer.draw(3, 1, 0, 0);
 }
+
+bool BloomCompositePass::describe_pipeline_state(backend::ResourceCache &resource_cache, PipelineState &pipeline_state)
+{
+	auto &vert_shader_module = resource_cache.request_shader_module(vk::ShaderStageFlagBits::eVertex, get_vertex_shader());
+	auto &frag_shader_module = resource_cache.request_shader_module(vk::ShaderStageFlagBits::eFragment, get_fragment_shader());
+
+	std::vector<backend::ShaderModule *> shader_modules = {&vert_shader_module, &frag_shader_module};
+
+	pipeline_state.set_pipeline_layout(resource_cache.request_pipeline_layout(shader_modules));
+
+	RasterizationState rasterization_state;
+	rasterization_state.cull_mode = vk::CullModeFlagBits::eNone;
+	pipeline_state.set_rasterization_state(rasterization_state);
+
+	return true;
+}
 }        // namespace xihe::rendering
@@ -21,8 +21,9 @@ struct ExtractPush
 
 struct CompositePush
 {
-	float bloom_strength = 0.3f;
-	float exposure       = 1.0f;
+	float     bloom_strength = 0.3f;
+	float     exposure       = 1.0f;
+	glm::vec2 uv_scale{1.0f};
 };
 
 class BloomComputePass : public RenderPass
@@ -52,11 +53,16 @@ class BloomDownsamplePass : public BloomComputePass
 	float filter_radius_ = 1.0;
 };
 
+/**
+ * \brief Tone maps the lighting with bloom into the swapchain, upscaling it from the sub-rect rendered with dynamic resolution
+ */
 class BloomCompositePass : public RenderPass
 {
   public:
 	BloomCompositePass() = default;
 	void execute(backend::CommandBuffer &command_buffer, RenderFrame &active_frame, std::vector<ShaderBindable> input_bindables) override;
+
+	bool describe_pipeline_state(backend::ResourceCache &resource_cache, PipelineState &pipeline_state) override;
 };
 
 }        // namespace xihe::rendering
\ No newline at end of file
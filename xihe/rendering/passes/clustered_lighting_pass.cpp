@@ -3,6 +3,7 @@
 #include "scene_graph/components/image.h"
 
 #include <algorithm>
+#include <cmath>
 #include <utility>
 
 namespace xihe::rendering
@@ -79,8 +80,12 @@ ClusteredLightingPass::ClusteredLightingPass(std::vector<sg::Light *> lights, sg
 {
 }
 
-void ClusteredLightingPass::generate_lighting_data()
+void ClusteredLightingPass::generate_lighting_data(uint32_t width, uint32_t height, float render_scale)
 {
+	width_  = width;
+	height_ = height;
+	set_render_scale(render_scale);
+
 	collect_and_sort_lights();
 	generate_bins();
 	generate_tiles();
@@ -88,9 +93,8 @@ void ClusteredLightingPass::generate_lighting_data()
 
 void ClusteredLightingPass::execute(backend::CommandBuffer &command_buffer, RenderFrame &active_frame, std::vector<ShaderBindable> input_bindables)
 {
-	width_  = input_bindables[0].image_view().get_image().get_extent().width;
-	height_ = input_bindables[0].image_view().get_image().get_extent().height;
-	generate_lighting_data();
+	const auto &extent = input_bindables[0].image_view().get_image().get_extent();
+	generate_lighting_data(extent.width, extent.height, render_scale_);
 
 	set_lighting_state(kMaxPointLightCount);
 	set_pipeline_state(command_buffer);
@@ -282,6 +286,10 @@ void ClusteredLightingPass::generate_tiles()
 
 	uint32_t tile_stride = num_tiles_x_ * num_words_;
 
+	// Lights are projected onto the rendered sub-rect, the shader indexes the tiles by pixel position within it
+	const float render_width  = std::ceil(static_cast<float>(width_) * render_scale_);
+	const float render_height = std::ceil(static_cast<float>(height_) * render_scale_);
+
 	auto camera_view = camera_.get_view();
 
 	for (size_t sorted_idx = 0; sorted_idx < sorted_lights_.size(); ++sorted_idx)
@@ -323,10 +331,10 @@ void ClusteredLightingPass::generate_tiles()
 		}
 
 		glm::vec4 aabb_screen{
-		    (aabb.x * 0.5f + 0.5f) * (width_ - 1),
-		    (aabb.y * 0.5f + 0.5f) * (height_ - 1),
-		    (aabb.z * 0.5f + 0.5f) * (width_ - 1),
-		    (aabb.w * 0.5f + 0.5f) * (height_ - 1)};
+		    (aabb.x * 0.5f + 0.5f) * (render_width - 1),
+		    (aabb.y * 0.5f + 0.5f) * (render_height - 1),
+		    (aabb.z * 0.5f + 0.5f) * (render_width - 1),
+		    (aabb.w * 0.5f + 0.5f) * (render_height - 1)};
 
 		float width  = aabb_screen.z - aabb_screen.x;
 		float height = aabb_screen.w - aabb_screen.y;
@@ -342,15 +350,15 @@ void ClusteredLightingPass::generate_tiles()
 		float max_x = min_x + width;
 		float max_y = min_y + height;
 
-		if (min_x > width_ || min_y > height_ || max_x < 0 || max_y < 0)
+		if (min_x > render_width || min_y > render_height || max_x < 0 || max_y < 0)
 		{
 			continue;
 		}
 
 		min_x = std::max(min_x, 0.0f);
 		min_y = std::max(min_y, 0.0f);
-		max_x = std::min(max_x, static_cast<float>(width_));
-		max_y = std::min(max_y, static_cast<float>(height_));
+		max_x = std::min(max_x, render_width);
+		max_y = std::min(max_y, render_height);
 
 		uint32_t first_tile_x = static_cast<uint32_t>(min_x * tile_size_inv);
 		uint32_t first_tile_y = static_cast<uint32_t>(min_y * tile_size_inv);
@@ -42,7 +42,11 @@ class ClusteredLightingPass : public LightingPass
 
 	~ClusteredLightingPass() override = default;
 
-	void generate_lighting_data();
+	/**
+	 * \brief Sorts the point lights by depth and bins them into depth slices and screen tiles of the given render extent
+	 * \param render_scale Scale of the sub-rect rendered into, the tile grid still covers the whole extent as the shader expects
+	 */
+	void generate_lighting_data(uint32_t width, uint32_t height, float render_scale = 1.0f);
 
 	void execute(backend::CommandBuffer &command_buffer, RenderFrame &active_frame, std::vector<ShaderBindable> input_bindables) override;
 
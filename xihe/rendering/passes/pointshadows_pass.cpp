@@ -169,6 +169,16 @@ void PointShadowsCullingPass::execute(backend::CommandBuffer &command_buffer, Re
 	command_buffer.dispatch((PointShadowsResources::get().get_point_light_count() + 7) / 8, (gpu_scene_.get_instance_count() + 7) / 8, 1);
 }
 
+bool PointShadowsCullingPass::describe_pipeline_state(backend::ResourceCache &resource_cache, PipelineState &pipeline_state)
+{
+	RenderPass::describe_pipeline_state(resource_cache, pipeline_state);
+
+	pipeline_state.set_specialization_constant(0, to_bytes(to_u32(PointShadowsResources::get().get_point_light_count())));
+	pipeline_state.set_specialization_constant(1, to_bytes(to_u32(gpu_scene_.get_instance_count())));
+
+	return true;
+}
+
 void PointShadowsCommandsGenerationPass::execute(backend::CommandBuffer &command_buffer, RenderFrame &active_frame, std::vector<ShaderBindable> input_bindables)
 {
 	auto &resource_cache     = command_buffer.get_device().get_resource_cache();
@@ -187,6 +197,15 @@ void PointShadowsCommandsGenerationPass::execute(backend::CommandBuffer &command
 	command_buffer.dispatch((PointShadowsResources::get().get_point_light_count() + 31) / 32, 1, 1);
 }
 
+bool PointShadowsCommandsGenerationPass::describe_pipeline_state(backend::ResourceCache &resource_cache, PipelineState &pipeline_state)
+{
+	RenderPass::describe_pipeline_state(resource_cache, pipeline_state);
+
+	pipeline_state.set_specialization_constant(0, to_bytes(PointShadowsResources::get().get_point_light_count()));
+
+	return true;
+}
+
 PointShadowsPass::PointShadowsPass(GpuScene &gpu_scene, std::vector<sg::Light *> lights) :
     gpu_scene_{gpu_scene}
 {
@@ -237,4 +256,32 @@ void PointShadowsPass::execute(backend::CommandBuffer &command_buffer, RenderFra
 
 	command_buffer.set_has_mesh_shader(false);
 }
+
+bool PointShadowsPass::describe_pipeline_state(backend::ResourceCache &resource_cache, PipelineState &pipeline_state)
+{
+	pipeline_state.set_has_mesh_shader(true);
+
+	auto &task_shader_module = resource_cache.request_shader_module(vk::ShaderStageFlagBits::eTaskEXT, get_task_shader());
+	auto &mesh_shader_module = resource_cache.request_shader_module(vk::ShaderStageFlagBits::eMeshEXT, get_mesh_shader());
+
+	std::vector<backend::ShaderModule *> shader_modules{&task_shader_module, &mesh_shader_module};
+
+	pipeline_state.set_pipeline_layout(resource_cache.request_pipeline_layout(shader_modules));
+
+	DepthStencilState depth_stencil_state{};
+	depth_stencil_state.depth_test_enable  = true;
+	depth_stencil_state.depth_write_enable = true;
+
+	pipeline_state.set_depth_stencil_state(depth_stencil_state);
+
+	return true;
+}
+
+PointShadowsClearPass::~PointShadowsClearPass()
+{
+	PointShadowsResources::destroy();
+}
+
+void PointShadowsClearPass::execute(backend::CommandBuffer &command_buffer, RenderFrame &active_frame, std::vector<ShaderBindable> input_bindables)
+{}
 }        // namespace xihe::rendering
@@ -59,6 +59,8 @@ class PointShadowsCullingPass : public RenderPass
 
 	void execute(backend::CommandBuffer &command_buffer, RenderFrame &active_frame, std::vector<ShaderBindable> input_bindables) override;
 
+	bool describe_pipeline_state(backend::ResourceCache &resource_cache, PipelineState &pipeline_state) override;
+
   private:
 	GpuScene &gpu_scene_;
 };
@@ -69,6 +71,8 @@ class PointShadowsCommandsGenerationPass : public RenderPass
 	PointShadowsCommandsGenerationPass() = default;
 
 	void execute(backend::CommandBuffer &command_buffer, RenderFrame &active_frame, std::vector<ShaderBindable> input_bindables) override;
+
+	bool describe_pipeline_state(backend::ResourceCache &resource_cache, PipelineState &pipeline_state) override;
 };
 
 class PointShadowsPass : public RenderPass
@@ -80,7 +84,22 @@ class PointShadowsPass : public RenderPass
 
 	void execute(backend::CommandBuffer &command_buffer, RenderFrame &active_frame, std::vector<ShaderBindable> input_bindables) override;
 
+	bool describe_pipeline_state(backend::ResourceCache &resource_cache, PipelineState &pipeline_state) override;
+
   private:
 	GpuScene &gpu_scene_;
 };
+
+/**
+ * \brief Stands in for PointShadowsPass on devices without mesh shaders. It draws nothing, beginning the rendering clears
+ *        the maps to the far plane, which leaves the point lights unshadowed. Its shaders only make it a raster pass.
+ */
+class PointShadowsClearPass : public RenderPass
+{
+  public:
+	// Stands in for PointShadowsPass, so it releases the resources the app initialized for the point lights
+	~PointShadowsClearPass() override;
+
+	void execute(backend::CommandBuffer &command_buffer, RenderFrame &active_frame, std::vector<ShaderBindable> input_bindables) override;
+};
 }        // namespace xihe::rendering
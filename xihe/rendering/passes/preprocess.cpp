@@ -91,4 +91,13 @@ void BrdfLutPass::execute(backend::CommandBuffer &command_buffer, RenderFrame &a
 
 	command_buffer.draw(3, 1, 0, 0);
 }
+
+IblBakePass::IblBakePass(IblBaker &baker) :
+    baker_{baker}
+{}
+
+void IblBakePass::execute(backend::CommandBuffer &command_buffer, RenderFrame &active_frame, std::vector<ShaderBindable> input_bindables)
+{
+	baker_.record(command_buffer, active_frame, get_compute_shader());
+}
 }        // namespace xihe::rendering
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "render_pass.h"
+#include "rendering/ibl_baker.h"
 #include "scene_graph/components/mesh.h"
 #include "scene_graph/components/texture.h"
 
@@ -41,4 +42,19 @@ class BrdfLutPass : public RenderPass
 	BrdfLutPass() = default;
 	auto execute(backend::CommandBuffer &command_buffer, RenderFrame &active_frame, std::vector<ShaderBindable> input_bindables) -> void override;
 };
+
+/**
+ * \brief Records the next dispatches of an IblBaker each frame. Its outputs are not tracked by the graph,
+ *        the pass is to be added with side_effects() and disabled once the baker is complete.
+ */
+class IblBakePass : public RenderPass
+{
+  public:
+	explicit IblBakePass(IblBaker &baker);
+
+	void execute(backend::CommandBuffer &command_buffer, RenderFrame &active_frame, std::vector<ShaderBindable> input_bindables) override;
+
+  private:
+	IblBaker &baker_;
+};
 }
@@ -113,8 +113,58 @@ const backend::ShaderSource & RenderPass::get_compute_shader() const
 	return compute_shader_.value();
 }
 
+std::vector<const backend::ShaderSource *> RenderPass::get_shader_sources() const
+{
+	std::vector<const backend::ShaderSource *> shader_sources;
+	for (const auto *shader : {&vertex_shader_, &task_shader_, &mesh_shader_, &fragment_shader_, &compute_shader_})
+	{
+		if (shader->has_value())
+		{
+			shader_sources.push_back(&shader->value());
+		}
+	}
+	return shader_sources;
+}
+
+void RenderPass::update_shader_source(const backend::ShaderSource &shader_source)
+{
+	for (auto *shader : {&vertex_shader_, &task_shader_, &mesh_shader_, &fragment_shader_, &compute_shader_})
+	{
+		if (shader->has_value() && shader->value().get_filename() == shader_source.get_filename())
+		{
+			*shader = shader_source;
+		}
+	}
+}
+
 void RenderPass::execute(backend::CommandBuffer &command_buffer, RenderFrame &active_frame, std::vector<ShaderBindable> input_bindables)
 {
 	throw std::runtime_error("RenderPass::execute not implemented");
 }
+
+void RenderPass::end_execute(backend::CommandBuffer &command_buffer, RenderFrame &active_frame)
+{
+}
+
+bool RenderPass::describe_pipeline_state(backend::ResourceCache &resource_cache, PipelineState &pipeline_state)
+{
+	// Only plain compute passes are described by default, raster passes set up state that only they know about
+	if (type_ != PassType::kCompute)
+	{
+		return false;
+	}
+
+	auto &comp_shader_module = resource_cache.request_shader_module(vk::ShaderStageFlagBits::eCompute, get_compute_shader());
+
+	std::vector<backend::ShaderModule *> shader_modules = {&comp_shader_module};
+
+	pipeline_state.set_pipeline_layout(resource_cache.request_pipeline_layout(shader_modules));
+
+	return true;
+}
+
+void RenderPass::set_render_scale(float render_scale)
+{
+	render_scale_ = render_scale;
+}
 }
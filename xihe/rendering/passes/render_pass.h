@@ -1,6 +1,7 @@
 #pragma once
 
 #include "backend/command_buffer.h"
+#include "backend/resources_management/resource_cache.h"
 #include "backend/shader_module.h"
 #include "rendering/render_frame.h"
 #include "rendering/render_graph/render_resource.h"
@@ -40,6 +41,13 @@ class RenderPass
 	const backend::ShaderSource &get_fragment_shader() const;
 	const backend::ShaderSource &get_compute_shader() const;
 
+	std::vector<const backend::ShaderSource *> get_shader_sources() const;
+
+	/**
+	 * \brief Replaces the shader source loaded from the same file, used when a shader is reloaded
+	 */
+	void update_shader_source(const backend::ShaderSource &shader_source);
+
 	/**
 	 * \brief
 	 * \param command_buffer
@@ -48,9 +56,26 @@ class RenderPass
 	 */
 	virtual void execute(backend::CommandBuffer &command_buffer, RenderFrame &active_frame, std::vector<ShaderBindable> input_bindables);
 
+	/**
+	 * \brief Called after execute, once the rendering of a raster pass has ended, for commands that cannot be recorded inside it
+	 */
+	virtual void end_execute(backend::CommandBuffer &command_buffer, RenderFrame &active_frame);
+
+	/**
+	 * \brief Describes the pipeline bound in execute so it can be built before the first frame
+	 * \param pipeline_state Attachment formats and blend attachments are already set for raster passes
+	 * \return false if the pipeline depends on per-draw data (shader variants, bindless) and cannot be prewarmed
+	 */
+	virtual bool describe_pipeline_state(backend::ResourceCache &resource_cache, PipelineState &pipeline_state);
+
+	/// Set before execute, the scale of the sub-rect of its dynamically sized targets the pass renders into, 1 for fixed ones
+	void set_render_scale(float render_scale);
+
   protected:
 	uint32_t thread_index_{0};
 
+	float render_scale_{1.0f};
+
   private:
 	PassType type_{};
 
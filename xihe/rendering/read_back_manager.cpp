@@ -0,0 +1,181 @@
+#include "read_back_manager.h"
+
+#include <bit>
+#include <numeric>
+
+#include "backend/command_buffer.h"
+#include "backend/device.h"
+#include "backend/image_view.h"
+#include "common/trace.h"
+
+namespace xihe::rendering
+{
+ReadBackManager::ReadBackManager(backend::Device &device, vk::DeviceSize block_size) :
+    device_{device}, block_size_{block_size}
+{}
+
+void ReadBackManager::resolve()
+{
+	if (requests_.empty())
+	{
+		return;
+	}
+
+	XIHE_TRACE_ZONE("Resolve read backs");
+
+	for (auto &request : requests_)
+	{
+		data_.resize(request.size);
+		blocks_[request.block].buffer->read_back(data_.data(), request.size, request.offset);
+		request.callback(data_.data(), request.size);
+	}
+	requests_.clear();
+
+	// Blocks created for copies larger than the block size are not kept around
+	std::erase_if(blocks_, [this](const Block &block) { return block.buffer->get_size() > block_size_; });
+
+	for (auto &block : blocks_)
+	{
+		block.used = 0;
+	}
+	current_block_ = 0;
+}
+
+void ReadBackManager::read_back(backend::CommandBuffer &command_buffer, const backend::Buffer &buffer, vk::DeviceSize offset, vk::DeviceSize size,
+                                vk::PipelineStageFlags2 stage_mask, vk::AccessFlags2 access_mask, ReadBackCallback &&callback)
+{
+	assert(size > 0 && offset + size <= buffer.get_size());
+
+	auto request     = allocate(size, 4);
+	request.callback = std::move(callback);
+
+	{
+		common::BufferMemoryBarrier memory_barrier{};
+		memory_barrier.src_access_mask = access_mask;
+		memory_barrier.dst_access_mask = vk::AccessFlagBits2::eTransferRead;
+		memory_barrier.src_stage_mask  = stage_mask;
+		memory_barrier.dst_stage_mask  = vk::PipelineStageFlagBits2::eTransfer;
+		command_buffer.buffer_memory_barrier(buffer, offset, size, memory_barrier);
+	}
+
+	vk::BufferCopy copy_region{offset, request.offset, size};
+	command_buffer.get_handle().copyBuffer(buffer.get_handle(), blocks_[request.block].buffer->get_handle(), copy_region);
+
+	{
+		// Later writes of the buffer must not overtake the copy
+		common::BufferMemoryBarrier memory_barrier{};
+		memory_barrier.src_access_mask = vk::AccessFlagBits2::eNone;
+		memory_barrier.dst_access_mask = vk::AccessFlagBits2::eNone;
+		memory_barrier.src_stage_mask  = vk::PipelineStageFlagBits2::eTransfer;
+		memory_barrier.dst_stage_mask  = stage_mask;
+		command_buffer.buffer_memory_barrier(buffer, offset, size, memory_barrier);
+	}
+
+	add_host_barrier(command_buffer, request);
+	requests_.push_back(std::move(request));
+}
+
+void ReadBackManager::read_back(backend::CommandBuffer &command_buffer, const backend::ImageView &image_view, vk::ImageLayout layout,
+                                vk::PipelineStageFlags2 stage_mask, vk::AccessFlags2 access_mask, ReadBackCallback &&callback)
+{
+	const auto &image        = image_view.get_image();
+	const auto  range        = image_view.get_subresource_range();
+	const auto  format       = image_view.get_format();
+	const auto  block_extent = vk::blockExtent(format);
+	const auto  block_size   = vk::blockSize(format);
+	const auto &extent       = image.get_extent();
+
+	assert(std::has_single_bit(static_cast<uint32_t>(range.aspectMask)) && "Only one aspect can be copied at a time");
+	assert(image.get_usage() & vk::ImageUsageFlagBits::eTransferSrc);
+
+	std::vector<vk::BufferImageCopy> regions;
+	vk::DeviceSize                   size = 0;
+	for (uint32_t level = range.baseMipLevel; level < range.baseMipLevel + range.levelCount; ++level)
+	{
+		const vk::Extent3D level_extent{std::max(extent.width >> level, 1u), std::max(extent.height >> level, 1u), std::max(extent.depth >> level, 1u)};
+
+		regions.emplace_back(size, 0, 0, vk::ImageSubresourceLayers{range.aspectMask, level, range.baseArrayLayer, range.layerCount}, vk::Offset3D{}, level_extent);
+
+		const vk::DeviceSize block_count = static_cast<vk::DeviceSize>((level_extent.width + block_extent[0] - 1) / block_extent[0]) *
+		                                   ((level_extent.height + block_extent[1] - 1) / block_extent[1]) *
+		                                   ((level_extent.depth + block_extent[2] - 1) / block_extent[2]);
+		size += block_count * block_size * range.layerCount;
+	}
+
+	// Buffer offsets of image copies are multiples of both the texel block size and 4
+	auto request     = allocate(size, std::lcm<vk::DeviceSize>(block_size, 4));
+	request.callback = std::move(callback);
+	for (auto &region : regions)
+	{
+		region.bufferOffset += request.offset;
+	}
+
+	{
+		common::ImageMemoryBarrier memory_barrier{};
+		memory_barrier.old_layout      = layout;
+		memory_barrier.new_layout      = vk::ImageLayout::eTransferSrcOptimal;
+		memory_barrier.src_access_mask = access_mask;
+		memory_barrier.dst_access_mask = vk::AccessFlagBits2::eTransferRead;
+		memory_barrier.src_stage_mask  = stage_mask;
+		memory_barrier.dst_stage_mask  = vk::PipelineStageFlagBits2::eTransfer;
+		command_buffer.image_memory_barrier(image_view, memory_barrier);
+	}
+
+	command_buffer.copy_image_to_buffer(image, vk::ImageLayout::eTransferSrcOptimal, *blocks_[request.block].buffer, regions);
+
+	{
+		common::ImageMemoryBarrier memory_barrier{};
+		memory_barrier.old_layout      = vk::ImageLayout::eTransferSrcOptimal;
+		memory_barrier.new_layout      = layout;
+		memory_barrier.src_access_mask = vk::AccessFlagBits2::eNone;
+		memory_barrier.dst_access_mask = access_mask;
+		memory_barrier.src_stage_mask  = vk::PipelineStageFlagBits2::eTransfer;
+		memory_barrier.dst_stage_mask  = stage_mask;
+		command_buffer.image_memory_barrier(image_view, memory_barrier);
+	}
+
+	add_host_barrier(command_buffer, request);
+	requests_.push_back(std::move(request));
+}
+
+size_t ReadBackManager::get_pending_count() const
+{
+	return requests_.size();
+}
+
+ReadBackManager::Request ReadBackManager::allocate(vk::DeviceSize size, vk::DeviceSize alignment)
+{
+	for (; current_block_ < blocks_.size(); ++current_block_)
+	{
+		auto          &block  = blocks_[current_block_];
+		vk::DeviceSize offset = (block.used + alignment - 1) / alignment * alignment;
+		if (offset + size <= block.buffer->get_size())
+		{
+			block.used = offset + size;
+			return {current_block_, offset, size};
+		}
+	}
+
+	backend::BufferBuilder builder{std::max(size, block_size_)};
+	builder.with_usage(vk::BufferUsageFlagBits::eTransferDst)
+	    .with_vma_usage(VMA_MEMORY_USAGE_GPU_TO_CPU)
+	    .with_vma_flags(VMA_ALLOCATION_CREATE_MAPPED_BIT)
+	    .with_vma_preferred_flags(vk::MemoryPropertyFlagBits::eHostCached)
+	    .with_memory_category(backend::allocated::MemoryCategory::kStaging)
+	    .with_debug_name("Read back block");
+
+	current_block_ = blocks_.size();
+	blocks_.push_back({builder.build_unique(device_), size});
+	return {current_block_, 0, size};
+}
+
+void ReadBackManager::add_host_barrier(backend::CommandBuffer &command_buffer, const Request &request)
+{
+	common::BufferMemoryBarrier memory_barrier{};
+	memory_barrier.src_access_mask = vk::AccessFlagBits2::eTransferWrite;
+	memory_barrier.dst_access_mask = vk::AccessFlagBits2::eHostRead;
+	memory_barrier.src_stage_mask  = vk::PipelineStageFlagBits2::eTransfer;
+	memory_barrier.dst_stage_mask  = vk::PipelineStageFlagBits2::eHost;
+	command_buffer.buffer_memory_barrier(*blocks_[request.block].buffer, request.offset, request.size, memory_barrier);
+}
+}        // namespace xihe::rendering
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "backend/buffer.h"
+
+namespace xihe
+{
+namespace backend
+{
+class CommandBuffer;
+class Device;
+class ImageView;
+}        // namespace backend
+
+namespace rendering
+{
+/// Receives the copied bytes, which are only valid during the call
+using ReadBackCallback = std::function<void(const uint8_t *data, vk::DeviceSize size)>;
+
+/**
+ * \brief Copies buffers and images to host memory without waiting for the GPU. Each RenderFrame owns one, the copies
+ *        recorded during the frame land in persistently mapped, host cached blocks, and their callbacks are invoked
+ *        when the frame is reused, after its fence was waited for. The frames in turn use their blocks like a ring.
+ *
+ *        Copies must be recorded in command buffers of the graphics queue, whose last submission of the frame signals
+ *        the fence. Callbacks must stay valid until they are invoked, the pending ones are dropped with the frame.
+ */
+class ReadBackManager
+{
+  public:
+	explicit ReadBackManager(backend::Device &device, vk::DeviceSize block_size = 4 * 1024 * 1024);
+
+	ReadBackManager(const ReadBackManager &)            = delete;
+	ReadBackManager &operator=(const ReadBackManager &) = delete;
+
+	/**
+	 * \brief Invokes the callbacks of the copies recorded the last time this frame was used and rewinds the blocks.
+	 *        Must only be called once the GPU is done with the frame.
+	 */
+	void resolve();
+
+	/**
+	 * \brief Records the copy of a range of the buffer
+	 * \param stage_mask Stages accessing the buffer around the copy, the copy waits for their writes and later
+	 *        accesses of these stages wait for the copy
+	 * \param access_mask Accesses of the buffer by those stages
+	 */
+	void read_back(backend::CommandBuffer &command_buffer, const backend::Buffer &buffer, vk::DeviceSize offset, vk::DeviceSize size,
+	               vk::PipelineStageFlags2 stage_mask, vk::AccessFlags2 access_mask, ReadBackCallback &&callback);
+
+	/**
+	 * \brief Records the copy of all levels and layers of the view, packed level by level with the layers of a level
+	 *        next to each other. The view must have a single aspect and its image transfer source usage.
+	 * \param layout Layout of the view, it is transitioned back to it after the copy
+	 * \param stage_mask Stages accessing the view around the copy, as for buffers
+	 * \param access_mask Accesses of the view by those stages
+	 */
+	void read_back(backend::CommandBuffer &command_buffer, const backend::ImageView &image_view, vk::ImageLayout layout,
+	               vk::PipelineStageFlags2 stage_mask, vk::AccessFlags2 access_mask, ReadBackCallback &&callback);
+
+	/// Copies recorded since the last resolve
+	size_t get_pending_count() const;
+
+  private:
+	struct Block
+	{
+		std::unique_ptr<backend::Buffer> buffer;
+		vk::DeviceSize                   used{0};
+	};
+
+	struct Request
+	{
+		size_t           block{0};
+		vk::DeviceSize   offset{0};
+		vk::DeviceSize   size{0};
+		ReadBackCallback callback;
+	};
+
+	/// Sub-allocates from the current block, moving to the next one or creating a block when it does not fit
+	Request allocate(vk::DeviceSize size, vk::DeviceSize alignment);
+
+	void add_host_barrier(backend::CommandBuffer &command_buffer, const Request &request);
+
+	backend::Device &device_;
+
+	vk::DeviceSize block_size_;
+
+	std::vector<Block> blocks_;
+
+	size_t current_block_{0};
+
+	std::vector<Request> requests_;
+
+	// The invalidated data of a request is copied here for its callback, reused across requests
+	std::vector<uint8_t> data_;
+};
+}        // namespace rendering
+}        // namespace xihe
@@ -1,9 +1,26 @@
 #include "render_context.h"
 
+#include "common/trace.h"
 #include "rendering/render_frame.h"
 
+#include <limits>
+
 namespace xihe::rendering
 {
+namespace
+{
+// vkQueueSubmit takes the original stage flags, which share their values with the synchronization2 ones
+vk::PipelineStageFlags to_wait_stage_mask(vk::PipelineStageFlags2 stage_mask)
+{
+	auto mask = static_cast<VkPipelineStageFlags2>(stage_mask);
+	if (mask == 0 || mask > std::numeric_limits<VkPipelineStageFlags>::max())
+	{
+		return vk::PipelineStageFlagBits::eAllCommands;
+	}
+	return static_cast<vk::PipelineStageFlags>(static_cast<VkPipelineStageFlags>(mask));
+}
+}        // namespace
+
 RenderContext::RenderContext(backend::Device &device, vk::SurfaceKHR surface, const Window &window, vk::PresentModeKHR present_mode, std::vector<vk::PresentModeKHR> const &present_mode_priority_list, std::vector<vk::SurfaceFormatKHR> const &surface_format_priority_list) :
     device_{device}, window_{window}, surface_extent_{window.get_extent().width, window.get_extent().height}
 {
@@ -43,10 +60,16 @@ RenderContext::RenderContext(backend::Device &device, vk::SurfaceKHR surface, co
 
 	graphics_semaphore_ = device_.get_handle().createSemaphore(semaphore_create_info);
 	compute_semaphore_  = device_.get_handle().createSemaphore(semaphore_create_info);
+
+	frame_pacer_ = std::make_unique<FramePacer>(device_, graphics_semaphore_);
 }
 
 RenderContext::~RenderContext()
 {
+	for (auto semaphore : present_semaphores_)
+	{
+		device_.get_handle().destroySemaphore(semaphore);
+	}
 	device_.get_handle().destroySemaphore(graphics_semaphore_);
 	device_.get_handle().destroySemaphore(compute_semaphore_);
 }
@@ -57,18 +80,62 @@ void RenderContext::prepare(size_t thread_count)
 
 	surface_extent_ = swapchain_->get_extent();
 
-	const vk::Extent3D extent{surface_extent_.width, surface_extent_.height, 1};
-
 	assert(swapchain_);
 
-	for (auto &image_handle : swapchain_->get_images())
+	thread_count_ = thread_count;
+
+	// The device is idle, the copies of the frames are delivered before the frames go away
+	for (auto &frame : frames_)
+	{
+		frame->get_read_back_manager().resolve();
+	}
+	frames_.clear();
+	for (uint32_t i = 0; i < frames_in_flight_; ++i)
 	{
 		frames_.emplace_back(std::make_unique<rendering::RenderFrame>(device_, thread_count));
 	}
 	recreate_frame_render_targets();
 
-	thread_count_ = thread_count;
-	prepared_     = true;
+	prepared_ = true;
+}
+
+void RenderContext::set_frames_in_flight(uint32_t count)
+{
+	assert(count > 0 && "At least one frame must be in flight");
+	assert(!frame_active_ && "Frames in flight cannot change during a frame");
+
+	if (count == frames_in_flight_)
+	{
+		return;
+	}
+
+	frames_in_flight_ = count;
+
+	if (prepared_)
+	{
+		device_.get_handle().waitIdle();
+
+		for (auto &frame : frames_)
+		{
+			frame->get_read_back_manager().resolve();
+		}
+		frames_.clear();
+		for (uint32_t i = 0; i < frames_in_flight_; ++i)
+		{
+			frames_.emplace_back(std::make_unique<rendering::RenderFrame>(device_, thread_count_));
+		}
+		active_frame_index_ = 0;
+	}
+}
+
+uint32_t RenderContext::get_frames_in_flight() const
+{
+	return frames_in_flight_;
+}
+
+FramePacer &RenderContext::get_frame_pacer()
+{
+	return *frame_pacer_;
 }
 
 void RenderContext::recreate_frame_render_targets()
@@ -76,14 +143,23 @@ void RenderContext::recreate_frame_render_targets()
 	vk::Extent2D swapchain_extent = swapchain_->get_extent();
 	vk::Extent3D extent{swapchain_extent.width, swapchain_extent.height, 1};
 
-	assert(frames_.size() == swapchain_->get_images().size() && "Frame count does not match swapchain image count");
+	// Frames in flight may still render to or present the previous images
+	for (auto &render_target : swapchain_render_targets_)
+	{
+		release_deferred(std::move(render_target));
+	}
 
-	for (uint32_t i = 0; i < frames_.size(); ++i)
+	swapchain_render_targets_.clear();
+	for (const auto &image_handle : swapchain_->get_images())
 	{
-		backend::Image swapchain_image{device_, swapchain_->get_images()[i], extent, swapchain_->get_format(), swapchain_->get_image_usage()};
+		backend::Image swapchain_image{device_, image_handle, extent, swapchain_->get_format(), swapchain_->get_image_usage()};
+
+		swapchain_render_targets_.push_back(create_render_target_function_(std::move(swapchain_image)));
+	}
 
-		auto render_target = create_render_target_function_(std::move(swapchain_image));
-		frames_[i]->update_render_target(std::move(render_target));
+	while (present_semaphores_.size() < swapchain_render_targets_.size())
+	{
+		present_semaphores_.push_back(device_.get_handle().createSemaphore({}));
 	}
 }
 
@@ -111,6 +187,33 @@ RenderFrame &RenderContext::get_active_frame() const
 	return *frames_[active_frame_index_];
 }
 
+uint32_t RenderContext::get_active_frame_index() const
+{
+	return active_frame_index_;
+}
+
+uint32_t RenderContext::get_active_image_index() const
+{
+	return active_image_index_;
+}
+
+uint32_t RenderContext::get_render_frame_count() const
+{
+	return static_cast<uint32_t>(frames_.size());
+}
+
+const std::vector<GpuScopeTiming> &RenderContext::get_gpu_timings() const
+{
+	static const std::vector<GpuScopeTiming> kNoTimings;
+	if (frames_.empty())
+	{
+		return kNoTimings;
+	}
+
+	// Results are resolved when a frame begins, the last begun frame holds the latest ones
+	return frames_[active_frame_index_]->get_gpu_profiler().get_results();
+}
+
 backend::Device &RenderContext::get_device() const
 {
 	return device_;
@@ -164,6 +267,9 @@ backend::CommandBuffer &RenderContext::request_compute_command_buffer(backend::C
 
 void RenderContext::begin_frame()
 {
+	// Includes waiting for the fence of the reused frame and acquiring the next image
+	XIHE_TRACE_ZONE("Begin frame");
+
 	if (swapchain_)
 	{
 		handle_surface_changes();
@@ -171,44 +277,56 @@ void RenderContext::begin_frame()
 
 	assert(!frame_active_ && "Frame is still active, please call end_frame");
 
-	auto &prev_frame = *frames_[active_frame_index_];
+	frame_pacer_->begin_frame();
+
+	++frame_count_;
+	collect_deferred_releases();
 
-	// We will use the acquired semaphore in a different frame context,
-	// so we need to hold ownership.
-	acquired_semaphore_ = prev_frame.request_semaphore_with_ownership();
+	// Frames are reused in turn, waiting for the fence of the frame that used the same resources
+	active_frame_index_ = (active_frame_index_ + 1) % static_cast<uint32_t>(frames_.size());
+	auto &frame         = *frames_[active_frame_index_];
+	frame.reset();
+
+	// The frame holds ownership until it ends, so the semaphore is not handed out while the acquire may still signal it
+	acquired_semaphore_ = frame.request_semaphore_with_ownership();
 
 	if (swapchain_)
 	{
 		vk::Result result;
 		try
 		{
-			std::tie(result, active_frame_index_) = swapchain_->acquire_next_image(acquired_semaphore_);
+			std::tie(result, active_image_index_) = swapchain_->acquire_next_image(acquired_semaphore_);
 		}
 		catch (vk::OutOfDateKHRError & /*err*/)
 		{
 			result = vk::Result::eErrorOutOfDateKHR;
 		}
 
-		if (result == vk::Result::eSuboptimalKHR || result == vk::Result::eErrorOutOfDateKHR)
+		// A suboptimal image is still presentable, the swapchain is recreated after its present.
+		// An out of date acquire does not signal the semaphore, so it can be used again.
+		if (result == vk::Result::eErrorOutOfDateKHR && handle_surface_changes(true))
 		{
-			bool swapchain_updated = handle_surface_changes(result == vk::Result::eErrorOutOfDateKHR);
-
-			if (swapchain_updated)
+			try
 			{
-				std::tie(result, active_frame_index_) = swapchain_->acquire_next_image(acquired_semaphore_);
+				std::tie(result, active_image_index_) = swapchain_->acquire_next_image(acquired_semaphore_);
+			}
+			catch (vk::OutOfDateKHRError & /*err*/)
+			{
+				result = vk::Result::eErrorOutOfDateKHR;
 			}
 		}
 
-		if (result != vk::Result::eSuccess)
+		if (result != vk::Result::eSuccess && result != vk::Result::eSuboptimalKHR)
 		{
-			prev_frame.reset();
+			frame.release_owned_semaphore(acquired_semaphore_);
+			acquired_semaphore_ = nullptr;
 			return;
 		}
+
+		frame.set_render_target(*swapchain_render_targets_[active_image_index_]);
 	}
 
 	frame_active_ = true;
-
-	get_active_frame().reset();
 }
 
 void RenderContext::end_frame(vk::Semaphore semaphore, bool present)
@@ -218,12 +336,21 @@ void RenderContext::end_frame(vk::Semaphore semaphore, bool present)
 	if (swapchain_ && present)
 	{
 		vk::SwapchainKHR   vk_swapchain = swapchain_->get_handle();
-		vk::PresentInfoKHR present_info(semaphore, vk_swapchain, active_frame_index_);
+		vk::PresentInfoKHR present_info(semaphore, vk_swapchain, active_image_index_);
+
+		const uint64_t   present_id = frame_pacer_->end_frame(vk_swapchain, graphics_semaphore_value_);
+		vk::PresentIdKHR present_id_info;
+		if (present_id != 0)
+		{
+			present_id_info.setPresentIds(present_id);
+			present_info.setPNext(&present_id_info);
+		}
 
 		vk::DisplayPresentInfoKHR display_present_info;
 		if (device_.is_extension_supported(VK_KHR_DISPLAY_SWAPCHAIN_EXTENSION_NAME) &&
 		    window_.get_display_present_info(&display_present_info, surface_extent_.width, surface_extent_.height))
 		{
+			display_present_info.setPNext(present_info.pNext);
 			present_info.setPNext(&display_present_info);
 		}
 
@@ -237,11 +364,16 @@ void RenderContext::end_frame(vk::Semaphore semaphore, bool present)
 			result = vk::Result::eErrorOutOfDateKHR;
 		}
 
+		// A suboptimal swapchain can keep the surface extent, e.g. after a rotation, so it is recreated regardless
 		if (result == vk::Result::eSuboptimalKHR || result == vk::Result::eErrorOutOfDateKHR)
 		{
-			handle_surface_changes();
+			handle_surface_changes(true);
 		}
 	}
+	else
+	{
+		frame_pacer_->end_frame(nullptr, graphics_semaphore_value_);
+	}
 
 	if (acquired_semaphore_)
 	{
@@ -295,8 +427,13 @@ void RenderContext::submit(const backend::Queue &queue, const std::vector<backen
 	queue.get_handle().submit(submit_info, fence);
 }
 
-void RenderContext::compute_submit(const std::vector<backend::CommandBuffer *> &command_buffers, uint64_t &signal_semaphore_value, uint64_t wait_semaphore_value)
+void RenderContext::compute_submit(const std::vector<backend::CommandBuffer *> &command_buffers,
+                                   uint64_t                                    &signal_semaphore_value,
+                                   uint64_t                                     wait_semaphore_value,
+                                   vk::PipelineStageFlags2                      wait_stage_mask)
 {
+	XIHE_TRACE_ZONE("Compute submit");
+
 	vk::SubmitInfo                 submit_info;
 	std::vector<vk::CommandBuffer> command_buffer_handles(command_buffers.size(), nullptr);
 	std::ranges::transform(command_buffers, command_buffer_handles.begin(), [](const backend::CommandBuffer *cmd_buf) {
@@ -313,7 +450,7 @@ void RenderContext::compute_submit(const std::vector<backend::CommandBuffer *> &
 	{
 		timeline_submit_info.setWaitSemaphoreValues(wait_semaphore_value);
 		wait_semaphores.push_back(graphics_semaphore_);
-		wait_stages.push_back(vk::PipelineStageFlagBits::eComputeShader);
+		wait_stages.push_back(to_wait_stage_mask(wait_stage_mask));
 	}
 
 	++compute_semaphore_value_;
@@ -335,10 +472,13 @@ void RenderContext::compute_submit(const std::vector<backend::CommandBuffer *> &
 void RenderContext::graphics_submit(const std::vector<backend::CommandBuffer *> &command_buffers,
                                     uint64_t                                    &signal_semaphore_value,
                                     uint64_t                                     wait_semaphore_value,
+                                    vk::PipelineStageFlags2                      wait_stage_mask,
                                     bool                                         is_first_submission,
                                     bool                                         is_last_submission,
                                     bool                                         present)
 {
+	XIHE_TRACE_ZONE("Graphics submit");
+
 	vk::SubmitInfo                 submit_info{};
 	std::vector<vk::CommandBuffer> command_buffer_handles(command_buffers.size());
 	std::transform(command_buffers.begin(), command_buffers.end(), command_buffer_handles.begin(), [](const backend::CommandBuffer *cmd_buf) {
@@ -360,10 +500,12 @@ void RenderContext::graphics_submit(const std::vector<backend::CommandBuffer *>
 		wait_stages.push_back(vk::PipelineStageFlagBits::eColorAttachmentOutput);
 		wait_semaphore_values.push_back(0);        // Placeholder value for binary semaphore
 	}
-	else if (wait_semaphore_value != 0)
+
+	// Async compute may run ahead of the first graphics submission, so both waits can be needed
+	if (wait_semaphore_value != 0)
 	{
 		wait_semaphores.push_back(compute_semaphore_);
-		wait_stages.push_back(vk::PipelineStageFlagBits::eComputeShader);
+		wait_stages.push_back(to_wait_stage_mask(wait_stage_mask));
 		wait_semaphore_values.push_back(wait_semaphore_value);
 	}
 
@@ -373,11 +515,12 @@ void RenderContext::graphics_submit(const std::vector<backend::CommandBuffer *>
 	signal_semaphores.push_back(graphics_semaphore_);
 	signal_semaphore_values.push_back(signal_semaphore_value);
 
-	// Handle the last submission: Signal the render finished semaphore
-	RenderFrame        &frame            = get_active_frame();
-	const vk::Semaphore render_semaphore = frame.request_semaphore();
-	if (is_last_submission && swapchain_)
+	// Handle the last submission: Signal the render finished semaphore of the acquired image
+	RenderFrame  &frame = get_active_frame();
+	vk::Semaphore render_semaphore;
+	if (is_last_submission && swapchain_ && present)
 	{
+		render_semaphore = present_semaphores_[active_image_index_];
 		signal_semaphores.push_back(render_semaphore);
 		signal_semaphore_values.push_back(0);        // Placeholder value for binary semaphore
 	}
@@ -428,11 +571,14 @@ bool RenderContext::handle_surface_changes(bool force_update)
 		return false;
 	}
 
-	if (surface_capabilities.currentExtent.width != surface_extent_.width || surface_capabilities.currentExtent.height != surface_extent_.height)
+	// The window is minimized, a swapchain cannot be created until it is restored
+	if (surface_capabilities.currentExtent.width == 0 || surface_capabilities.currentExtent.height == 0)
 	{
-		// Recreate swapchain
-		device_.get_handle().waitIdle();
+		return false;
+	}
 
+	if (force_update || surface_capabilities.currentExtent.width != surface_extent_.width || surface_capabilities.currentExtent.height != surface_extent_.height)
+	{
 		update_swapchain(surface_capabilities.currentExtent);
 
 		surface_extent_ = surface_capabilities.currentExtent;
@@ -457,9 +603,15 @@ void RenderContext::update_swapchain(const vk::Extent2D &extent)
 {
 	// device_.get_resource_cache().clear_framebuffers();
 
-	swapchain_ = std::make_unique<backend::Swapchain>(*swapchain_, extent);
+	frame_pacer_->on_swapchain_recreated();
 
+	// The old swapchain is retired by passing it to the new one, its pending presents still complete
+	auto old_swapchain = std::move(swapchain_);
+	swapchain_         = std::make_unique<backend::Swapchain>(*old_swapchain, extent);
+
+	// Releases run in order, the render targets on the old images have to go before the swapchain owning them
 	recreate_frame_render_targets();
+	release_deferred(std::move(old_swapchain));
 }
 
 void RenderContext::update_swapchain(const std::set<vk::ImageUsageFlagBits> &image_usage_flags)
@@ -468,9 +620,36 @@ void RenderContext::update_swapchain(const std::set<vk::ImageUsageFlagBits> &ima
 
 	// device_.get_resource_cache().clear_framebuffers();
 
-	swapchain_ = std::make_unique<backend::Swapchain>(*swapchain_, image_usage_flags);
+	frame_pacer_->on_swapchain_recreated();
+
+	auto old_swapchain = std::move(swapchain_);
+	swapchain_         = std::make_unique<backend::Swapchain>(*old_swapchain, image_usage_flags);
 
 	recreate_frame_render_targets();
+	release_deferred(std::move(old_swapchain));
+}
+
+void RenderContext::collect_deferred_releases()
+{
+	if (deferred_releases_.empty())
+	{
+		return;
+	}
+
+	const uint64_t graphics_value = device_.get_handle().getSemaphoreCounterValue(graphics_semaphore_);
+	const uint64_t compute_value  = device_.get_handle().getSemaphoreCounterValue(compute_semaphore_);
+
+	// Entries were pushed with increasing values, the first one still in use ends the scan
+	while (!deferred_releases_.empty())
+	{
+		const auto &release = deferred_releases_.front();
+		if (release.graphics_semaphore_value > graphics_value || release.compute_semaphore_value > compute_value ||
+		    release.frame_count > frame_count_)
+		{
+			break;
+		}
+		deferred_releases_.pop_front();
+	}
 }
 
 backend::Swapchain const &RenderContext::get_swapchain() const
@@ -558,4 +737,9 @@ void RenderContext::create_sparse_bind_queue()
 	}
 	sparse_queue_ = &get_device().get_queue(sparse_queue_family_index, 0);
 }
+
+const backend::Queue *RenderContext::get_sparse_queue() const
+{
+	return sparse_queue_;
+}
 }        // namespace xihe::rendering
@@ -1,9 +1,13 @@
 #pragma once
 
+#include <deque>
+
 #include "backend/command_buffer.h"
 #include "backend/device.h"
 #include "backend/swapchain.h"
 #include "platform/window.h"
+#include "rendering/frame_pacer.h"
+#include "rendering/gpu_profiler.h"
 #include "rendering/render_target.h"
 
 namespace xihe::rendering
@@ -11,6 +15,8 @@ namespace xihe::rendering
 class RenderContext
 {
   public:
+	static constexpr uint32_t kDefaultFramesInFlight = 2;
+
 	RenderContext(backend::Device                         &device,
 	              vk::SurfaceKHR                           surface,
 	              const Window                            &window,
@@ -33,12 +39,35 @@ class RenderContext
 	 */
 	void prepare(size_t thread_count = 1);
 
+	/**
+	 * \brief Frames the CPU may record while the GPU works on the previous ones, independent of the swapchain image count.
+	 *        Fewer frames lower the latency, more frames hide longer CPU spikes. Waits for the device if already prepared.
+	 */
+	void set_frames_in_flight(uint32_t count);
+
+	uint32_t get_frames_in_flight() const;
+
+	FramePacer &get_frame_pacer();
+
 	void recreate_frame_render_targets();
 
 	void begin();
 
 	RenderFrame &get_active_frame() const;
 
+	/// Index of the frame begun last, it stays valid after the frame ended
+	uint32_t get_active_frame_index() const;
+
+	/// Index of the swapchain image acquired by the frame begun last
+	uint32_t get_active_image_index() const;
+
+	uint32_t get_render_frame_count() const;
+
+	/**
+	 * \brief GPU timings of the most recently resolved frame, can be called between frames
+	 */
+	const std::vector<GpuScopeTiming> &get_gpu_timings() const;
+
 	backend::Device &get_device() const;
 
 	void submit(backend::CommandBuffer &command_buffer);
@@ -69,15 +98,32 @@ class RenderContext
 
 	void submit(const backend::Queue &queue, const std::vector<backend::CommandBuffer *> &command_buffers);
 
-	void compute_submit(const std::vector<backend::CommandBuffer *> &command_buffers, uint64_t &signal_semaphore_value, uint64_t wait_semaphore_value = 0);
+	/**
+	 * \param wait_semaphore_value Value of the graphics timeline to wait for, 0 to not wait
+	 * \param wait_stage_mask Stages that consume the graphics results, all commands wait if empty
+	 */
+	void compute_submit(const std::vector<backend::CommandBuffer *> &command_buffers,
+	                    uint64_t                                    &signal_semaphore_value,
+	                    uint64_t                                     wait_semaphore_value = 0,
+	                    vk::PipelineStageFlags2                      wait_stage_mask      = {});
 
+	/**
+	 * \param wait_semaphore_value Value of the compute timeline to wait for, 0 to not wait
+	 * \param wait_stage_mask Stages that consume the compute results, all commands wait if empty
+	 */
 	void graphics_submit(const std::vector<backend::CommandBuffer *> &command_buffers,
 	                     uint64_t                                    &signal_semaphore_value,
 	                     uint64_t                                     wait_semaphore_value = 0,
+	                     vk::PipelineStageFlags2                      wait_stage_mask      = {},
 	                     bool                                         is_first_submission  = false,
 	                     bool                                         is_last_submission   = false,
 	                     bool                                         present              = true);
 
+	/**
+	 * \brief Recreates the swapchain if the surface extent changed, without waiting for the device.
+	 *        The old swapchain and its render targets are released once the frames using them completed.
+	 * \param force_update Recreates the swapchain even if the extent is unchanged, e.g. when it is out of date
+	 */
 	bool handle_surface_changes(bool force_update = false);
 
 	void set_on_surface_change(std::function<void()> on_surface_change);
@@ -94,9 +140,40 @@ class RenderContext
 
 	uint32_t get_queue_family_index(vk::QueueFlagBits queue_flags) const;
 
+	/**
+	 * \brief Keeps an object the submitted GPU work may still use alive until that work completed, so it can be
+	 *        replaced without waiting for the device. Objects are released in the order they were handed over.
+	 */
+	template <typename T>
+	void release_deferred(std::unique_ptr<T> &&object)
+	{
+		if (object)
+		{
+			deferred_releases_.push_back({graphics_semaphore_value_, compute_semaphore_value_, frame_count_ + frames_in_flight_,
+			                              std::shared_ptr<void>(std::move(object))});
+		}
+	}
+
+	/// Releases the deferred objects whose GPU work completed, called at the start of each frame
+	void collect_deferred_releases();
+
 	void create_sparse_bind_queue();
 
+	/// Null until create_sparse_bind_queue was called
+	const backend::Queue *get_sparse_queue() const;
+
   private:
+	struct DeferredRelease
+	{
+		uint64_t graphics_semaphore_value{0};
+		uint64_t compute_semaphore_value{0};
+
+		// Presents are not covered by the timelines, the frames in flight must have been begun again as well
+		uint64_t frame_count{0};
+
+		std::shared_ptr<void> object;
+	};
+
 	backend::Device &device_;
 
 	const Window &window_;
@@ -114,6 +191,17 @@ class RenderContext
 
 	std::vector<std::unique_ptr<RenderFrame>> frames_;
 
+	uint32_t frames_in_flight_{kDefaultFramesInFlight};
+
+	// One per swapchain image, the frame that acquires an image renders to its target
+	std::vector<std::unique_ptr<RenderTarget>> swapchain_render_targets_;
+
+	// Signaled by the last submission of a frame and waited by the present. They are per image rather than per frame,
+	// so a semaphore is only reused once its image was acquired again and the previous present is done with it
+	std::vector<vk::Semaphore> present_semaphores_;
+
+	std::unique_ptr<FramePacer> frame_pacer_;
+
 	// Per frame synchronization
 	vk::Semaphore acquired_semaphore_;
 	bool          first_acquired_{true};
@@ -126,6 +214,12 @@ class RenderContext
 	bool     prepared_{false};
 	bool     frame_active_{false};
 	uint32_t active_frame_index_{0};
+	uint32_t active_image_index_{0};
+
+	// Frames begun so far
+	uint64_t frame_count_{0};
+
+	std::deque<DeferredRelease> deferred_releases_;
 
 	vk::SurfaceTransformFlagBitsKHR pre_transform_{vk::SurfaceTransformFlagBitsKHR::eIdentity};
 
@@ -10,6 +10,8 @@ RenderFrame::RenderFrame(backend::Device &device, size_t thread_count) :
     device_{device},
     fence_pool_{device},
     semaphore_pool_{device},
+    gpu_profiler_{device},
+    read_back_manager_{device},
     thread_count_{thread_count}
 {
 	for (auto &usage_it : supported_usage_map_)
@@ -51,6 +53,7 @@ backend::CommandBuffer &RenderFrame::request_command_buffer(const backend::Queue
 
 RenderTarget & RenderFrame::get_render_target()
 {
+	assert(swapchain_render_target_ && "No swapchain image was acquired for this frame");
 	return *swapchain_render_target_;
 }
 
@@ -134,6 +137,11 @@ void RenderFrame::reset()
 
 	fence_pool_.reset();
 
+	// The fence covers every query of the frame, so this reads finished results
+	gpu_profiler_.resolve();
+
+	read_back_manager_.resolve();
+
 	for (auto &command_pools_per_queue : command_pools_)
 	{
 		for (auto &command_pool : command_pools_per_queue.second)
@@ -175,9 +183,19 @@ void RenderFrame::clear_descriptors()
 	}
 }
 
-void RenderFrame::update_render_target(std::unique_ptr<RenderTarget> &&render_target)
+void RenderFrame::set_render_target(RenderTarget &render_target)
+{
+	swapchain_render_target_ = &render_target;
+}
+
+void RenderFrame::set_render_scale(float render_scale)
+{
+	render_scale_ = render_scale;
+}
+
+float RenderFrame::get_render_scale() const
 {
-	swapchain_render_target_ = std::move(render_target);
+	return render_scale_;
 }
 
 //void RenderFrame::update_render_target(std::string rdg_name, std::unique_ptr<RenderTarget> &&render_target)
@@ -215,6 +233,16 @@ backend::BufferAllocation RenderFrame::allocate_buffer(vk::BufferUsageFlags usag
 	return buffer_block->allocate(size);
 }
 
+GpuProfiler &RenderFrame::get_gpu_profiler()
+{
+	return gpu_profiler_;
+}
+
+ReadBackManager &RenderFrame::get_read_back_manager()
+{
+	return read_back_manager_;
+}
+
 std::vector<std::unique_ptr<backend::CommandPool>> &RenderFrame::get_command_pools(const backend::Queue &queue, backend::CommandBuffer::ResetMode reset_mode)
 {
 	auto command_pool_it = command_pools_.find(queue.get_family_index());
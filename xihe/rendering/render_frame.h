@@ -7,6 +7,8 @@
 #include "backend/descriptor_pool.h"
 #include "backend/descriptor_set.h"
 #include "backend/semaphore_pool.h"
+#include "rendering/gpu_profiler.h"
+#include "rendering/read_back_manager.h"
 //#include "rendering/render_target.h"
 
 namespace xihe::rendering
@@ -53,12 +55,24 @@ class RenderFrame
 
 	void clear_descriptors();
 
-	void update_render_target(std::unique_ptr<RenderTarget> &&render_target);
+	/// The render target of the swapchain image acquired for this frame, owned by the RenderContext
+	void set_render_target(RenderTarget &render_target);
 
 	void release_owned_semaphore(vk::Semaphore semaphore);
 
 	backend::BufferAllocation allocate_buffer(vk::BufferUsageFlags usage, vk::DeviceSize size, size_t thread_index);
 
+	/// Timings of this frame are available once the frame is reused, see GpuProfiler
+	GpuProfiler &get_gpu_profiler();
+
+	/// Copies recorded in this frame are delivered once the frame is reused, see ReadBackManager
+	ReadBackManager &get_read_back_manager();
+
+	/// Scale dynamically sized graph targets are rendered at this frame, see DynamicResolution
+	void set_render_scale(float render_scale);
+
+	float get_render_scale() const;
+
 private:
 	std::vector<std::unique_ptr<backend::CommandPool>> &get_command_pools(const backend::Queue &queue, backend::CommandBuffer::ResetMode reset_mode);
 
@@ -75,7 +89,9 @@ private:
 	backend::Device &device_;
 
 	// std::unordered_map<std::string, std::unique_ptr<RenderTarget>> render_targets_ = {};
-	std::unique_ptr<RenderTarget> swapchain_render_target_;
+	RenderTarget *swapchain_render_target_{nullptr};
+
+	float render_scale_{1.0f};
 
 	/// Commands pools associated to the frame
 	std::map<uint32_t, std::vector<std::unique_ptr<backend::CommandPool>>> command_pools_;
@@ -90,6 +106,10 @@ private:
 
 	backend::SemaphorePool semaphore_pool_;
 
+	GpuProfiler gpu_profiler_;
+
+	ReadBackManager read_back_manager_;
+
 	size_t thread_count_;
 
 	BufferAllocationStrategy buffer_allocation_strategy_{BufferAllocationStrategy::kMultipleAllocationsPerBuffer};
@@ -0,0 +1,273 @@
+#include "barrier_planner.h"
+
+#include "backend/buffer.h"
+#include "backend/image_view.h"
+
+#include <algorithm>
+
+namespace xihe::rendering
+{
+namespace
+{
+constexpr vk::AccessFlags2 kWriteAccessMask = vk::AccessFlagBits2::eShaderWrite |
+                                              vk::AccessFlagBits2::eShaderStorageWrite |
+                                              vk::AccessFlagBits2::eColorAttachmentWrite |
+                                              vk::AccessFlagBits2::eDepthStencilAttachmentWrite |
+                                              vk::AccessFlagBits2::eTransferWrite |
+                                              vk::AccessFlagBits2::eHostWrite |
+                                              vk::AccessFlagBits2::eMemoryWrite |
+                                              vk::AccessFlagBits2::eAccelerationStructureWriteKHR;
+
+template <typename T>
+void merge_masks(T &dst, const T &src)
+{
+	dst.src_stage_mask |= src.src_stage_mask;
+	dst.dst_stage_mask |= src.dst_stage_mask;
+	dst.src_access_mask |= src.src_access_mask;
+	dst.dst_access_mask |= src.dst_access_mask;
+}
+
+bool is_read_after_read(vk::AccessFlags2 src_access_mask, vk::AccessFlags2 dst_access_mask)
+{
+	return !(src_access_mask & kWriteAccessMask) && !(dst_access_mask & kWriteAccessMask);
+}
+
+template <typename T>
+bool covers(const T &visibility, vk::PipelineStageFlags2 stage_mask, vk::AccessFlags2 access_mask)
+{
+	return !(stage_mask & ~visibility.stage_mask) && !(access_mask & ~visibility.access_mask);
+}
+}        // namespace
+
+bool is_write_access(vk::AccessFlags2 access_mask)
+{
+	return static_cast<bool>(access_mask & kWriteAccessMask);
+}
+
+void BarrierPlanner::add_image_barrier(vk::Image image, const vk::ImageSubresourceRange &subresource_range, const common::ImageMemoryBarrier &barrier)
+{
+	++statistics_.requested_count;
+
+	common::ImageMemoryBarrier minimal_barrier = barrier;
+	// Only writes have to be made available, reads before the barrier just need the execution dependency
+	minimal_barrier.src_access_mask &= kWriteAccessMask;
+
+	bool keeps_layout       = barrier.old_layout == barrier.new_layout;
+	bool keeps_queue_family = barrier.old_queue_family == barrier.new_queue_family;
+
+	auto tracked = std::ranges::find_if(tracked_images_, [&](const TrackedImage &tracked_image) {
+		return tracked_image.image == image && tracked_image.subresource_range == subresource_range;
+	});
+
+	if (keeps_layout && keeps_queue_family && is_read_after_read(barrier.src_access_mask, barrier.dst_access_mask))
+	{
+		// Reads in other stages still need the last write made visible to them, unless an earlier barrier already did
+		if (tracked != tracked_images_.end() && covers(tracked->visibility, barrier.dst_stage_mask, barrier.dst_access_mask))
+		{
+			++statistics_.dropped_count;
+			return;
+		}
+
+		if (tracked != tracked_images_.end())
+		{
+			tracked->visibility.stage_mask |= barrier.dst_stage_mask;
+			tracked->visibility.access_mask |= barrier.dst_access_mask;
+		}
+		else
+		{
+			tracked_images_.push_back({image, subresource_range, {barrier.dst_stage_mask, barrier.dst_access_mask}});
+		}
+	}
+	else
+	{
+		// A write or transition on any range of the image hides what earlier barriers made visible
+		std::erase_if(tracked_images_, [image](const TrackedImage &tracked_image) { return tracked_image.image == image; });
+		tracked_images_.push_back({image, subresource_range, {barrier.dst_stage_mask, barrier.dst_access_mask}});
+	}
+
+	for (auto &pending : image_barriers_)
+	{
+		if (pending.image != image || pending.subresource_range != subresource_range)
+		{
+			continue;
+		}
+
+		if (pending.barrier.old_layout == barrier.old_layout && pending.barrier.new_layout == barrier.new_layout &&
+		    pending.barrier.old_queue_family == barrier.old_queue_family && pending.barrier.new_queue_family == barrier.new_queue_family)
+		{
+			merge_masks(pending.barrier, minimal_barrier);
+			++statistics_.merged_count;
+			return;
+		}
+
+		bool transfers_queue_family = pending.barrier.old_queue_family != pending.barrier.new_queue_family || !keeps_queue_family;
+		if (pending.barrier.new_layout == barrier.old_layout && !transfers_queue_family)
+		{
+			// Nothing runs between the two transitions, so they collapse into one from the first source to the last destination
+			pending.barrier.new_layout      = barrier.new_layout;
+			pending.barrier.dst_stage_mask  = barrier.dst_stage_mask;
+			pending.barrier.dst_access_mask = barrier.dst_access_mask;
+			++statistics_.merged_count;
+			return;
+		}
+	}
+
+	image_barriers_.push_back({image, subresource_range, minimal_barrier});
+}
+
+void BarrierPlanner::add_image_barrier(const backend::ImageView &image_view, const common::ImageMemoryBarrier &barrier)
+{
+	auto subresource_range = image_view.get_subresource_range();
+	auto format            = image_view.get_format();
+
+	if (common::is_depth_only_format(format))
+	{
+		subresource_range.aspectMask = vk::ImageAspectFlagBits::eDepth;
+	}
+	else if (common::is_depth_stencil_format(format))
+	{
+		subresource_range.aspectMask = vk::ImageAspectFlagBits::eDepth | vk::ImageAspectFlagBits::eStencil;
+	}
+
+	add_image_barrier(image_view.get_image().get_handle(), subresource_range, barrier);
+}
+
+void BarrierPlanner::add_buffer_barrier(vk::Buffer buffer, vk::DeviceSize offset, vk::DeviceSize size, const common::BufferMemoryBarrier &barrier)
+{
+	++statistics_.requested_count;
+
+	common::BufferMemoryBarrier minimal_barrier = barrier;
+	minimal_barrier.src_access_mask &= kWriteAccessMask;
+
+	bool keeps_queue_family = barrier.old_queue_family == barrier.new_queue_family;
+
+	auto tracked = std::ranges::find_if(tracked_buffers_, [&](const TrackedBuffer &tracked_buffer) {
+		return tracked_buffer.buffer == buffer && tracked_buffer.offset == offset && tracked_buffer.size == size;
+	});
+
+	if (keeps_queue_family && is_read_after_read(barrier.src_access_mask, barrier.dst_access_mask))
+	{
+		if (tracked != tracked_buffers_.end() && covers(tracked->visibility, barrier.dst_stage_mask, barrier.dst_access_mask))
+		{
+			++statistics_.dropped_count;
+			return;
+		}
+
+		if (tracked != tracked_buffers_.end())
+		{
+			tracked->visibility.stage_mask |= barrier.dst_stage_mask;
+			tracked->visibility.access_mask |= barrier.dst_access_mask;
+		}
+		else
+		{
+			tracked_buffers_.push_back({buffer, offset, size, {barrier.dst_stage_mask, barrier.dst_access_mask}});
+		}
+	}
+	else
+	{
+		std::erase_if(tracked_buffers_, [buffer](const TrackedBuffer &tracked_buffer) { return tracked_buffer.buffer == buffer; });
+		tracked_buffers_.push_back({buffer, offset, size, {barrier.dst_stage_mask, barrier.dst_access_mask}});
+	}
+
+	for (auto &pending : buffer_barriers_)
+	{
+		if (pending.buffer == buffer && pending.offset == offset && pending.size == size &&
+		    pending.barrier.old_queue_family == barrier.old_queue_family && pending.barrier.new_queue_family == barrier.new_queue_family)
+		{
+			merge_masks(pending.barrier, minimal_barrier);
+			++statistics_.merged_count;
+			return;
+		}
+	}
+
+	buffer_barriers_.push_back({buffer, offset, size, minimal_barrier});
+}
+
+void BarrierPlanner::add_buffer_barrier(const backend::Buffer &buffer, vk::DeviceSize offset, vk::DeviceSize size, const common::BufferMemoryBarrier &barrier)
+{
+	add_buffer_barrier(buffer.get_handle(), offset, size, barrier);
+}
+
+bool BarrierPlanner::empty() const
+{
+	return image_barriers_.empty() && buffer_barriers_.empty();
+}
+
+const std::vector<BarrierPlanner::ImageBarrier> &BarrierPlanner::get_image_barriers() const
+{
+	return image_barriers_;
+}
+
+const std::vector<BarrierPlanner::BufferBarrier> &BarrierPlanner::get_buffer_barriers() const
+{
+	return buffer_barriers_;
+}
+
+void BarrierPlanner::flush(backend::CommandBuffer &command_buffer)
+{
+	if (empty())
+	{
+		return;
+	}
+
+	std::vector<vk::ImageMemoryBarrier2> image_memory_barriers;
+	image_memory_barriers.reserve(image_barriers_.size());
+	for (const auto &[image, subresource_range, barrier] : image_barriers_)
+	{
+		image_memory_barriers.emplace_back(barrier.src_stage_mask,
+		                                   barrier.src_access_mask,
+		                                   barrier.dst_stage_mask,
+		                                   barrier.dst_access_mask,
+		                                   barrier.old_layout,
+		                                   barrier.new_layout,
+		                                   barrier.old_queue_family,
+		                                   barrier.new_queue_family,
+		                                   image,
+		                                   subresource_range);
+	}
+
+	std::vector<vk::BufferMemoryBarrier2> buffer_memory_barriers;
+	buffer_memory_barriers.reserve(buffer_barriers_.size());
+	for (const auto &[buffer, offset, size, barrier] : buffer_barriers_)
+	{
+		buffer_memory_barriers.emplace_back(barrier.src_stage_mask,
+		                                    barrier.src_access_mask,
+		                                    barrier.dst_stage_mask,
+		                                    barrier.dst_access_mask,
+		                                    barrier.old_queue_family,
+		                                    barrier.new_queue_family,
+		                                    buffer,
+		                                    offset,
+		                                    size);
+	}
+
+	command_buffer.pipeline_barrier(image_memory_barriers, buffer_memory_barriers);
+
+	statistics_.emitted_count += static_cast<uint32_t>(image_memory_barriers.size() + buffer_memory_barriers.size());
+	++statistics_.call_count;
+
+	clear();
+}
+
+void BarrierPlanner::clear()
+{
+	image_barriers_.clear();
+	buffer_barriers_.clear();
+}
+
+void BarrierPlanner::reset_tracking()
+{
+	tracked_images_.clear();
+	tracked_buffers_.clear();
+}
+
+const BarrierPlanner::Statistics &BarrierPlanner::get_statistics() const
+{
+	return statistics_;
+}
+
+void BarrierPlanner::reset_statistics()
+{
+	statistics_ = {};
+}
+}        // namespace xihe::rendering
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "backend/command_buffer.h"
+#include "common/vk_common.h"
+
+#include <vector>
+
+namespace xihe::rendering
+{
+/**
+ * \brief Collects the barriers a pass needs at one point of its execution and records them with a single vkCmdPipelineBarrier2.
+ *        Planning only works on handles and masks, so the planned barriers and the counters can be inspected without a device.
+ *
+ *        Over a frame, the planner remembers for each resource which stages and accesses the last write or transition was
+ *        made visible to. A read-after-read barrier is only dropped if its destination is already covered by that.
+ */
+class BarrierPlanner
+{
+  public:
+	struct ImageBarrier
+	{
+		vk::Image                  image;
+		vk::ImageSubresourceRange  subresource_range;
+		common::ImageMemoryBarrier barrier;
+	};
+
+	struct BufferBarrier
+	{
+		vk::Buffer                  buffer;
+		vk::DeviceSize              offset;
+		vk::DeviceSize              size;
+		common::BufferMemoryBarrier barrier;
+	};
+
+	struct Statistics
+	{
+		uint32_t requested_count{0};        // barriers handed to the planner
+		uint32_t dropped_count{0};          // read-after-read barriers whose stages already see the last write
+		uint32_t merged_count{0};           // folded into a barrier on the same range
+		uint32_t emitted_count{0};          // barriers recorded to a command buffer
+		uint32_t call_count{0};             // vkCmdPipelineBarrier2 calls
+	};
+
+	void add_image_barrier(vk::Image image, const vk::ImageSubresourceRange &subresource_range, const common::ImageMemoryBarrier &barrier);
+
+	/// Uses the subresource range of the view, with the aspect mask adjusted for depth formats
+	void add_image_barrier(const backend::ImageView &image_view, const common::ImageMemoryBarrier &barrier);
+
+	void add_buffer_barrier(vk::Buffer buffer, vk::DeviceSize offset, vk::DeviceSize size, const common::BufferMemoryBarrier &barrier);
+
+	void add_buffer_barrier(const backend::Buffer &buffer, vk::DeviceSize offset, vk::DeviceSize size, const common::BufferMemoryBarrier &barrier);
+
+	bool empty() const;
+
+	const std::vector<ImageBarrier> &get_image_barriers() const;
+
+	const std::vector<BufferBarrier> &get_buffer_barriers() const;
+
+	/**
+	 * \brief Records all pending barriers with one vkCmdPipelineBarrier2, does nothing if there are none
+	 */
+	void flush(backend::CommandBuffer &command_buffer);
+
+	/**
+	 * \brief Drops the pending barriers without recording them
+	 */
+	void clear();
+
+	/**
+	 * \brief Forgets what the previous barriers made visible, called when a frame starts recording
+	 */
+	void reset_tracking();
+
+	const Statistics &get_statistics() const;
+
+	void reset_statistics();
+
+  private:
+	/// The stages and accesses that see the last write or transition of a resource range
+	struct Visibility
+	{
+		vk::PipelineStageFlags2 stage_mask;
+		vk::AccessFlags2        access_mask;
+	};
+
+	struct TrackedImage
+	{
+		vk::Image                 image;
+		vk::ImageSubresourceRange subresource_range;
+		Visibility                visibility;
+	};
+
+	struct TrackedBuffer
+	{
+		vk::Buffer     buffer;
+		vk::DeviceSize offset;
+		vk::DeviceSize size;
+		Visibility     visibility;
+	};
+
+	Statistics statistics_;
+
+	std::vector<ImageBarrier>  image_barriers_;
+	std::vector<BufferBarrier> buffer_barriers_;
+
+	std::vector<TrackedImage>  tracked_images_;
+	std::vector<TrackedBuffer> tracked_buffers_;
+};
+
+bool is_write_access(vk::AccessFlags2 access_mask);
+}        // namespace xihe::rendering
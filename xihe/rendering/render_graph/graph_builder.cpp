@@ -1,7 +1,39 @@
 #include "graph_builder.h"
 
+#include "backend/swapchain.h"
+#include "common/trace.h"
+#include "pipeline_build_scheduler.h"
+
+#include <queue>
+
 namespace xihe::rendering
 {
+namespace
+{
+common::ImageMemoryBarrier get_present_attachment_barrier()
+{
+	common::ImageMemoryBarrier barrier;
+	barrier.old_layout      = vk::ImageLayout::eUndefined;
+	barrier.new_layout      = vk::ImageLayout::eColorAttachmentOptimal;
+	barrier.src_stage_mask  = vk::PipelineStageFlagBits2::eTopOfPipe;
+	barrier.dst_stage_mask  = vk::PipelineStageFlagBits2::eColorAttachmentOutput;
+	barrier.src_access_mask = {};
+	barrier.dst_access_mask = vk::AccessFlagBits2::eColorAttachmentWrite;
+	return barrier;
+}
+
+vk::DeviceSize estimate_resource_size(const ResourceCreateInfo &info, const vk::Extent2D &swapchain_extent)
+{
+	if (info.is_buffer)
+	{
+		return info.buffer_size;
+	}
+
+	const auto extent = info.extent_desc.calculate(swapchain_extent);
+	return vk::DeviceSize{vk::blockSize(info.format)} * extent.width * extent.height * extent.depth * info.array_layers;
+}
+}        // namespace
+
 ResourceStateTracker::State ResourceStateTracker::get_or_create_state(const ResourceHandle &handle)
 {
 	if (!states_.contains(handle))
@@ -74,6 +106,14 @@ GraphBuilder::PassBuilder &GraphBuilder::PassBuilder::copy(uint32_t attachment_i
 	return *this;
 }
 
+GraphBuilder::PassBuilder &GraphBuilder::PassBuilder::read_back(uint32_t attachment_index, ReadBackCallback &&callback)
+{
+	image_read_back_                   = std::make_unique<PassNode::ImageCopyInfo>();
+	image_read_back_->attachment_index = attachment_index;
+	image_read_back_->callback         = std::move(callback);
+	return *this;
+}
+
 GraphBuilder::PassBuilder &GraphBuilder::PassBuilder::present()
 {
 	is_present_ = true;
@@ -86,13 +126,25 @@ GraphBuilder::PassBuilder &GraphBuilder::PassBuilder::gui(Gui *gui)
 	return *this;
 }
 
+GraphBuilder::PassBuilder &GraphBuilder::PassBuilder::enabled(std::function<bool()> &&enabled_predicate)
+{
+	enabled_predicate_ = std::move(enabled_predicate);
+	return *this;
+}
+
+GraphBuilder::PassBuilder &GraphBuilder::PassBuilder::side_effects()
+{
+	has_side_effects_ = true;
+	return *this;
+}
+
 void GraphBuilder::PassBuilder::finalize()
 {
 	graph_builder_.add_pass(pass_name_, std::move(pass_info_),
-	                        std::move(render_pass_), is_present_, std::move(image_read_back_), gui_);
+	                        std::move(render_pass_), is_present_, std::move(image_read_back_), gui_, std::move(enabled_predicate_), has_side_effects_);
 }
 
-void GraphBuilder::add_pass(const std::string &name, PassInfo &&pass_info, std::unique_ptr<RenderPass> &&render_pass, bool is_present, std::unique_ptr<PassNode::ImageCopyInfo> &&image_read_back, Gui *gui)
+void GraphBuilder::add_pass(const std::string &name, PassInfo &&pass_info, std::unique_ptr<RenderPass> &&render_pass, bool is_present, std::unique_ptr<PassNode::ImageCopyInfo> &&image_read_back, Gui *gui, std::function<bool()> &&enabled_predicate, bool has_side_effects)
 {
 	is_dirty_ = true;
 
@@ -108,39 +160,103 @@ void GraphBuilder::add_pass(const std::string &name, PassInfo &&pass_info, std::
 		pass_node.set_image_copy_info(std::move(image_read_back));
 	}
 
-	if (is_present)
+	if (enabled_predicate)
 	{
-		common::ImageMemoryBarrier barrier;
-		barrier.old_layout      = vk::ImageLayout::eUndefined;
-		barrier.new_layout      = vk::ImageLayout::eColorAttachmentOptimal;
-		barrier.src_stage_mask  = vk::PipelineStageFlagBits2::eTopOfPipe;
-		barrier.dst_stage_mask  = vk::PipelineStageFlagBits2::eColorAttachmentOutput;
-		barrier.src_access_mask = {};
-		barrier.dst_access_mask = vk::AccessFlagBits2::eColorAttachmentWrite;
-		pass_node.add_attachment_memory_barrier(0, barrier);
+		pass_node.set_enabled_predicate(std::move(enabled_predicate));
 	}
 
+	pass_node.set_present(is_present);
+	pass_node.set_side_effects(has_side_effects);
+
 	render_graph_.add_pass_node(std::move(pass_node));
 }
 
 void GraphBuilder::create_resources()
 {
-	collect_resource_create_info();
+	// Re-culling within the passes allocated for already only rebuilds the batches and barriers
+	bool needs_allocation = allocated_passes_.size() != live_passes_.size();
+	for (uint32_t i = 0; !needs_allocation && i < live_passes_.size(); ++i)
+	{
+		needs_allocation = live_passes_[i] && !allocated_passes_[i];
+	}
 
-	create_graph_resource();
+	if (needs_allocation)
+	{
+		if (!render_graph_.pass_batches_.empty())
+		{
+			// Rebuilding replaces resources that frames in flight may still use
+			release_graph_resources();
+		}
+
+		// Passes that were live before keep their resources, so toggling them back does not allocate again
+		if (allocated_passes_.size() != live_passes_.size())
+		{
+			allocated_passes_.assign(live_passes_.size(), false);
+		}
+		for (uint32_t i = 0; i < live_passes_.size(); ++i)
+		{
+			allocated_passes_[i] = allocated_passes_[i] || live_passes_[i];
+		}
+
+		resource_create_infos_ = collect_resource_create_info(allocated_passes_);
+	}
+
+	// Resources only used by culled passes are never allocated
+	const vk::Extent2D swapchain_extent = render_context_.get_swapchain().get_extent();
+	vk::DeviceSize     saved_size       = 0;
+	for (const auto &[name, info] : collect_resource_create_info(std::vector<bool>(live_passes_.size(), true)))
+	{
+		if (!resource_create_infos_.contains(name))
+		{
+			saved_size += estimate_resource_size(info, swapchain_extent);
+		}
+	}
+
+	std::string culled_passes;
+	for (uint32_t i = 0; i < live_passes_.size(); ++i)
+	{
+		if (!live_passes_[i])
+		{
+			culled_passes += (culled_passes.empty() ? "" : ", ") + render_graph_.pass_nodes_[i].get_name();
+		}
+	}
+
+	if (!culled_passes.empty())
+	{
+		LOGI("Render graph culled passes [{}], saving {:.2f} MB", culled_passes, static_cast<double>(saved_size) / (1024.0 * 1024.0));
+	}
+
+	if (needs_allocation)
+	{
+		create_graph_resource();
+	}
 }
 
-void GraphBuilder::collect_resource_create_info()
+std::unordered_map<std::string, ResourceCreateInfo> GraphBuilder::collect_resource_create_info(const std::vector<bool> &included_passes)
 {
-	resource_create_infos_.clear();
+	std::unordered_map<std::string, ResourceCreateInfo> resource_create_infos;
+	std::unordered_set<std::string>                     included_resources;
 
-	for (auto &pass : render_graph_.pass_nodes_)
+	// Every pass contributes to the description, a live pass reading the output of a culled one still needs its format and usage
+	for (uint32_t pass_index = 0; pass_index < render_graph_.pass_nodes_.size(); ++pass_index)
 	{
-		auto &info = pass.get_pass_info();
+		auto &info = render_graph_.pass_nodes_[pass_index].get_pass_info();
+
+		if (included_passes[pass_index])
+		{
+			for (const auto &bindable : info.bindables)
+			{
+				included_resources.insert(bindable.name);
+			}
+			for (const auto &attachment : info.attachments)
+			{
+				included_resources.insert(attachment.name);
+			}
+		}
 
 		for (auto &bindable : info.bindables)
 		{
-			auto &res_info = resource_create_infos_[bindable.name];
+			auto &res_info = resource_create_infos[bindable.name];
 			switch (bindable.type)
 			{
 				case BindableType::kSampled:
@@ -182,7 +298,7 @@ void GraphBuilder::collect_resource_create_info()
 		// Collect attachment info
 		for (const auto &attachment : info.attachments)
 		{
-			auto &res_info       = resource_create_infos_[attachment.name];
+			auto &res_info       = resource_create_infos[attachment.name];
 			res_info.format      = attachment.format;
 			res_info.extent_desc = attachment.extent_desc;
 
@@ -210,6 +326,10 @@ void GraphBuilder::collect_resource_create_info()
 			res_info.array_layers = std::max(res_info.array_layers, attachment.image_properties.array_layers);
 		}
 	}
+
+	std::erase_if(resource_create_infos, [&](const auto &entry) { return !included_resources.contains(entry.first); });
+
+	return resource_create_infos;
 }
 
 void GraphBuilder::create_graph_resource()
@@ -227,7 +347,8 @@ void GraphBuilder::create_graph_resource()
 		{
 			backend::BufferBuilder buffer_builder{info.buffer_size};
 			buffer_builder.with_usage(info.buffer_usage)
-			    .with_vma_usage(VMA_MEMORY_USAGE_CPU_TO_GPU);
+			    .with_vma_usage(VMA_MEMORY_USAGE_CPU_TO_GPU)
+			    .with_memory_category(backend::allocated::MemoryCategory::kRenderGraph);
 			render_graph_.buffers_.push_back(buffer_builder.build_unique(device));
 			render_graph_.buffers_.back()->set_debug_name(name);
 			ResourceHandle handle{
@@ -263,7 +384,8 @@ void GraphBuilder::create_graph_resource()
 			    .with_usage(info.image_usage)
 			    .with_array_layers(info.array_layers)
 			    .with_flags(info.image_flags)
-			    .with_vma_usage(VMA_MEMORY_USAGE_GPU_ONLY);
+			    .with_vma_usage(VMA_MEMORY_USAGE_GPU_ONLY)
+			    .with_memory_category(backend::allocated::MemoryCategory::kRenderGraph);
 
 			render_graph_.images_.push_back(image_builder.build_unique(device));
 			base_images[name] = render_graph_.images_.back().get();
@@ -271,10 +393,17 @@ void GraphBuilder::create_graph_resource()
 	}
 
 	// Third: Create image views
-	for (auto &pass : render_graph_.pass_nodes_)
+	for (uint32_t pass_index = 0; pass_index < render_graph_.pass_nodes_.size(); ++pass_index)
 	{
+		if (!allocated_passes_[pass_index])
+		{
+			continue;
+		}
+
+		auto                           &pass = render_graph_.pass_nodes_[pass_index];
 		auto                           &info = pass.get_pass_info();
 		std::vector<backend::ImageView> rt_image_views;
+		bool                            dynamic_resolution = false;
 		for (auto &attachment : info.attachments)
 		{
 			auto &res_info = resource_create_infos_[attachment.name];
@@ -282,6 +411,7 @@ void GraphBuilder::create_graph_resource()
 			{
 				continue;
 			}
+			dynamic_resolution |= res_info.extent_desc.is_dynamic();
 			backend::Image *image = base_images[attachment.name];
 			if (!image)
 			{
@@ -309,6 +439,11 @@ void GraphBuilder::create_graph_resource()
 			{
 				continue;
 			}
+			// Compute passes writing dynamically sized images only process the rendered sub-rect
+			if (bindable.type == BindableType::kStorageWrite || bindable.type == BindableType::kStorageReadWrite)
+			{
+				dynamic_resolution |= res_info.extent_desc.is_dynamic();
+			}
 			if (bindable.image_properties.n_use_layer == 0)
 			{
 				bindable.image_properties.n_use_layer = res_info.array_layers;
@@ -345,6 +480,8 @@ void GraphBuilder::create_graph_resource()
 			render_graph_.resources_[handle] = resource_info;
 			render_graph_.image_views_.push_back(std::move(image_view));
 		}
+
+		pass.set_dynamic_resolution(dynamic_resolution);
 	}
 }
 
@@ -355,23 +492,61 @@ void GraphBuilder::build_pass_batches()
 
 	auto [adjacency_list, indegree] = build_dependency_graph();
 
+	live_passes_ = find_live_passes(adjacency_list);
+
+	// Edges from culled producers do not hold back their consumers
+	for (uint32_t producer = 0; producer < adjacency_list.size(); ++producer)
+	{
+		if (live_passes_[producer])
+		{
+			continue;
+		}
+		for (uint32_t consumer : adjacency_list[producer])
+		{
+			--indegree[consumer];
+		}
+	}
+
+	for (uint32_t i = 0; i < render_graph_.pass_nodes_.size(); ++i)
+	{
+		auto &pass = render_graph_.pass_nodes_[i];
+		pass.reset_build_state();
+		if (live_passes_[i] && pass.is_present())
+		{
+			pass.add_attachment_memory_barrier(0, get_present_attachment_barrier());
+		}
+	}
+
 	create_resources();
 
-	// Topological sort and build pass batches
-	std::queue<uint32_t> zero_indegree_queue;
+	assign_async_compute(adjacency_list);
+
+	// Topological sort, keeping one ready list per queue. Within a queue, passes run in the order they were added.
+	using ReadyQueue = std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<>>;
+	ReadyQueue graphics_ready;
+	ReadyQueue compute_ready;
+
+	auto push_ready = [&](uint32_t node) {
+		(render_graph_.pass_nodes_[node].is_async_compute() ? compute_ready : graphics_ready).push(node);
+	};
+
 	for (uint32_t i = 0; i < indegree.size(); ++i)
 	{
-		if (indegree[i] == 0)
+		if (live_passes_[i] && indegree[i] == 0)
 		{
-			zero_indegree_queue.push(i);
+			push_ready(i);
 		}
 	}
 
 	uint32_t processed_count = 0;
-	while (!zero_indegree_queue.empty())
+	while (!graphics_ready.empty() || !compute_ready.empty())
 	{
-		uint32_t node = zero_indegree_queue.front();
-		zero_indegree_queue.pop();
+		// Async compute is submitted as soon as it is ready, so that the graphics work recorded after it can overlap with it.
+		// This ends a graphics batch early, but costs one submission at most per wave of async compute work.
+		auto &ready_queue = compute_ready.empty() ? graphics_ready : compute_ready;
+
+		uint32_t node = ready_queue.top();
+		ready_queue.pop();
 		++processed_count;
 
 		PassNode &current_pass = render_graph_.pass_nodes_[node];
@@ -382,14 +557,14 @@ void GraphBuilder::build_pass_batches()
 
 		for (uint32_t neighbor : adjacency_list[node])
 		{
-			if (--indegree[neighbor] == 0)
+			if (--indegree[neighbor] == 0 && live_passes_[neighbor])
 			{
-				zero_indegree_queue.push(neighbor);
+				push_ready(neighbor);
 			}
 		}
 	}
 
-	if (processed_count != render_graph_.pass_nodes_.size())
+	if (processed_count != static_cast<uint32_t>(std::ranges::count(live_passes_, true)))
 	{
 		throw std::runtime_error("Cycle detected in the pass dependency graph.");
 	}
@@ -459,6 +634,98 @@ std::pair<std::vector<std::unordered_set<uint32_t>>, std::vector<uint32_t>> Grap
 	return {adjacency_list, indegree};
 }
 
+std::vector<bool> GraphBuilder::find_live_passes(const std::vector<std::unordered_set<uint32_t>> &adjacency_list) const
+{
+	const auto &pass_nodes = render_graph_.pass_nodes_;
+
+	std::vector<std::vector<uint32_t>> producers(pass_nodes.size());
+	for (uint32_t producer = 0; producer < adjacency_list.size(); ++producer)
+	{
+		for (uint32_t consumer : adjacency_list[producer])
+		{
+			producers[consumer].push_back(producer);
+		}
+	}
+
+	std::vector<bool>    live_passes(pass_nodes.size(), false);
+	std::queue<uint32_t> live_queue;
+	for (uint32_t i = 0; i < pass_nodes.size(); ++i)
+	{
+		if (enabled_passes_[i] && pass_nodes[i].is_sink())
+		{
+			live_passes[i] = true;
+			live_queue.push(i);
+		}
+	}
+
+	// A disabled producer is culled even if a live pass reads its output, no barrier orders the read after an earlier
+	// write then and the contents are undefined, so a consumer that needs them has to be disabled along with it
+	while (!live_queue.empty())
+	{
+		uint32_t node = live_queue.front();
+		live_queue.pop();
+
+		for (uint32_t producer : producers[node])
+		{
+			if (!live_passes[producer] && enabled_passes_[producer])
+			{
+				live_passes[producer] = true;
+				live_queue.push(producer);
+			}
+		}
+	}
+
+	return live_passes;
+}
+
+void GraphBuilder::assign_async_compute(const std::vector<std::unordered_set<uint32_t>> &adjacency_list)
+{
+	auto          &pass_nodes = render_graph_.pass_nodes_;
+	const uint32_t pass_count = static_cast<uint32_t>(pass_nodes.size());
+
+	// Without a dedicated queue family both queues are the same, splitting batches would only add semaphores
+	const bool has_async_queue = render_context_.get_queue_family_index(vk::QueueFlagBits::eCompute) !=
+	                             render_context_.get_queue_family_index(vk::QueueFlagBits::eGraphics);
+
+	// reachable[i][j] is set if live pass j depends on pass i, directly or through other live passes
+	std::vector<std::vector<bool>> reachable(pass_count, std::vector<bool>(pass_count, false));
+	for (uint32_t i = 0; has_async_queue && i < pass_count; ++i)
+	{
+		std::vector<uint32_t> stack{i};
+		while (!stack.empty())
+		{
+			uint32_t node = stack.back();
+			stack.pop_back();
+
+			for (uint32_t consumer : adjacency_list[node])
+			{
+				if (live_passes_[consumer] && !reachable[i][consumer])
+				{
+					reachable[i][consumer] = true;
+					stack.push_back(consumer);
+				}
+			}
+		}
+	}
+
+	for (uint32_t i = 0; i < pass_count; ++i)
+	{
+		bool is_async_compute = false;
+
+		// Resources written outside the graph are not handed over between the queues
+		if (has_async_queue && live_passes_[i] && pass_nodes[i].get_type() == PassType::kCompute && !pass_nodes[i].has_side_effects())
+		{
+			for (uint32_t j = 0; j < pass_count && !is_async_compute; ++j)
+			{
+				is_async_compute = live_passes_[j] && pass_nodes[j].get_type() != PassType::kCompute &&
+				                   !reachable[i][j] && !reachable[j][i];
+			}
+		}
+
+		pass_nodes[i].set_async_compute(is_async_compute);
+	}
+}
+
 void GraphBuilder::process_pass_resources(uint32_t node, PassNode &pass, ResourceStateTracker &tracker, PassBatchBuilder &batch_builder)
 {
 	const PassInfo &pass_info = pass.get_pass_info();
@@ -485,13 +752,13 @@ void GraphBuilder::process_pass_resources(uint32_t node, PassNode &pass, Resourc
 		barrier.src_stage_mask  = state.usage_state.stage_mask;
 		barrier.dst_stage_mask  = new_state.stage_mask;
 
-		if (state.last_user != -1 && render_graph_.pass_nodes_[state.last_user].get_type() != pass.get_type())
+		if (state.last_user != -1 && render_graph_.pass_nodes_[state.last_user].get_batch_type() != pass.get_batch_type())
 		{
-			batch_builder.set_batch_dependency(render_graph_.pass_nodes_[state.last_user].get_batch_index());
+			batch_builder.set_batch_dependency(render_graph_.pass_nodes_[state.last_user].get_batch_index(), new_state.stage_mask);
 			auto &prev_pass = render_graph_.pass_nodes_[state.last_user];
 
 			MemoryBarrierBase release_barrier;
-			if (pass.get_type() == PassType::kCompute)
+			if (pass.get_batch_type() == PassType::kCompute)
 			{
 				release_barrier.old_queue_family = render_context_.get_queue_family_index(vk::QueueFlagBits::eGraphics);
 				release_barrier.new_queue_family = render_context_.get_queue_family_index(vk::QueueFlagBits::eCompute);
@@ -499,7 +766,7 @@ void GraphBuilder::process_pass_resources(uint32_t node, PassNode &pass, Resourc
 				barrier.old_queue_family = render_context_.get_queue_family_index(vk::QueueFlagBits::eGraphics);
 				barrier.new_queue_family = render_context_.get_queue_family_index(vk::QueueFlagBits::eCompute);
 			}
-			else if (pass.get_type() == PassType::kRaster)
+			else
 			{
 				release_barrier.old_queue_family = render_context_.get_queue_family_index(vk::QueueFlagBits::eCompute);
 				release_barrier.new_queue_family = render_context_.get_queue_family_index(vk::QueueFlagBits::eGraphics);
@@ -508,13 +775,12 @@ void GraphBuilder::process_pass_resources(uint32_t node, PassNode &pass, Resourc
 				barrier.new_queue_family = render_context_.get_queue_family_index(vk::QueueFlagBits::eGraphics);
 			}
 
+			// The release only covers the producing queue and the acquire only the consuming one,
+			// the semaphore between the batches orders them
 			release_barrier.src_stage_mask  = state.usage_state.stage_mask;
 			release_barrier.src_access_mask = state.usage_state.access_mask;
-
-			/* release_barrier.dst_stage_mask  = vk::PipelineStageFlagBits2::eBottomOfPipe;
-			 release_barrier.dst_access_mask = vk::AccessFlagBits2::eNone;*/
-			release_barrier.dst_stage_mask  = new_state.stage_mask;
-			release_barrier.dst_access_mask = new_state.access_mask;
+			release_barrier.dst_stage_mask  = vk::PipelineStageFlagBits2::eNone;
+			release_barrier.dst_access_mask = vk::AccessFlagBits2::eNone;
 
 			if (is_buffer(bindable.type))
 			{
@@ -543,8 +809,9 @@ void GraphBuilder::process_pass_resources(uint32_t node, PassNode &pass, Resourc
 				prev_pass.add_release_barrier(handle, image_barrier);
 			}
 
-			// barrier.src_stage_mask  = new_state.stage_mask;
-			// barrier.src_access_mask = vk::AccessFlagBits2::eNone;
+			// Starting from the stages the semaphore wait blocks chains the acquire to it
+			barrier.src_stage_mask  = new_state.stage_mask;
+			barrier.src_access_mask = vk::AccessFlagBits2::eNone;
 		}
 
 		if (is_buffer(bindable.type))
@@ -608,42 +875,111 @@ GraphBuilder::GraphBuilder(RenderGraph &render_graph, RenderContext &render_cont
 
 void GraphBuilder::build()
 {
-	if (is_dirty_)
+	XIHE_TRACE_ZONE("Build render graph");
+
+	// Evaluating the predicates is cheap, so this can be called every frame to pick up passes being toggled
+	std::vector<bool> enabled_passes(render_graph_.pass_nodes_.size());
+	for (uint32_t i = 0; i < enabled_passes.size(); ++i)
+	{
+		enabled_passes[i] = render_graph_.pass_nodes_[i].is_enabled();
+	}
+
+	if (enabled_passes != enabled_passes_)
+	{
+		enabled_passes_ = std::move(enabled_passes);
+		is_dirty_       = true;
+	}
+
+	if (!is_dirty_)
 	{
-		build_pass_batches();
+		return;
 	}
+
+	build_pass_batches();
+	prewarm_pipelines();
+
+	auto overlap = render_graph_.estimate_queue_overlap();
+	LOGI("Scheduled {} graphics and {} async compute batches, {} passes on async compute, {} cross-queue waits, {} ownership transfers, "
+	     "estimated overlap {:.0f} of {:.0f} passes",
+	     overlap.graphics_batch_count, overlap.compute_batch_count, overlap.async_compute_pass_count,
+	     overlap.cross_queue_wait_count, overlap.ownership_transfer_count, overlap.get_overlap(), overlap.serial_cost);
+
 	is_dirty_ = false;
 }
 
+void GraphBuilder::prewarm_pipelines()
+{
+	auto &device = render_context_.get_device();
+
+	// Passes without a render target draw into the one created by RenderTarget::kDefaultCreateFunc
+	AttachmentsState swapchain_attachments;
+	swapchain_attachments.color_attachment_formats = {render_context_.get_swapchain().get_format()};
+	swapchain_attachments.depth_attachment_format  = common::get_suitable_depth_format(device.get_gpu().get_handle());
+
+	PipelineBuildScheduler scheduler{device, std::thread::hardware_concurrency()};
+
+	auto report = scheduler.build(render_graph_.pass_batches_, swapchain_attachments);
+
+	LOGI("Prebuilt {} pipelines in {:.2f} ms (critical path {:.2f} ms, serial {:.2f} ms), {} cached, {} skipped, {} failed",
+	     report.built_count, report.total_ms, report.critical_path_ms, report.serial_ms,
+	     report.cached_count, report.skipped_count, report.failed_count);
+}
+
 void GraphBuilder::recreate_resources()
 {
+	release_graph_resources();
+
+	create_graph_resource();
+}
+
+void GraphBuilder::release_graph_resources()
+{
+	// Views are released before the images they were created from
+	for (auto &pass : render_graph_.pass_nodes_)
+	{
+		render_context_.release_deferred(pass.release_render_target());
+	}
+	for (auto &image_view : render_graph_.image_views_)
+	{
+		render_context_.release_deferred(std::move(image_view));
+	}
+	for (auto &image : render_graph_.images_)
+	{
+		render_context_.release_deferred(std::move(image));
+	}
+	for (auto &buffer : render_graph_.buffers_)
+	{
+		render_context_.release_deferred(std::move(buffer));
+	}
+
 	render_graph_.image_views_.clear();
 	render_graph_.images_.clear();
+	render_graph_.buffers_.clear();
 	render_graph_.resources_.clear();
-
-	create_graph_resource();
 }
 
 void GraphBuilder::PassBatchBuilder::process_pass(PassNode *pass)
 {
-	if (current_batch_.type != pass->get_type() && !current_batch_.pass_nodes.empty())
+	if (current_batch_.type != pass->get_batch_type() && !current_batch_.pass_nodes.empty())
 	{
 		finalize_current_batch();
 	}
 
 	if (current_batch_.pass_nodes.empty())
 	{
-		current_batch_.type = pass->get_type();
+		current_batch_.type = pass->get_batch_type();
 	}
 
 	current_batch_.pass_nodes.push_back(pass);
 	pass->set_batch_index(batches_.size());
 }
 
-void GraphBuilder::PassBatchBuilder::set_batch_dependency(int64_t wait_batch_index)
+void GraphBuilder::PassBatchBuilder::set_batch_dependency(int64_t wait_batch_index, vk::PipelineStageFlags2 wait_stage_mask)
 {
+	// Batches of a queue signal increasing timeline values, waiting for the latest one covers the earlier ones
 	current_batch_.wait_batch_index =
 	    std::max(current_batch_.wait_batch_index, wait_batch_index);
+	current_batch_.wait_stage_mask |= wait_stage_mask;
 }
 
 std::vector<PassBatch> GraphBuilder::PassBatchBuilder::finalize()
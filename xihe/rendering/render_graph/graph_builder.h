@@ -63,10 +63,26 @@ class GraphBuilder
 
 		PassBuilder &copy(uint32_t attachment_index, std::unique_ptr<backend::ImageView> &&dst_image_view, const vk::ImageCopy &copy_region);
 
+		/**
+		 * \brief Copies an external attachment to host memory every frame the pass runs, the callback receives it
+		 *        once the frame is reused, see ReadBackManager
+		 */
+		PassBuilder &read_back(uint32_t attachment_index, ReadBackCallback &&callback);
+
 		PassBuilder &present();
 
 		PassBuilder &gui(Gui *gui);
 
+		/**
+		 * \brief The pass and everything only it depends on are culled while the predicate returns false
+		 */
+		PassBuilder &enabled(std::function<bool()> &&enabled_predicate);
+
+		/**
+		 * \brief The pass writes resources the graph does not track, it is kept as a sink and never moved to the async compute queue
+		 */
+		PassBuilder &side_effects();
+
 		void finalize();
 
 	  private:
@@ -76,6 +92,8 @@ class GraphBuilder
 		std::unique_ptr<RenderPass> render_pass_;
 		bool                        is_present_{false};
 		Gui                        *gui_{nullptr};
+		std::function<bool()>       enabled_predicate_;
+		bool                        has_side_effects_{false};
 
 		std::unique_ptr<PassNode::ImageCopyInfo> image_read_back_;
 	};
@@ -88,15 +106,25 @@ class GraphBuilder
 	}
 	void build();
 
+	/// Recreates the swapchain-relative resources, the previous ones are released once the frames using them completed
 	void recreate_resources();
 
+	/**
+	 * \brief Builds the pipelines of all passes that can describe them on worker threads, see PipelineBuildScheduler
+	 */
+	void prewarm_pipelines();
+
   private:
 	class PassBatchBuilder
 	{
 	  public:
 		void process_pass(PassNode *pass);
 
-		void set_batch_dependency(int64_t wait_batch_index);
+		/**
+		 * \brief Makes the current batch wait for a batch of the other queue
+		 * \param wait_stage_mask Stages of the current batch that consume the results of that batch
+		 */
+		void set_batch_dependency(int64_t wait_batch_index, vk::PipelineStageFlags2 wait_stage_mask);
 
 		std::vector<PassBatch> finalize();
 
@@ -112,19 +140,37 @@ class GraphBuilder
 	              std::unique_ptr<RenderPass>              &&render_pass,
 	              bool                                       is_present,
 	              std::unique_ptr<PassNode::ImageCopyInfo> &&image_read_back,
-	              Gui                                       *gui = nullptr);
+	              Gui                                       *gui               = nullptr,
+	              std::function<bool()>                    &&enabled_predicate = {},
+	              bool                                       has_side_effects  = false);
 
+	/// Allocates the resources of the live passes and of those allocated for before, unless they all exist already
 	void create_resources();
 
-	void collect_resource_create_info();
+	std::unordered_map<std::string, ResourceCreateInfo> collect_resource_create_info(const std::vector<bool> &included_passes);
 
 	void create_graph_resource();
 
+	/// Hands the resources of the graph to the render context, frames in flight may still use them
+	void release_graph_resources();
+
 	void build_pass_batches();
 
 	std::pair<std::vector<std::unordered_set<uint32_t>>, std::vector<uint32_t>>
 	    build_dependency_graph() const;
 
+	/**
+	 * \brief Walks the dependency graph backwards from the enabled sinks, through enabled passes only
+	 * \return For each pass, whether it contributes to a sink
+	 */
+	std::vector<bool> find_live_passes(const std::vector<std::unordered_set<uint32_t>> &adjacency_list) const;
+
+	/**
+	 * \brief Moves the live compute passes to the async compute queue if some live graphics pass neither depends on them
+	 *        nor is depended on by them, the others stay on the graphics queue where they need no semaphores or ownership transfers
+	 */
+	void assign_async_compute(const std::vector<std::unordered_set<uint32_t>> &adjacency_list);
+
 	void process_pass_resources(
 	    uint32_t              node,
 	    PassNode             &pass,
@@ -138,6 +184,14 @@ class GraphBuilder
 
 	std::unordered_map<std::string, ResourceHandle> resource_handles_;
 
+	// Results of the enabled predicates at the last build, a change triggers a rebuild
+	std::vector<bool> enabled_passes_;
+
+	std::vector<bool> live_passes_;
+
+	// Passes whose resources and render targets exist, every pass live since the last allocation
+	std::vector<bool> allocated_passes_;
+
 	bool is_dirty_{false};
 };
 }        // namespace xihe::rendering
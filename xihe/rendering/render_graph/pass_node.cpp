@@ -2,6 +2,9 @@
 
 #include "render_graph.h"
 
+#include "common/trace.h"
+#include "rendering/dynamic_resolution.h"
+
 namespace xihe::rendering
 {
 ExtentDescriptor ExtentDescriptor::SwapchainRelative(float width_scale, float height_scale, uint32_t depth)
@@ -13,6 +16,13 @@ ExtentDescriptor ExtentDescriptor::SwapchainRelative(float width_scale, float he
 	return desc;
 }
 
+ExtentDescriptor ExtentDescriptor::DynamicRelative(float width_scale, float height_scale, uint32_t depth)
+{
+	ExtentDescriptor desc = SwapchainRelative(width_scale, height_scale, depth);
+	desc.type_            = Type::kDynamicRelative;
+	return desc;
+}
+
 vk::Extent3D ExtentDescriptor::calculate(const vk::Extent2D &swapchain_extent) const
 {
 	switch (type_)
@@ -20,6 +30,7 @@ vk::Extent3D ExtentDescriptor::calculate(const vk::Extent2D &swapchain_extent) c
 		case Type::kFixed:
 			return extent_;
 		case Type::kSwapchainRelative:
+		case Type::kDynamicRelative:
 			return vk::Extent3D{
 			    static_cast<uint32_t>(swapchain_extent.width * scale_x_),
 			    static_cast<uint32_t>(swapchain_extent.height * scale_y_),
@@ -29,6 +40,11 @@ vk::Extent3D ExtentDescriptor::calculate(const vk::Extent2D &swapchain_extent) c
 	}
 }
 
+bool ExtentDescriptor::is_dynamic() const
+{
+	return type_ == Type::kDynamicRelative;
+}
+
 ExtentDescriptor::ExtentDescriptor(Type t, const vk::Extent3D &e) :
     type_(t), extent_(e)
 {}
@@ -40,10 +56,19 @@ PassNode::PassNode(RenderGraph &render_graph, std::string name, PassInfo &&pass_
 
 void PassNode::execute(backend::CommandBuffer &command_buffer, RenderTarget &render_target, RenderFrame &render_frame)
 {
+	XIHE_TRACE_ZONE(name_);
+
 	backend::ScopedDebugLabel subpass_debug_label{command_buffer, name_.c_str()};
 
+	// Pipeline statistics are only counted on the graphics queue, where queries may use graphics stages
+	auto          &gpu_profiler = render_frame.get_gpu_profiler();
+	const uint32_t gpu_scope    = gpu_profiler.begin_scope(command_buffer, name_, 1, get_batch_type() == PassType::kRaster);
+
 	std::vector<ShaderBindable> shader_bindable(bindables_.size());
 
+	// All transitions into the pass are recorded with a single barrier call
+	auto &barrier_planner = render_graph_.get_barrier_planner();
+
 	for (const auto &[index, input_info] : bindables_)
 	{
 		shader_bindable[index] = render_graph_.get_resource_bindable(input_info.handle);
@@ -55,13 +80,20 @@ void PassNode::execute(backend::CommandBuffer &command_buffer, RenderTarget &ren
 
 		if (shader_bindable[index].is_buffer())
 		{
-			auto &buffer = shader_bindable[index].buffer();
-			// todo offset and size
-			command_buffer.buffer_memory_barrier(buffer, 0, buffer.get_size(), std::get<common::BufferMemoryBarrier>(input_info.barrier.value()));
+			auto       &buffer         = shader_bindable[index].buffer();
+			const auto &buffer_barrier = std::get<common::BufferMemoryBarrier>(input_info.barrier.value());
+
+			// A pass that declares a size only touches that range, ownership transfers must cover the same range on both queues
+			vk::DeviceSize size = buffer.get_size();
+			if (pass_info_.bindables[index].buffer_size != 0 && buffer_barrier.old_queue_family == buffer_barrier.new_queue_family)
+			{
+				size = std::min<vk::DeviceSize>(pass_info_.bindables[index].buffer_size, size);
+			}
+			barrier_planner.add_buffer_barrier(buffer, 0, size, buffer_barrier);
 		}
 		else
 		{
-			command_buffer.image_memory_barrier(shader_bindable[index].image_view(), std::get<common::ImageMemoryBarrier>(input_info.barrier.value()));
+			barrier_planner.add_image_barrier(shader_bindable[index].image_view(), std::get<common::ImageMemoryBarrier>(input_info.barrier.value()));
 		}
 	}
 
@@ -70,19 +102,18 @@ void PassNode::execute(backend::CommandBuffer &command_buffer, RenderTarget &ren
 	{
 		if (std::holds_alternative<common::ImageMemoryBarrier>(barrier))
 		{
-			command_buffer.image_memory_barrier(output_views[index], std::get<common::ImageMemoryBarrier>(barrier));
-		}
-		else
-		{
-
+			barrier_planner.add_image_barrier(output_views[index], std::get<common::ImageMemoryBarrier>(barrier));
 		}
 	}
 
+	barrier_planner.flush(command_buffer);
+
 	if (type_ == PassType::kRaster)
 	{
-		command_buffer.begin_rendering(render_target);
+		command_buffer.begin_rendering(render_target, {}, get_render_area(render_target, render_frame));
 	}
 
+	render_pass_->set_render_scale(dynamic_resolution_ ? render_frame.get_render_scale() : 1.0f);
 	render_pass_->execute(command_buffer, render_frame, shader_bindable);
 
 	if (gui_)
@@ -103,65 +134,85 @@ void PassNode::execute(backend::CommandBuffer &command_buffer, RenderTarget &ren
 			memory_barrier.src_stage_mask  = vk::PipelineStageFlagBits2::eColorAttachmentOutput;
 			memory_barrier.dst_stage_mask  = vk::PipelineStageFlagBits2::eBottomOfPipe;
 
-			command_buffer.image_memory_barrier(views[0], memory_barrier);
+			barrier_planner.add_image_barrier(views[0], memory_barrier);
 		}
 	}
 
+	render_pass_->end_execute(command_buffer, render_frame);
+
 	if (image_read_back_)
 	{
-		{
-			common::ImageMemoryBarrier memory_barrier{};
-			memory_barrier.new_layout      = vk::ImageLayout::eTransferDstOptimal;
-			memory_barrier.dst_access_mask = vk::AccessFlagBits2::eTransferWrite;
-			memory_barrier.src_stage_mask  = vk::PipelineStageFlagBits2::eAllCommands;
-			memory_barrier.dst_stage_mask  = vk::PipelineStageFlagBits2::eAllCommands;
-
-			command_buffer.image_memory_barrier(*image_read_back_->image_view, memory_barrier);
-		}
+		// The present transition may target the attachment being read back, it has to happen first
+		barrier_planner.flush(command_buffer);
 
 		assert(image_read_back_->attachment_index < render_target.get_views().size());
 		const auto &src_image_view = render_target.get_views()[image_read_back_->attachment_index];
 
-		const vk::ImageLayout  layout      = std::get<common::ImageMemoryBarrier>(attachment_barriers_[image_read_back_->attachment_index]).new_layout;
-		const vk::AccessFlags2 aspect_mask = std::get<common::ImageMemoryBarrier>(attachment_barriers_[image_read_back_->attachment_index]).dst_access_mask;
-
-		{
-			common::ImageMemoryBarrier memory_barrier;
-			memory_barrier.old_layout      = layout;
-			memory_barrier.src_access_mask = aspect_mask;
-			memory_barrier.new_layout      = vk::ImageLayout::eTransferSrcOptimal;
-			memory_barrier.dst_access_mask = vk::AccessFlagBits2::eTransferRead;
-			memory_barrier.src_stage_mask  = vk::PipelineStageFlagBits2::eAllCommands;
-			// todo
-			memory_barrier.dst_stage_mask  = vk::PipelineStageFlagBits2::eAllCommands;
-
-			command_buffer.image_memory_barrier(src_image_view, memory_barrier);	
-		}
+		const auto &attachment_barrier = std::get<common::ImageMemoryBarrier>(attachment_barriers_[image_read_back_->attachment_index]);
 
-		command_buffer.copy_image(src_image_view.get_image(), image_read_back_->image_view->get_image(), {image_read_back_->copy_region});
+		const vk::ImageLayout         layout      = attachment_barrier.new_layout;
+		const vk::AccessFlags2        access_mask = attachment_barrier.dst_access_mask;
+		const vk::PipelineStageFlags2 stage_mask  = attachment_barrier.dst_stage_mask;
 
+		if (image_read_back_->callback)
 		{
-			common::ImageMemoryBarrier memory_barrier;
-			memory_barrier.old_layout      = vk::ImageLayout::eTransferSrcOptimal;
-			memory_barrier.src_access_mask = vk::AccessFlagBits2::eTransferRead;
-			memory_barrier.new_layout      = layout;
-			memory_barrier.dst_access_mask = aspect_mask;
-			memory_barrier.src_stage_mask  = vk::PipelineStageFlagBits2::eAllCommands;
-			memory_barrier.dst_stage_mask  = vk::PipelineStageFlagBits2::eAllCommands;
-
-			command_buffer.image_memory_barrier(src_image_view, memory_barrier);
+			// The copy is recorded after the flush above, the manager places its own barriers around it
+			auto callback = image_read_back_->callback;
+			render_frame.get_read_back_manager().read_back(command_buffer, src_image_view, layout, stage_mask, access_mask, std::move(callback));
 		}
-
+		else
 		{
-			common::ImageMemoryBarrier memory_barrier;
-			memory_barrier.old_layout      = vk::ImageLayout::eTransferDstOptimal;
-			memory_barrier.src_access_mask = vk::AccessFlagBits2::eTransferWrite;
-			memory_barrier.new_layout      = vk::ImageLayout::eShaderReadOnlyOptimal;
-			memory_barrier.dst_access_mask = vk::AccessFlagBits2::eHostWrite | vk::AccessFlagBits2::eTransferWrite;
-			memory_barrier.src_stage_mask  = vk::PipelineStageFlagBits2::eAllCommands;
-			memory_barrier.dst_stage_mask  = vk::PipelineStageFlagBits2::eAllCommands;
-
-			command_buffer.image_memory_barrier(*image_read_back_->image_view, memory_barrier);
+			{
+				// Orders the copy after the one of the previous frame, the host reads are covered by the frame fence
+				common::ImageMemoryBarrier memory_barrier{};
+				memory_barrier.new_layout      = vk::ImageLayout::eTransferDstOptimal;
+				memory_barrier.src_access_mask = vk::AccessFlagBits2::eTransferWrite;
+				memory_barrier.dst_access_mask = vk::AccessFlagBits2::eTransferWrite;
+				memory_barrier.src_stage_mask  = vk::PipelineStageFlagBits2::eTransfer;
+				memory_barrier.dst_stage_mask  = vk::PipelineStageFlagBits2::eTransfer;
+
+				barrier_planner.add_image_barrier(*image_read_back_->image_view, memory_barrier);
+			}
+
+			{
+				common::ImageMemoryBarrier memory_barrier;
+				memory_barrier.old_layout      = layout;
+				memory_barrier.src_access_mask = access_mask;
+				memory_barrier.new_layout      = vk::ImageLayout::eTransferSrcOptimal;
+				memory_barrier.dst_access_mask = vk::AccessFlagBits2::eTransferRead;
+				memory_barrier.src_stage_mask  = stage_mask;
+				memory_barrier.dst_stage_mask  = vk::PipelineStageFlagBits2::eTransfer;
+
+				barrier_planner.add_image_barrier(src_image_view, memory_barrier);
+			}
+
+			barrier_planner.flush(command_buffer);
+
+			command_buffer.copy_image(src_image_view.get_image(), image_read_back_->image_view->get_image(), {image_read_back_->copy_region});
+
+			{
+				common::ImageMemoryBarrier memory_barrier;
+				memory_barrier.old_layout      = vk::ImageLayout::eTransferSrcOptimal;
+				memory_barrier.src_access_mask = vk::AccessFlagBits2::eTransferRead;
+				memory_barrier.new_layout      = layout;
+				memory_barrier.dst_access_mask = access_mask;
+				memory_barrier.src_stage_mask  = vk::PipelineStageFlagBits2::eTransfer;
+				memory_barrier.dst_stage_mask  = stage_mask;
+
+				barrier_planner.add_image_barrier(src_image_view, memory_barrier);
+			}
+
+			{
+				common::ImageMemoryBarrier memory_barrier;
+				memory_barrier.old_layout      = vk::ImageLayout::eTransferDstOptimal;
+				memory_barrier.src_access_mask = vk::AccessFlagBits2::eTransferWrite;
+				memory_barrier.new_layout      = vk::ImageLayout::eShaderReadOnlyOptimal;
+				memory_barrier.dst_access_mask = vk::AccessFlagBits2::eHostRead | vk::AccessFlagBits2::eTransferWrite;
+				memory_barrier.src_stage_mask  = vk::PipelineStageFlagBits2::eTransfer;
+				memory_barrier.dst_stage_mask  = vk::PipelineStageFlagBits2::eHost | vk::PipelineStageFlagBits2::eTransfer;
+
+				barrier_planner.add_image_barrier(*image_read_back_->image_view, memory_barrier);
+			}
 		}
 	}
 
@@ -169,15 +220,18 @@ void PassNode::execute(backend::CommandBuffer &command_buffer, RenderTarget &ren
 	{
 		if (std::holds_alternative<common::ImageMemoryBarrier>(barrier))
 		{
-			command_buffer.image_memory_barrier(render_graph_.get_resource_bindable(handle).image_view(), std::get<common::ImageMemoryBarrier>(barrier));
+			barrier_planner.add_image_barrier(render_graph_.get_resource_bindable(handle).image_view(), std::get<common::ImageMemoryBarrier>(barrier));
 		}
 		else
 		{
+			// Ownership transfers cover the whole buffer, matching the acquire in the consuming pass
 			auto &buffer = render_graph_.get_resource_bindable(handle).buffer();
-			// todo offset and size
-			command_buffer.buffer_memory_barrier(buffer, 0, buffer.get_size(), std::get<common::BufferMemoryBarrier>(barrier));
+			barrier_planner.add_buffer_barrier(buffer, 0, buffer.get_size(), std::get<common::BufferMemoryBarrier>(barrier));
 		}
 	}
+
+	// The barriers left pending are recorded together with those of the next pass, or at the end of the batch
+	gpu_profiler.end_scope(command_buffer, gpu_scope);
 }
 
 PassInfo &PassNode::get_pass_info()
@@ -195,11 +249,100 @@ std::string PassNode::get_name() const
 	return name_;
 }
 
+void PassNode::set_present(bool is_present)
+{
+	is_present_ = is_present;
+}
+
+bool PassNode::is_present() const
+{
+	return is_present_;
+}
+
+void PassNode::set_side_effects(bool has_side_effects)
+{
+	has_side_effects_ = has_side_effects;
+}
+
+bool PassNode::has_side_effects() const
+{
+	return has_side_effects_;
+}
+
+void PassNode::set_enabled_predicate(std::function<bool()> &&enabled_predicate)
+{
+	enabled_predicate_ = std::move(enabled_predicate);
+}
+
+bool PassNode::is_enabled() const
+{
+	return !enabled_predicate_ || enabled_predicate_();
+}
+
+bool PassNode::is_sink() const
+{
+	if (is_present_ || image_read_back_ || has_side_effects_)
+	{
+		return true;
+	}
+
+	// Raster passes without attachments draw into the render target of the render frame
+	if (type_ == PassType::kRaster && pass_info_.attachments.empty())
+	{
+		return true;
+	}
+
+	return std::ranges::any_of(pass_info_.attachments, [](const PassAttachment &attachment) { return attachment.is_external; });
+}
+
+void PassNode::reset_build_state()
+{
+	batch_index_      = -1;
+	is_async_compute_ = false;
+	bindables_.clear();
+	attachment_barriers_.clear();
+	release_barriers_.clear();
+}
+
+RenderPass &PassNode::get_render_pass()
+{
+	return *render_pass_;
+}
+
+RenderPass const &PassNode::get_render_pass() const
+{
+	return *render_pass_;
+}
+
 void PassNode::set_render_target(std::unique_ptr<RenderTarget> &&render_target)
 {
 	render_target_ = std::move(render_target);
 }
 
+std::unique_ptr<RenderTarget> PassNode::release_render_target()
+{
+	return std::move(render_target_);
+}
+
+void PassNode::set_dynamic_resolution(bool dynamic_resolution)
+{
+	dynamic_resolution_ = dynamic_resolution;
+}
+
+bool PassNode::is_dynamic_resolution() const
+{
+	return dynamic_resolution_;
+}
+
+vk::Extent2D PassNode::get_render_area(const RenderTarget &render_target, const RenderFrame &render_frame) const
+{
+	if (!dynamic_resolution_)
+	{
+		return render_target.get_extent();
+	}
+	return scale_extent(render_target.get_extent(), render_frame.get_render_scale());
+}
+
 RenderTarget *PassNode::get_render_target()
 {
 	return render_target_.get();
@@ -215,6 +358,22 @@ void PassNode::set_image_copy_info(std::unique_ptr<ImageCopyInfo> &&image_read_b
 	image_read_back_ = std::move(image_read_back);
 }
 
+void PassNode::set_async_compute(bool is_async_compute)
+{
+	assert(!is_async_compute || type_ == PassType::kCompute);
+	is_async_compute_ = is_async_compute;
+}
+
+bool PassNode::is_async_compute() const
+{
+	return is_async_compute_;
+}
+
+PassType PassNode::get_batch_type() const
+{
+	return is_async_compute_ ? PassType::kCompute : PassType::kRaster;
+}
+
 void PassNode::set_batch_index(uint64_t batch_index)
 {
 	batch_index_ = batch_index;
@@ -248,4 +407,42 @@ void PassNode::add_release_barrier(const ResourceHandle &handle, Barrier &&barri
 {
 	release_barriers_[handle] = barrier;
 }
+
+size_t PassNode::get_release_barrier_count() const
+{
+	return release_barriers_.size();
+}
+
+bool PassNode::describe_pipeline_state(backend::ResourceCache &resource_cache, const AttachmentsState &swapchain_attachments, PipelineState &pipeline_state)
+{
+	if (type_ != PassType::kCompute)
+	{
+		AttachmentsState attachments_state = swapchain_attachments;
+
+		if (render_target_)
+		{
+			attachments_state = {};
+			for (const auto &view : render_target_->get_views())
+			{
+				if (common::is_depth_format(view.get_format()))
+				{
+					attachments_state.depth_attachment_format = view.get_format();
+				}
+				else
+				{
+					attachments_state.color_attachment_formats.push_back(view.get_format());
+				}
+			}
+		}
+
+		// Same as CommandBuffer::begin_rendering, one blend attachment per color attachment
+		pipeline_state.set_attachments_state(attachments_state);
+
+		auto blend_state = pipeline_state.get_color_blend_state();
+		blend_state.attachments.resize(attachments_state.color_attachment_formats.size());
+		pipeline_state.set_color_blend_state(blend_state);
+	}
+
+	return render_pass_->describe_pipeline_state(resource_cache, pipeline_state);
+}
 }        // namespace xihe::rendering
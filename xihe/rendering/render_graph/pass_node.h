@@ -6,6 +6,7 @@
 #include "render_resource.h"
 #include "rendering/passes/render_pass.h"
 
+#include <functional>
 #include <optional>
 #include <variant>
 
@@ -29,6 +30,7 @@ class ExtentDescriptor
 	{
 		kFixed,
 		kSwapchainRelative,
+		kDynamicRelative,
 		kCustom
 	};
 
@@ -43,8 +45,17 @@ class ExtentDescriptor
 	                                          float    height_scale = 1.0f,
 	                                          uint32_t depth        = 1);
 
+	/**
+	 * \brief Allocated like SwapchainRelative, but passes render into the sub-rect of the scale chosen by DynamicResolution
+	 */
+	static ExtentDescriptor DynamicRelative(float    width_scale  = 1.0f,
+	                                        float    height_scale = 1.0f,
+	                                        uint32_t depth        = 1);
+
 	vk::Extent3D calculate(const vk::Extent2D &swapchain_extent) const;
 
+	bool is_dynamic() const;
+
   private:
 	Type         type_{Type::kSwapchainRelative};
 	vk::Extent3D extent_;
@@ -98,6 +109,9 @@ class PassNode
 		uint32_t        attachment_index{};
 		std::unique_ptr<backend::ImageView> image_view;
 		vk::ImageCopy   copy_region;
+
+		// Copies the attachment to host memory instead of the image view when set
+		ReadBackCallback callback;
 	};
 
 	PassNode(RenderGraph &render_graph, std::string name, PassInfo &&pass_info, std::unique_ptr<RenderPass> &&render_pass);
@@ -110,8 +124,21 @@ class PassNode
 
 	std::string get_name() const;
 
+	RenderPass       &get_render_pass();
+	RenderPass const &get_render_pass() const;
+
 	void set_render_target(std::unique_ptr<RenderTarget> &&render_target);
 
+	/// Set when the attachments or written images of the pass are dynamically scaled, it then renders into a sub-rect of them
+	void set_dynamic_resolution(bool dynamic_resolution);
+
+	bool is_dynamic_resolution() const;
+
+	/// Area of the render target the pass renders into this frame
+	vk::Extent2D get_render_area(const RenderTarget &render_target, const RenderFrame &render_frame) const;
+
+	std::unique_ptr<RenderTarget> release_render_target();
+
 	/**
 	 * \brief
 	 * \return If nullptr is returned, it indicates that this pass uses the render target of the render frame
@@ -122,6 +149,44 @@ class PassNode
 
 	void set_image_copy_info(std::unique_ptr<ImageCopyInfo> &&image_read_back);
 
+	void set_present(bool is_present);
+
+	bool is_present() const;
+
+	void set_side_effects(bool has_side_effects);
+
+	bool has_side_effects() const;
+
+	/**
+	 * \brief The pass is only part of the graph while the predicate returns true, it is evaluated on every GraphBuilder::build
+	 */
+	void set_enabled_predicate(std::function<bool()> &&enabled_predicate);
+
+	bool is_enabled() const;
+
+	/**
+	 * \brief A sink produces something observable outside the graph: it presents, reads back an attachment,
+	 *        writes an external attachment or has side effects. Passes that no sink depends on are culled.
+	 */
+	bool is_sink() const;
+
+	/**
+	 * \brief Drops the barriers and batch index assigned by the previous graph build, the render target is kept
+	 *        until the graph resources are released
+	 */
+	void reset_build_state();
+
+	/**
+	 * \brief Compute passes that can overlap with graphics work run on the async compute queue,
+	 *        the others are recorded in the graphics batches around them
+	 */
+	void set_async_compute(bool is_async_compute);
+
+	bool is_async_compute() const;
+
+	/// kCompute for passes on the async compute queue, kRaster for everything submitted to the graphics queue
+	PassType get_batch_type() const;
+
 	void set_batch_index(uint64_t batch_index);
 
 	int64_t get_batch_index() const;
@@ -133,6 +198,15 @@ class PassNode
 
 	void add_release_barrier(const ResourceHandle &handle, Barrier &&barrier);
 
+	size_t get_release_barrier_count() const;
+
+	/**
+	 * \brief Fills in the pipeline state this pass will bind, including the attachment formats of its render target
+	 * \param swapchain_attachments Used when the pass renders to the render target of the render frame
+	 * \return false if the pass cannot describe its pipeline ahead of time
+	 */
+	bool describe_pipeline_state(backend::ResourceCache &resource_cache, const AttachmentsState &swapchain_attachments, PipelineState &pipeline_state);
+
   private:
 	RenderGraph &render_graph_;
 
@@ -144,10 +218,14 @@ class PassNode
 
 	int64_t batch_index_{-1};
 
+	bool is_async_compute_{false};
+
 	std::unique_ptr<RenderPass> render_pass_;
 
 	std::unique_ptr<RenderTarget> render_target_;
 
+	bool dynamic_resolution_{false};
+
 	// Barriers applied before execution to ensure the input resources are in the correct state for reading.
 	std::unordered_map<uint32_t, BindableInfo> bindables_;
 
@@ -159,6 +237,12 @@ class PassNode
 
 	Gui *gui_{nullptr};
 
+	bool is_present_{false};
+
+	bool has_side_effects_{false};
+
+	std::function<bool()> enabled_predicate_;
+
 	std::unique_ptr<ImageCopyInfo> image_read_back_;
 };
 }        // namespace xihe::rendering
@@ -0,0 +1,119 @@
+#include "pipeline_build_scheduler.h"
+
+#include <ctpl_stl.h>
+
+#include "backend/resources_management/resource_caching.h"
+#include "common/timer.h"
+#include "common/trace.h"
+
+namespace xihe::rendering
+{
+PipelineBuildScheduler::PipelineBuildScheduler(backend::Device &device, uint32_t thread_count) :
+    device_{device}, thread_count_{std::max(1u, thread_count)}
+{}
+
+PipelineBuildReport PipelineBuildScheduler::build(const std::vector<PassBatch> &pass_batches, const AttachmentsState &swapchain_attachments)
+{
+	PipelineBuildReport report;
+
+	Timer timer;
+	timer.start();
+
+	auto             &resource_cache = device_.get_resource_cache();
+	vk::PipelineCache pipeline_cache = resource_cache.request_pipeline_cache();
+
+	ctpl::thread_pool thread_pool(thread_count_);
+
+	std::vector<std::pair<std::string, std::future<double>>> build_futures;
+	std::unordered_set<size_t>                               scheduled;
+
+	for (const auto &pass_batch : pass_batches)
+	{
+		// Compute passes of a batch share one command buffer and nothing resets the pipeline state in between,
+		// so specialization constants set by a pass are still part of the state of the following ones
+		PipelineState compute_state;
+		bool          compute_state_known = true;
+
+		for (auto *pass_node : pass_batch.pass_nodes)
+		{
+			const bool is_compute = pass_node->get_type() == PassType::kCompute;
+
+			PipelineState pipeline_state = is_compute ? compute_state : PipelineState{};
+
+			bool described = pass_node->describe_pipeline_state(resource_cache, swapchain_attachments, pipeline_state);
+
+			if (is_compute)
+			{
+				compute_state       = pipeline_state;
+				compute_state_known = compute_state_known && described;
+				described           = compute_state_known;
+			}
+			else
+			{
+				// Compute passes recorded in a graphics batch inherit whatever the raster pass before them left bound
+				compute_state_known = false;
+			}
+
+			if (!described)
+			{
+				++report.skipped_count;
+				continue;
+			}
+
+			size_t key = 0;
+			hash_combine(key, pipeline_state);
+			hash_combine(key, is_compute);
+
+			if (!scheduled.insert(key).second ||
+			    (is_compute ? resource_cache.has_compute_pipeline(pipeline_state) : resource_cache.has_graphics_pipeline(pipeline_state)))
+			{
+				++report.cached_count;
+				continue;
+			}
+
+			auto future = thread_pool.push([this, &resource_cache, pipeline_cache, is_compute, pipeline_state](size_t thread_index) mutable {
+				XIHE_TRACE_THREAD_NAME(fmt::format("Pipeline builder {}", thread_index));
+				XIHE_TRACE_ZONE(is_compute ? "Build compute pipeline" : "Build graphics pipeline");
+
+				Timer build_timer;
+				build_timer.start();
+
+				if (is_compute)
+				{
+					resource_cache.publish_compute_pipeline(pipeline_state, backend::ComputePipeline{device_, pipeline_cache, pipeline_state});
+				}
+				else
+				{
+					resource_cache.publish_graphics_pipeline(pipeline_state, backend::GraphicsPipeline{device_, pipeline_cache, pipeline_state});
+				}
+
+				return build_timer.stop<Timer::Milliseconds>();
+			});
+
+			build_futures.emplace_back(pass_node->get_name(), std::move(future));
+		}
+	}
+
+	for (auto &[pass_name, future] : build_futures)
+	{
+		try
+		{
+			double build_ms = future.get();
+
+			++report.built_count;
+			report.serial_ms        += build_ms;
+			report.critical_path_ms = std::max(report.critical_path_ms, build_ms);
+		}
+		catch (const std::exception &e)
+		{
+			// The pass will request the pipeline again while recording and report the error there
+			++report.failed_count;
+			LOGW("Failed to prebuild pipeline of pass {}: {}", pass_name, e.what());
+		}
+	}
+
+	report.total_ms = timer.stop<Timer::Milliseconds>();
+
+	return report;
+}
+}        // namespace xihe::rendering
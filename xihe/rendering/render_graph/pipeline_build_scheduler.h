@@ -0,0 +1,39 @@
+#pragma once
+
+#include "backend/device.h"
+#include "render_graph.h"
+
+#include <thread>
+
+namespace xihe::rendering
+{
+struct PipelineBuildReport
+{
+	uint32_t built_count{0};
+	uint32_t cached_count{0};         // already in the resource cache, or shared by an earlier pass
+	uint32_t skipped_count{0};        // passes that cannot describe their pipeline ahead of time
+	uint32_t failed_count{0};
+
+	double total_ms{0.0};                // wall time from the first request to the last publish
+	double critical_path_ms{0.0};        // longest single build, the lower bound of total_ms with enough threads
+	double serial_ms{0.0};               // sum of all builds, what a single thread would have spent
+};
+
+/**
+ * \brief Builds the pipelines of a render graph on worker threads before the first frame is recorded.
+ *        Batches are visited in execution order, so the pipelines needed first are queued first.
+ *        All builds share the pipeline cache of the resource cache and are published to it once created.
+ */
+class PipelineBuildScheduler
+{
+  public:
+	PipelineBuildScheduler(backend::Device &device, uint32_t thread_count);
+
+	PipelineBuildReport build(const std::vector<PassBatch> &pass_batches, const AttachmentsState &swapchain_attachments);
+
+  private:
+	backend::Device &device_;
+
+	uint32_t thread_count_;
+};
+}        // namespace xihe::rendering
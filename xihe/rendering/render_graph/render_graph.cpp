@@ -1,15 +1,18 @@
 #include "render_graph.h"
 
+#include "common/logging.h"
+#include "common/trace.h"
+#include "rendering/frame_capture.h"
 #include "rendering/render_frame.h"
 
 #include <ranges>
 
 namespace xihe::rendering
 {
-void set_viewport_and_scissor(backend::CommandBuffer const &command_buffer, vk::Extent2D const &extent)
+void set_viewport_and_scissor(backend::CommandBuffer &command_buffer, vk::Extent2D const &extent)
 {
-	command_buffer.get_handle().setViewport(0, {{0.0f, 0.0f, static_cast<float>(extent.width), static_cast<float>(extent.height), 0.0f, 1.0f}});
-	command_buffer.get_handle().setScissor(0, vk::Rect2D({}, extent));
+	command_buffer.set_viewport(0, {{0.0f, 0.0f, static_cast<float>(extent.width), static_cast<float>(extent.height), 0.0f, 1.0f}});
+	command_buffer.set_scissor(0, {vk::Rect2D({}, extent)});
 }
 
 RenderGraph::RenderGraph(RenderContext &render_context) :
@@ -18,22 +21,54 @@ RenderGraph::RenderGraph(RenderContext &render_context) :
 
 void RenderGraph::execute(bool present)
 {
+	XIHE_TRACE_ZONE("Execute render graph");
+
 	render_context_.begin_frame();
 
-	size_t batch_count = pass_batches_.size();
-	for (size_t i = 0; i < batch_count; ++i)
+	if (dynamic_resolution_.is_enabled())
+	{
+		// Sum of the submitted batches of the frame resolved in begin_frame
+		double gpu_ms = 0.0;
+		for (const auto &timing : render_context_.get_gpu_timings())
+		{
+			if (timing.depth == 0)
+			{
+				gpu_ms += timing.gpu_ms;
+			}
+		}
+		dynamic_resolution_.update(gpu_ms);
+	}
+	render_context_.get_active_frame().set_render_scale(dynamic_resolution_.get_scale());
+
+	barrier_planner_.reset_statistics();
+	barrier_planner_.reset_tracking();
+
+	// The first graphics submission waits for the swapchain image and the last one presents it,
+	// async compute batches may come before or after them
+	int64_t first_graphics_batch = -1;
+	int64_t last_graphics_batch  = -1;
+	for (int64_t i = 0; i < static_cast<int64_t>(pass_batches_.size()); ++i)
 	{
-		bool is_first = (i == 0);
-		bool is_last  = (i == batch_count - 1);
 		if (pass_batches_[i].type == PassType::kRaster)
 		{
-			execute_raster_batch(pass_batches_[i], is_first, is_last, present);
+			first_graphics_batch = first_graphics_batch == -1 ? i : first_graphics_batch;
+			last_graphics_batch  = i;
+		}
+	}
+
+	for (int64_t i = 0; i < static_cast<int64_t>(pass_batches_.size()); ++i)
+	{
+		if (pass_batches_[i].type == PassType::kRaster)
+		{
+			execute_raster_batch(pass_batches_[i], i == first_graphics_batch, i == last_graphics_batch, present);
 		}
 		else if (pass_batches_[i].type == PassType::kCompute)
 		{
-			execute_compute_batch(pass_batches_[i], is_first, is_last);
+			execute_compute_batch(pass_batches_[i]);
 		}
 	}
+
+	barrier_statistics_ = barrier_planner_.get_statistics();
 }
 
 ShaderBindable RenderGraph::get_resource_bindable(ResourceHandle handle) const
@@ -46,6 +81,100 @@ ShaderBindable RenderGraph::get_resource_bindable(ResourceHandle handle) const
 	return it->second.get_bindable();
 }
 
+std::vector<backend::ShaderSource> RenderGraph::get_shader_sources() const
+{
+	std::vector<backend::ShaderSource> shader_sources;
+	for (const auto &pass_node : pass_nodes_)
+	{
+		for (const auto *shader_source : pass_node.get_render_pass().get_shader_sources())
+		{
+			auto it = std::ranges::find_if(shader_sources, [shader_source](const backend::ShaderSource &source) {
+				return source.get_filename() == shader_source->get_filename();
+			});
+			if (it == shader_sources.end())
+			{
+				shader_sources.push_back(*shader_source);
+			}
+		}
+	}
+	return shader_sources;
+}
+
+void RenderGraph::update_shader_sources(const std::vector<backend::ShaderSource> &shader_sources)
+{
+	for (auto &pass_node : pass_nodes_)
+	{
+		for (const auto &shader_source : shader_sources)
+		{
+			pass_node.get_render_pass().update_shader_source(shader_source);
+		}
+	}
+}
+
+BarrierPlanner &RenderGraph::get_barrier_planner()
+{
+	return barrier_planner_;
+}
+
+const BarrierPlanner::Statistics &RenderGraph::get_barrier_statistics() const
+{
+	return barrier_statistics_;
+}
+
+QueueOverlapReport RenderGraph::estimate_queue_overlap(const std::function<double(const PassNode &)> &pass_cost) const
+{
+	QueueOverlapReport report;
+
+	double              graphics_end = 0.0;
+	double              compute_end  = 0.0;
+	std::vector<double> batch_ends(pass_batches_.size(), 0.0);
+
+	for (size_t i = 0; i < pass_batches_.size(); ++i)
+	{
+		const auto &pass_batch  = pass_batches_[i];
+		const bool  is_graphics = pass_batch.type == PassType::kRaster;
+
+		double cost = 0.0;
+		for (const auto *pass_node : pass_batch.pass_nodes)
+		{
+			cost += pass_cost ? pass_cost(*pass_node) : 1.0;
+			report.ownership_transfer_count += static_cast<uint32_t>(pass_node->get_release_barrier_count());
+			if (pass_node->is_async_compute())
+			{
+				++report.async_compute_pass_count;
+			}
+		}
+
+		double &queue_end = is_graphics ? graphics_end : compute_end;
+		double  start     = queue_end;
+		if (pass_batch.wait_batch_index >= 0)
+		{
+			start = std::max(start, batch_ends[pass_batch.wait_batch_index]);
+			++report.cross_queue_wait_count;
+		}
+
+		batch_ends[i] = start + cost;
+		queue_end     = batch_ends[i];
+
+		report.serial_cost += cost;
+		++(is_graphics ? report.graphics_batch_count : report.compute_batch_count);
+	}
+
+	report.overlapped_cost = std::max(graphics_end, compute_end);
+
+	return report;
+}
+
+void RenderGraph::set_frame_capture(FrameCapture *frame_capture)
+{
+	frame_capture_ = frame_capture;
+}
+
+DynamicResolution &RenderGraph::get_dynamic_resolution()
+{
+	return dynamic_resolution_;
+}
+
 void RenderGraph::add_pass_node(PassNode &&pass_node)
 {
 	pass_nodes_.push_back(std::move(pass_node));
@@ -59,6 +188,12 @@ void RenderGraph::execute_raster_batch(PassBatch &pass_batch, bool is_first, boo
 
 	command_buffer.begin(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
 
+	const auto batch_name = fmt::format("Graphics batch {}", &pass_batch - pass_batches_.data());
+	begin_capture(command_buffer, batch_name);
+
+	auto          &gpu_profiler = render_context_.get_active_frame().get_gpu_profiler();
+	const uint32_t gpu_scope    = gpu_profiler.begin_scope(command_buffer, batch_name, 0);
+
 	for (const auto pass_node : pass_batch.pass_nodes)
 	{
 		RenderTarget *render_target = pass_node->get_render_target();
@@ -68,11 +203,28 @@ void RenderGraph::execute_raster_batch(PassBatch &pass_batch, bool is_first, boo
 			render_target = &render_context_.get_active_frame().get_render_target();
 		}
 
-		set_viewport_and_scissor(command_buffer, render_target->get_extent());
+		if (frame_capture_)
+		{
+			frame_capture_->record(CaptureCommand::kBeginPass, pass_node->get_name());
+		}
+
+		set_viewport_and_scissor(command_buffer, pass_node->get_render_area(*render_target, render_context_.get_active_frame()));
 
 		pass_node->execute(command_buffer, *render_target, render_context_.get_active_frame());
+
+		if (frame_capture_)
+		{
+			frame_capture_->record(CaptureCommand::kEndPass);
+		}
 	}
 
+	// The barriers left at the end of the last pass are recorded before the submission
+	barrier_planner_.flush(command_buffer);
+
+	gpu_profiler.end_scope(command_buffer, gpu_scope);
+
+	end_capture(command_buffer);
+
 	command_buffer.end();
 
 	const auto     last_wait_batch      = pass_batch.wait_batch_index;
@@ -82,21 +234,46 @@ void RenderGraph::execute_raster_batch(PassBatch &pass_batch, bool is_first, boo
 	    {&command_buffer},        // list of command buffers
 	    pass_batch.signal_semaphore_value,
 	    wait_semaphore_value,
+	    pass_batch.wait_stage_mask,
 	    is_first,
 	    is_last,
 		present);
 }
 
-void RenderGraph::execute_compute_batch(PassBatch &pass_batch, bool is_first, bool is_last)
+void RenderGraph::execute_compute_batch(PassBatch &pass_batch)
 {
 	auto &command_buffer = render_context_.request_compute_command_buffer(
 	    backend::CommandBuffer::ResetMode::kResetPool,
 	    vk::CommandBufferLevel::ePrimary, 0);
 	command_buffer.begin(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+
+	const auto batch_name = fmt::format("Async compute batch {}", &pass_batch - pass_batches_.data());
+	begin_capture(command_buffer, batch_name);
+
+	auto          &gpu_profiler = render_context_.get_active_frame().get_gpu_profiler();
+	const uint32_t gpu_scope    = gpu_profiler.begin_scope(command_buffer, batch_name, 0);
+
 	for (const auto pass_node : pass_batch.pass_nodes)
 	{
+		if (frame_capture_)
+		{
+			frame_capture_->record(CaptureCommand::kBeginPass, pass_node->get_name());
+		}
+
 		pass_node->execute(command_buffer, render_context_.get_active_frame().get_render_target(), render_context_.get_active_frame());
+
+		if (frame_capture_)
+		{
+			frame_capture_->record(CaptureCommand::kEndPass);
+		}
 	}
+
+	barrier_planner_.flush(command_buffer);
+
+	gpu_profiler.end_scope(command_buffer, gpu_scope);
+
+	end_capture(command_buffer);
+
 	command_buffer.end();
 	const auto     last_wait_batch      = pass_batch.wait_batch_index;
 	const uint64_t wait_semaphore_value = last_wait_batch >= 0 ? pass_batches_[last_wait_batch].signal_semaphore_value : 0;
@@ -104,6 +281,25 @@ void RenderGraph::execute_compute_batch(PassBatch &pass_batch, bool is_first, bo
 	render_context_.compute_submit(
 	    {&command_buffer},        // list of command buffers
 	    pass_batch.signal_semaphore_value,
-	    wait_semaphore_value);
+	    wait_semaphore_value,
+	    pass_batch.wait_stage_mask);
+}
+
+void RenderGraph::begin_capture(backend::CommandBuffer &command_buffer, const std::string &batch_name) const
+{
+	if (frame_capture_)
+	{
+		frame_capture_->record(CaptureCommand::kBeginBatch, batch_name);
+		command_buffer.set_frame_capture(frame_capture_);
+	}
+}
+
+void RenderGraph::end_capture(backend::CommandBuffer &command_buffer) const
+{
+	if (frame_capture_)
+	{
+		command_buffer.set_frame_capture(nullptr);
+		frame_capture_->record(CaptureCommand::kEndBatch);
+	}
 }
 }        // namespace xihe::rendering
@@ -1,8 +1,10 @@
 #pragma once
 #include "backend/command_buffer.h"
 #include "backend/sampler.h"
+#include "barrier_planner.h"
 #include "pass_node.h"
 #include "render_resource.h"
+#include "rendering/dynamic_resolution.h"
 #include "rendering/passes/render_pass.h"
 #include "rendering/render_context.h"
 #include "rendering/render_target.h"
@@ -12,16 +14,39 @@
 
 namespace xihe::rendering
 {
+class FrameCapture;
 class GraphBuilder;
 
 struct PassBatch
 {
 	std::vector<PassNode *> pass_nodes;
-	PassType                type;
+	PassType                type;        // kRaster batches go to the graphics queue, kCompute batches to the async compute queue
 	int64_t                 wait_batch_index{-1};
+	vk::PipelineStageFlags2 wait_stage_mask{};        // stages of this batch that consume the results of the waited batch
 	uint64_t                signal_semaphore_value{0};
 };
 
+/**
+ * \brief Estimate of how much graphics and async compute work runs at the same time, by replaying the batches
+ *        on two queues that only wait where the graph requires it
+ */
+struct QueueOverlapReport
+{
+	uint32_t graphics_batch_count{0};
+	uint32_t compute_batch_count{0};
+	uint32_t async_compute_pass_count{0};
+	uint32_t cross_queue_wait_count{0};
+	uint32_t ownership_transfer_count{0};
+
+	double serial_cost{0.0};            // all batches back to back on a single queue
+	double overlapped_cost{0.0};        // end of the last batch with both queues running
+
+	double get_overlap() const
+	{
+		return serial_cost - overlapped_cost;
+	}
+};
+
 class RenderGraph
 {
   public:
@@ -33,13 +58,40 @@ class RenderGraph
 
 	ShaderBindable get_resource_bindable(ResourceHandle handle) const;
 
+	/// One entry per shader file used by the passes of the graph
+	std::vector<backend::ShaderSource> get_shader_sources() const;
+
+	void update_shader_sources(const std::vector<backend::ShaderSource> &shader_sources);
+
+	/// Shared by all passes, barriers are recorded in one pass at a time
+	BarrierPlanner &get_barrier_planner();
+
+	/// Barrier counters of the last executed frame
+	const BarrierPlanner::Statistics &get_barrier_statistics() const;
+
+	/**
+	 * \brief Replays the current batches on a graphics and an async compute timeline
+	 * \param pass_cost Cost of a pass, e.g. its last GPU time. Every pass costs 1 if not set
+	 */
+	QueueOverlapReport estimate_queue_overlap(const std::function<double(const PassNode &)> &pass_cost = {}) const;
+
+	/// The batches executed while it is set are recorded into the capture, nullptr stops capturing
+	void set_frame_capture(FrameCapture *frame_capture);
+
+	/// Updated from the GPU time of the last completed frame at the start of each frame
+	DynamicResolution &get_dynamic_resolution();
+
   private:
 	// Called by GraphBuilder
 	void add_pass_node(PassNode &&pass_node);
 
 	void execute_raster_batch(PassBatch &pass_batch, bool is_first, bool is_last, bool present);
 
-	void execute_compute_batch(PassBatch &pass_batch, bool is_first, bool is_last);
+	void execute_compute_batch(PassBatch &pass_batch);
+
+	void begin_capture(backend::CommandBuffer &command_buffer, const std::string &batch_name) const;
+
+	void end_capture(backend::CommandBuffer &command_buffer) const;
 
 	RenderContext &render_context_;
 
@@ -49,6 +101,14 @@ class RenderGraph
 
 	std::unordered_map<ResourceHandle, ResourceInfo> resources_{};
 
+	BarrierPlanner barrier_planner_;
+
+	BarrierPlanner::Statistics barrier_statistics_{};
+
+	FrameCapture *frame_capture_{nullptr};
+
+	DynamicResolution dynamic_resolution_;
+
 	// must use unique_ptr to avoid address invalidation
 	std::vector<std::unique_ptr<backend::Image>>     images_;
 	std::vector<std::unique_ptr<backend::Buffer>>    buffers_;
@@ -0,0 +1,126 @@
+#include "shader_reloader.h"
+
+#include "common/logging.h"
+#include "common/timer.h"
+#include "common/trace.h"
+
+namespace xihe::rendering
+{
+ShaderReloader::ShaderReloader(backend::Device &device, RenderGraph &render_graph, GraphBuilder &graph_builder) :
+    device_{device},
+    render_graph_{render_graph},
+    graph_builder_{graph_builder},
+    file_watcher_{fs::path::get(fs::path::Type::kShaders)}
+{}
+
+ShaderReloader::~ShaderReloader()
+{
+	if (compile_result_.valid())
+	{
+		compile_result_.wait();
+	}
+}
+
+void ShaderReloader::update()
+{
+	auto changes = file_watcher_.take_changes();
+	pending_changes_.insert(pending_changes_.end(), changes.begin(), changes.end());
+
+	if (compile_result_.valid())
+	{
+		if (compile_result_.wait_for(std::chrono::seconds{0}) != std::future_status::ready)
+		{
+			return;
+		}
+
+		auto shader_sources = compile_result_.get();
+		if (!shader_sources.empty())
+		{
+			render_graph_.update_shader_sources(shader_sources);
+
+			// Unchanged pipelines are still cached, so only the ones using the new modules get built
+			graph_builder_.prewarm_pipelines();
+		}
+	}
+
+	if (pending_changes_.empty())
+	{
+		return;
+	}
+
+	// Each source knows the files it includes, a change to any of them affects the source
+	std::vector<backend::ShaderSource> affected_sources;
+	for (auto &shader_source : render_graph_.get_shader_sources())
+	{
+		if (std::ranges::any_of(pending_changes_, [&shader_source](const std::string &file) { return shader_source.depends_on(file); }))
+		{
+			affected_sources.push_back(std::move(shader_source));
+		}
+	}
+	pending_changes_.clear();
+
+	if (affected_sources.empty())
+	{
+		return;
+	}
+
+	compile_result_ = std::async(std::launch::async, [this, affected_sources = std::move(affected_sources)]() {
+		XIHE_TRACE_THREAD_NAME("Shader reloader");
+		return compile(affected_sources);
+	});
+}
+
+std::vector<backend::ShaderSource> ShaderReloader::compile(const std::vector<backend::ShaderSource> &affected_sources)
+{
+	XIHE_TRACE_ZONE("Reload shaders");
+
+	Timer timer;
+	timer.start();
+
+	auto &resource_cache = device_.get_resource_cache();
+
+	std::vector<backend::ShaderSource> reloaded_sources;
+	size_t                             module_count = 0;
+
+	for (const auto &old_source : affected_sources)
+	{
+		try
+		{
+			backend::ShaderSource shader_source{old_source.get_filename()};
+
+			if (shader_source.get_id() == old_source.get_id())
+			{
+				continue;
+			}
+
+			auto shader_variants = resource_cache.get_shader_variants(old_source.get_filename());
+
+			// Compile every variant before publishing any, a shader that fails to compile leaves the old modules in use
+			std::vector<backend::ShaderModule> shader_modules;
+			for (const auto &[stage, shader_variant] : shader_variants)
+			{
+				shader_modules.emplace_back(device_, stage, shader_source, "main", shader_variant);
+			}
+
+			for (size_t i = 0; i < shader_modules.size(); ++i)
+			{
+				resource_cache.publish_shader_module(shader_variants[i].first, shader_source, shader_variants[i].second, std::move(shader_modules[i]));
+			}
+
+			module_count += shader_modules.size();
+			reloaded_sources.push_back(std::move(shader_source));
+		}
+		catch (const std::exception &e)
+		{
+			LOGW("Failed to reload shader {}, keeping the previous version: {}", old_source.get_filename(), e.what());
+		}
+	}
+
+	if (!reloaded_sources.empty())
+	{
+		LOGI("Reloaded {} shaders ({} modules) in {:.2f} ms", reloaded_sources.size(), module_count, timer.stop<Timer::Milliseconds>());
+	}
+
+	return reloaded_sources;
+}
+}        // namespace xihe::rendering
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <future>
+
+#include "backend/device.h"
+#include "platform/file_watcher.h"
+#include "rendering/render_graph/graph_builder.h"
+
+namespace xihe::rendering
+{
+/**
+ * \brief Recompiles the shaders of a render graph when their files, or any file they include, change on disk.
+ *        Shader modules are compiled on a background thread and handed to the passes at a frame boundary,
+ *        after which only the pipeline layouts and pipelines built from them are missing from the cache.
+ */
+class ShaderReloader
+{
+  public:
+	ShaderReloader(backend::Device &device, RenderGraph &render_graph, GraphBuilder &graph_builder);
+
+	~ShaderReloader();
+
+	ShaderReloader(const ShaderReloader &)            = delete;
+	ShaderReloader &operator=(const ShaderReloader &) = delete;
+
+	/**
+	 * \brief Must be called between frames, before the render graph is executed
+	 */
+	void update();
+
+  private:
+	/**
+	 * \brief Compiles all cached variants of the given sources and publishes them to the resource cache
+	 * \return The sources that compiled successfully, to be swapped into the passes
+	 */
+	std::vector<backend::ShaderSource> compile(const std::vector<backend::ShaderSource> &affected_sources);
+
+	backend::Device &device_;
+
+	RenderGraph &render_graph_;
+
+	GraphBuilder &graph_builder_;
+
+	fs::FileWatcher file_watcher_;
+
+	// Changes seen while a compilation was still running
+	std::vector<std::string> pending_changes_;
+
+	std::future<std::vector<backend::ShaderSource>> compile_result_;
+};
+}        // namespace xihe::rendering
@@ -0,0 +1,167 @@
+#include "replay_app.h"
+
+#include <fstream>
+
+#include <fmt/ranges.h>
+
+#include "common/logging.h"
+#include "platform/filesystem.h"
+#include "stats/stats.h"
+
+namespace xihe
+{
+namespace
+{
+std::string format_summary(const stats::StatSummary &summary)
+{
+	return fmt::format("{{\"mean\": {}, \"p50\": {}, \"p95\": {}, \"p99\": {}, \"max\": {}}}",
+	                   summary.mean, summary.p50, summary.p95, summary.p99, summary.max);
+}
+}        // namespace
+
+ReplayApp::ReplayApp(ReplayConfig config) :
+    config_{std::move(config)}
+{
+	if (config_.output_path.empty())
+	{
+		config_.output_path = fs::path::get(fs::path::Type::kStorage, "replay.json").string();
+	}
+}
+
+bool ReplayApp::prepare(Window *window)
+{
+	// The scene is not loaded, everything the frame uses comes from the capture
+	if (!XiheApp::prepare(window))
+	{
+		return false;
+	}
+
+	Timer timer;
+	timer.start();
+	try
+	{
+		replayer_ = std::make_unique<rendering::FrameReplayer>(*device_);
+		replayer_->load(config_.capture_path);
+	}
+	catch (const std::exception &e)
+	{
+		LOGE("Failed to load the frame capture: {}", e.what());
+		return false;
+	}
+	load_ms_ = timer.stop<Timer::Milliseconds>();
+
+	render_frame_users_.resize(render_context_->get_render_frame_count());
+	iterations_.reserve(config_.iteration_count);
+
+	LOGI("Replaying {} {} times after {} warmup iterations", config_.capture_path, config_.iteration_count, config_.warmup_iteration_count);
+
+	return true;
+}
+
+void ReplayApp::update(float delta_time)
+{
+	if (complete_)
+	{
+		return;
+	}
+
+	Timer cpu_timer;
+	cpu_timer.start();
+	replayer_->execute(*render_context_);
+	const double cpu_ms = cpu_timer.stop<Timer::Milliseconds>();
+
+	const uint32_t measure_end = config_.warmup_iteration_count + config_.iteration_count;
+	if (iteration_index_ >= config_.warmup_iteration_count && iteration_index_ < measure_end)
+	{
+		iterations_.push_back({cpu_ms});
+	}
+
+	record_gpu_timings();
+
+	++iteration_index_;
+
+	// Keeps replaying until every render frame was reused once, so the timings of the last iterations are read back
+	if (iteration_index_ == measure_end + render_context_->get_render_frame_count())
+	{
+		write_report();
+		complete_ = true;
+		window_->close();
+	}
+}
+
+bool ReplayApp::is_complete() const
+{
+	return complete_;
+}
+
+void ReplayApp::record_gpu_timings()
+{
+	auto &user = render_frame_users_[render_context_->get_active_frame_index()];
+
+	if (user && *user >= config_.warmup_iteration_count && *user - config_.warmup_iteration_count < iterations_.size())
+	{
+		auto &record = iterations_[*user - config_.warmup_iteration_count];
+
+		double gpu_ms = 0.0;
+		for (const auto &timing : render_context_->get_gpu_timings())
+		{
+			if (timing.depth == 0)
+			{
+				gpu_ms += timing.gpu_ms;
+			}
+			record.scope_gpu_ms[timing.name] += timing.gpu_ms;
+		}
+		record.gpu_ms = gpu_ms;
+	}
+
+	user = iteration_index_;
+}
+
+void ReplayApp::write_report() const
+{
+	std::ofstream file{config_.output_path, std::ios::out | std::ios::trunc};
+	if (!file.is_open())
+	{
+		LOGE("Failed to open {} for writing the replay report", config_.output_path);
+		return;
+	}
+
+	std::vector<float>                        cpu_ms;
+	std::vector<float>                        gpu_ms;
+	std::map<std::string, std::vector<float>> scope_gpu_ms;
+	for (const auto &record : iterations_)
+	{
+		cpu_ms.push_back(static_cast<float>(record.cpu_ms));
+		if (record.gpu_ms)
+		{
+			gpu_ms.push_back(static_cast<float>(*record.gpu_ms));
+		}
+		for (const auto &[name, ms] : record.scope_gpu_ms)
+		{
+			scope_gpu_ms[name].push_back(static_cast<float>(ms));
+		}
+	}
+
+	file << "{\n";
+	file << fmt::format("  \"capture\": \"{}\",\n", config_.capture_path);
+	file << fmt::format("  \"device\": \"{}\",\n", std::string{device_->get_gpu().get_properties().deviceName.data()});
+	file << fmt::format("  \"iteration_count\": {},\n", iterations_.size());
+	file << fmt::format("  \"warmup_iteration_count\": {},\n", config_.warmup_iteration_count);
+	file << fmt::format("  \"load_ms\": {},\n", load_ms_);
+
+	file << "  \"summary\": {\n";
+	file << fmt::format("    \"cpu_ms\": {},\n", format_summary(stats::summarize(std::move(cpu_ms))));
+	file << fmt::format("    \"gpu_ms\": {}\n", format_summary(stats::summarize(std::move(gpu_ms))));
+	file << "  },\n";
+
+	// Batches and passes keep the names of the captured frame
+	std::vector<std::string> scopes;
+	for (auto &[name, values] : scope_gpu_ms)
+	{
+		scopes.push_back(fmt::format("\n    \"{}\": {}", name, format_summary(stats::summarize(std::move(values)))));
+	}
+	file << fmt::format("  \"scopes\": {{{}\n  }}\n}}\n", fmt::join(scopes, ","));
+
+	LOGI("Wrote replay report of {} iterations to {}", iterations_.size(), config_.output_path);
+}
+}        // namespace xihe
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "sample_app.h"
+
+#include <map>
+#include <optional>
+
+#include "common/timer.h"
+#include "rendering/frame_capture.h"
+
+namespace xihe
+{
+struct ReplayConfig
+{
+	/// Frame capture written by XiheApp::capture_frame
+	std::string capture_path;
+
+	std::string output_path;
+
+	uint32_t iteration_count{300};
+
+	/// Replays before measuring, so pipeline builds are not counted
+	uint32_t warmup_iteration_count{30};
+};
+
+/**
+ * \brief Replays a captured frame a fixed number of times and writes its GPU timings per batch and pass as JSON,
+ *        shader changes can be measured on the same frame without loading the scene
+ */
+class ReplayApp : public SampleApp
+{
+  public:
+	explicit ReplayApp(ReplayConfig config);
+	~ReplayApp() override = default;
+
+	bool prepare(Window *window) override;
+
+	void update(float delta_time) override;
+
+	/// Whether all iterations were replayed and the report was written
+	bool is_complete() const;
+
+  private:
+	struct IterationRecord
+	{
+		double cpu_ms{0.0};
+
+		// Empty if the iteration's timestamps were never read back
+		std::optional<double>         gpu_ms;
+		std::map<std::string, double> scope_gpu_ms;
+	};
+
+	/// Attributes the GPU timings read back at the start of this frame to the iteration that last used its render frame
+	void record_gpu_timings();
+
+	void write_report() const;
+
+	ReplayConfig config_;
+
+	std::unique_ptr<rendering::FrameReplayer> replayer_;
+
+	double load_ms_{0.0};
+
+	uint32_t iteration_index_{0};
+
+	std::vector<std::optional<uint32_t>> render_frame_users_;
+
+	std::vector<IterationRecord> iterations_;
+
+	bool complete_{false};
+};
+}        // namespace xihe
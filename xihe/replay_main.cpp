@@ -0,0 +1,118 @@
+#include <iostream>
+#include <string>
+
+#include "platform/headless/headless_platform.h"
+#include "platform/windows/windows_platform.h"
+#include "replay_app.h"
+
+namespace
+{
+void print_usage()
+{
+	std::cout << "Usage: xihe_replay --capture <file> [options]\n"
+	             "  --capture <file>      frame capture written with F12\n"
+	             "  --iterations <count>  replays to measure\n"
+	             "  --warmup <count>      replays before measuring\n"
+	             "  --output <file>       JSON report, defaults to replay.json in the storage directory\n"
+	             "  --width <pixels>\n"
+	             "  --height <pixels>\n"
+	             "  --headless            replay without a window through VK_EXT_headless_surface\n";
+}
+}        // namespace
+
+int main(int argc, char *argv[])
+{
+	xihe::ReplayConfig               config;
+	xihe::Window::OptionalProperties properties{};
+	properties.title     = "Xi He Replay";
+	properties.vsync     = xihe::Window::Vsync::OFF;
+	properties.resizable = false;
+
+	bool headless = false;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+
+		if (arg == "--headless")
+		{
+			headless = true;
+			continue;
+		}
+
+		if (i + 1 >= argc)
+		{
+			print_usage();
+			return 1;
+		}
+		const std::string value = argv[++i];
+
+		if (arg == "--capture")
+		{
+			config.capture_path = value;
+		}
+		else if (arg == "--iterations")
+		{
+			config.iteration_count = static_cast<uint32_t>(std::stoul(value));
+		}
+		else if (arg == "--warmup")
+		{
+			config.warmup_iteration_count = static_cast<uint32_t>(std::stoul(value));
+		}
+		else if (arg == "--output")
+		{
+			config.output_path = value;
+		}
+		else if (arg == "--width")
+		{
+			properties.extent.width = static_cast<uint32_t>(std::stoul(value));
+		}
+		else if (arg == "--height")
+		{
+			properties.extent.height = static_cast<uint32_t>(std::stoul(value));
+		}
+		else
+		{
+			print_usage();
+			return 1;
+		}
+	}
+
+	if (config.capture_path.empty())
+	{
+		print_usage();
+		return 1;
+	}
+
+	std::unique_ptr<xihe::Platform> platform;
+	if (headless)
+	{
+		properties.mode = xihe::Window::Mode::kHeadless;
+		platform        = std::make_unique<xihe::HeadlessPlatform>();
+	}
+	else
+	{
+		platform = std::make_unique<xihe::WindowsPlatform>();
+	}
+	platform->set_window_properties(properties);
+
+	xihe::ReplayApp *replay_app = nullptr;
+
+	const auto code = platform->initialize();
+	const bool started = code == xihe::ExitCode::kSuccess && platform->start_app("xihe_replay", [&]() {
+		auto app   = std::make_unique<xihe::ReplayApp>(config);
+		replay_app = app.get();
+		return app;
+	});
+
+	bool complete = false;
+	if (started)
+	{
+		platform->main_loop();
+		complete = replay_app && replay_app->is_complete();
+	}
+
+	platform->terminate(code);
+
+	return complete ? 0 : 1;
+}
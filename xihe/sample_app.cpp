@@ -20,12 +20,15 @@ namespace xihe
 {
 using namespace rendering;
 
-SampleApp::SampleApp()
+SampleApp::SampleApp(std::string scene_path) :
+    scene_path_{std::move(scene_path)}
 {
 	add_device_extension(VK_KHR_SPIRV_1_4_EXTENSION_NAME);
-	add_device_extension(VK_EXT_MESH_SHADER_EXTENSION_NAME);
 	add_device_extension(VK_KHR_SHADER_FLOAT_CONTROLS_EXTENSION_NAME);
-	add_device_extension(VK_KHR_FRAGMENT_SHADING_RATE_EXTENSION_NAME);
+
+	// Software rasterizers such as lavapipe lack them, add_passes then falls back to vertex shaders
+	add_device_extension(VK_EXT_MESH_SHADER_EXTENSION_NAME, /*optional=*/true);
+	add_device_extension(VK_KHR_FRAGMENT_SHADING_RATE_EXTENSION_NAME, /*optional=*/true);
 
 	backend::GlslCompiler::set_target_environment(glslang::EShTargetSpv, glslang::EShTargetSpv_1_4);
 }
@@ -37,16 +40,29 @@ bool SampleApp::prepare(Window *window)
 		return false;
 	}
 
+	load_assets();
+
+	add_passes(*window);
+
+	graph_builder_->build();
+
+	return true;
+}
+
+void SampleApp::load_assets()
+{
 	asset_loader_ = std::make_unique<AssetLoader>(*device_);
 
-	load_scene("scenes/sponza/Sponza01.gltf");
+	enable_texture_streaming();
+
+	load_scene(scene_path_);
 	// load_scene("scenes/cube.gltf");
 	assert(scene_ && "Scene not loaded");
 	update_bindless_descriptor_sets();
 	gpu_scene_ = std::make_unique<GpuScene>(*device_);
 	gpu_scene_->initialize(*scene_);
 
-	auto *skybox_texture = asset_loader_->load_texture_cube(*scene_, "skybox", "textures/uffizi_rgba16f_cube.ktx");
+	skybox_texture_ = asset_loader_->load_texture_cube(*scene_, "skybox", "textures/uffizi_rgba16f_cube.ktx");
 
 	auto light_pos   = glm::vec3(-150.0f, 188.0f, -225.0f);
 	auto light_color = glm::vec3(1.0, 1.0, 1.0);
@@ -102,8 +118,16 @@ bool SampleApp::prepare(Window *window)
 	}
 
 	auto &camera_node = sg::add_free_camera(*scene_, "main_camera", render_context_->get_surface_extent());
-	auto  camera      = &camera_node.get_component<sg::Camera>();
-	camera_           = camera;
+	camera_           = &camera_node.get_component<sg::Camera>();
+
+	get_texture_streamer()->set_camera(camera_);
+	get_texture_streamer()->set_gpu_scene(gpu_scene_.get());
+}
+
+void SampleApp::add_passes(Window &window)
+{
+	auto *camera         = camera_;
+	auto *skybox_texture = skybox_texture_;
 
 	auto  cascade_script   = std::make_unique<sg::CascadeScript>("", *scene_, *dynamic_cast<sg::PerspectiveCamera *>(camera));
 	auto *p_cascade_script = cascade_script.get();
@@ -141,58 +165,88 @@ bool SampleApp::prepare(Window *window)
 		    .shader({"shadow/csm.vert", "shadow/csm.frag"})
 		    .finalize();
 
-		/*auto test_pass = std::make_unique<TestPass>();
+		// Debug pass, culled unless toggled in the views window
+		auto test_pass = std::make_unique<TestPass>();
 		graph_builder_->add_pass("Test", std::move(test_pass))
-		    .bindables({{.type = BindableType::kStorageBufferWrite, .name = "per-light meshlet indies", .buffer_size = 256 * 4}})
+		    .bindables({{.type = BindableType::kStorageBufferWrite, .name = "debug per-light meshlet indies", .buffer_size = 256 * 4}})
 		    .shader({"shadow/test.comp"})
-		    .finalize();*/
-
-		auto point_shadows_culling_pass = std::make_unique<PointShadowsCullingPass>(*gpu_scene_, scene_->get_components<sg::Light>());
-		graph_builder_->add_pass("Point Light Shadows Culling", std::move(point_shadows_culling_pass))
-		    .bindables({{.type = BindableType::kStorageBufferWrite, .name = "meshlet instances", .buffer_size = kMaxPointLightCount * kMaxPerLightMeshletCount * 8},
-		                {.type = BindableType::kStorageBufferWriteClear, .name = "per-light meshlet indies", .buffer_size = (kMaxPointLightCount + 1) * 2 * 4}})
-		    .shader({"shadow/pointshadows_culling.comp"})
+		    .enabled([this] { return run_test_pass_; })
+		    .side_effects()
 		    .finalize();
 
-		auto point_shadows_commands_generation_pass = std::make_unique<PointShadowsCommandsGenerationPass>();
-		graph_builder_->add_pass("Point Light Shadows Commands Generation", std::move(point_shadows_commands_generation_pass))
-		    .bindables({{.type = BindableType::kStorageBufferRead, .name = "per-light meshlet indies"},
-		                {.type = BindableType::kStorageBufferWrite, .name = "meshlet draw command", .buffer_size = kMaxPointLightCount * 6 * 16}})
-		    .shader({"shadow/pointshadows_commands_generation.comp"})
-		    .finalize();
+		// The point light passes would initialize it as well, the map needs the light count first
+		PointShadowsResources::get().initialize(*device_, scene_->get_components<sg::Light>());
+
+		// Without point lights nothing samples the point shadow maps, the point light passes are culled
+		auto has_point_lights   = [] { return PointShadowsResources::get().get_point_light_count() > 0; };
+		auto point_light_layers = std::max(PointShadowsResources::get().get_point_light_count(), 1u) * 6;
 
 		PassAttachment point_shadows_attachment{AttachmentType::kDepth, "point shadowmaps"};
 		point_shadows_attachment.extent_desc                    = ExtentDescriptor::Fixed({1024, 1024, 1});
-		point_shadows_attachment.image_properties.array_layers  = PointShadowsResources::get().get_point_light_count() * 6;
+		point_shadows_attachment.image_properties.array_layers  = point_light_layers;
 		point_shadows_attachment.image_properties.current_layer = 0;
-		point_shadows_attachment.image_properties.n_use_layer   = PointShadowsResources::get().get_point_light_count() * 6;
-
-		auto point_shadows_pass = std::make_unique<PointShadowsPass>(*gpu_scene_, scene_->get_components<sg::Light>());
-		graph_builder_->add_pass("Point Light Shadows", std::move(point_shadows_pass))
-		    .bindables({
-		        {.type = BindableType::kStorageBufferRead, .name = "meshlet instances"},
-		        {.type = BindableType::kStorageBufferRead, .name = "per-light meshlet indies"},
-		        {.type = BindableType::kIndirectBuffer, .name = "meshlet draw command"},
-		    })
-		    .attachments({point_shadows_attachment})
-		    .shader({"shadow/pointshadows.task", "shadow/pointshadows.mesh"})
-		    .finalize();
-		;
+		point_shadows_attachment.image_properties.n_use_layer   = point_light_layers;
+
+		if (mesh_shading_supported_)
+		{
+			auto point_shadows_culling_pass = std::make_unique<PointShadowsCullingPass>(*gpu_scene_, scene_->get_components<sg::Light>());
+			graph_builder_->add_pass("Point Light Shadows Culling", std::move(point_shadows_culling_pass))
+			    .bindables({{.type = BindableType::kStorageBufferWrite, .name = "meshlet instances", .buffer_size = kMaxPointLightCount * kMaxPerLightMeshletCount * 8},
+			                {.type = BindableType::kStorageBufferWriteClear, .name = "per-light meshlet indies", .buffer_size = (kMaxPointLightCount + 1) * 2 * 4}})
+			    .shader({"shadow/pointshadows_culling.comp"})
+			    .enabled(has_point_lights)
+			    .finalize();
+
+			auto point_shadows_commands_generation_pass = std::make_unique<PointShadowsCommandsGenerationPass>();
+			graph_builder_->add_pass("Point Light Shadows Commands Generation", std::move(point_shadows_commands_generation_pass))
+			    .bindables({{.type = BindableType::kStorageBufferRead, .name = "per-light meshlet indies"},
+			                {.type = BindableType::kStorageBufferWrite, .name = "meshlet draw command", .buffer_size = kMaxPointLightCount * 6 * 16}})
+			    .shader({"shadow/pointshadows_commands_generation.comp"})
+			    .enabled(has_point_lights)
+			    .finalize();
+
+			auto point_shadows_pass = std::make_unique<PointShadowsPass>(*gpu_scene_, scene_->get_components<sg::Light>());
+			graph_builder_->add_pass("Point Light Shadows", std::move(point_shadows_pass))
+			    .bindables({
+			        {.type = BindableType::kStorageBufferRead, .name = "meshlet instances"},
+			        {.type = BindableType::kStorageBufferRead, .name = "per-light meshlet indies"},
+			        {.type = BindableType::kIndirectBuffer, .name = "meshlet draw command"},
+			    })
+			    .attachments({point_shadows_attachment})
+			    .shader({"shadow/pointshadows.task", "shadow/pointshadows.mesh"})
+			    .enabled(has_point_lights)
+			    .finalize();
+		}
+		else
+		{
+			// Only clears the maps to the far plane, which leaves the point lights unshadowed
+			auto point_shadows_pass = std::make_unique<PointShadowsClearPass>();
+			graph_builder_->add_pass("Point Light Shadows", std::move(point_shadows_pass))
+			    .attachments({point_shadows_attachment})
+			    .shader({"shadow/csm.vert", "shadow/pointshadows.frag"})
+			    .enabled(has_point_lights)
+			    .finalize();
+		}
 	}
 
 	// geometry pass
+	if (!mesh_shading_supported_)
 	{
-		/*auto geometry_pass = std::make_unique<GeometryPass>(scene_->get_components<sg::Mesh>(), *camera);
+		auto geometry_pass = std::make_unique<GeometryPass>(scene_->get_components<sg::Mesh>(), *camera);
 
 		graph_builder_->add_pass("Geometry", std::move(geometry_pass))
 
-		    .attachments({{AttachmentType::kDepth, "depth"},
-		                  {AttachmentType::kColor, "albedo"},
-		                  {AttachmentType::kColor, "normal", vk::Format::eA2B10G10R10UnormPack32}})
+		    .attachments({{AttachmentType::kDepth, "depth", vk::Format::eUndefined, ExtentDescriptor::DynamicRelative()},
+		                  {AttachmentType::kColor, "albedo", vk::Format::eUndefined, ExtentDescriptor::DynamicRelative()},
+		                  {AttachmentType::kColor, "normal", vk::Format::eA2B10G10R10UnormPack32, ExtentDescriptor::DynamicRelative()},
+		                  {AttachmentType::kColor, "emission", vk::Format::eUndefined, ExtentDescriptor::DynamicRelative()}})
 
 		    .shader({"deferred/geometry.vert", "deferred/geometry.frag"})
 
-		    .finalize();*/
+		    .finalize();
+	}
+	else
+	{
 #ifdef EX
 		auto mesh_preparation_pass = std::make_unique<MeshDrawPreparationPass>(*gpu_scene_);
 		graph_builder_->add_pass("Mesh Draw Preparation", std::move(mesh_preparation_pass))
@@ -211,9 +265,9 @@ bool SampleApp::prepare(Window *window)
 		    .bindables({{.type = BindableType::kStorageBufferRead, .name = "draw command"}})
 #endif
 
-		    .attachments({{AttachmentType::kDepth, "depth"},
-		                  {AttachmentType::kColor, "albedo"},
-		                  {AttachmentType::kColor, "normal", vk::Format::eA2B10G10R10UnormPack32}})
+		    .attachments({{AttachmentType::kDepth, "depth", vk::Format::eUndefined, ExtentDescriptor::DynamicRelative()},
+		                  {AttachmentType::kColor, "albedo", vk::Format::eUndefined, ExtentDescriptor::DynamicRelative()},
+		                  {AttachmentType::kColor, "normal", vk::Format::eA2B10G10R10UnormPack32, ExtentDescriptor::DynamicRelative()}})
 #ifdef EX
 		    .shader({"deferred/geometry_indirect.task", "deferred/geometry_indirect.mesh", "deferred/geometry_indirect.frag"})
 #else
@@ -234,7 +288,7 @@ bool SampleApp::prepare(Window *window)
 		                {BindableType::kSampled, "shadowmap"},
 		                {BindableType::kSampledCube, "point shadowmaps"}})
 
-		    .attachments({{AttachmentType::kColor, "lighting", vk::Format::eR16G16B16A16Sfloat}})
+		    .attachments({{AttachmentType::kColor, "lighting", vk::Format::eR16G16B16A16Sfloat, ExtentDescriptor::DynamicRelative()}})
 
 		    .shader({"deferred/lighting.vert", "deferred/clustered_lighting.frag"})
 
@@ -247,54 +301,54 @@ bool SampleApp::prepare(Window *window)
 
 		graph_builder_->add_pass("Bloom Extract", std::move(extract_pass))
 		    .bindables({{BindableType::kSampled, "lighting"},
-		                {BindableType::kStorageWrite, "bloom_extract", vk::Format::eR16G16B16A16Sfloat, ExtentDescriptor::SwapchainRelative(0.5, 0.5)}})
+		                {BindableType::kStorageWrite, "bloom_extract", vk::Format::eR16G16B16A16Sfloat, ExtentDescriptor::DynamicRelative(0.5, 0.5)}})
 		    .shader({"post_processing/bloom/threshold.comp"})
 		    .finalize();
 
 		auto downsample_pass0 = std::make_unique<BloomComputePass>();
 		graph_builder_->add_pass("Bloom Downsample 0", std::move(downsample_pass0))
 		    .bindables({{BindableType::kSampled, "bloom_extract"},
-		                {BindableType::kStorageWrite, "bloom_down_sample_0", vk::Format::eR16G16B16A16Sfloat, ExtentDescriptor::SwapchainRelative(0.25, 0.25)}})
+		                {BindableType::kStorageWrite, "bloom_down_sample_0", vk::Format::eR16G16B16A16Sfloat, ExtentDescriptor::DynamicRelative(0.25, 0.25)}})
 		    .shader({"post_processing/bloom/blur_down_first.comp"})
 		    .finalize();
 
 		auto downsample_pass1 = std::make_unique<BloomComputePass>();
 		graph_builder_->add_pass("Bloom Downsample 1", std::move(downsample_pass1))
 		    .bindables({{BindableType::kSampled, "bloom_down_sample_0"},
-		                {BindableType::kStorageWrite, "bloom_down_sample_1", vk::Format::eR16G16B16A16Sfloat, ExtentDescriptor::SwapchainRelative(0.125, 0.125)}})
+		                {BindableType::kStorageWrite, "bloom_down_sample_1", vk::Format::eR16G16B16A16Sfloat, ExtentDescriptor::DynamicRelative(0.125, 0.125)}})
 		    .shader({"post_processing/bloom/blur_down.comp"})
 		    .finalize();
 
 		auto downsample_pass2 = std::make_unique<BloomComputePass>();
 		graph_builder_->add_pass("Bloom Downsample 2", std::move(downsample_pass2))
 		    .bindables({{BindableType::kSampled, "bloom_down_sample_1"},
-		                {BindableType::kStorageWrite, "bloom_down_sample_2", vk::Format::eR16G16B16A16Sfloat, ExtentDescriptor::SwapchainRelative(0.0625, 0.0625)}})
+		                {BindableType::kStorageWrite, "bloom_down_sample_2", vk::Format::eR16G16B16A16Sfloat, ExtentDescriptor::DynamicRelative(0.0625, 0.0625)}})
 		    .shader({"post_processing/bloom/blur_down.comp"})
 		    .finalize();
 
 		auto upsample_pass0 = std::make_unique<BloomComputePass>();
 		graph_builder_->add_pass("Bloom Upsample 0", std::move(upsample_pass0))
 		    .bindables({{BindableType::kSampled, "bloom_down_sample_2"},
-		                {BindableType::kStorageWrite, "bloom_up_sample_0", vk::Format::eR16G16B16A16Sfloat, ExtentDescriptor::SwapchainRelative(0.125, 0.125)}})
+		                {BindableType::kStorageWrite, "bloom_up_sample_0", vk::Format::eR16G16B16A16Sfloat, ExtentDescriptor::DynamicRelative(0.125, 0.125)}})
 		    .shader({"post_processing/bloom/blur_up.comp"})
 		    .finalize();
 
 		auto upsample_pass1 = std::make_unique<BloomComputePass>();
 		graph_builder_->add_pass("Bloom Upsample 1", std::move(upsample_pass1))
 		    .bindables({{BindableType::kSampled, "bloom_up_sample_0"},
-		                {BindableType::kStorageWrite, "bloom_up_sample_1", vk::Format::eR16G16B16A16Sfloat, ExtentDescriptor::SwapchainRelative(0.25, 0.25)}})
+		                {BindableType::kStorageWrite, "bloom_up_sample_1", vk::Format::eR16G16B16A16Sfloat, ExtentDescriptor::DynamicRelative(0.25, 0.25)}})
 		    .shader({"post_processing/bloom/blur_up.comp"})
 		    .finalize();
 
 		auto upsample_pass2 = std::make_unique<BloomComputePass>();
 		graph_builder_->add_pass("Bloom Upsample 2", std::move(upsample_pass2))
 		    .bindables({{BindableType::kSampled, "bloom_up_sample_1"},
-		                {BindableType::kStorageWrite, "bloom_up_sample_2", vk::Format::eR16G16B16A16Sfloat, ExtentDescriptor::SwapchainRelative(0.5, 0.5)}})
+		                {BindableType::kStorageWrite, "bloom_up_sample_2", vk::Format::eR16G16B16A16Sfloat, ExtentDescriptor::DynamicRelative(0.5, 0.5)}})
 		    .shader({"post_processing/bloom/blur_up.comp"})
 		    .finalize();
 	}
 
-	gui_ = std::make_unique<Gui>(*this, *window, stats_.get());
+	gui_ = std::make_unique<Gui>(*this, window, stats_.get());
 	// composite pass
 	{
 		auto composite_pass = std::make_unique<BloomCompositePass>();
@@ -308,10 +362,6 @@ bool SampleApp::prepare(Window *window)
 	}
 	{
 	}
-
-	graph_builder_->build();
-
-	return true;
 }
 
 void SampleApp::update(float delta_time)
@@ -321,6 +371,7 @@ void SampleApp::update(float delta_time)
 	MeshPass::show_meshlet_view(show_meshlet_view_);
 	MeshPass::freeze_frustum(freeze_frustum_, camera_);
 	LightingPass::show_cascade_view(show_cascade_view_);
+	render_graph_->get_dynamic_resolution().set_enabled(dynamic_resolution_);
 	XiheApp::update(delta_time);
 }
 
@@ -328,12 +379,23 @@ void SampleApp::request_gpu_features(backend::PhysicalDevice &gpu)
 {
 	XiheApp::request_gpu_features(gpu);
 
-	REQUEST_REQUIRED_FEATURE(gpu, vk::PhysicalDeviceMeshShaderFeaturesEXT, meshShader);
-	REQUEST_REQUIRED_FEATURE(gpu, vk::PhysicalDeviceMeshShaderFeaturesEXT, meshShaderQueries);
-	REQUEST_REQUIRED_FEATURE(gpu, vk::PhysicalDeviceMeshShaderFeaturesEXT, taskShader);
+	mesh_shading_supported_ = gpu.is_extension_supported(VK_EXT_MESH_SHADER_EXTENSION_NAME) &&
+	                          REQUEST_OPTIONAL_FEATURE(gpu, vk::PhysicalDeviceMeshShaderFeaturesEXT, meshShader) &&
+	                          REQUEST_OPTIONAL_FEATURE(gpu, vk::PhysicalDeviceMeshShaderFeaturesEXT, taskShader);
+	if (mesh_shading_supported_)
+	{
+		REQUEST_OPTIONAL_FEATURE(gpu, vk::PhysicalDeviceMeshShaderFeaturesEXT, meshShaderQueries);
+	}
+	else
+	{
+		LOGW("Mesh shaders are not supported, the geometry is drawn with vertex shaders and point light shadows are disabled");
+	}
 
 	REQUEST_REQUIRED_FEATURE(gpu, vk::PhysicalDeviceVulkan11Features, shaderDrawParameters);
-	REQUEST_REQUIRED_FEATURE(gpu, vk::PhysicalDeviceFragmentShadingRateFeaturesKHR, primitiveFragmentShadingRate);
+	if (gpu.is_extension_supported(VK_KHR_FRAGMENT_SHADING_RATE_EXTENSION_NAME))
+	{
+		REQUEST_OPTIONAL_FEATURE(gpu, vk::PhysicalDeviceFragmentShadingRateFeaturesKHR, primitiveFragmentShadingRate);
+	}
 	// REQUEST_REQUIRED_FEATURE(gpu, vk::PhysicalDeviceFragmentShadingRateFeaturesKHR, attachmentFragmentShadingRate);
 }
 
@@ -346,6 +408,12 @@ void SampleApp::draw_gui()
 		    ImGui::Checkbox("Meshlet", &show_meshlet_view_);
 		    ImGui::Checkbox("视域静留", &freeze_frustum_);
 		    ImGui::Checkbox("级联阴影", &show_cascade_view_);
+		    ImGui::Checkbox("Test Pass", &run_test_pass_);
+		    ImGui::Checkbox("动态分辨率", &dynamic_resolution_);
+		    if (dynamic_resolution_)
+		    {
+			    ImGui::Text("%.0f%%", render_graph_->get_dynamic_resolution().get_scale() * 100.0f);
+		    }
 	    },
 	    /* lines = */ 2);
 }
@@ -6,10 +6,10 @@
 
 namespace xihe
 {
-class SampleApp final : public XiheApp
+class SampleApp : public XiheApp
 {
   public:
-	SampleApp();
+	explicit SampleApp(std::string scene_path = "scenes/sponza/Sponza01.gltf");
 	~SampleApp() override = default;
 
 	bool prepare(Window *window) override;
@@ -18,9 +18,23 @@ class SampleApp final : public XiheApp
 
 	void request_gpu_features(backend::PhysicalDevice &gpu) override;
 
-private:
+  protected:
+	/**
+	 * @brief Loads the scene and adds the lights and the camera
+	 */
+	void load_assets();
+
+	/**
+	 * @brief Adds the passes rendering the scene to the graph builder, the graph is not built yet
+	 */
+	void add_passes(Window &window);
+
 	void draw_gui() override;
 
+	std::string scene_path_;
+
+	sg::Texture *skybox_texture_{nullptr};
+
 	xihe::sg::Camera *camera_{nullptr};
 
 	std::unique_ptr<AssetLoader> asset_loader_;
@@ -28,5 +42,10 @@ private:
 	bool show_meshlet_view_{false};
 	bool freeze_frustum_{false};
 	bool show_cascade_view_{false};
+	bool run_test_pass_{false};
+	bool dynamic_resolution_{false};
+
+	/// Without mesh shaders, such as on lavapipe, the geometry is drawn with vertex shaders and point light shadows are only cleared
+	bool mesh_shading_supported_{true};
 };
 }        // namespace xihe
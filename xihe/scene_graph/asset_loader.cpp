@@ -1,12 +1,83 @@
 #include "asset_loader.h"
 
+#include "common/trace.h"
 #include "components/image.h"
 
 namespace xihe
 {
+namespace
+{
+/// Blits each missing level from the previous one, the whole image must be in transfer dst layout
+void generate_mipmaps_on_gpu(backend::CommandBuffer &command_buffer, sg::Image &image, vk::ImageLayout final_layout, vk::PipelineStageFlags2 final_stage, vk::AccessFlags2 final_access)
+{
+	XIHE_TRACE_ZONE("Generate mipmaps on GPU");
+
+	const auto &vk_image    = image.get_vk_image();
+	const auto  level_count = image.get_mip_levels();
+	const auto  first_level = to_u32(image.get_mipmaps().size());
+
+	auto level_range = [](uint32_t level, uint32_t count) {
+		return vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, level, count, 0, 1};
+	};
+
+	for (uint32_t level = first_level; level < level_count; ++level)
+	{
+		common::ImageMemoryBarrier memory_barrier{};
+		memory_barrier.old_layout      = vk::ImageLayout::eTransferDstOptimal;
+		memory_barrier.new_layout      = vk::ImageLayout::eTransferSrcOptimal;
+		memory_barrier.src_access_mask = vk::AccessFlagBits2::eTransferWrite;
+		memory_barrier.dst_access_mask = vk::AccessFlagBits2::eTransferRead;
+		memory_barrier.src_stage_mask  = vk::PipelineStageFlagBits2::eTransfer;
+		memory_barrier.dst_stage_mask  = vk::PipelineStageFlagBits2::eTransfer;
+		common::image_layout_transition(command_buffer.get_handle(), vk_image.get_handle(), memory_barrier, level_range(level - 1, 1));
+
+		auto src_extent = vk_image.get_extent();
+		auto src_width  = std::max(1u, src_extent.width >> (level - 1));
+		auto src_height = std::max(1u, src_extent.height >> (level - 1));
+
+		vk::ImageBlit blit;
+		blit.srcSubresource = vk::ImageSubresourceLayers{vk::ImageAspectFlagBits::eColor, level - 1, 0, 1};
+		blit.srcOffsets[1]  = vk::Offset3D{static_cast<int32_t>(src_width), static_cast<int32_t>(src_height), 1};
+		blit.dstSubresource = vk::ImageSubresourceLayers{vk::ImageAspectFlagBits::eColor, level, 0, 1};
+		blit.dstOffsets[1]  = vk::Offset3D{static_cast<int32_t>(std::max(1u, src_width / 2)), static_cast<int32_t>(std::max(1u, src_height / 2)), 1};
+
+		command_buffer.blit_image(vk_image, vk_image, {blit});
+	}
+
+	// All levels but the last are blit sources now
+	{
+		common::ImageMemoryBarrier memory_barrier{};
+		memory_barrier.old_layout      = vk::ImageLayout::eTransferSrcOptimal;
+		memory_barrier.new_layout      = final_layout;
+		memory_barrier.src_access_mask = vk::AccessFlagBits2::eTransferRead;
+		memory_barrier.dst_access_mask = final_access;
+		memory_barrier.src_stage_mask  = vk::PipelineStageFlagBits2::eTransfer;
+		memory_barrier.dst_stage_mask  = final_stage;
+		common::image_layout_transition(command_buffer.get_handle(), vk_image.get_handle(), memory_barrier, level_range(0, level_count - 1));
+	}
+	{
+		common::ImageMemoryBarrier memory_barrier{};
+		memory_barrier.old_layout      = vk::ImageLayout::eTransferDstOptimal;
+		memory_barrier.new_layout      = final_layout;
+		memory_barrier.src_access_mask = vk::AccessFlagBits2::eTransferWrite;
+		memory_barrier.dst_access_mask = final_access;
+		memory_barrier.src_stage_mask  = vk::PipelineStageFlagBits2::eTransfer;
+		memory_barrier.dst_stage_mask  = final_stage;
+		common::image_layout_transition(command_buffer.get_handle(), vk_image.get_handle(), memory_barrier, level_range(level_count - 1, 1));
+	}
+}
+}        // namespace
+
 void upload_image_to_gpu(backend::CommandBuffer &command_buffer, const backend::Buffer &staging_buffer, sg::Image &image, vk::ImageLayout final_layout, vk::PipelineStageFlags2 final_stage, vk::AccessFlags2 final_access)
 {
-	image.clear_data();
+	XIHE_TRACE_ZONE("Upload image");
+
+	// Streamed images keep their data, the levels in front of the resident mip are uploaded later
+	const auto resident_mip = image.get_resident_mip();
+	if (resident_mip == 0)
+	{
+		image.clear_data();
+	}
 	{
 		common::ImageMemoryBarrier memory_barrier{};
 		memory_barrier.old_layout      = vk::ImageLayout::eUndefined;
@@ -17,19 +88,25 @@ void upload_image_to_gpu(backend::CommandBuffer &command_buffer, const backend::
 		command_buffer.image_memory_barrier(image.get_vk_image_view(), memory_barrier);
 	}
 	auto                            &mipmaps = image.get_mipmaps();
-	std::vector<vk::BufferImageCopy> buffer_copy_regions(mipmaps.size());
-	for (size_t i = 0; i < mipmaps.size(); ++i)
+	std::vector<vk::BufferImageCopy> buffer_copy_regions(mipmaps.size() - resident_mip);
+	for (size_t i = resident_mip; i < mipmaps.size(); ++i)
 	{
 		auto &mipmap                          = mipmaps[i];
-		auto &copy_region                     = buffer_copy_regions[i];
-		copy_region.bufferOffset              = mipmap.offset;
+		auto &copy_region                     = buffer_copy_regions[i - resident_mip];
+		copy_region.bufferOffset              = mipmap.offset - mipmaps[resident_mip].offset;
 		copy_region.imageSubresource          = image.get_vk_image_view().get_subresource_layers();
-		copy_region.imageSubresource.mipLevel = mipmap.level;
+		copy_region.imageSubresource.mipLevel = mipmap.level - resident_mip;
 		copy_region.imageExtent               = mipmap.extent;
 	}
 
 	command_buffer.copy_buffer_to_image(staging_buffer, image.get_vk_image(), buffer_copy_regions);
 
+	if (image.get_mip_levels() > mipmaps.size())
+	{
+		generate_mipmaps_on_gpu(command_buffer, image, final_layout, final_stage, final_access);
+		return;
+	}
+
 	{
 		common::ImageMemoryBarrier memory_barrier{};
 		memory_barrier.old_layout      = vk::ImageLayout::eTransferDstOptimal;
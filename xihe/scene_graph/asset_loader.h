@@ -7,6 +7,9 @@
 namespace xihe
 {
 
+/**
+ * \brief Records the upload of the levels of the image from its resident mip down, the staging buffer holds the data from that level on
+ */
 void upload_image_to_gpu(
     backend::CommandBuffer &      command_buffer,
     const backend::Buffer        &staging_buffer,
@@ -1,20 +1,219 @@
 #include "image.h"
 
-#define STB_IMAGE_RESIZE_IMPLEMENTATION
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
 #include "image/ktx.h"
 #include "image/stb.h"
 
-#include <stb_image_resize.h>
-
+#include "common/worker_budget.h"
 #include "platform/filesystem.h"
 
 namespace xihe::sg
 {
+namespace
+{
+// Images smaller than this on their longest side keep the CPU filter, the upload barriers would cost more than the filter
+constexpr uint32_t kGpuMipMinExtent = 512;
+
+constexpr uint32_t kMipRowsPerTask = 64;
+
+uint32_t get_full_mip_count(const vk::Extent3D &extent)
+{
+	uint32_t count = 1;
+	for (auto size = std::max(extent.width, extent.height); size > 1; size /= 2)
+	{
+		++count;
+	}
+	return count;
+}
+
+/// Spreads the four 8 bit channels of a texel over 16 bit lanes, so four texels can be summed in one register
+inline uint64_t widen(const uint8_t *texel)
+{
+	uint32_t value;
+	std::memcpy(&value, texel, sizeof(value));
+
+	uint64_t lanes = value;
+	lanes          = (lanes | (lanes << 16)) & 0x0000FFFF0000FFFFull;
+	lanes          = (lanes | (lanes << 8)) & 0x00FF00FF00FF00FFull;
+	return lanes;
+}
+
+inline void narrow(uint64_t lanes, uint8_t *texel)
+{
+	lanes &= 0x00FF00FF00FF00FFull;
+	lanes = (lanes | (lanes >> 8)) & 0x0000FFFF0000FFFFull;
+	lanes = (lanes | (lanes >> 16)) & 0x00000000FFFFFFFFull;
+
+	const auto value = static_cast<uint32_t>(lanes);
+	std::memcpy(texel, &value, sizeof(value));
+}
+
+bool is_srgb_rgba8(vk::Format format)
+{
+	return format == vk::Format::eR8G8B8A8Srgb || format == vk::Format::eB8G8R8A8Srgb || format == vk::Format::eA8B8G8R8SrgbPack32;
+}
+
+/// Decoded value of each 8 bit sRGB code
+const std::array<float, 256> &get_srgb_to_linear()
+{
+	static const auto table = [] {
+		std::array<float, 256> values{};
+		for (uint32_t code = 0; code < 256; ++code)
+		{
+			const float value = static_cast<float>(code) / 255.0f;
+			values[code]      = value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+		}
+		return values;
+	}();
+	return table;
+}
+
+/// Nearest sRGB code of each linear value quantized to 16 bits, fine enough to round the darkest codes correctly
+const std::vector<uint8_t> &get_linear_to_srgb()
+{
+	static const auto table = [] {
+		std::vector<uint8_t> codes(65536);
+		for (uint32_t i = 0; i < codes.size(); ++i)
+		{
+			const float value   = static_cast<float>(i) / 65535.0f;
+			const float encoded = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+			codes[i]            = static_cast<uint8_t>(std::lround(std::clamp(encoded, 0.0f, 1.0f) * 255.0f));
+		}
+		return codes;
+	}();
+	return table;
+}
+
+/// Averages the 2x2 texels under each texel of the destination rows, the last row and column are repeated for odd sizes
+void downsample_rows(const uint8_t *src, vk::Extent3D src_extent, uint8_t *dst, vk::Extent3D dst_extent, uint32_t first_row, uint32_t last_row)
+{
+	const uint32_t last_x = src_extent.width - 1;
+	const uint32_t last_y = src_extent.height - 1;
+
+	for (uint32_t y = first_row; y < last_row; ++y)
+	{
+		const uint8_t *row0 = src + std::min(2 * y, last_y) * src_extent.width * 4;
+		const uint8_t *row1 = src + std::min(2 * y + 1, last_y) * src_extent.width * 4;
+		uint8_t       *out  = dst + y * dst_extent.width * 4;
+
+		for (uint32_t x = 0; x < dst_extent.width; ++x)
+		{
+			const uint32_t x0 = std::min(2 * x, last_x) * 4;
+			const uint32_t x1 = std::min(2 * x + 1, last_x) * 4;
+
+			// Rounded average of each channel, the +2 per lane rounds to nearest
+			const uint64_t sum = widen(row0 + x0) + widen(row0 + x1) + widen(row1 + x0) + widen(row1 + x1) + 0x0002000200020002ull;
+			narrow(sum >> 2, out + x * 4);
+		}
+	}
+}
+
+/// The same filter on sRGB texels, the color channels are averaged in linear space as a linear blit of an sRGB image does.
+/// Alpha is stored linearly and averaged as is
+void downsample_rows_srgb(const uint8_t *src, vk::Extent3D src_extent, uint8_t *dst, vk::Extent3D dst_extent, uint32_t first_row, uint32_t last_row)
+{
+	const auto &to_linear = get_srgb_to_linear();
+	const auto &to_srgb   = get_linear_to_srgb();
+
+	const uint32_t last_x = src_extent.width - 1;
+	const uint32_t last_y = src_extent.height - 1;
+
+	for (uint32_t y = first_row; y < last_row; ++y)
+	{
+		const uint8_t *row0 = src + std::min(2 * y, last_y) * src_extent.width * 4;
+		const uint8_t *row1 = src + std::min(2 * y + 1, last_y) * src_extent.width * 4;
+		uint8_t       *out  = dst + y * dst_extent.width * 4;
+
+		for (uint32_t x = 0; x < dst_extent.width; ++x)
+		{
+			const uint32_t x0 = std::min(2 * x, last_x) * 4;
+			const uint32_t x1 = std::min(2 * x + 1, last_x) * 4;
+
+			// The alpha channel is the last one of every RGBA8 sRGB format
+			for (uint32_t c = 0; c < 3; ++c)
+			{
+				const float sum = to_linear[row0[x0 + c]] + to_linear[row0[x1 + c]] + to_linear[row1[x0 + c]] + to_linear[row1[x1 + c]];
+				out[x * 4 + c]  = to_srgb[std::min(static_cast<uint32_t>(sum * (65535.0f / 4.0f) + 0.5f), 65535u)];
+			}
+			out[x * 4 + 3] = static_cast<uint8_t>((row0[x0 + 3] + row0[x1 + 3] + row1[x0 + 3] + row1[x1 + 3] + 2) >> 2);
+		}
+	}
+}
+}        // namespace
+
 bool is_astc(const vk::Format format)
 {
 	return strncmp(vk::compressionScheme(format), "ASTC", 4) == 0;
 }
 
+const char *to_string(TranscodeTarget target)
+{
+	switch (target)
+	{
+		case TranscodeTarget::kBc7:
+			return "bc7";
+		case TranscodeTarget::kAstc4x4:
+			return "astc4x4";
+		case TranscodeTarget::kEtc2:
+			return "etc2";
+		default:
+			return "rgba8";
+	}
+}
+
+bool is_rgba8(vk::Format format)
+{
+	return std::string(vk::compressionScheme(format)).empty() && vk::blockSize(format) == 4 && vk::componentCount(format) == 4 && vk::componentBits(format, 0) == 8;
+}
+
+MipGenerator select_mip_generator(const backend::Device &device, const Image &image, uint32_t streamed_mip_tail_extent)
+{
+	const auto &extent = image.get_extent();
+	if (image.get_mipmaps().size() > 1 || image.get_layers() > 1 || extent.depth > 1 || !is_rgba8(image.get_format()))
+	{
+		return MipGenerator::kNone;
+	}
+
+	// Levels above the tail are streamed in from the data later, so they have to exist on the CPU
+	if (streamed_mip_tail_extent != 0 && std::max(extent.width, extent.height) > streamed_mip_tail_extent)
+	{
+		return MipGenerator::kCpu;
+	}
+
+	constexpr auto blit_features = vk::FormatFeatureFlagBits::eBlitSrc | vk::FormatFeatureFlagBits::eBlitDst | vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+
+	auto properties = device.get_gpu().get_format_properties(image.get_format());
+	if (std::max(extent.width, extent.height) >= kGpuMipMinExtent && (properties.optimalTilingFeatures & blit_features) == blit_features)
+	{
+		return MipGenerator::kGpu;
+	}
+	return MipGenerator::kCpu;
+}
+
+TranscodeTarget select_transcode_target(const backend::Device &device)
+{
+	auto features = device.get_gpu().get_requested_features();
+
+	if (features.textureCompressionBC && device.is_image_format_supported(vk::Format::eBc7SrgbBlock))
+	{
+		return TranscodeTarget::kBc7;
+	}
+	if (features.textureCompressionASTC_LDR && device.is_image_format_supported(vk::Format::eAstc4x4SrgbBlock))
+	{
+		return TranscodeTarget::kAstc4x4;
+	}
+	if (features.textureCompressionETC2 && device.is_image_format_supported(vk::Format::eEtc2R8G8B8A8SrgbBlock))
+	{
+		return TranscodeTarget::kEtc2;
+	}
+	return TranscodeTarget::kRgba8;
+}
+
 Image::Image(const std::string &name, std::vector<uint8_t> &&d, std::vector<sg::Mipmap> &&m) :
     Component{name},
     data{std::move(d)},
@@ -23,7 +222,7 @@ Image::Image(const std::string &name, std::vector<uint8_t> &&d, std::vector<sg::
 {}
 
 std::unique_ptr<sg::Image> Image::load(const std::string &name, const std::string &uri,
-                                                                       ContentType content_type)
+                                       ContentType content_type, TranscodeTarget transcode_target)
 {
 	std::unique_ptr<sg::Image> image{nullptr};
 
@@ -33,7 +232,7 @@ std::unique_ptr<sg::Image> Image::load(const std::string &name, const std::strin
 	auto extension = fs::get_extension(uri);
 
 	// the derived classes Stb, Astc, and Ktx are not transcoded (yet), so we need some more complex casting here...
-	if (extension == "png" || extension == "jpg")
+	if (extension == "png" || extension == "jpg" || extension == "jpeg")
 	{
 		image = std::unique_ptr<sg::Image>(reinterpret_cast<sg::Image *>(
 		    std::make_unique<sg::Stb>(name, data, static_cast<sg::Image::ContentType>(content_type)).release()));
@@ -46,7 +245,7 @@ std::unique_ptr<sg::Image> Image::load(const std::string &name, const std::strin
 	else if ((extension == "ktx") || (extension == "ktx2"))
 	{
 		image = std::unique_ptr<sg::Image>(reinterpret_cast<sg::Image *>(
-		    std::make_unique<sg::Ktx>(name, data, static_cast<sg::Image::ContentType>(content_type)).release()));
+		    std::make_unique<sg::Ktx>(name, data, static_cast<sg::Image::ContentType>(content_type), transcode_target).release()));
 	}
 
 	return image;
@@ -176,72 +375,183 @@ void Image::coerce_format_to_srgb()
 	}
 }
 
-void Image::create_vk_image(backend::Device &device, vk::ImageViewType image_view_type, vk::ImageCreateFlags flags)
+void Image::create_vk_image(backend::Device &device, vk::ImageViewType image_view_type, vk::ImageCreateFlags flags, uint32_t resident_mip)
 {
 	assert(!vk_image && !vk_image_view && "Vulkan Image already constructed");
 
-	vk_image = std::make_unique<backend::Image>(device,
-	                                                 get_extent(),
-	                                                 format,
-	                                                 vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst,
-	                                                 VMA_MEMORY_USAGE_GPU_ONLY,
-	                                                 vk::SampleCountFlagBits::e1,
-	                                                 to_u32(mipmaps.size()),
-	                                                 layers,
-	                                                 vk::ImageTiling::eOptimal,
-	                                                 flags);
-	vk_image->set_debug_name(get_name());
+	auto gpu_image = build_vk_image(device, resident_mip, image_view_type, flags);
+
+	vk_image           = std::move(gpu_image.image);
+	vk_image_view      = std::move(gpu_image.image_view);
+	this->resident_mip = resident_mip;
+}
+
+Image::GpuImage Image::build_vk_image(backend::Device &device, uint32_t resident_mip, vk::ImageViewType image_view_type, vk::ImageCreateFlags flags) const
+{
+	assert(resident_mip < get_mip_levels());
+	assert((resident_mip == 0 || resident_mip < mipmaps.size()) && "Only levels held in the data can be streamed");
+
+	backend::ImageBuilder image_builder{mipmaps[resident_mip].extent};
+	image_builder.with_format(format)
+	    .with_usage(vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eTransferSrc)
+	    .with_vma_usage(VMA_MEMORY_USAGE_GPU_ONLY)
+	    .with_memory_category(backend::allocated::MemoryCategory::kTexture)
+	    .with_mip_levels(get_mip_levels() - resident_mip)
+	    .with_array_layers(layers)
+	    .with_tiling(vk::ImageTiling::eOptimal)
+	    .with_flags(flags);
+
+	GpuImage gpu_image;
+	gpu_image.image = image_builder.build_unique(device);
+	gpu_image.image->set_debug_name(get_name());
+
+	gpu_image.image_view = std::make_unique<backend::ImageView>(*gpu_image.image, image_view_type);
+	gpu_image.image_view->set_debug_name("View on " + get_name());
+
+	return gpu_image;
+}
+
+Image::GpuImage Image::swap_vk_image(GpuImage &&gpu_image, uint32_t resident_mip)
+{
+	GpuImage replaced{std::move(vk_image), std::move(vk_image_view)};
+
+	vk_image           = std::move(gpu_image.image);
+	vk_image_view      = std::move(gpu_image.image_view);
+	this->resident_mip = resident_mip;
+
+	return replaced;
+}
+
+std::unique_ptr<Image> Image::create_packed_array(backend::Device &device, const std::string &name, const std::vector<Image *> &images)
+{
+	assert(!images.empty());
+	const auto &first = *images.front();
+
+	auto array    = std::make_unique<Image>(name, std::vector<uint8_t>{}, std::vector<sg::Mipmap>{first.mipmaps});
+	array->format = first.format;
+	array->layers = to_u32(images.size());
+	array->create_vk_image(device, vk::ImageViewType::e2DArray);
+
+	for (uint32_t layer = 0; layer < array->layers; ++layer)
+	{
+		auto &image = *images[layer];
+		assert(!image.is_created() && "Vulkan Image already constructed");
+		assert(image.format == first.format && image.get_extent() == first.get_extent() && image.get_mip_levels() == first.get_mip_levels());
+
+		image.vk_image_view = std::make_unique<backend::ImageView>(*array->vk_image, vk::ImageViewType::e2D, image.format, 0, layer, image.get_mip_levels(), 1);
+		image.vk_image_view->set_debug_name("View on " + image.get_name());
+		image.packed_array = array.get();
+		image.packed_layer = layer;
+	}
+
+	return array;
+}
+
+Image *Image::get_packed_array() const
+{
+	return packed_array;
+}
 
-	vk_image_view = std::make_unique<backend::ImageView>(*vk_image, image_view_type);
-	vk_image_view->set_debug_name("View on " + get_name());
+uint32_t Image::get_packed_layer() const
+{
+	return packed_layer;
 }
 
 void Image::generate_mipmaps()
 {
 	assert(mipmaps.size() == 1 && "Mipmaps already generated");
+	assert(is_rgba8(format) && "Mipmaps are only generated for RGBA8 images");
 
 	if (mipmaps.size() > 1)
 	{
 		return;        // Do not generate again
 	}
 
-	auto extent      = get_extent();
-	auto next_width  = std::max<uint32_t>(1u, extent.width / 2);
-	auto next_height = std::max<uint32_t>(1u, extent.height / 2);
-	auto channels    = 4;
-	auto next_size   = next_width * next_height * channels;
+	const auto level_count = get_full_mip_count(get_extent());
 
-	while (true)
+	// Make space for the whole chain at once
+	uint32_t size = mipmaps[0].offset + mipmaps[0].extent.width * mipmaps[0].extent.height * 4;
+	for (uint32_t level = 1; level < level_count; ++level)
 	{
-		// Make space for next mipmap
-		auto old_size = to_u32(data.size());
-		data.resize(old_size + next_size);
+		const auto &prev_mipmap = mipmaps.back();
 
-		auto &prev_mipmap = mipmaps.back();
-		// Update mipmaps
 		sg::Mipmap next_mipmap{};
-		next_mipmap.level  = prev_mipmap.level + 1;
-		next_mipmap.offset = old_size;
-		next_mipmap.extent = vk::Extent3D(next_width, next_height, 1u);
+		next_mipmap.level  = level;
+		next_mipmap.offset = size;
+		next_mipmap.extent = vk::Extent3D(std::max<uint32_t>(1u, prev_mipmap.extent.width / 2), std::max<uint32_t>(1u, prev_mipmap.extent.height / 2), 1u);
 
-		// Fill next mipmap memory
-		stbir_resize_uint8(data.data() + prev_mipmap.offset, prev_mipmap.extent.width, prev_mipmap.extent.height, 0,
-		                   data.data() + next_mipmap.offset, next_mipmap.extent.width, next_mipmap.extent.height, 0, channels);
+		size += next_mipmap.extent.width * next_mipmap.extent.height * 4;
+		mipmaps.push_back(next_mipmap);
+	}
+	data.resize(size);
+
+	// This runs on a loader thread, extra threads come from the shared budget so concurrent loads do not oversubscribe
+	auto lease = WorkerBudget::get().acquire(WorkerBudget::get().get_thread_count());
+
+	// Filtering in linear space matches the GPU blit path, the bytes of an sRGB image are not linear
+	const auto downsample = is_srgb_rgba8(format) ? downsample_rows_srgb : downsample_rows;
+
+	for (uint32_t level = 1; level < level_count; ++level)
+	{
+		const auto &src = mipmaps[level - 1];
+		const auto &dst = mipmaps[level];
 
-		mipmaps.emplace_back(std::move(next_mipmap));
+		const uint8_t *src_data = data.data() + src.offset;
+		uint8_t       *dst_data = data.data() + dst.offset;
 
-		// Next mipmap values
-		next_width  = std::max<uint32_t>(1u, next_width / 2);
-		next_height = std::max<uint32_t>(1u, next_height / 2);
-		next_size   = next_width * next_height * channels;
+		// Small levels are not worth a thread
+		const uint32_t task_count = std::min(lease.get_thread_count(), (dst.extent.height + kMipRowsPerTask - 1) / kMipRowsPerTask);
+		const uint32_t rows       = (dst.extent.height + task_count - 1) / task_count;
 
-		if (next_width == 1 && next_height == 1)
+		std::vector<std::thread> workers;
+		for (uint32_t task = 1; task < task_count; ++task)
 		{
-			break;
+			workers.emplace_back(downsample, src_data, src.extent, dst_data, dst.extent, task * rows, std::min(dst.extent.height, (task + 1) * rows));
+		}
+		downsample(src_data, src.extent, dst_data, dst.extent, 0, std::min(dst.extent.height, rows));
+
+		for (auto &worker : workers)
+		{
+			worker.join();
 		}
 	}
 }
 
+void Image::request_gpu_mipmaps()
+{
+	assert(!vk_image && "The Vulkan image is already created");
+
+	gpu_mip_levels = get_full_mip_count(get_extent());
+}
+
+uint32_t Image::get_mip_levels() const
+{
+	return std::max(to_u32(mipmaps.size()), gpu_mip_levels);
+}
+
+uint32_t Image::get_resident_mip() const
+{
+	return resident_mip;
+}
+
+uint32_t Image::get_mip_tail(uint32_t max_extent) const
+{
+	for (uint32_t level = 0; level < mipmaps.size(); ++level)
+	{
+		if (std::max(mipmaps[level].extent.width, mipmaps[level].extent.height) <= max_extent)
+		{
+			return level;
+		}
+	}
+	return to_u32(mipmaps.size()) - 1;
+}
+
+size_t Image::get_data_size(uint32_t first_mip) const
+{
+	assert(first_mip < mipmaps.size());
+	return data.size() - mipmaps[first_mip].offset;
+}
+
 const std::vector<uint8_t> &Image::get_data() const
 {
 	return data;
@@ -275,8 +585,9 @@ const std::vector<std::vector<vk::DeviceSize>> &Image::get_offsets() const
 
 const backend::Image &Image::get_vk_image() const
 {
-	assert(vk_image && "Vulkan Image was not created");
-	return *vk_image;
+	assert(vk_image_view && "Vulkan Image was not created");
+	// Packed images only hold a view on their layer of the array
+	return vk_image ? *vk_image : vk_image_view->get_image();
 }
 
 const backend::ImageView &Image::get_vk_image_view() const
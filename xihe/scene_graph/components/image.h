@@ -8,6 +8,25 @@ namespace xihe::sg
 {
 bool is_astc(vk::Format format);
 
+/**
+ * @brief Block compressed format Basis Universal textures are transcoded to when they are loaded
+ */
+enum class TranscodeTarget
+{
+	kBc7,
+	kAstc4x4,
+	kEtc2,
+	kRgba8
+};
+
+const char *to_string(TranscodeTarget target);
+
+/**
+ * @brief Picks the best compressed format the device samples, in the order BC7, ASTC 4x4, ETC2, uncompressed RGBA8 otherwise
+ * The texture compression features must be enabled on the device for a compressed target to be chosen
+ */
+TranscodeTarget select_transcode_target(const backend::Device &device);
+
 /**
  * @brief Mipmap information
  */
@@ -25,6 +44,15 @@ class Image : public sg::Component
 	virtual ~Image() = default;
 
   public:
+	/**
+	 * @brief Vulkan image and view over the levels from a first mip down, texture streaming swaps them in
+	 */
+	struct GpuImage
+	{
+		std::unique_ptr<backend::Image>     image;
+		std::unique_ptr<backend::ImageView> image_view;
+	};
+
 	/**
 	 * @brief Type of content held in image.
 	 * This helps to steer the image loaders when deciding what the format should be.
@@ -39,15 +67,69 @@ class Image : public sg::Component
 		kOther
 	};
 
-	static std::unique_ptr<sg::Image> load(const std::string &name, const std::string &uri, ContentType content_type);
+	/**
+	 * @brief Loads an image from the assets, the transcode target only applies to Basis Universal KTX2 files
+	 */
+	static std::unique_ptr<sg::Image> load(const std::string &name, const std::string &uri, ContentType content_type,
+	                                       TranscodeTarget transcode_target = TranscodeTarget::kRgba8);
 
 	// from Component
 	virtual std::type_index get_type() override;
 
 	void                                                        clear_data();
 	void                                                        coerce_format_to_srgb();
-	void                                                        create_vk_image(backend::Device &device, vk::ImageViewType image_view_type = vk::ImageViewType::e2D, vk::ImageCreateFlags flags = {});
+	/**
+	 * @brief The Vulkan image holds the levels from the resident mip down, the others stay in the data to be streamed in later
+	 */
+	void                                                        create_vk_image(backend::Device &device, vk::ImageViewType image_view_type = vk::ImageViewType::e2D, vk::ImageCreateFlags flags = {}, uint32_t resident_mip = 0);
+
+	/**
+	 * @brief Builds a Vulkan image over the levels from the resident mip down without touching the current one, the caller uploads it
+	 */
+	GpuImage                                                    build_vk_image(backend::Device &device, uint32_t resident_mip, vk::ImageViewType image_view_type = vk::ImageViewType::e2D, vk::ImageCreateFlags flags = {}) const;
+
+	/**
+	 * @brief Replaces the Vulkan image, the replaced one is returned to be released once the GPU no longer samples it
+	 */
+	GpuImage                                                    swap_vk_image(GpuImage &&gpu_image, uint32_t resident_mip);
+
+	/**
+	 * @brief Creates an array image with the images as its layers, they must match in format, extent and levels and have no Vulkan image yet.
+	 * Each image gets a 2D view on its layer and is uploaded through it, the array holds no data and is sampled through its 2D array view
+	 */
+	static std::unique_ptr<Image>                               create_packed_array(backend::Device &device, const std::string &name, const std::vector<Image *> &images);
+
+	/**
+	 * @brief Array the image is a layer of, nullptr if it owns its Vulkan image
+	 */
+	Image                                                      *get_packed_array() const;
+	uint32_t                                                    get_packed_layer() const;
+	/**
+	 * @brief Generates the rest of the mip chain of an RGBA8 image with a 2x2 box filter, the rows of each level are split across threads.
+	 * sRGB images are filtered in linear space like the GPU blit path
+	 */
 	void                                                        generate_mipmaps();
+
+	/**
+	 * @brief The rest of the mip chain is blitted from the first level after the upload instead, must be called before create_vk_image
+	 */
+	void                                                        request_gpu_mipmaps();
+	uint32_t                                                    get_mip_levels() const;
+
+	/**
+	 * @brief Level of the data the Vulkan image starts at, its level 0
+	 */
+	uint32_t                                                    get_resident_mip() const;
+
+	/**
+	 * @brief First level that fits within the max extent, the last level if none does
+	 */
+	uint32_t                                                    get_mip_tail(uint32_t max_extent) const;
+
+	/**
+	 * @brief Bytes of the data of the levels from the first mip down
+	 */
+	size_t                                                      get_data_size(uint32_t first_mip) const;
 	const std::vector<uint8_t>                                 &get_data() const;
 	const vk::Extent3D                                         &get_extent() const;
 	vk::Format                                                  get_format() const;
@@ -80,5 +162,28 @@ class Image : public sg::Component
 	std::vector<std::vector<vk::DeviceSize>>             offsets;        // Offsets stored like offsets[array_layer][mipmap_layer]
 	std::unique_ptr<backend::Image>                 vk_image;
 	std::unique_ptr<backend::ImageView>             vk_image_view;
+	uint32_t                                             gpu_mip_levels = 0;        // Levels of the Vulkan image when the mip chain is generated on the GPU
+	uint32_t                                             resident_mip   = 0;
+	Image                                               *packed_array   = nullptr;
+	uint32_t                                             packed_layer   = 0;
 };
+
+/**
+ * @brief Where the missing levels of a mip chain are generated
+ */
+enum class MipGenerator
+{
+	kNone,
+	kCpu,
+	kGpu
+};
+
+bool is_rgba8(vk::Format format);
+
+/**
+ * @brief Large images the device can blit with linear filtering get their mips on the GPU, other RGBA8 images on the CPU
+ * Images that already have a mip chain, and compressed or layered images, get none.
+ * Images larger than a non zero streamed mip tail extent are streamed from their data and always get them on the CPU
+ */
+MipGenerator select_mip_generator(const backend::Device &device, const Image &image, uint32_t streamed_mip_tail_extent = 0);
 }
@@ -6,10 +6,21 @@
 #endif
 #include <astcenc.h>
 
+#include <algorithm>
+#include <thread>
+
+#include "common/worker_budget.h"
+
 #define MAGIC_FILE_CONSTANT 0x5CA1AB13
 
 namespace xihe::sg
 {
+namespace
+{
+// Below this many blocks per thread, starting another thread costs more than it saves
+constexpr uint64_t kBlocksPerThread = 1024;
+}        // namespace
+
 BlockDim to_blockdim(const vk::Format format)
 {
 	switch (format)
@@ -76,7 +87,7 @@ void Astc::init()
 {
 }
 
-void Astc::decode(BlockDim blockdim, vk::Extent3D extent, const uint8_t *compressed_data, uint32_t compressed_size)
+void Astc::decode(BlockDim blockdim, const std::vector<AstcLevel> &levels)
 {
 	// Actual decoding
 	astcenc_swizzle swizzle = {ASTCENC_SWZ_R, ASTCENC_SWZ_G, ASTCENC_SWZ_B, ASTCENC_SWZ_A};
@@ -96,40 +107,87 @@ void Astc::decode(BlockDim blockdim, vk::Extent3D extent, const uint8_t *compres
 		throw std::runtime_error{"Error initializing astc"};
 	}
 
-	if (extent.width == 0 || extent.height == 0 || extent.depth == 0)
+	if (levels.empty() || levels[0].extent.width == 0 || levels[0].extent.height == 0 || levels[0].extent.depth == 0)
 	{
 		throw std::runtime_error{"Error reading astc: invalid size"};
 	}
 
-	// Allocate working state given config and thread_count
-	astcenc_context *astc_context;
-	astcenc_context_alloc(&astc_config, 1, &astc_context);
-
-	astcenc_image decoded{};
-	decoded.dim_x     = extent.width;
-	decoded.dim_y     = extent.height;
-	decoded.dim_z     = extent.depth;
-	decoded.data_type = ASTCENC_TYPE_U8;
-
-	// allocate storage for the decoded image
-	// The astcenc_decompress_image function will write directly to the image data vector
-	auto  uncompressed_size = decoded.dim_x * decoded.dim_y * decoded.dim_z * 4;
-	auto &decoded_data      = get_mut_data();
-	decoded_data.resize(uncompressed_size);
-	void *data_ptr = static_cast<void *>(decoded_data.data());
-	decoded.data   = &data_ptr;
-
-	atscresult = astcenc_decompress_image(astc_context, compressed_data, compressed_size, &decoded, &swizzle, 0);
-	if (atscresult != ASTCENC_SUCCESS)
+	// Allocate storage for all decoded levels, the decoder writes directly to the image data vector
+	auto &mipmaps = get_mut_mipmaps();
+	mipmaps.resize(levels.size());
+
+	uint32_t decoded_size = 0;
+	for (uint32_t level = 0; level < to_u32(levels.size()); ++level)
+	{
+		const auto &extent = levels[level].extent;
+
+		mipmaps[level].level  = level;
+		mipmaps[level].offset = decoded_size;
+		mipmaps[level].extent = extent;
+
+		decoded_size += extent.width * extent.height * extent.depth * 4;
+	}
+
+	auto &decoded_data = get_mut_data();
+	decoded_data.resize(decoded_size);
+
+	// Decoding runs on a loader thread, extra threads come from the shared budget so concurrent loads do not oversubscribe.
+	// Levels are decoded one after another, each on as many of the leased threads as it has blocks for
+	auto lease = WorkerBudget::get().acquire(WorkerBudget::get().get_thread_count());
+
+	for (size_t level = 0; level < levels.size(); ++level)
 	{
-		throw std::runtime_error("Error decoding astc");
+		const auto &extent = levels[level].extent;
+
+		const uint64_t block_count  = levels[level].size / 16;
+		const uint32_t thread_count = static_cast<uint32_t>(std::clamp<uint64_t>(block_count / kBlocksPerThread, 1, lease.get_thread_count()));
+
+		astcenc_context *context = nullptr;
+		atscresult               = astcenc_context_alloc(&astc_config, thread_count, &context);
+		if (atscresult != ASTCENC_SUCCESS)
+		{
+			throw std::runtime_error{"Error allocating astc context"};
+		}
+
+		// One pointer per z slice
+		std::vector<void *> slices;
+		for (uint32_t z = 0; z < extent.depth; ++z)
+		{
+			slices.push_back(decoded_data.data() + mipmaps[level].offset + z * extent.width * extent.height * 4);
+		}
+
+		astcenc_image decoded;
+		decoded.dim_x     = extent.width;
+		decoded.dim_y     = extent.height;
+		decoded.dim_z     = extent.depth;
+		decoded.data_type = ASTCENC_TYPE_U8;
+		decoded.data      = slices.data();
+
+		// The calling thread decodes too, as thread index 0
+		std::vector<astcenc_error> results(thread_count, ASTCENC_SUCCESS);
+		std::vector<std::thread>   workers;
+		for (uint32_t thread_index = 1; thread_index < thread_count; ++thread_index)
+		{
+			workers.emplace_back([&, thread_index]() {
+				results[thread_index] = astcenc_decompress_image(context, levels[level].data, levels[level].size, &decoded, &swizzle, thread_index);
+			});
+		}
+		results[0] = astcenc_decompress_image(context, levels[level].data, levels[level].size, &decoded, &swizzle, 0);
+
+		for (auto &worker : workers)
+		{
+			worker.join();
+		}
+
+		astcenc_context_free(context);
+
+		if (std::any_of(results.begin(), results.end(), [](astcenc_error result) { return result != ASTCENC_SUCCESS; }))
+		{
+			throw std::runtime_error("Error decoding astc");
+		}
 	}
-	astcenc_context_free(astc_context);
 
 	set_format(VK_FORMAT_R8G8B8A8_SRGB);
-	set_width(decoded.dim_x);
-	set_height(decoded.dim_y);
-	set_depth(decoded.dim_z);
 }
 
 Astc::Astc(const Image &image) :
@@ -137,18 +195,23 @@ Astc::Astc(const Image &image) :
 {
 	init();
 
-	// Locate mip #0 in the KTX. This is the first one in the data array for KTX1s, but the last one in KTX2s!
-	auto mip_it = std::find_if(image.get_mipmaps().begin(), image.get_mipmaps().end(),
-	                           [](auto &mip) { return mip.level == 0; });
-	assert(mip_it != image.get_mipmaps().end() && "Mip #0 not found");
-
-	// When decoding ASTC on CPU (as it is the case in here), we don't decode all mips in the mip chain.
-	// Instead, we just decode mip #0 and re-generate the other LODs later (via image->generate_mipmaps()).
-	const auto     blockdim = to_blockdim(image.get_format());
-	const auto    &extent   = mip_it->extent;
-	auto           size     = extent.width * extent.height * extent.depth * 4;
-	const uint8_t *data_ptr = image.get_data().data() + mip_it->offset;
-	decode(blockdim, mip_it->extent, data_ptr, size);
+	const auto blockdim = to_blockdim(image.get_format());
+
+	// All levels of the source mip chain are decoded, so they keep their authored content.
+	// Mip #0 is the first one in the data array for KTX1s, but the last one in KTX2s, so levels are placed by index
+	std::vector<AstcLevel> levels(image.get_mipmaps().size());
+	for (const auto &mip : image.get_mipmaps())
+	{
+		assert(mip.level < levels.size() && "Mip levels are not contiguous");
+
+		const auto &extent = mip.extent;
+		auto        blocks = ((extent.width + blockdim.x - 1) / blockdim.x) *
+		          ((extent.height + blockdim.y - 1) / blockdim.y) *
+		          ((extent.depth + blockdim.z - 1) / blockdim.z);
+
+		levels[mip.level] = {image.get_data().data() + mip.offset, blocks * 16, extent};
+	}
+	decode(blockdim, levels);
 }
 
 Astc::Astc(const std::string &name, const std::vector<uint8_t> &data) :
@@ -179,6 +242,6 @@ Astc::Astc(const std::string &name, const std::vector<uint8_t> &data) :
 	    /* height = */ static_cast<uint32_t>(header.ysize[0] + 256 * header.ysize[1] + 65536 * header.ysize[2]),
 	    /* depth  = */ static_cast<uint32_t>(header.zsize[0] + 256 * header.zsize[1] + 65536 * header.zsize[2])};
 
-	decode(blockdim, extent, data.data() + sizeof(AstcHeader), to_u32(data.size() - sizeof(AstcHeader)));
+	decode(blockdim, {{data.data() + sizeof(AstcHeader), to_u32(data.size() - sizeof(AstcHeader)), extent}});
 }
 }
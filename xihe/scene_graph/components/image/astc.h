@@ -12,6 +12,16 @@ struct BlockDim
 	uint8_t z;
 };
 
+/**
+ * @brief Compressed data of one mip level
+ */
+struct AstcLevel
+{
+	const uint8_t *data{nullptr};
+	uint32_t       size{0};
+	vk::Extent3D   extent{};
+};
+
 class Astc : public Image
 {
   public:
@@ -23,9 +33,10 @@ class Astc : public Image
 
   private:
 	/**
-	 * @brief Decodes ASTC data
+	 * @brief Decodes the mip levels concurrently, each level is split across worker threads sharing one astcenc context
+	 * The decoded levels are stored one after the other starting with the first
 	 */
-	void decode(BlockDim blockdim, vk::Extent3D extent, const uint8_t *data, uint32_t size);
+	void decode(BlockDim blockdim, const std::vector<AstcLevel> &levels);
 
 	void init();
 };
@@ -1,8 +1,14 @@
 #include "ktx.h"
 
+#include <filesystem>
+#include <string_view>
+
 #include <ktx.h>
 #include <ktxvulkan.h>
 
+#include "common/logging.h"
+#include "platform/filesystem.h"
+
 namespace xihe::sg
 {
 struct CallbackData final
@@ -43,8 +49,30 @@ static ktx_error_code_e KTX_APIENTRY optimal_tiling_callback(int          mip_le
 	return KTX_SUCCESS;
 }
 
-Ktx::Ktx(const std::string &name, const std::vector<uint8_t> &data, ContentType content_type) :
-    Image{name}
+static ktx_transcode_fmt_e get_transcode_format(ktxTexture2 *texture, TranscodeTarget target)
+{
+	switch (target)
+	{
+		case TranscodeTarget::kBc7:
+			return KTX_TTF_BC7_RGBA;
+		case TranscodeTarget::kAstc4x4:
+			return KTX_TTF_ASTC_4x4_RGBA;
+		case TranscodeTarget::kEtc2:
+			// ETC1 is a subset of ETC2 and half the size when there is no alpha to keep
+			return ktxTexture2_GetNumComponents(texture) == 4 ? KTX_TTF_ETC2_RGBA : KTX_TTF_ETC1_RGB;
+		default:
+			return KTX_TTF_RGBA32;
+	}
+}
+
+/// The cache entry is keyed on the content of the source file, so an edited texture is transcoded again
+static std::filesystem::path get_cache_path(const std::vector<uint8_t> &data, TranscodeTarget target)
+{
+	auto hash = std::hash<std::string_view>{}(std::string_view{reinterpret_cast<const char *>(data.data()), data.size()});
+	return fs::path::get(fs::path::Type::kCache, fmt::format("{:016x}_{}.ktx2", hash, to_string(target)));
+}
+
+static ktxTexture *create_texture(const std::string &name, const std::vector<uint8_t> &data, TranscodeTarget transcode_target)
 {
 	auto data_buffer = reinterpret_cast<const ktx_uint8_t *>(data.data());
 	auto data_size   = static_cast<ktx_size_t>(data.size());
@@ -59,6 +87,45 @@ Ktx::Ktx(const std::string &name, const std::vector<uint8_t> &data, ContentType
 		throw std::runtime_error{"Error loading KTX texture: " + name};
 	}
 
+	if (texture->classId != ktxTexture2_c || !ktxTexture2_NeedsTranscoding(reinterpret_cast<ktxTexture2 *>(texture)))
+	{
+		return texture;
+	}
+
+	auto cache_path = get_cache_path(data, transcode_target);
+
+	std::error_code error;
+	if (std::filesystem::exists(cache_path, error))
+	{
+		ktxTexture *cached_texture;
+		if (ktxTexture_CreateFromNamedFile(cache_path.string().c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &cached_texture) == KTX_SUCCESS)
+		{
+			ktxTexture_Destroy(texture);
+			return cached_texture;
+		}
+		LOGW("Ignoring unreadable transcoded texture {}", cache_path.string());
+	}
+
+	auto *texture2         = reinterpret_cast<ktxTexture2 *>(texture);
+	auto  transcode_result = ktxTexture2_TranscodeBasis(texture2, get_transcode_format(texture2, transcode_target), 0);
+	if (transcode_result != KTX_SUCCESS)
+	{
+		ktxTexture_Destroy(texture);
+		throw std::runtime_error{fmt::format("Error transcoding KTX texture {}: {}", name, ktxErrorString(transcode_result))};
+	}
+
+	fs::write_file_atomic(cache_path, [texture](const fs::Path &path) {
+		return ktxTexture_WriteToNamedFile(texture, path.string().c_str()) == KTX_SUCCESS;
+	});
+
+	return texture;
+}
+
+Ktx::Ktx(const std::string &name, const std::vector<uint8_t> &data, ContentType content_type, TranscodeTarget transcode_target) :
+    Image{name}
+{
+	ktxTexture *texture = create_texture(name, data, transcode_target);
+
 	if (texture->pData)
 	{
 		// Already loaded
@@ -8,7 +8,11 @@ namespace xihe::sg
 class Ktx : public Image
 {
   public:
-	Ktx(const std::string &name, const std::vector<uint8_t> &data, ContentType content_type);
+	/**
+	 * @brief Basis Universal KTX2 textures are transcoded to the target format, the transcoded texture is kept
+	 *        in the cache folder so later loads of the same data skip the transcoder
+	 */
+	Ktx(const std::string &name, const std::vector<uint8_t> &data, ContentType content_type, TranscodeTarget transcode_target = TranscodeTarget::kRgba8);
 
 	virtual ~Ktx() = default;
 };
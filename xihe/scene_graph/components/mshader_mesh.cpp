@@ -70,10 +70,12 @@ MshaderMesh::MshaderMesh(const MeshPrimitiveData &primitive_data, backend::Devic
 		vertex_data_buffer_->update(packed_vertex_data);
 	}
 
-	std::vector<Meshlet> meshlets;
-	prepare_meshlets(meshlets, primitive_data, device);
+	const auto meshlet_data = build_meshlets(primitive_data);
+	prepare_meshlets(meshlet_data, device);
 
 	{
+		const auto &meshlets = meshlet_data.meshlets;
+
 		backend::BufferBuilder buffer_builder{meshlets.size() * sizeof(Meshlet)};
 		buffer_builder.with_usage(vk::BufferUsageFlagBits::eStorageBuffer)
 		    .with_vma_usage(VMA_MEMORY_USAGE_CPU_TO_GPU);
@@ -154,7 +156,7 @@ void MshaderMesh::compute_shader_variant()
 	}
 }
 
-void MshaderMesh::prepare_meshlets(std::vector<Meshlet> &meshlets, const MeshPrimitiveData &primitive_data, backend::Device &device)
+MeshletData MshaderMesh::build_meshlets(const MeshPrimitiveData &primitive_data)
 {
 	std::vector<uint32_t> index_data_32;
 	if (primitive_data.index_type == vk::IndexType::eUint16)
@@ -201,8 +203,11 @@ void MshaderMesh::prepare_meshlets(std::vector<Meshlet> &meshlets, const MeshPri
 
 	local_meshlets.resize(meshlet_count);
 
-	std::vector<uint32_t> meshlet_vertices;
-	std::vector<uint32_t> meshlet_triangles;
+	MeshletData meshlet_data;
+	meshlet_data.meshlets.reserve(meshlet_count);
+
+	auto &meshlet_vertices  = meshlet_data.vertices;
+	auto &meshlet_triangles = meshlet_data.triangles;
 
 	// Convert meshopt_Meshlet to our Meshlet structure
 	for (size_t i = 0; i < meshlet_count; ++i)
@@ -246,9 +251,17 @@ void MshaderMesh::prepare_meshlets(std::vector<Meshlet> &meshlets, const MeshPri
 		meshlet.cone_axis   = glm::vec3(meshlet_bounds.cone_axis[0], meshlet_bounds.cone_axis[1], meshlet_bounds.cone_axis[2]);
 		meshlet.cone_cutoff = meshlet_bounds.cone_cutoff;
 
-		meshlets.push_back(meshlet);
+		meshlet_data.meshlets.push_back(meshlet);
 	}
 
+	return meshlet_data;
+}
+
+void MshaderMesh::prepare_meshlets(const MeshletData &meshlet_data, backend::Device &device)
+{
+	const auto &meshlet_vertices  = meshlet_data.vertices;
+	const auto &meshlet_triangles = meshlet_data.triangles;
+
 	{
 		backend::BufferBuilder buffer_builder{meshlet_vertices.size() * 4};
 		buffer_builder.with_usage(vk::BufferUsageFlagBits::eStorageBuffer)
@@ -265,7 +278,7 @@ void MshaderMesh::prepare_meshlets(std::vector<Meshlet> &meshlets, const MeshPri
 		packed_meshlet_indices_buffer_->update(meshlet_triangles);
 	}
 
-	meshlet_count_ = meshlets.size();
+	meshlet_count_ = static_cast<uint32_t>(meshlet_data.meshlets.size());
 	{
 		std::vector<MeshDrawCounts> counts = {{meshlet_count_}};
 		backend::BufferBuilder    buffer_builder{sizeof(MeshDrawCounts)};
@@ -35,6 +35,14 @@ struct MeshDrawCounts
 	uint32_t meshlet_count;
 };
 
+struct MeshletData
+{
+	std::vector<Meshlet> meshlets;
+
+	std::vector<uint32_t> vertices;         // indices into the vertex buffer, referenced by Meshlet::vertex_offset
+	std::vector<uint32_t> triangles;        // three 8 bit meshlet local indices per triangle, referenced by Meshlet::triangle_offset
+};
+
 class MshaderMesh : public Component
 {
   public:
@@ -59,10 +67,15 @@ class MshaderMesh : public Component
 	const backend::ShaderVariant &get_shader_variant() const;
 	backend::ShaderVariant       &get_mut_shader_variant();
 
+	/**
+	 * \brief Splits a primitive into meshlets with their culling bounds, this is the CPU side of the constructor
+	 */
+	static MeshletData build_meshlets(const MeshPrimitiveData &primitive_data);
+
   private:
 	void compute_shader_variant();
 
-	void prepare_meshlets(std::vector<Meshlet> &meshlets, const MeshPrimitiveData &primitive_data, backend::Device &device);
+	void prepare_meshlets(const MeshletData &meshlet_data, backend::Device &device);
 
 	uint32_t meshlet_count_{0};
 
@@ -1,8 +1,10 @@
 #define TINYGLTF_IMPLEMENTATION
 #include "gltf_loader.h"
 
+#include <algorithm>
 #include <future>
 #include <limits>
+#include <map>
 #include <queue>
 
 #include "common/glm_common.h"
@@ -14,6 +16,8 @@
 #include "common/helpers.h"
 #include "common/logging.h"
 #include "common/timer.h"
+#include "common/trace.h"
+#include "common/worker_budget.h"
 #include "platform/filesystem.h"
 
 #include "components/light.h"
@@ -31,6 +35,7 @@
 #include "components/transform.h"
 #include "node.h"
 #include "scene.h"
+#include "texture_packer.h"
 
 namespace xihe
 {
@@ -384,15 +389,97 @@ std::vector<bool> parse_srgb_requirements(const tinygltf::Model &model)
 	return needs_srgb;
 }
 
+/// Role of each image for its compression, see TextureCompressor
+std::vector<TextureRole> parse_texture_roles(const tinygltf::Model &model)
+{
+	std::vector<std::optional<TextureRole>> roles(model.images.size());
+
+	auto add_role = [&](const std::string &name, const tinygltf::Parameter &parameter) {
+		if (name.find("Texture") == std::string::npos)
+		{
+			return;
+		}
+
+		int texture_index = parameter.TextureIndex();
+		if (texture_index < 0 || texture_index >= model.textures.size())
+		{
+			return;
+		}
+
+		int image_index = model.textures[texture_index].source;
+		if (image_index < 0 || image_index >= roles.size())
+		{
+			return;
+		}
+
+		auto role = texture_needs_srgb_colorspace(name) ? TextureRole::kColor :
+		            name == "normalTexture"             ? TextureRole::kNormal :
+		            name == "occlusionTexture"          ? TextureRole::kOcclusion :
+		                                                  TextureRole::kMask;
+
+		// Color keeps every channel and wins over the other roles, occlusion keeps one and loses to them
+		auto &image_role = roles[image_index];
+		if (!image_role || *image_role == TextureRole::kOcclusion || role == TextureRole::kColor)
+		{
+			image_role = role;
+		}
+	};
+
+	for (const auto &material : model.materials)
+	{
+		for (const auto &value : material.values)
+		{
+			add_role(value.first, value.second);
+		}
+
+		for (const auto &value : material.additionalValues)
+		{
+			add_role(value.first, value.second);
+		}
+	}
+
+	// Images no material samples keep all their channels
+	std::vector<TextureRole> result(roles.size());
+	std::ranges::transform(roles, result.begin(), [](const std::optional<TextureRole> &role) { return role.value_or(TextureRole::kColor); });
+	return result;
+}
+
 }        // namespace
 
 std::unordered_map<std::string, bool> GltfLoader::supported_extensions_ = {
     {"KHR_lights_punctual", false}};
 
 GltfLoader::GltfLoader(backend::Device &device) :
-    device_{device}
+    device_{device},
+    transcode_target_{sg::select_transcode_target(device)}
 {}
 
+void GltfLoader::set_streamed_mip_tail_extent(uint32_t extent)
+{
+	streamed_mip_tail_extent_ = extent;
+}
+
+void GltfLoader::set_texture_packing(const TexturePackingConfig &config)
+{
+	texture_packing_config_ = config;
+}
+
+const TexturePackingStats &GltfLoader::get_texture_packing_stats() const
+{
+	return texture_packing_stats_;
+}
+
+void GltfLoader::set_texture_compression(const TextureCompressionConfig &config)
+{
+	if (transcode_target_ == sg::TranscodeTarget::kRgba8)
+	{
+		LOGW("The device samples no compressed format, textures are loaded uncompressed");
+		return;
+	}
+
+	texture_compressor_ = std::make_unique<TextureCompressor>(config, transcode_target_);
+}
+
 std::unique_ptr<sg::Scene> GltfLoader::read_scene_from_file(const std::string &file_name, int scene_index)
 {
 	std::string err;
@@ -465,51 +552,55 @@ std::unique_ptr<sg::SubMesh> GltfLoader::minimal_read_model(const std::string &f
 
 	for (const auto &gltf_primitive : gltf_mesh.primitives)
 	{
-		MeshPrimitiveData primitive_data;
-		primitive_data.name = gltf_mesh.name;
+		auto primitive_data = extract_primitive_data(model, gltf_primitive, gltf_mesh.name);
 
-		// auto submesh_name = fmt::format("'{}' mesh, primitive #{}", gltf_mesh.name, i_primitive);
-		// auto submesh      = std::make_unique<sg::SubMesh>(std::move(submesh_name));
+		auto submesh = std::make_unique<sg::SubMesh>(primitive_data, device_);
 
-		for (auto &attribute : gltf_primitive.attributes)
-		{
-			VertexAttributeData attrib_data;
-			std::string         attrib_name = attribute.first;
-			std::ranges::transform(attrib_name, attrib_name.begin(), ::tolower);
+		return submesh;
+	}
+	return nullptr;
+}
+
+MeshPrimitiveData GltfLoader::extract_primitive_data(const tinygltf::Model &model, const tinygltf::Primitive &gltf_primitive, std::string name)
+{
+	MeshPrimitiveData primitive_data;
+	primitive_data.name = std::move(name);
 
-			int accessor_index = attribute.second;
-			attrib_data.format = get_attribute_format(&model, accessor_index);
-			attrib_data.stride = to_u32(get_attribute_stride(&model, accessor_index));
-			attrib_data.data   = get_attribute_data(&model, accessor_index);
+	for (auto &attribute : gltf_primitive.attributes)
+	{
+		VertexAttributeData attrib_data;
+		std::string         attrib_name = attribute.first;
+		std::ranges::transform(attrib_name, attrib_name.begin(), ::tolower);
 
-			primitive_data.attributes[attrib_name] = std::move(attrib_data);
+		int accessor_index = attribute.second;
+		attrib_data.format = get_attribute_format(&model, accessor_index);
+		attrib_data.stride = to_u32(get_attribute_stride(&model, accessor_index));
+		attrib_data.data   = get_attribute_data(&model, accessor_index);
 
-			if (attrib_name == "position")
-			{
-				primitive_data.vertex_count = to_u32(model.accessors[accessor_index].count);
-			}
-		}
+		primitive_data.attributes[attrib_name] = std::move(attrib_data);
 
-		if (gltf_primitive.indices >= 0)
+		if (attrib_name == "position")
 		{
-			int accessor_index         = gltf_primitive.indices;
-			primitive_data.index_count = to_u32(get_attribute_size(&model, accessor_index));
-			primitive_data.index_type  = get_index_type(&model, accessor_index);
-			primitive_data.indices     = get_attribute_data(&model, accessor_index);
-
-			// Handle index format conversion if necessary
-			if (primitive_data.index_type == vk::IndexType::eUint8EXT)
-			{
-				primitive_data.indices    = convert_indices_to_uint16(primitive_data.indices);
-				primitive_data.index_type = vk::IndexType::eUint16;
-			}
+			primitive_data.vertex_count = to_u32(model.accessors[accessor_index].count);
 		}
+	}
 
-		auto submesh = std::make_unique<sg::SubMesh>(primitive_data, device_);
+	if (gltf_primitive.indices >= 0)
+	{
+		int accessor_index         = gltf_primitive.indices;
+		primitive_data.index_count = to_u32(get_attribute_size(&model, accessor_index));
+		primitive_data.index_type  = get_index_type(&model, accessor_index);
+		primitive_data.indices     = get_attribute_data(&model, accessor_index);
 
-		return submesh;
+		// Handle index format conversion if necessary
+		if (primitive_data.index_type == vk::IndexType::eUint8EXT)
+		{
+			primitive_data.indices    = convert_indices_to_uint16(primitive_data.indices);
+			primitive_data.index_type = vk::IndexType::eUint16;
+		}
 	}
-	return nullptr;
+
+	return primitive_data;
 }
 
 sg::Scene GltfLoader::load_scene(int scene_index)
@@ -565,22 +656,25 @@ sg::Scene GltfLoader::load_scene(int scene_index)
 	Timer timer;
 	timer.start();
 
-	// Load images
-	auto thread_count = std::thread::hardware_concurrency();
-	thread_count      = thread_count == 0 ? 1 : thread_count;
-	ctpl::thread_pool thread_pool(thread_count);
+	// Load images. The pool threads are taken from the shared budget, the decoders and encoders they run only get what is left
+	auto              loader_lease = WorkerBudget::get().acquire(WorkerBudget::get().get_thread_count());
+	ctpl::thread_pool thread_pool(static_cast<int>(loader_lease.get_thread_count()));
 
 	auto image_count = to_u32(model_.images.size());
 
 	std::vector<std::future<std::unique_ptr<sg::Image>>> image_component_futures;
 
 	auto srgb_flags = parse_srgb_requirements(model_);
+	auto roles      = parse_texture_roles(model_);
 
 	for (size_t image_index = 0; image_index < image_count; image_index++)
 	{
 		auto fut = thread_pool.push(
-		    [this, image_index, &srgb_flags](size_t) {
-			    auto image = parse_image(model_.images[image_index], srgb_flags[image_index]);
+		    [this, image_index, &srgb_flags, &roles](size_t thread_index) {
+			    XIHE_TRACE_THREAD_NAME(fmt::format("Image loader {}", thread_index));
+			    XIHE_TRACE_ZONE(model_.images[image_index].uri);
+
+			    auto image = parse_image(model_.images[image_index], srgb_flags[image_index], roles[image_index]);
 
 			    LOGI("Loaded gltf image #{} ({})", image_index, model_.images[image_index].uri.c_str());
 
@@ -591,6 +685,25 @@ sg::Scene GltfLoader::load_scene(int scene_index)
 	}
 
 	std::vector<std::unique_ptr<sg::Image>> image_components;
+	std::vector<std::unique_ptr<sg::Image>> packed_arrays;
+
+	texture_packing_stats_ = {};
+	if (texture_packing_config_)
+	{
+		// Images are grouped across the whole scene, so all of them must be loaded first. The loader threads keep
+		// their results until they are taken anyway, only the staging buffers are batched below
+		for (auto &future : image_component_futures)
+		{
+			image_components.push_back(future.get());
+		}
+
+		std::vector<sg::Image *> images(image_components.size());
+		std::ranges::transform(image_components, images.begin(), [](const std::unique_ptr<sg::Image> &image) { return image.get(); });
+
+		TexturePacker texture_packer{device_, *texture_packing_config_};
+		packed_arrays          = texture_packer.pack(images);
+		texture_packing_stats_ = texture_packer.get_stats();
+	}
 
 	// Upload images to GPU. We do this in batches of 64MB of data to avoid needing
 	// double the amount of memory (all the images and all the corresponding buffers).
@@ -598,6 +711,8 @@ sg::Scene GltfLoader::load_scene(int scene_index)
 	size_t image_index = 0;
 	while (image_index < image_count)
 	{
+		XIHE_TRACE_ZONE("Upload image batch");
+
 		std::vector<backend::Buffer> transient_buffers;
 
 		auto &command_buffer = device_.request_command_buffer();
@@ -609,14 +724,19 @@ sg::Scene GltfLoader::load_scene(int scene_index)
 		// Deal with 64MB of image data at a time to keep memory footprint low
 		while (image_index < image_count && batch_size < 64 * 1024 * 1024)
 		{
-			// Wait for this image to complete loading, then stage for upload
-			image_components.push_back(image_component_futures[image_index].get());
+			// Wait for this image to complete loading, unless it was for the packing, then stage for upload
+			if (image_index == image_components.size())
+			{
+				image_components.push_back(image_component_futures[image_index].get());
+			}
 
 			auto &image = image_components[image_index];
 
-			backend::Buffer stage_buffer = backend::Buffer::create_staging_buffer(device_, image->get_data());
+			// Only the resident levels, the others of a streamed image stay in its data
+			const auto      resident_size = image->get_data_size(image->get_resident_mip());
+			backend::Buffer stage_buffer  = backend::Buffer::create_staging_buffer(device_, resident_size, image->get_data().data() + image->get_data().size() - resident_size);
 
-			batch_size += image->get_data().size();
+			batch_size += resident_size;
 
 			upload_image_to_gpu(command_buffer, stage_buffer, *image);
 
@@ -642,9 +762,15 @@ sg::Scene GltfLoader::load_scene(int scene_index)
 
 	scene.set_components(std::move(image_components));
 
+	// After the glTF images, whose indices the textures refer to
+	for (auto &packed_array : packed_arrays)
+	{
+		scene.add_component(std::move(packed_array));
+	}
+
 	auto elapsed_time = timer.stop();
 
-	LOGI("Time spent loading images: {} seconds across {} threads.", xihe::to_string(elapsed_time), thread_count);
+	LOGI("Time spent loading images: {} seconds across {} threads.", xihe::to_string(elapsed_time), loader_lease.get_thread_count());
 
 	// Load textures
 	std::unique_ptr<sg::BindlessTextures> bindless_textures = std::make_unique<sg::BindlessTextures>("bindless_textures");
@@ -655,6 +781,15 @@ sg::Scene GltfLoader::load_scene(int scene_index)
 	auto default_sampler_nearest = create_default_sampler(TINYGLTF_TEXTURE_FILTER_NEAREST);
 	bool used_nearest_sampler    = false;
 
+	// Textures by glTF index, with the index the shaders take for them
+	std::vector<sg::Texture *> textures;
+	std::vector<uint32_t>      texture_indices;
+
+	// Textures of packed images share the bindless slot of their array and sampler, they are kept out of the bindless textures
+	std::map<std::pair<sg::Image *, sg::Sampler *>, uint32_t> array_slots;
+	std::vector<std::unique_ptr<sg::Texture>>                  packed_textures;
+	uint32_t                                                   slot_count = 0;
+
 	for (auto &gltf_texture : model_.textures)
 	{
 		auto texture = parse_texture(gltf_texture);
@@ -687,8 +822,41 @@ sg::Scene GltfLoader::load_scene(int scene_index)
 				used_nearest_sampler = true;
 			}
 		}
-		bindless_textures->add_texture(std::move(texture));
-		//scene.add_component(std::move(texture));
+
+		textures.push_back(texture.get());
+
+		auto *array = texture->get_image()->get_packed_array();
+		if (!array)
+		{
+			texture_indices.push_back(slot_count++);
+			bindless_textures->add_texture(std::move(texture));
+			continue;
+		}
+
+		auto *sampler       = texture->get_sampler();
+		auto [slot, is_new] = array_slots.try_emplace({array, sampler}, slot_count);
+		if (is_new)
+		{
+			auto array_texture = std::make_unique<sg::Texture>(fmt::format("{} with {}", array->get_name(), sampler->get_name()));
+			array_texture->set_image(*array);
+			array_texture->set_sampler(*sampler);
+			bindless_textures->add_texture(std::move(array_texture));
+			slot_count++;
+		}
+
+		texture_indices.push_back(TexturePacker::encode_texture_index(slot->second, texture->get_image()->get_packed_layer()));
+		packed_textures.push_back(std::move(texture));
+	}
+
+	if (texture_packing_config_)
+	{
+		texture_packing_stats_.saved_descriptors = to_u32(packed_textures.size() - array_slots.size());
+
+		LOGI("Packed {} images into {} arrays ({:.1f} MiB), {} small images left unpacked, {} bindless slots saved",
+		     texture_packing_stats_.packed_images, texture_packing_stats_.arrays, static_cast<double>(texture_packing_stats_.packed_size) / (1024.0 * 1024.0),
+		     texture_packing_stats_.unpacked_images, texture_packing_stats_.saved_descriptors);
+
+		scene.set_components(std::move(packed_textures));
 	}
 
 	scene.add_component(std::move(default_sampler_linear));
@@ -703,8 +871,6 @@ sg::Scene GltfLoader::load_scene(int scene_index)
 		textures = scene.get_components<sg::Texture>();
 	}*/
 
-	auto textures = bindless_textures->get_textures();
-
 	for (auto &gltf_material : model_.materials)
 	{
 		auto material = parse_material(gltf_material);
@@ -720,7 +886,7 @@ sg::Scene GltfLoader::load_scene(int scene_index)
 
 				material->textures[tex_name] = tex;
 
-				material->set_texture_index(tex_name, gltf_value.second.TextureIndex());
+				material->set_texture_index(tex_name, texture_indices[gltf_value.second.TextureIndex()]);
 			}
 		}
 
@@ -735,7 +901,7 @@ sg::Scene GltfLoader::load_scene(int scene_index)
 
 				material->textures[tex_name] = tex;
 
-				material->set_texture_index(tex_name, gltf_value.second.TextureIndex());
+				material->set_texture_index(tex_name, texture_indices[gltf_value.second.TextureIndex()]);
 			}
 		}
 
@@ -759,46 +925,7 @@ sg::Scene GltfLoader::load_scene(int scene_index)
 		for (size_t i_primitive = 0; i_primitive < gltf_mesh.primitives.size(); i_primitive++)
 		{
 			const auto &gltf_primitive = gltf_mesh.primitives[i_primitive];
-			MeshPrimitiveData primitive_data;
-			primitive_data.name = fmt::format("'{}' mesh, primitive #{}", gltf_mesh.name, i_primitive);
-
-			//auto submesh_name = fmt::format("'{}' mesh, primitive #{}", gltf_mesh.name, i_primitive);
-			//auto submesh      = std::make_unique<sg::SubMesh>(std::move(submesh_name));
-
-			for (auto &attribute : gltf_primitive.attributes)
-			{
-				VertexAttributeData attrib_data;
-				std::string attrib_name = attribute.first;
-				std::ranges::transform(attrib_name, attrib_name.begin(), ::tolower);
-
-				int accessor_index = attribute.second;
-				attrib_data.format = get_attribute_format(&model_, accessor_index);
-				attrib_data.stride = to_u32(get_attribute_stride(&model_, accessor_index));
-				attrib_data.data   = get_attribute_data(&model_, accessor_index);
-
-				primitive_data.attributes[attrib_name] = std::move(attrib_data);
-
-				if (attrib_name == "position")
-				{
-					primitive_data.vertex_count = to_u32(model_.accessors[accessor_index].count);
-				}
-			}
-
-			if (gltf_primitive.indices >= 0)
-			{
-				int accessor_index         = gltf_primitive.indices;
-				primitive_data.index_count = to_u32(get_attribute_size(&model_, accessor_index));
-				primitive_data.index_type  = get_index_type(&model_, accessor_index);
-				primitive_data.indices     = get_attribute_data(&model_, accessor_index);
-
-				// Handle index format conversion if necessary
-				if (primitive_data.index_type == vk::IndexType::eUint8EXT)
-				{
-					primitive_data.indices    = convert_indices_to_uint16(primitive_data.indices);
-					primitive_data.index_type = vk::IndexType::eUint16;
-				}
-
-			}
+			auto primitive_data = extract_primitive_data(model_, gltf_primitive, fmt::format("'{}' mesh, primitive #{}", gltf_mesh.name, i_primitive));
 
 			auto submesh = std::make_unique<sg::SubMesh>(primitive_data, device_);
 			auto mshader_mesh = std::make_unique<sg::MshaderMesh>(primitive_data, device_);
@@ -1095,7 +1222,7 @@ std::unique_ptr<sg::PbrMaterial> GltfLoader::parse_material(const tinygltf::Mate
 	return material;
 }
 
-std::unique_ptr<sg::Image> GltfLoader::parse_image(tinygltf::Image &gltf_image, bool is_srgb) const
+std::unique_ptr<sg::Image> GltfLoader::parse_image(tinygltf::Image &gltf_image, bool is_srgb, TextureRole role) const
 {
 	std::unique_ptr<sg::Image> image{nullptr};
 
@@ -1115,7 +1242,25 @@ std::unique_ptr<sg::Image> GltfLoader::parse_image(tinygltf::Image &gltf_image,
 	{
 		// Load image from uri
 		auto image_uri = model_path_ + "/" + gltf_image.uri;
-		image          = sg::Image::load(gltf_image.name, image_uri, sg::Image::kUnknown);
+
+		// Prefer a Basis Universal version of the image next to the model, it is transcoded to what the device samples
+		auto ktx2_uri = std::filesystem::path{model_path_} / "ktx2" / std::filesystem::path{gltf_image.uri}.stem();
+		ktx2_uri += ".ktx2";
+		std::error_code error;
+		if (fs::get_extension(gltf_image.uri) != "ktx2" && std::filesystem::exists(fs::path::get(fs::path::Type::kAssets) / ktx2_uri, error))
+		{
+			image_uri = ktx2_uri.generic_string();
+		}
+
+		const auto extension = fs::get_extension(image_uri);
+		if (texture_compressor_ && (extension == "png" || extension == "jpg" || extension == "jpeg"))
+		{
+			image = texture_compressor_->load(gltf_image.name, image_uri, role, is_srgb);
+		}
+		else
+		{
+			image = sg::Image::load(gltf_image.name, image_uri, sg::Image::kUnknown, transcode_target_);
+		}
 	}
 
 
@@ -1126,7 +1271,6 @@ std::unique_ptr<sg::Image> GltfLoader::parse_image(tinygltf::Image &gltf_image,
 		{
 			LOGW("ASTC not supported: decoding {}", image->get_name());
 			image = std::make_unique<sg::Astc>(*image);
-			image->generate_mipmaps();
 		}
 	 }
 
@@ -1135,7 +1279,34 @@ std::unique_ptr<sg::Image> GltfLoader::parse_image(tinygltf::Image &gltf_image,
 		image->coerce_format_to_srgb();
 	}
 
-	image->create_vk_image(device_);
+	switch (sg::select_mip_generator(device_, *image, streamed_mip_tail_extent_))
+	{
+		case sg::MipGenerator::kCpu:
+			image->generate_mipmaps();
+			break;
+		case sg::MipGenerator::kGpu:
+			image->request_gpu_mipmaps();
+			break;
+		default:
+			break;
+	}
+
+	uint32_t resident_mip = 0;
+	// The streamed levels are staged as the data from their offset on, which needs the finest level stored first
+	const auto &mipmaps = image->get_mipmaps();
+	if (streamed_mip_tail_extent_ != 0 && image->get_layers() == 1 &&
+	    std::ranges::is_sorted(mipmaps, {}, &sg::Mipmap::offset))
+	{
+		resident_mip = image->get_mip_tail(streamed_mip_tail_extent_);
+	}
+
+	// The Vulkan image of a packable image is created by the packer, as a layer of an array or on its own
+	if (texture_packing_config_ && resident_mip == 0 && TexturePacker::is_packable(*image, *texture_packing_config_))
+	{
+		return image;
+	}
+
+	image->create_vk_image(device_, vk::ImageViewType::e2D, {}, resident_mip);
 
 	return image;
 }
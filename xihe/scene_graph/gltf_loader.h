@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <optional>
 #include <unordered_map>
 
 #include "vulkan/vulkan_format_traits.hpp"
@@ -9,6 +10,10 @@
 #define TINYGLTF_NO_EXTERNAL_IMAGE
 #include <tiny_gltf.h>
 
+#include "scene_graph/geometry_data.h"
+#include "scene_graph/texture_compressor.h"
+#include "scene_graph/texture_packer.h"
+
 #define KHR_LIGHTS_PUNCTUAL_EXTENSION "KHR_lights_punctual"
 
 namespace xihe
@@ -30,6 +35,8 @@ class Sampler;
 class Scene;
 class SubMesh;
 class Texture;
+
+enum class TranscodeTarget;
 }
 
 template <class T, class Y>
@@ -48,8 +55,36 @@ class GltfLoader
 
 	std::unique_ptr<sg::Scene> read_scene_from_file(const std::string &file_name, int scene_index = -1);
 
+	/**
+	 * @brief Only the levels of 2D images that fit within the extent are uploaded, the images keep their data and a
+	 *        TextureStreamer streams the rest in. 0 uploads every level
+	 */
+	void set_streamed_mip_tail_extent(uint32_t extent);
+
+	/**
+	 * @brief Small images are packed into 2D arrays sharing an allocation and a bindless slot per sampler, see TexturePacker.
+	 *        The materials then need shaders that sample through shaders/material_textures.h
+	 */
+	void set_texture_packing(const TexturePackingConfig &config);
+
+	/**
+	 * @brief Statistics of the packing of the last scene read
+	 */
+	const TexturePackingStats &get_texture_packing_stats() const;
+
+	/**
+	 * @brief PNG and JPEG images are block compressed to the format family the device samples, see TextureCompressor.
+	 *        Does nothing if the device samples no compressed format
+	 */
+	void set_texture_compression(const TextureCompressionConfig &config);
+
 	std::unique_ptr<sg::SubMesh> minimal_read_model(const std::string &file_name);
 
+	/**
+	 * @brief Copies the attributes and indices of a primitive out of the glTF buffers, 8 bit indices are widened to 16 bit
+	 */
+	static MeshPrimitiveData extract_primitive_data(const tinygltf::Model &model, const tinygltf::Primitive &gltf_primitive, std::string name);
+
 private:
 	sg::Scene load_scene(int scene_index = -1);
 
@@ -61,7 +96,7 @@ private:
 
 	std::unique_ptr<sg::PbrMaterial> parse_material(const tinygltf::Material &gltf_material) const;
 
-	std::unique_ptr<sg::Image> parse_image(tinygltf::Image &gltf_image, bool is_srgb=false) const;
+	std::unique_ptr<sg::Image> parse_image(tinygltf::Image &gltf_image, bool is_srgb = false, TextureRole role = TextureRole::kColor) const;
 
 	std::unique_ptr<sg::Sampler> parse_sampler(const tinygltf::Sampler &gltf_sampler) const;
 
@@ -90,6 +125,17 @@ private:
 
 	backend::Device &device_;
 
+	/// Format Basis Universal textures are transcoded to, chosen once for the device
+	sg::TranscodeTarget transcode_target_;
+
+	uint32_t streamed_mip_tail_extent_{0};
+
+	std::optional<TexturePackingConfig> texture_packing_config_;
+
+	TexturePackingStats texture_packing_stats_;
+
+	std::unique_ptr<TextureCompressor> texture_compressor_;
+
 	tinygltf::Model model_;
 
 	std::string model_path_;
@@ -0,0 +1,140 @@
+#include "transform_path.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+#include "common/logging.h"
+#include "scene_graph/components/transform.h"
+#include "scene_graph/node.h"
+
+namespace xihe::sg
+{
+TransformPath::TransformPath(Node &node, std::vector<Keyframe> keyframes, bool loop) :
+    NodeScript{node, "TransformPath"}, keyframes_{std::move(keyframes)}, loop_{loop}
+{
+	if (keyframes_.empty())
+	{
+		throw std::runtime_error("Transform path needs at least one keyframe");
+	}
+
+	std::ranges::sort(keyframes_, {}, &Keyframe::time);
+
+	apply(0.0f);
+}
+
+void TransformPath::update(float delta_time)
+{
+	time_ += delta_time;
+	apply(time_);
+}
+
+float TransformPath::get_duration() const
+{
+	return keyframes_.back().time - keyframes_.front().time;
+}
+
+void TransformPath::apply(float time)
+{
+	const float duration = get_duration();
+
+	float path_time = keyframes_.front().time + time;
+	if (loop_ && duration > 0.0f)
+	{
+		path_time = keyframes_.front().time + std::fmod(time, duration);
+	}
+
+	auto next = std::ranges::upper_bound(keyframes_, path_time, {}, &Keyframe::time);
+
+	glm::vec3 translation;
+	glm::quat rotation;
+	if (next == keyframes_.begin())
+	{
+		translation = next->translation;
+		rotation    = next->rotation;
+	}
+	else if (next == keyframes_.end())
+	{
+		translation = keyframes_.back().translation;
+		rotation    = keyframes_.back().rotation;
+	}
+	else
+	{
+		const auto &previous = *(next - 1);
+		const float t        = (path_time - previous.time) / (next->time - previous.time);
+
+		translation = glm::mix(previous.translation, next->translation, t);
+		rotation    = glm::slerp(previous.rotation, next->rotation, t);
+	}
+
+	auto &transform = get_node().get_transform();
+	transform.set_translation(translation);
+	transform.set_rotation(glm::normalize(rotation));
+}
+
+std::map<std::string, std::vector<TransformPath::Keyframe>> TransformPath::load_tracks(const std::string &path)
+{
+	std::ifstream file{path};
+	if (!file.is_open())
+	{
+		throw std::runtime_error{"Failed to open transform path: " + path};
+	}
+
+	std::map<std::string, std::vector<Keyframe>> tracks;
+
+	std::string line;
+	uint32_t    line_number = 0;
+	while (std::getline(file, line))
+	{
+		++line_number;
+		if (line.empty() || line[0] == '#')
+		{
+			continue;
+		}
+
+		std::istringstream stream{line};
+
+		std::string track;
+		Keyframe    keyframe{};
+		stream >> track >> keyframe.time >>
+		    keyframe.translation.x >> keyframe.translation.y >> keyframe.translation.z >>
+		    keyframe.rotation.w >> keyframe.rotation.x >> keyframe.rotation.y >> keyframe.rotation.z;
+
+		if (stream.fail())
+		{
+			LOGW("Skipping malformed keyframe in {}:{}", path, line_number);
+			continue;
+		}
+
+		tracks[track].push_back(keyframe);
+	}
+
+	for (auto &[track, keyframes] : tracks)
+	{
+		std::ranges::sort(keyframes, {}, &Keyframe::time);
+	}
+
+	return tracks;
+}
+
+void TransformPath::save_tracks(const std::string &path, const std::map<std::string, std::vector<Keyframe>> &tracks)
+{
+	std::ofstream file{path, std::ios::out | std::ios::trunc};
+	if (!file.is_open())
+	{
+		throw std::runtime_error{"Failed to open transform path for writing: " + path};
+	}
+
+	file << "# <track> <time> <tx> <ty> <tz> <qw> <qx> <qy> <qz>\n";
+	for (const auto &[track, keyframes] : tracks)
+	{
+		for (const auto &keyframe : keyframes)
+		{
+			file << fmt::format("{} {} {} {} {} {} {} {} {}\n", track, keyframe.time,
+			                    keyframe.translation.x, keyframe.translation.y, keyframe.translation.z,
+			                    keyframe.rotation.w, keyframe.rotation.x, keyframe.rotation.y, keyframe.rotation.z);
+		}
+	}
+}
+}        // namespace xihe::sg
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "common/glm_common.h"
+#include <glm/gtc/quaternion.hpp>
+#include "scene_graph/script.h"
+
+namespace xihe::sg
+{
+/**
+ * \brief Moves its node along keyframes, positions are interpolated linearly and rotations spherically.
+ *        Time only advances by the delta time passed to update(), so a fixed delta time replays the path exactly.
+ */
+class TransformPath : public NodeScript
+{
+  public:
+	struct Keyframe
+	{
+		float     time;
+		glm::vec3 translation;
+		glm::quat rotation;
+	};
+
+	TransformPath(Node &node, std::vector<Keyframe> keyframes, bool loop = true);
+
+	~TransformPath() override = default;
+
+	void update(float delta_time) override;
+
+	/// Duration of one pass through the keyframes, in seconds
+	float get_duration() const;
+
+	/**
+	 * \brief Reads keyframes grouped by track, one keyframe per line: <track> <time> <tx> <ty> <tz> <qw> <qx> <qy> <qz>
+	 *        Empty lines and lines starting with # are skipped, the keyframes of each track are sorted by time.
+	 */
+	static std::map<std::string, std::vector<Keyframe>> load_tracks(const std::string &path);
+
+	static void save_tracks(const std::string &path, const std::map<std::string, std::vector<Keyframe>> &tracks);
+
+  private:
+	void apply(float time);
+
+	std::vector<Keyframe> keyframes_;
+
+	bool loop_;
+
+	float time_{0.0f};
+};
+}        // namespace xihe::sg
@@ -0,0 +1,322 @@
+#include "texture_compressor.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string_view>
+#include <thread>
+
+#if defined(_WIN32) || defined(_WIN64)
+// Windows.h defines IGNORE, so we must #undef it to avoid clashes with astc header
+#	undef IGNORE
+#endif
+#include <astcenc.h>
+#include <ktx.h>
+
+#include "common/helpers.h"
+#include "common/logging.h"
+#include "common/timer.h"
+#include "common/trace.h"
+#include "common/worker_budget.h"
+#include "platform/filesystem.h"
+#include "scene_graph/components/image/ktx.h"
+#include "scene_graph/components/image/stb.h"
+
+namespace xihe
+{
+namespace
+{
+// Part of the cache key, bumped when the encoding changes so older entries are not picked up
+constexpr uint32_t kCacheVersion = 1;
+
+constexpr uint32_t kAstcBlockSize = 4;
+
+ktx_transcode_fmt_e get_transcode_format(TextureRole role, sg::TranscodeTarget target)
+{
+	if (target == sg::TranscodeTarget::kEtc2)
+	{
+		switch (role)
+		{
+			case TextureRole::kNormal:
+				return KTX_TTF_ETC2_EAC_RG11;
+			case TextureRole::kOcclusion:
+				return KTX_TTF_ETC2_EAC_R11;
+			case TextureRole::kMask:
+				// ETC1 is a subset of ETC2 and half the size, masks have no alpha to keep
+				return KTX_TTF_ETC1_RGB;
+			default:
+				return KTX_TTF_ETC2_RGBA;
+		}
+	}
+
+	switch (role)
+	{
+		case TextureRole::kNormal:
+			return KTX_TTF_BC5_RG;
+		case TextureRole::kOcclusion:
+			return KTX_TTF_BC4_R;
+		default:
+			return KTX_TTF_BC7_RGBA;
+	}
+}
+
+/// The two channel formats are transcoded from the red and alpha channels of UASTC
+void set_input_swizzle(ktxBasisParams &params, TextureRole role)
+{
+	const char *swizzle = "rgba";
+	switch (role)
+	{
+		case TextureRole::kNormal:
+			swizzle = "rrrg";
+			break;
+		case TextureRole::kMask:
+			swizzle = "rgb1";
+			break;
+		case TextureRole::kOcclusion:
+			swizzle = "rrr1";
+			break;
+		default:
+			break;
+	}
+	std::memcpy(params.inputSwizzle, swizzle, sizeof(params.inputSwizzle));
+}
+
+std::filesystem::path get_cache_path(const std::vector<uint8_t> &source, TextureRole role, bool is_srgb, sg::TranscodeTarget target, const TextureCompressionConfig &config)
+{
+	const auto source_hash = std::hash<std::string_view>{}(std::string_view{reinterpret_cast<const char *>(source.data()), source.size()});
+	const auto key         = fmt::format("{}_{:016x}_{}_{}_{}_{}", kCacheVersion, source_hash, is_srgb, config.astc_quality, config.uastc_level, config.min_extent);
+
+	return fs::path::get(fs::path::Type::kCache, fmt::format("tex_{:016x}_{}_{}.ktx2", std::hash<std::string>{}(key), to_string(role), sg::to_string(target)));
+}
+
+ktxTexture2 *create_ktx_texture(const sg::Image &image, vk::Format format)
+{
+	const auto &extent = image.get_extent();
+
+	ktxTextureCreateInfo create_info{};
+	create_info.vkFormat        = static_cast<VkFormat>(format);
+	create_info.baseWidth       = extent.width;
+	create_info.baseHeight      = extent.height;
+	create_info.baseDepth       = 1;
+	create_info.numDimensions   = 2;
+	create_info.numFaces        = 1;
+	create_info.numLevels       = image.get_mip_levels();
+	create_info.numLayers       = 1;
+	create_info.isArray         = KTX_FALSE;
+	create_info.generateMipmaps = KTX_FALSE;
+
+	ktxTexture2 *texture = nullptr;
+	if (ktxTexture2_Create(&create_info, KTX_TEXTURE_CREATE_ALLOC_STORAGE, &texture) != KTX_SUCCESS)
+	{
+		throw std::runtime_error{"Error creating KTX texture for " + image.get_name()};
+	}
+	return texture;
+}
+
+/// Encodes the levels to UASTC and transcodes them to the format of the role
+ktxTexture2 *encode_basis(const sg::Image &image, TextureRole role, sg::TranscodeTarget target, const TextureCompressionConfig &config)
+{
+	auto *texture = create_ktx_texture(image, image.get_format());
+
+	for (const auto &mipmap : image.get_mipmaps())
+	{
+		const auto size = static_cast<ktx_size_t>(mipmap.extent.width) * mipmap.extent.height * 4;
+		ktxTexture_SetImageFromMemory(reinterpret_cast<ktxTexture *>(texture), mipmap.level, 0, 0, image.get_data().data() + mipmap.offset, size);
+	}
+
+	// Encoding runs on a loader thread, the encoder threads come from the shared budget so concurrent loads do not oversubscribe
+	auto lease = WorkerBudget::get().acquire(WorkerBudget::get().get_thread_count());
+
+	ktxBasisParams params{};
+	params.structSize  = sizeof(params);
+	params.uastc       = KTX_TRUE;
+	params.uastcFlags  = std::min(config.uastc_level, static_cast<uint32_t>(KTX_PACK_UASTC_MAX_LEVEL));
+	params.threadCount = lease.get_thread_count();
+	set_input_swizzle(params, role);
+
+	auto result = ktxTexture2_CompressBasisEx(texture, &params);
+	if (result == KTX_SUCCESS)
+	{
+		result = ktxTexture2_TranscodeBasis(texture, get_transcode_format(role, target), 0);
+	}
+	if (result != KTX_SUCCESS)
+	{
+		ktxTexture_Destroy(reinterpret_cast<ktxTexture *>(texture));
+		throw std::runtime_error{fmt::format("Error compressing {}: {}", image.get_name(), ktxErrorString(result))};
+	}
+
+	return texture;
+}
+
+/// Encodes the levels to ASTC 4x4, the blocks of each level are split across threads sharing one context
+ktxTexture2 *encode_astc(const sg::Image &image, TextureRole role, bool is_srgb, const TextureCompressionConfig &config)
+{
+	const bool srgb    = is_srgb && role == TextureRole::kColor;
+	auto      *texture = create_ktx_texture(image, srgb ? vk::Format::eAstc4x4SrgbBlock : vk::Format::eAstc4x4UnormBlock);
+
+	astcenc_swizzle swizzle{ASTCENC_SWZ_R, ASTCENC_SWZ_G, ASTCENC_SWZ_B, ASTCENC_SWZ_A};
+
+	astcenc_config astc_config;
+	auto           result = astcenc_config_init(srgb ? ASTCENC_PRF_LDR_SRGB : ASTCENC_PRF_LDR, kAstcBlockSize, kAstcBlockSize, 1, config.astc_quality, 0, &astc_config);
+
+	// Channels the role does not sample are constant and weigh nothing in the error
+	switch (role)
+	{
+		case TextureRole::kNormal:
+			swizzle                 = {ASTCENC_SWZ_R, ASTCENC_SWZ_G, ASTCENC_SWZ_0, ASTCENC_SWZ_1};
+			astc_config.cw_b_weight = 0.0f;
+			astc_config.cw_a_weight = 0.0f;
+			break;
+		case TextureRole::kMask:
+			swizzle                 = {ASTCENC_SWZ_R, ASTCENC_SWZ_G, ASTCENC_SWZ_B, ASTCENC_SWZ_1};
+			astc_config.cw_a_weight = 0.0f;
+			break;
+		case TextureRole::kOcclusion:
+			swizzle                 = {ASTCENC_SWZ_R, ASTCENC_SWZ_R, ASTCENC_SWZ_R, ASTCENC_SWZ_1};
+			astc_config.cw_a_weight = 0.0f;
+			break;
+		default:
+			break;
+	}
+
+	// Encoding runs on a loader thread, extra threads come from the shared budget so concurrent loads do not oversubscribe
+	auto lease = WorkerBudget::get().acquire(WorkerBudget::get().get_thread_count());
+
+	const uint32_t   worker_count = lease.get_thread_count();
+	astcenc_context *context      = nullptr;
+	if (result == ASTCENC_SUCCESS)
+	{
+		result = astcenc_context_alloc(&astc_config, worker_count, &context);
+	}
+	if (result != ASTCENC_SUCCESS)
+	{
+		ktxTexture_Destroy(reinterpret_cast<ktxTexture *>(texture));
+		throw std::runtime_error{fmt::format("Error initializing astc for {}: {}", image.get_name(), astcenc_get_error_string(result))};
+	}
+
+	std::vector<uint8_t> blocks;
+	for (const auto &mipmap : image.get_mipmaps())
+	{
+		const auto &extent = mipmap.extent;
+
+		void         *slice = const_cast<uint8_t *>(image.get_data().data() + mipmap.offset);
+		astcenc_image level{};
+		level.dim_x     = extent.width;
+		level.dim_y     = extent.height;
+		level.dim_z     = 1;
+		level.data_type = ASTCENC_TYPE_U8;
+		level.data      = &slice;
+
+		blocks.resize(static_cast<size_t>((extent.width + kAstcBlockSize - 1) / kAstcBlockSize) * ((extent.height + kAstcBlockSize - 1) / kAstcBlockSize) * 16);
+
+		// The calling thread encodes too, as thread index 0
+		std::vector<std::thread>   workers;
+		std::vector<astcenc_error> results(worker_count, ASTCENC_SUCCESS);
+		for (uint32_t thread_index = 1; thread_index < worker_count; ++thread_index)
+		{
+			workers.emplace_back([&, thread_index]() {
+				results[thread_index] = astcenc_compress_image(context, &level, &swizzle, blocks.data(), blocks.size(), thread_index);
+			});
+		}
+		results[0] = astcenc_compress_image(context, &level, &swizzle, blocks.data(), blocks.size(), 0);
+
+		for (auto &worker : workers)
+		{
+			worker.join();
+		}
+		astcenc_compress_reset(context);
+
+		if (auto failed = std::ranges::find_if(results, [](astcenc_error error) { return error != ASTCENC_SUCCESS; }); failed != results.end())
+		{
+			astcenc_context_free(context);
+			ktxTexture_Destroy(reinterpret_cast<ktxTexture *>(texture));
+			throw std::runtime_error{fmt::format("Error encoding astc for {}: {}", image.get_name(), astcenc_get_error_string(*failed))};
+		}
+
+		ktxTexture_SetImageFromMemory(reinterpret_cast<ktxTexture *>(texture), mipmap.level, 0, 0, blocks.data(), blocks.size());
+	}
+
+	astcenc_context_free(context);
+
+	return texture;
+}
+}        // namespace
+
+const char *to_string(TextureRole role)
+{
+	switch (role)
+	{
+		case TextureRole::kColor:
+			return "color";
+		case TextureRole::kNormal:
+			return "normal";
+		case TextureRole::kMask:
+			return "mask";
+		default:
+			return "occlusion";
+	}
+}
+
+TextureCompressor::TextureCompressor(const TextureCompressionConfig &config, sg::TranscodeTarget target) :
+    config_{config}, target_{target}
+{
+	assert(target_ != sg::TranscodeTarget::kRgba8 && "The device samples no compressed format");
+}
+
+std::unique_ptr<sg::Image> TextureCompressor::load(const std::string &name, const std::string &uri, TextureRole role, bool is_srgb) const
+{
+	const auto source     = fs::read_asset(uri);
+	const auto cache_path = get_cache_path(source, role, is_srgb, target_, config_);
+
+	std::error_code error;
+	if (std::filesystem::exists(cache_path, error))
+	{
+		try
+		{
+			return std::make_unique<sg::Ktx>(name, fs::read_binary_file(cache_path), sg::Image::kUnknown);
+		}
+		catch (const std::exception &e)
+		{
+			LOGW("Ignoring unreadable compressed texture {}: {}", cache_path.string(), e.what());
+		}
+	}
+
+	auto image = std::make_unique<sg::Stb>(name, source, is_srgb ? sg::Image::kColor : sg::Image::kOther);
+
+	const auto &extent = image->get_extent();
+	if (std::max(extent.width, extent.height) < config_.min_extent)
+	{
+		return image;
+	}
+
+	XIHE_TRACE_ZONE("Compress texture");
+
+	Timer timer;
+	timer.start();
+
+	// The levels are encoded from the data, so the whole chain is generated on the CPU
+	image->generate_mipmaps();
+
+	auto *texture = target_ == sg::TranscodeTarget::kAstc4x4 ? encode_astc(*image, role, is_srgb, config_) :
+	                                                           encode_basis(*image, role, target_, config_);
+
+	ktx_uint8_t *bytes = nullptr;
+	ktx_size_t   size  = 0;
+	const auto   result = ktxTexture_WriteToMemory(reinterpret_cast<ktxTexture *>(texture), &bytes, &size);
+	ktxTexture_Destroy(reinterpret_cast<ktxTexture *>(texture));
+	if (result != KTX_SUCCESS)
+	{
+		throw std::runtime_error{fmt::format("Error writing compressed texture {}: {}", name, ktxErrorString(result))};
+	}
+
+	std::vector<uint8_t> data{bytes, bytes + size};
+	free(bytes);
+
+	// A loader running at the same time never sees a partial entry
+	fs::write_file_atomic(cache_path, data);
+
+	LOGI("Compressed {} as {} for {} in {:.2f} seconds", name, to_string(role), sg::to_string(target_), timer.stop());
+
+	return std::make_unique<sg::Ktx>(name, data, sg::Image::kUnknown);
+}
+}        // namespace xihe
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "scene_graph/components/image.h"
+
+namespace xihe
+{
+/**
+ * @brief What a material samples from an image, it decides the channels a compressed format must keep
+ */
+enum class TextureRole
+{
+	kColor,            /// Base color and emissive, RGBA
+	kNormal,           /// Tangent space normal, XY only, Z is reconstructed by the shaders
+	kMask,             /// Occlusion, roughness and metallic packed as RGB
+	kOcclusion         /// Occlusion alone, R only
+};
+
+const char *to_string(TextureRole role);
+
+struct TextureCompressionConfig
+{
+	/// Images whose first level is smaller are kept uncompressed
+	uint32_t min_extent{64};
+
+	/// astcenc quality, from ASTCENC_PRE_FASTEST (0) to ASTCENC_PRE_EXHAUSTIVE (100)
+	float astc_quality{60.0f};
+
+	/// UASTC level the BC and ETC2 formats are transcoded from, 0 is the fastest and 4 the slowest
+	uint32_t uastc_level{2};
+};
+
+/**
+ * @brief Block compresses PNG and JPEG images at import to the format family the device samples, picking the format of
+ *        each image from its role: BC7, BC5 or BC4 for the BC target, ASTC 4x4 for the ASTC target, ETC2 RGBA, RG11 or R11
+ *        for the ETC2 target.
+ *
+ *        ASTC is encoded with astcenc. The other formats are encoded to UASTC with the Basis Universal encoder of libktx
+ *        and transcoded from it. Both spread the blocks of a level across the threads left in the WorkerBudget.
+ *
+ *        Encoded images are written to the cache folder as KTX2 files keyed on the content of the source file, the role,
+ *        the target and the settings, so only the first load pays for the encoding and later ones skip decoding too.
+ */
+class TextureCompressor
+{
+  public:
+	TextureCompressor(const TextureCompressionConfig &config, sg::TranscodeTarget target);
+
+	/**
+	 * @brief Loads the compressed image from the cache, encoding it first on a miss. Images below the min extent are
+	 *        returned decoded without levels, as sg::Image::load would.
+	 * @param uri PNG or JPEG file in the assets
+	 */
+	std::unique_ptr<sg::Image> load(const std::string &name, const std::string &uri, TextureRole role, bool is_srgb) const;
+
+  private:
+	TextureCompressionConfig config_;
+
+	sg::TranscodeTarget target_;
+};
+}        // namespace xihe
@@ -0,0 +1,84 @@
+#include "texture_packer.h"
+
+#include <map>
+#include <tuple>
+
+#include <fmt/format.h>
+
+#include "backend/device.h"
+#include "common/helpers.h"
+#include "common/trace.h"
+#include "scene_graph/components/image.h"
+
+namespace xihe
+{
+TexturePacker::TexturePacker(backend::Device &device, const TexturePackingConfig &config) :
+    device_{device},
+    max_layers_{std::clamp(config.max_layers, 2u, std::min(device.get_gpu().get_properties().limits.maxImageArrayLayers, 0xFFFFu))}
+{}
+
+bool TexturePacker::is_packable(const sg::Image &image, const TexturePackingConfig &config)
+{
+	const auto &extent = image.get_extent();
+	return image.get_layers() == 1 && extent.depth == 1 &&
+	       std::max(extent.width, extent.height) <= config.max_extent &&
+	       image.get_mip_levels() == image.get_mipmaps().size();
+}
+
+std::vector<std::unique_ptr<sg::Image>> TexturePacker::pack(const std::vector<sg::Image *> &images)
+{
+	XIHE_TRACE_ZONE("Pack textures");
+
+	// Ordered, so the arrays come out the same from one load to the next
+	using GroupKey = std::tuple<vk::Format, uint32_t, uint32_t, uint32_t>;
+	std::map<GroupKey, std::vector<sg::Image *>> groups;
+
+	for (auto *image : images)
+	{
+		if (!image->is_created())
+		{
+			const auto &extent = image->get_extent();
+			groups[{image->get_format(), extent.width, extent.height, image->get_mip_levels()}].push_back(image);
+		}
+	}
+
+	std::vector<std::unique_ptr<sg::Image>> arrays;
+
+	for (auto &[key, group] : groups)
+	{
+		for (size_t first = 0; first < group.size(); first += max_layers_)
+		{
+			const auto count = std::min<size_t>(group.size() - first, max_layers_);
+
+			if (count == 1)
+			{
+				group[first]->create_vk_image(device_);
+				stats_.unpacked_images++;
+				continue;
+			}
+
+			const auto &[format, width, height, levels] = key;
+
+			std::vector<sg::Image *> layers{group.begin() + first, group.begin() + first + count};
+			arrays.push_back(sg::Image::create_packed_array(device_, fmt::format("Packed {} {}x{} #{}", vk::to_string(format), width, height, arrays.size()), layers));
+
+			stats_.arrays++;
+			stats_.packed_images += to_u32(count);
+			stats_.packed_size += layers.front()->get_data_size(0) * count;
+		}
+	}
+
+	return arrays;
+}
+
+uint32_t TexturePacker::encode_texture_index(uint32_t slot, uint32_t layer)
+{
+	assert(slot <= 0xFFFF && layer < 0xFFFF);
+	return slot | ((layer + 1) << 16);
+}
+
+const TexturePackingStats &TexturePacker::get_stats() const
+{
+	return stats_;
+}
+}        // namespace xihe
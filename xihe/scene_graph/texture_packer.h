@@ -0,0 +1,86 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+namespace xihe
+{
+namespace backend
+{
+class Device;
+}
+
+namespace sg
+{
+class Image;
+}
+
+struct TexturePackingConfig
+{
+	/// Images whose first level fits within this extent are packed
+	uint32_t max_extent{256};
+
+	/// Layers of an array, larger groups are split across several arrays
+	uint32_t max_layers{64};
+};
+
+struct TexturePackingStats
+{
+	/// Images stored as a layer of an array
+	uint32_t packed_images{0};
+
+	/// Arrays the packed images share, one allocation each
+	uint32_t arrays{0};
+
+	/// Images small enough to be packed that matched no other one
+	uint32_t unpacked_images{0};
+
+	/// Bytes of the levels of the packed images
+	vk::DeviceSize packed_size{0};
+
+	/// Bindless slots the textures of the packed images would have taken beyond the ones of the arrays
+	uint32_t saved_descriptors{0};
+};
+
+/**
+ * @brief Packs small images of a scene into 2D arrays at import, so they share an allocation instead of each taking its own.
+ *        Images are grouped by format, extent and levels, each group of two or more becomes an array.
+ *
+ *        Textures sampling a packed image are bound through the array, the shaders take the layer from the upper bits
+ *        of their texture index, see encode_texture_index and shaders/material_textures.h.
+ */
+class TexturePacker
+{
+  public:
+	TexturePacker(backend::Device &device, const TexturePackingConfig &config);
+
+	/**
+	 * @brief Single layer 2D images within the max extent whose levels are all held in their data, the GPU generates no mips for them
+	 */
+	static bool is_packable(const sg::Image &image, const TexturePackingConfig &config);
+
+	/**
+	 * @brief Groups the images that have no Vulkan image yet into arrays, the ones that match no other image get their own Vulkan image.
+	 *        The images are uploaded as usual afterwards, through the view on their layer.
+	 * @return The arrays, to be kept alive as long as the images
+	 */
+	std::vector<std::unique_ptr<sg::Image>> pack(const std::vector<sg::Image *> &images);
+
+	/**
+	 * @brief Index of a texture sampling a layer of the array bound at the slot, the layer plus one goes in the upper 16 bits.
+	 *        Indices of unpacked textures are their slot.
+	 */
+	static uint32_t encode_texture_index(uint32_t slot, uint32_t layer);
+
+	const TexturePackingStats &get_stats() const;
+
+  private:
+	backend::Device &device_;
+
+	uint32_t max_layers_;
+
+	TexturePackingStats stats_;
+};
+}        // namespace xihe
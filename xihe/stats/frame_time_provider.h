@@ -1,5 +1,9 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
 #include "stats_provider.h"
 
 namespace xihe::stats
@@ -21,10 +25,36 @@ public:
 
 	Counters sample(float delta_time) override
 	{
+		last_frame_ms_.store(delta_time * 1000.0, std::memory_order_relaxed);
+		last_frame_start_.store(Clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+
 		Counters res;
 		// frame_times comes directly from delta_time
 		res[StatIndex::kFrameTimes].result = delta_time * 1000.f;
 		return res;
 	}
+
+	/// The time of the frame in progress once it takes longer than the previous one, so a stall shows up while it lasts
+	Counters continuous_sample(float delta_time) override
+	{
+		const Clock::duration elapsed{Clock::now().time_since_epoch().count() - last_frame_start_.load(std::memory_order_relaxed)};
+
+		Counters res;
+		res[StatIndex::kFrameTimes].result = std::max(last_frame_ms_.load(std::memory_order_relaxed),
+		                                              std::chrono::duration<double, std::milli>(elapsed).count());
+		return res;
+	}
+
+	bool is_continuous(StatIndex index) const override
+	{
+		return index == StatIndex::kFrameTimes;
+	}
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	// Written by sample() on the main thread, read by the sampling thread
+	std::atomic<double>     last_frame_ms_{0.0};
+	std::atomic<Clock::rep> last_frame_start_{Clock::now().time_since_epoch().count()};
 };
 }
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+
+#include "rendering/render_context.h"
+#include "stats_provider.h"
+
+namespace xihe::stats
+{
+class GpuTimeProvider : public StatsProvider
+{
+public:
+	GpuTimeProvider(std::set<StatIndex> &requested_stats, rendering::RenderContext &render_context) :
+	    render_context_{render_context}
+	{
+		// Remove from requested set to stop other providers looking for it.
+		requested_stats.erase(StatIndex::kGpuFrameTimes);
+	}
+
+	bool is_available(StatIndex index) const override
+	{
+		return index == StatIndex::kGpuFrameTimes;
+	}
+
+	Counters sample(float delta_time) override
+	{
+		// Sum of the submitted batches, work overlapping on the async compute queue is counted on both queues
+		double gpu_ms = 0.0;
+		for (const auto &timing : render_context_.get_gpu_timings())
+		{
+			if (timing.depth == 0)
+			{
+				gpu_ms += timing.gpu_ms;
+			}
+		}
+
+		last_gpu_ms_.store(gpu_ms, std::memory_order_relaxed);
+
+		Counters res;
+		res[StatIndex::kGpuFrameTimes].result = gpu_ms;
+		return res;
+	}
+
+	/// Timings are only read back on the main thread, the latest one is held until the next frame resolves its timestamps
+	Counters continuous_sample(float delta_time) override
+	{
+		Counters res;
+		res[StatIndex::kGpuFrameTimes].result = last_gpu_ms_.load(std::memory_order_relaxed);
+		return res;
+	}
+
+	bool is_continuous(StatIndex index) const override
+	{
+		return index == StatIndex::kGpuFrameTimes;
+	}
+
+private:
+	rendering::RenderContext &render_context_;
+
+	std::atomic<double> last_gpu_ms_{0.0};
+};
+}
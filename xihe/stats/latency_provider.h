@@ -0,0 +1,36 @@
+#pragma once
+
+#include "rendering/render_context.h"
+#include "stats_provider.h"
+
+namespace xihe::stats
+{
+class LatencyProvider : public StatsProvider
+{
+public:
+	LatencyProvider(std::set<StatIndex> &requested_stats, rendering::RenderContext &render_context) :
+	    render_context_{render_context}
+	{
+		// Remove from requested set to stop other providers looking for it.
+		requested_stats.erase(StatIndex::kInputLatency);
+	}
+
+	bool is_available(StatIndex index) const override
+	{
+		return index == StatIndex::kInputLatency;
+	}
+
+	Counters sample(float delta_time) override
+	{
+		// The latency of a frame is only known once it completes, the last completed frame is reported until the next one
+		const auto latency = render_context_.get_frame_pacer().get_last_latency();
+
+		Counters res;
+		res[StatIndex::kInputLatency].result = latency ? latency->input_to_complete_ms : 0.0;
+		return res;
+	}
+
+private:
+	rendering::RenderContext &render_context_;
+};
+}
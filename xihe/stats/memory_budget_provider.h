@@ -0,0 +1,54 @@
+#pragma once
+
+#include "backend/allocated.h"
+#include "stats_provider.h"
+
+namespace xihe::stats
+{
+/**
+ * \brief Device local memory usage and budget from VMA, and the bytes allocated per memory category
+ */
+class MemoryBudgetProvider : public StatsProvider
+{
+public:
+	MemoryBudgetProvider(std::set<StatIndex> &requested_stats)
+	{
+		// Remove from requested set to stop other providers looking for it.
+		for (const auto &[index, category] : category_stats_)
+		{
+			requested_stats.erase(index);
+		}
+		requested_stats.erase(StatIndex::kDeviceMemoryUsage);
+		requested_stats.erase(StatIndex::kDeviceMemoryBudget);
+	}
+
+	bool is_available(StatIndex index) const override
+	{
+		return index == StatIndex::kDeviceMemoryUsage || index == StatIndex::kDeviceMemoryBudget || category_stats_.contains(index);
+	}
+
+	Counters sample(float delta_time) override
+	{
+		const auto budget = backend::allocated::get_device_local_budget();
+
+		Counters res;
+		res[StatIndex::kDeviceMemoryUsage].result  = static_cast<double>(budget.usage);
+		res[StatIndex::kDeviceMemoryBudget].result = static_cast<double>(budget.budget);
+
+		for (const auto &[index, category] : category_stats_)
+		{
+			res[index].result = static_cast<double>(backend::allocated::get_category_statistics(category).allocation_bytes);
+		}
+		return res;
+	}
+
+private:
+	inline static const std::map<StatIndex, backend::allocated::MemoryCategory> category_stats_{
+	    {StatIndex::kRenderGraphMemory, backend::allocated::MemoryCategory::kRenderGraph},
+	    {StatIndex::kGpuSceneMemory, backend::allocated::MemoryCategory::kGpuScene},
+	    {StatIndex::kTextureMemory, backend::allocated::MemoryCategory::kTexture},
+	    {StatIndex::kStagingMemory, backend::allocated::MemoryCategory::kStaging},
+	    {StatIndex::kBufferPoolMemory, backend::allocated::MemoryCategory::kBufferPool},
+	};
+};
+}
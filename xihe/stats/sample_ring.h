@@ -0,0 +1,97 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace xihe::stats
+{
+/**
+ * \brief Fixed size circular buffer of samples, one thread pushes while any thread reads without locking.
+ *        Pushing is O(1), once full the oldest sample is overwritten.
+ */
+template <typename T>
+class SampleRing
+{
+  public:
+	explicit SampleRing(size_t capacity) :
+	    capacity_{capacity}, values_{std::make_unique<std::atomic<T>[]>(capacity)}
+	{
+		assert(capacity > 0 && "Sample ring needs room for at least one sample");
+	}
+
+	SampleRing(const SampleRing &)            = delete;
+	SampleRing &operator=(const SampleRing &) = delete;
+
+	/// Must only be called from the thread that owns the ring
+	void push(T value)
+	{
+		const uint64_t count = count_.load(std::memory_order_relaxed);
+		values_[count % capacity_].store(value, std::memory_order_relaxed);
+		count_.store(count + 1, std::memory_order_release);
+	}
+
+	size_t capacity() const
+	{
+		return capacity_;
+	}
+
+	size_t size() const
+	{
+		return static_cast<size_t>(std::min<uint64_t>(count_.load(std::memory_order_acquire), capacity_));
+	}
+
+	/// Number of samples ever pushed, readers use it as a cursor to pick up new samples
+	uint64_t get_push_count() const
+	{
+		return count_.load(std::memory_order_acquire);
+	}
+
+	/// The newest sample, T{} if none was pushed
+	T back() const
+	{
+		const uint64_t count = count_.load(std::memory_order_acquire);
+		return count == 0 ? T{} : values_[(count - 1) % capacity_].load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * \brief Copies the samples with push counts in [first_index, end_index), oldest first
+	 * \param first_index Push count to start at, samples already overwritten are skipped
+	 * \param end_index   Push count to stop at, clamped to the samples pushed so far
+	 */
+	std::vector<T> snapshot(uint64_t first_index = 0, uint64_t end_index = std::numeric_limits<uint64_t>::max()) const
+	{
+		const uint64_t count  = std::min(count_.load(std::memory_order_acquire), end_index);
+		const uint64_t oldest = count > capacity_ ? count - capacity_ : 0;
+		const uint64_t first  = std::max(first_index, oldest);
+
+		std::vector<T> values;
+		values.reserve(count > first ? count - first : 0);
+		for (uint64_t i = first; i < count; ++i)
+		{
+			values.push_back(values_[i % capacity_].load(std::memory_order_relaxed));
+		}
+
+		// The writer may have wrapped around while copying, the slots it wrote to since hold newer samples
+		const uint64_t new_count = count_.load(std::memory_order_acquire);
+		if (new_count > first + capacity_)
+		{
+			const auto overwritten = static_cast<size_t>(std::min<uint64_t>(new_count - first - capacity_, values.size()));
+			values.erase(values.begin(), values.begin() + overwritten);
+		}
+
+		return values;
+	}
+
+  private:
+	size_t capacity_;
+
+	std::unique_ptr<std::atomic<T>[]> values_;
+
+	std::atomic<uint64_t> count_{0};
+};
+}        // namespace xihe::stats
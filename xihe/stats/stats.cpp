@@ -1,8 +1,19 @@
 #include "stats.h"
 
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <numeric>
+
+#include <fmt/ranges.h>
+
 #include "backend/allocated.h"
 #include "backend/device.h"
+#include "common/trace.h"
 #include "rendering/render_context.h"
+#include "stats/gpu_time_provider.h"
+#include "stats/latency_provider.h"
+#include "stats/memory_budget_provider.h"
 
 namespace xihe::stats
 {
@@ -10,31 +21,52 @@ StatGraphData::StatGraphData(const std::string &name, const std::string &format,
     name(name), format(format), scale_factor(scale_factor), has_fixed_max(has_fixed_max), max_value(max_value)
 {}
 
-Stats::Stats(rendering::RenderContext &render_context, size_t buffer_size) :
-    render_context_(render_context), buffer_size_(buffer_size)
+namespace
+{
+float percentile(const std::vector<float> &sorted_values, float fraction)
+{
+	// Nearest rank, so the reported value is always one that was measured
+	const auto rank = static_cast<size_t>(std::ceil(fraction * static_cast<float>(sorted_values.size())));
+	return sorted_values[std::clamp<size_t>(rank, 1, sorted_values.size()) - 1];
+}
+}        // namespace
+
+Stats::Stats(rendering::RenderContext &render_context, size_t buffer_size, size_t history_size) :
+    render_context_(render_context), buffer_size_(buffer_size), history_size_(history_size)
 {
 	assert(buffer_size >= 2 && "Buffers size should be greater than 2");
 }
 
 Stats::~Stats()
-{}
+{
+	if (continuous_sampling_thread_.joinable())
+	{
+		stop_continuous_sampling_.set_value();
+		continuous_sampling_thread_.join();
+	}
+}
 
 void Stats::update(float delta_time)
 {
-	switch (sampling_config_.mode)
+	// Providers are sampled here in both modes, counters the sampling thread takes are then pushed from its rings instead
+	StatsProvider::Counters sample;
+
+	for (auto &p : providers)
 	{
-		case CounterSamplingMode::kPolling:
-		{
-			StatsProvider::Counters sample;
+		auto s = p->sample(delta_time);
+		sample.insert(s.begin(), s.end());
+	}
+	std::erase_if(sample, [this](const auto &counter) { return continuous_samples_.contains(counter.first); });
+	push_sample(sample);
 
-			for (auto &p : providers)
-			{
-				auto s = p->sample(delta_time);
-				sample.insert(s.begin(), s.end());
-			}
-			push_sample(sample);
-			break;
-		}
+	if (sampling_config_.mode == CounterSamplingMode::kContinuous)
+	{
+		push_continuous_samples();
+	}
+
+	if (requested_stats_.contains(StatIndex::kGpuFrameTimes))
+	{
+		update_gpu_timings();
 	}
 }
 
@@ -51,15 +83,40 @@ void Stats::request_stats(const std::set<StatIndex> &requested_stats, const Coun
 	std::set<StatIndex> stats = requested_stats;
 
 	providers.emplace_back(std::make_unique<FrameTimeProvider>(stats));
+	providers.emplace_back(std::make_unique<GpuTimeProvider>(stats, render_context_));
+	providers.emplace_back(std::make_unique<MemoryBudgetProvider>(stats));
+	providers.emplace_back(std::make_unique<LatencyProvider>(stats, render_context_));
 
 	for (const auto &stat : requested_stats)
 	{
-		counters_data_[stat] = std::vector<float>(buffer_size_, 0);
+		auto &values = counters_data_.try_emplace(stat, buffer_size_).first->second;
+		for (size_t i = 0; i < buffer_size_; ++i)
+		{
+			values.push(0.0f);
+		}
+
+		history_.try_emplace(stat, history_size_);
 	}
 
 	if (sampling_config.mode == CounterSamplingMode::kContinuous)
 	{
-		//todo
+		for (const auto &stat : requested_stats)
+		{
+			if (std::ranges::any_of(providers, [stat](const auto &provider) { return provider->is_continuous(stat); }))
+			{
+				continuous_samples_.try_emplace(stat, history_size_);
+				continuous_read_counts_[stat] = 0;
+			}
+		}
+
+		if (continuous_samples_.empty())
+		{
+			LOGW("None of the requested stats can be sampled continuously, they are polled every frame");
+		}
+		else
+		{
+			continuous_sampling_thread_ = std::thread(&Stats::continuous_sampling_worker, this, stop_continuous_sampling_.get_future());
+		}
 	}
 
 	for (const auto &stat_index : requested_stats)
@@ -90,34 +147,190 @@ bool Stats::is_available(StatIndex index) const
 	});
 }
 
-void Stats::push_sample(const StatsProvider::Counters &sample)
+StatSummary summarize(std::vector<float> values)
+{
+	if (values.empty())
+	{
+		return {};
+	}
+
+	std::ranges::sort(values);
+
+	StatSummary summary;
+	summary.count = values.size();
+	summary.min   = values.front();
+	summary.max   = values.back();
+	summary.mean  = static_cast<float>(std::accumulate(values.begin(), values.end(), 0.0) / static_cast<double>(values.size()));
+	summary.p50   = percentile(values, 0.50f);
+	summary.p95   = percentile(values, 0.95f);
+	summary.p99   = percentile(values, 0.99f);
+	return summary;
+}
+
+StatSummary Stats::get_summary(StatIndex index) const
+{
+	return summarize(history_.at(index).snapshot());
+}
+
+bool Stats::write_csv(const std::string &path) const
 {
-	for (auto &c : counters_data_)
+	std::ofstream file{path, std::ios::out | std::ios::trunc};
+	if (!file.is_open())
 	{
-		StatIndex           idx    = c.first;
-		std::vector<float> &values = c.second;
+		LOGE("Failed to open {} for writing stats", path);
+		return false;
+	}
+
+	std::vector<std::vector<float>> columns;
+	size_t                          row_count = 0;
 
-		// Find the counter matching this StatIndex in the Sample
-		const auto &smp = sample.find(idx);
-		if (smp == sample.end())
+	for (const auto &[index, values] : history_)
+	{
+		file << (columns.empty() ? "" : ",") << get_graph_data(index).name;
+
+		columns.push_back(values.snapshot());
+		row_count = std::max(row_count, columns.back().size());
+	}
+	file << "\n";
+
+	for (size_t row = 0; row < row_count; ++row)
+	{
+		for (size_t column = 0; column < columns.size(); ++column)
 		{
-			continue;
+			// Counters sampled at different rates hold different amounts of samples, the shorter ones start later
+			const auto  &values = columns[column];
+			const size_t offset = row_count - values.size();
+
+			file << (column == 0 ? "" : ",");
+			if (row >= offset)
+			{
+				file << values[row - offset];
+			}
 		}
+		file << "\n";
+	}
+
+	LOGI("Wrote {} samples of {} counters to {}", row_count, columns.size(), path);
+	return true;
+}
+
+bool Stats::write_json(const std::string &path) const
+{
+	std::ofstream file{path, std::ios::out | std::ios::trunc};
+	if (!file.is_open())
+	{
+		LOGE("Failed to open {} for writing stats", path);
+		return false;
+	}
+
+	file << "{\n  \"counters\": [";
 
-		auto measurement = static_cast<float>(smp->second.result);
+	bool first_counter = true;
+	for (const auto &[index, values] : history_)
+	{
+		const auto summary = get_summary(index);
 
-		assert(values.size() >= 2 && "Buffers size should be greater than 2");
+		file << (first_counter ? "" : ",") << fmt::format(
+		    "\n    {{\"name\": \"{}\", \"count\": {}, \"min\": {}, \"max\": {}, \"mean\": {}, \"p50\": {}, \"p95\": {}, \"p99\": {}, \"samples\": [{}]}}",
+		    get_graph_data(index).name, summary.count, summary.min, summary.max, summary.mean, summary.p50, summary.p95, summary.p99,
+		    fmt::join(values.snapshot(), ", "));
+		first_counter = false;
+	}
 
-		float alpha_smoothing = 0.2f;
+	file << "\n  ]\n}\n";
 
-		if (values.size() == values.capacity())
+	LOGI("Wrote stats of {} counters to {}", history_.size(), path);
+	return true;
+}
+
+void Stats::push_sample(const StatsProvider::Counters &sample)
+{
+	for (const auto &[index, counter] : sample)
+	{
+		push_counter(index, static_cast<float>(counter.result));
+	}
+}
+
+void Stats::push_counter(StatIndex index, float measurement)
+{
+	auto it = counters_data_.find(index);
+	if (it == counters_data_.end())
+	{
+		return;
+	}
+
+	history_.at(index).push(measurement);
+
+	// Use an exponential moving average to smooth values
+	float alpha_smoothing = 0.2f;
+	it->second.push(measurement * alpha_smoothing + it->second.back() * (1.0f - alpha_smoothing));
+}
+
+void Stats::continuous_sampling_worker(std::future<void> should_terminate)
+{
+	XIHE_TRACE_THREAD_NAME("Stats sampler");
+
+	Timer timer;
+	timer.tick();
+
+	// Deadlines advance by the interval, so the rate does not drift with the time spent sampling
+	auto next_sample_time = std::chrono::steady_clock::now();
+
+	while (should_terminate.wait_until(next_sample_time += sampling_config_.interval_ms) == std::future_status::timeout)
+	{
+		auto delta_time = static_cast<float>(timer.tick());
+
+		for (auto &p : providers)
+		{
+			for (const auto &[index, counter] : p->continuous_sample(delta_time))
+			{
+				auto it = continuous_samples_.find(index);
+				if (it != continuous_samples_.end())
+				{
+					it->second.push(static_cast<float>(counter.result));
+				}
+			}
+		}
+	}
+}
+
+void Stats::push_continuous_samples()
+{
+	for (const auto &[index, samples] : continuous_samples_)
+	{
+		auto          &read_count = continuous_read_counts_.at(index);
+		const uint64_t push_count = samples.get_push_count();
+
+		// Samples the sampling thread overwrote before they were read are lost, the rest keep their order
+		for (float measurement : samples.snapshot(read_count, push_count))
 		{
-			// Shift values to the left to make space at the end and update counters
-			std::ranges::rotate(values, values.begin() + 1);
+			push_counter(index, measurement);
 		}
 
-		// Use an exponential moving average to smooth values
-		values.back() = measurement * alpha_smoothing + *(values.end() - 2) * (1.0f - alpha_smoothing);
+		read_count = push_count;
 	}
 }
+
+void Stats::update_gpu_timings()
+{
+	const auto &timings = render_context_.get_gpu_timings();
+
+	std::vector<rendering::GpuScopeTiming> gpu_timings;
+	gpu_timings.reserve(timings.size());
+
+	for (const auto &timing : timings)
+	{
+		auto &smoothed = gpu_timings.emplace_back(timing);
+
+		// Same smoothing as the graphs, scopes keep their names across frames unless the graph is rebuilt
+		auto it = std::ranges::find_if(gpu_timings_, [&timing](const rendering::GpuScopeTiming &previous) { return previous.name == timing.name; });
+		if (it != gpu_timings_.end())
+		{
+			float alpha_smoothing = 0.2f;
+			smoothed.gpu_ms       = timing.gpu_ms * alpha_smoothing + it->gpu_ms * (1.0f - alpha_smoothing);
+		}
+	}
+
+	gpu_timings_ = std::move(gpu_timings);
+}
 }        // namespace xihe::stats
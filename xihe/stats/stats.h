@@ -3,10 +3,13 @@
 #include <future>
 #include <map>
 #include <set>
+#include <thread>
 #include <vector>
 
 #include "common/timer.h"
+#include "rendering/gpu_profiler.h"
 #include "stats/frame_time_provider.h"
+#include "stats/sample_ring.h"
 #include "stats/stats_common.h"
 #include "stats_provider.h"
 
@@ -29,7 +32,11 @@ namespace stats
 class Stats
 {
   public:
-	explicit Stats(rendering::RenderContext &render_context, size_t buffer_size = 16);
+	/**
+	 * \param buffer_size  Number of smoothed values shown in the graphs
+	 * \param history_size Number of raw samples kept per counter for summaries and exports
+	 */
+	explicit Stats(rendering::RenderContext &render_context, size_t buffer_size = 16, size_t history_size = 4096);
 
 	~Stats();
 
@@ -39,11 +46,27 @@ class Stats
 
 	const StatGraphData &get_graph_data(StatIndex index) const;
 
-	const std::vector<float> &get_data(StatIndex index) const
+	/// Smoothed values for the graph, oldest first
+	std::vector<float> get_data(StatIndex index) const
 	{
-		return counters_data_.at(index);
+		return counters_data_.at(index).snapshot();
 	}
 
+	/**
+	 * \brief Min, max, mean and percentiles over the raw samples in the history of a counter
+	 */
+	StatSummary get_summary(StatIndex index) const;
+
+	/**
+	 * \brief Writes the raw samples in the history, one column per counter, newest samples aligned on the last row
+	 */
+	bool write_csv(const std::string &path) const;
+
+	/**
+	 * \brief Writes the summary and the raw samples of every counter
+	 */
+	bool write_json(const std::string &path) const;
+
 	const std::set<StatIndex> &get_requested_stats() const
 	{
 		return requested_stats_;
@@ -51,6 +74,14 @@ class Stats
 
 	bool is_available(StatIndex index) const;
 
+	/**
+	 * \brief Smoothed GPU time of every batch and pass, only updated if StatIndex::kGpuFrameTimes was requested
+	 */
+	const std::vector<rendering::GpuScopeTiming> &get_gpu_timings() const
+	{
+		return gpu_timings_;
+	}
+
 	void push_sample(const StatsProvider::Counters &sample);
 
   private:
@@ -64,8 +95,33 @@ class Stats
 
 	size_t buffer_size_;
 
-	/// Circular buffers for counter data
-	std::map<StatIndex, std::vector<float>> counters_data_;
+	size_t history_size_;
+
+	/// Circular buffers for the smoothed counter data shown in the graphs
+	std::map<StatIndex, SampleRing<float>> counters_data_;
+
+	/// Circular buffers for the raw counter data, written only by the thread calling update()
+	std::map<StatIndex, SampleRing<float>> history_;
+
+	/// Samples taken by the sampling thread, which is their only writer, until update() moves them to the history
+	std::map<StatIndex, SampleRing<float>> continuous_samples_;
+
+	/// Push count of each continuous ring already moved to the history
+	std::map<StatIndex, uint64_t> continuous_read_counts_;
+
+	std::thread continuous_sampling_thread_;
+
+	std::promise<void> stop_continuous_sampling_;
+
+	void continuous_sampling_worker(std::future<void> should_terminate);
+
+	void push_continuous_samples();
+
+	void push_counter(StatIndex index, float measurement);
+
+	std::vector<rendering::GpuScopeTiming> gpu_timings_;
+
+	void update_gpu_timings();
 };
 }        // namespace stats
 }        // namespace xihe
@@ -2,12 +2,14 @@
 
 #include <chrono>
 #include <string>
+#include <vector>
 
 namespace xihe::stats
 {
 enum class StatIndex
 {
 	kFrameTimes,
+	kGpuFrameTimes,
 	kCpuCycles,
 	kCpuInstructions,
 	kCpuCacheMissRatio,
@@ -38,6 +40,15 @@ enum class StatIndex
 	kGpuExtReadBytes,
 	kGpuExtWriteBytes,
 	kGpuTexCycles,
+
+	kDeviceMemoryUsage,
+	kDeviceMemoryBudget,
+	kRenderGraphMemory,
+	kGpuSceneMemory,
+	kTextureMemory,
+	kStagingMemory,
+	kBufferPoolMemory,
+	kInputLatency,
 };
 
 struct StatIndexHash
@@ -69,6 +80,22 @@ enum class CounterSamplingMode
 	kContinuous
 };
 
+/// Distribution of the raw samples kept for a counter, before smoothing
+struct StatSummary
+{
+	size_t count{0};
+
+	float min{0.0f};
+	float max{0.0f};
+	float mean{0.0f};
+	float p50{0.0f};
+	float p95{0.0f};
+	float p99{0.0f};
+};
+
+/// Summarizes samples in any order, an empty summary if there are none
+StatSummary summarize(std::vector<float> values);
+
 struct CounterSamplingConfig
 {
 	CounterSamplingMode mode;
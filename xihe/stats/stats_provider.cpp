@@ -6,6 +6,7 @@ std::map<StatIndex, StatGraphData> StatsProvider::default_graph_map_{
     // clang-format off
 	// StatIndex                        Name shown in graph                            Format           Scale                         Fixed_max Max_value
 	{StatIndex::kFrameTimes,           {"Frame Times",                                 "{:3.1f} ms",    1.0f}},
+	{StatIndex::kGpuFrameTimes,        {"GPU Frame Times",                             "{:3.1f} ms",    1.0f}},
 	{StatIndex::kCpuCycles,            {"CPU Cycles",                                  "{:4.1f} M/s",   static_cast<float>(1e-6)}},
 	{StatIndex::kCpuInstructions,      {"CPU Instructions",                            "{:4.1f} M/s",   static_cast<float>(1e-6)}},
 	{StatIndex::kCpuCacheMissRatio,    {"Cache Miss Ratio",                            "{:3.1f}%",      100.0f,                       true,     100.0f}},
@@ -36,6 +37,15 @@ std::map<StatIndex, StatGraphData> StatsProvider::default_graph_map_{
 	{StatIndex::kGpuExtWriteStalls,    {"External Write Stalls",                       "{:4.1f} M/s",   static_cast<float>(1e-6)}},
 	{StatIndex::kGpuExtReadBytes,      {"External Read Bytes",                         "{:4.1f} MiB/s", 1.0f / (1024.0f * 1024.0f)}},
 	{StatIndex::kGpuExtWriteBytes,     {"External Write Bytes",                        "{:4.1f} MiB/s", 1.0f / (1024.0f * 1024.0f)}},
+
+	{StatIndex::kDeviceMemoryUsage,    {"Device Memory Usage",                         "{:4.1f} MiB",   1.0f / (1024.0f * 1024.0f)}},
+	{StatIndex::kDeviceMemoryBudget,   {"Device Memory Budget",                        "{:4.1f} MiB",   1.0f / (1024.0f * 1024.0f)}},
+	{StatIndex::kRenderGraphMemory,    {"Render Graph Memory",                         "{:4.1f} MiB",   1.0f / (1024.0f * 1024.0f)}},
+	{StatIndex::kGpuSceneMemory,       {"GPU Scene Memory",                            "{:4.1f} MiB",   1.0f / (1024.0f * 1024.0f)}},
+	{StatIndex::kTextureMemory,        {"Texture Memory",                              "{:4.1f} MiB",   1.0f / (1024.0f * 1024.0f)}},
+	{StatIndex::kStagingMemory,        {"Staging Memory",                              "{:4.1f} MiB",   1.0f / (1024.0f * 1024.0f)}},
+	{StatIndex::kBufferPoolMemory,     {"Buffer Pool Memory",                          "{:4.1f} MiB",   1.0f / (1024.0f * 1024.0f)}},
+	{StatIndex::kInputLatency,         {"Input Latency",                               "{:3.1f} ms",    1.0f}},
     // clang-format on
 
 };
@@ -38,11 +38,23 @@ class StatsProvider
 
 	virtual Counters sample(float delta_time) = 0;
 
+	/**
+	 * \brief Called at a fixed rate from the sampling thread of Stats in CounterSamplingMode::kContinuous,
+	 *        so it may run concurrently with sample()
+	 */
 	virtual Counters continuous_sample(float delta_time)
 	{
 		return Counters{};
 	}
 
+	/**
+	 * \brief Whether continuous_sample() reports the counter, in CounterSamplingMode::kContinuous its value from sample() is then dropped
+	 */
+	virtual bool is_continuous(StatIndex index) const
+	{
+		return false;
+	}
+
 	virtual void begin_sampling(backend::CommandBuffer &command_buffer)
 	{}
 
@@ -1,22 +1,62 @@
 #include "test_app.h"
 
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "gui.h"
 #include "scene_graph/components/camera.h"
+#include "scene_graph/node.h"
+#include "scene_graph/scene.h"
 
 namespace xihe
 {
-SparseImagePass::SparseImagePass(backend::Device &device)
+namespace
 {
-	std::array<SimpleVertex, 4> vertices;
-	vertices[0].pos = {-100.0f, -100.0f};
-	vertices[1].pos = {100.0f, -100.0f};
-	vertices[2].pos = {100.0f, 100.0f};
-	vertices[3].pos = {-100.0f, 100.0f};
+constexpr float kQuadSize = 200.0f;
+
+const vk::Extent3D kSimulatedPageExtent{128, 128, 1};
+
+constexpr size_t kResidentBudget  = 256;
+constexpr size_t kUploadsPerFrame = 16;
+
+// Grid the feedback is simulated on, finer than the pages of the finest level a quad of this size requests
+constexpr uint32_t kFeedbackBlocks = 64;
+
+struct SettingsUniform
+{
+	uint32_t color_highlight;
+	int32_t  min_lod;
+	int32_t  max_lod;
+};
+
+// Same as the PageLayout uniform block of sparse_image.frag
+struct PageLayoutUniform
+{
+	glm::uvec4 mips[16];
+	glm::uvec2 page_extent;
+	uint32_t   mip_count;
+};
+
+/// Maps the texture coordinates of the quad to its position
+glm::mat4 get_quad_transform()
+{
+	return glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(-kQuadSize * 0.5f, -kQuadSize * 0.5f, 0.0f)), glm::vec3(kQuadSize, kQuadSize, 1.0f));
+}
+}        // namespace
 
+SparseImagePass::SparseImagePass(backend::Device &device, VirtualTexture &virtual_texture, sg::Camera &camera) :
+    virtual_texture_{virtual_texture}, camera_{camera}
+{
+	std::array<SimpleVertex, 4> vertices;
 	vertices[0].uv = {0.0f, 0.0f};
 	vertices[1].uv = {1.0f, 0.0f};
 	vertices[2].uv = {1.0f, 1.0f};
 	vertices[3].uv = {0.0f, 1.0f};
 
+	for (auto &vertex : vertices)
+	{
+		vertex.pos = (vertex.uv - 0.5f) * kQuadSize;
+	}
+
 	{
 		backend::BufferBuilder buffer_builder(sizeof(vertices[0]) * vertices.size());
 
@@ -37,12 +77,132 @@ SparseImagePass::SparseImagePass(backend::Device &device)
 
 void SparseImagePass::execute(backend::CommandBuffer &command_buffer, rendering::RenderFrame &active_frame, std::vector<rendering::ShaderBindable> input_bindables)
 {
-	RenderPass::execute(command_buffer, active_frame, input_bindables);
+	if (!virtual_texture_.is_created())
+	{
+		return;
+	}
+
+	auto &resource_cache = command_buffer.get_device().get_resource_cache();
+
+	auto &vert_shader_module = resource_cache.request_shader_module(vk::ShaderStageFlagBits::eVertex, get_vertex_shader());
+	auto &frag_shader_module = resource_cache.request_shader_module(vk::ShaderStageFlagBits::eFragment, get_fragment_shader());
+
+	std::vector<backend::ShaderModule *> shader_modules{&vert_shader_module, &frag_shader_module};
+
+	auto &pipeline_layout = resource_cache.request_pipeline_layout(shader_modules);
+
+	command_buffer.bind_pipeline_layout(pipeline_layout);
+
+	VertexInputState vertex_input_state;
+	vertex_input_state.bindings   = {{0, sizeof(SimpleVertex), vk::VertexInputRate::eVertex}};
+	vertex_input_state.attributes = {{0, 0, vk::Format::eR32G32Sfloat, offsetof(SimpleVertex, pos)},
+	                                 {1, 0, vk::Format::eR32G32Sfloat, offsetof(SimpleVertex, uv)}};
+	command_buffer.set_vertex_input_state(vertex_input_state);
+
+	RasterizationState rasterization_state;
+	rasterization_state.cull_mode = vk::CullModeFlagBits::eNone;
+	command_buffer.set_rasterization_state(rasterization_state);
+
+	SceneUniform global_uniform{};
+	global_uniform.model            = glm::mat4(1.0f);
+	global_uniform.camera_view_proj = rendering::vulkan_style_projection(camera_.get_projection()) * camera_.get_view();
+	global_uniform.camera_position  = glm::vec3(glm::inverse(camera_.get_view())[3]);
+
+	auto allocation = active_frame.allocate_buffer(vk::BufferUsageFlagBits::eUniformBuffer, sizeof(SceneUniform), thread_index_);
+	allocation.update(global_uniform);
+	command_buffer.bind_buffer(allocation.get_buffer(), allocation.get_offset(), allocation.get_size(), 0, 0, 0);
+
+	command_buffer.bind_image(*virtual_texture_.texture_image_view, *virtual_texture_.sampler, 0, 1, 0);
+
+	SettingsUniform settings{};
+	settings.color_highlight = color_highlight_;
+	settings.min_lod         = virtual_texture_.base_mip_level;
+	settings.max_lod         = virtual_texture_.mip_levels - 1;
+
+	allocation = active_frame.allocate_buffer(vk::BufferUsageFlagBits::eUniformBuffer, sizeof(SettingsUniform), thread_index_);
+	allocation.update(settings);
+	command_buffer.bind_buffer(allocation.get_buffer(), allocation.get_offset(), allocation.get_size(), 0, 2, 0);
+
+	PageLayoutUniform page_layout{};
+	for (size_t mip = 0; mip < virtual_texture_.mip_properties.size(); ++mip)
+	{
+		const auto &properties = virtual_texture_.mip_properties[mip];
+		page_layout.mips[mip]  = glm::uvec4(properties.mip_base_page_index, properties.num_columns, properties.width, properties.height);
+	}
+	page_layout.page_extent = glm::uvec2(virtual_texture_.page_extent.width, virtual_texture_.page_extent.height);
+	page_layout.mip_count   = static_cast<uint32_t>(virtual_texture_.mip_properties.size());
+
+	allocation = active_frame.allocate_buffer(vk::BufferUsageFlagBits::eUniformBuffer, sizeof(PageLayoutUniform), thread_index_);
+	allocation.update(page_layout);
+	command_buffer.bind_buffer(allocation.get_buffer(), allocation.get_offset(), allocation.get_size(), 0, 3, 0);
+
+	auto &feedback_buffer = request_feedback_buffer(command_buffer.get_device(), active_frame);
+	command_buffer.bind_buffer(feedback_buffer, 0, feedback_buffer.get_size(), 0, 4, 0);
+
+	std::vector<std::reference_wrapper<const backend::Buffer>> vertex_buffers{*vertex_buffer_};
+	command_buffer.bind_vertex_buffers(0, vertex_buffers, {0});
+	command_buffer.bind_index_buffer(*index_buffer_, 0, vk::IndexType::eUint16);
+
+	command_buffer.draw_indexed(index_count_, 1, 0, 0, 0);
 }
 
-void SparseImagePass::create_sparse_texture_image(backend::Device &device)
+void SparseImagePass::end_execute(backend::CommandBuffer &command_buffer, rendering::RenderFrame &active_frame)
 {
+	auto it = feedback_buffers_.find(&active_frame);
+	if (it == feedback_buffers_.end() || !it->second)
+	{
+		return;
+	}
+
+	// The fence only makes the feedback available to the device, the host reads it when the frame is begun again
+	common::BufferMemoryBarrier memory_barrier{};
+	memory_barrier.src_access_mask = vk::AccessFlagBits2::eShaderStorageWrite;
+	memory_barrier.dst_access_mask = vk::AccessFlagBits2::eHostRead;
+	memory_barrier.src_stage_mask  = vk::PipelineStageFlagBits2::eFragmentShader;
+	memory_barrier.dst_stage_mask  = vk::PipelineStageFlagBits2::eHost;
+	command_buffer.buffer_memory_barrier(*it->second, 0, it->second->get_size(), memory_barrier);
+}
 
+void SparseImagePass::set_color_highlight(bool color_highlight)
+{
+	color_highlight_ = color_highlight;
+}
+
+backend::Buffer &SparseImagePass::request_feedback_buffer(backend::Device &device, rendering::RenderFrame &active_frame)
+{
+	const auto page_count = std::max<size_t>(virtual_texture_.get_page_count(), 1);
+
+	auto &buffer = feedback_buffers_[&active_frame];
+	if (buffer)
+	{
+		// The frame is only begun again once its previous GPU work completed
+		std::vector<uint32_t> requested(page_count);
+		buffer->read_back(reinterpret_cast<uint8_t *>(requested.data()), requested.size() * sizeof(uint32_t));
+
+		for (PageIndex page = 0; page < virtual_texture_.get_page_count(); ++page)
+		{
+			if (requested[page] != 0)
+			{
+				virtual_texture_.feedback.push_back(page);
+			}
+		}
+
+		std::fill(requested.begin(), requested.end(), 0U);
+		buffer->update(requested);
+		buffer->flush();
+
+		return *buffer;
+	}
+
+	backend::BufferBuilder buffer_builder(page_count * sizeof(uint32_t));
+	buffer_builder.with_usage(vk::BufferUsageFlagBits::eStorageBuffer)
+	    .with_vma_usage(VMA_MEMORY_USAGE_GPU_TO_CPU)
+	    .with_debug_name("Virtual texture feedback");
+	buffer = buffer_builder.build_unique(device);
+	buffer->update(std::vector<uint32_t>(page_count, 0U));
+	buffer->flush();
+
+	return *buffer;
 }
 
 TestApp::TestApp()
@@ -56,34 +216,159 @@ bool TestApp::prepare(Window *window)
 		return false;
 	}
 
+	create_camera();
+
 	virtual_texture_.raw_data_image = sg::Image::load("vulkan_logo", "/textures/vulkan_logo_full.ktx", sg::Image::ContentType::kColor);
 
 	assert(virtual_texture_.raw_data_image->get_format() == vk::Format::eR8G8B8A8Srgb);
 
+	if (virtual_texture_.raw_data_image->get_mipmaps().size() == 1)
+	{
+		virtual_texture_.raw_data_image->generate_mipmaps();
+	}
+
 	const auto extent       = virtual_texture_.raw_data_image->get_extent();
 	virtual_texture_.width  = extent.width;
 	virtual_texture_.height = extent.height;
 
-	auto &camera_node = sg::add_free_camera(*scene_, "default_camera", render_context_->get_surface_extent());
-	auto  camera      = &camera_node.get_component<sg::Camera>();
+	const auto features = device_->get_gpu().get_requested_features();
+	sparse_supported_   = features.sparseBinding && features.sparseResidencyImage2D && features.shaderResourceResidency && features.fragmentStoresAndAtomics;
+
+	if (sparse_supported_)
+	{
+		render_context_->create_sparse_bind_queue();
+		virtual_texture_.create_sparse_texture_image(*device_, *render_context_->get_sparse_queue(), kResidentBudget, kUploadsPerFrame);
+	}
+	else
+	{
+		LOGW("Sparse residency is not supported, the pages of the virtual texture are only tracked from simulated feedback");
+
+		// The mip tail starts at the first level smaller than a page
+		uint8_t mip_tail_first_lod = 0;
+		while ((extent.width >> mip_tail_first_lod) >= kSimulatedPageExtent.width && (extent.height >> mip_tail_first_lod) >= kSimulatedPageExtent.height)
+		{
+			++mip_tail_first_lod;
+		}
+		virtual_texture_.create_page_layout(kSimulatedPageExtent, mip_tail_first_lod, kResidentBudget, kUploadsPerFrame);
+
+		simulate_feedback_ = true;
+	}
+
+	gui_ = std::make_unique<Gui>(*this, *window, stats_.get());
 
-	render_context_->create_sparse_bind_queue();
+	auto sparse_image_pass = std::make_unique<SparseImagePass>(*device_, virtual_texture_, *camera_);
+	sparse_image_pass_     = sparse_image_pass.get();
+	graph_builder_->add_pass("Sparse Image", std::move(sparse_image_pass))
+	    .shader({"sparse/sparse_image.vert", "sparse/sparse_image.frag"})
+	    .gui(gui_.get())
+	    .present()
+	    .finalize();
+
+	graph_builder_->build();
 
 	return true;
 }
 
 void TestApp::update(float delta_time)
 {
+	if (virtual_texture_.residency)
+	{
+		const auto update = virtual_texture_.residency->update(gather_feedback());
+
+		if (sparse_supported_)
+		{
+			virtual_texture_.apply(update, *render_context_->get_sparse_queue(), render_context_->get_frames_in_flight());
+		}
+	}
+
+	sparse_image_pass_->set_color_highlight(color_highlight_);
+
 	XiheApp::update(delta_time);
 }
 
 void TestApp::request_gpu_features(backend::PhysicalDevice &gpu)
 {
 	XiheApp::request_gpu_features(gpu);
+
+	auto &requested_features                    = gpu.get_mutable_requested_features();
+	requested_features.sparseBinding            = gpu.get_features().sparseBinding;
+	requested_features.sparseResidencyImage2D   = gpu.get_features().sparseResidencyImage2D;
+	requested_features.shaderResourceResidency  = gpu.get_features().shaderResourceResidency;
+	requested_features.fragmentStoresAndAtomics = gpu.get_features().fragmentStoresAndAtomics;
 }
 
 void TestApp::draw_gui()
 {
-	XiheApp::draw_gui();
+	gui_->show_stats(*stats_);
+
+	const auto *residency = virtual_texture_.residency.get();
+	if (!residency)
+	{
+		return;
+	}
+
+	gui_->show_views_window(
+	    /* body = */ [this, residency]() {
+		    ImGui::Text("常驻页面 %zu / %zu (%.1f MB)", residency->get_resident_count(), residency->get_resident_budget(),
+		                static_cast<float>(virtual_texture_.get_resident_size()) / (1024.0f * 1024.0f));
+		    ImGui::Text("待加载页面 %zu", residency->get_pending_count());
+		    if (sparse_supported_)
+		    {
+			    ImGui::Checkbox("模拟反馈", &simulate_feedback_);
+			    ImGui::Checkbox("颜色标记", &color_highlight_);
+		    }
+	    },
+	    /* lines = */ 3);
+}
+
+void TestApp::create_camera()
+{
+	scene_ = std::make_unique<sg::Scene>("Sparse image");
+
+	auto root_node   = std::make_unique<sg::Node>(0, "root");
+	auto camera_node = std::make_unique<sg::Node>(1, "default_camera");
+
+	const auto extent = render_context_->get_surface_extent();
+
+	auto camera = std::make_unique<sg::PerspectiveCamera>("default_camera");
+	camera->set_aspect_ratio(static_cast<float>(extent.width) / static_cast<float>(extent.height));
+	camera->set_field_of_view(1.0f);
+	camera->set_near_plane(0.1f);
+	camera->set_far_plane(1000.0f);
+	camera->set_node(*camera_node);
+	camera_node->set_component(*camera);
+	camera_node->get_transform().set_translation(glm::vec3(0.0f, 0.0f, kQuadSize * 1.5f));
+
+	camera_ = camera.get();
+	scene_->add_component(std::move(camera));
+
+	scene_->set_root_node(*root_node);
+	camera_node->set_parent(*root_node);
+	root_node->add_child(*camera_node);
+	scene_->add_node(std::move(root_node));
+	scene_->add_node(std::move(camera_node));
+
+	sg::add_free_camera(*scene_, "default_camera", extent);
+}
+
+std::vector<PageIndex> TestApp::gather_feedback()
+{
+	// Read back by the pass whether it is used or not, so it does not pile up
+	auto feedback = std::exchange(virtual_texture_.feedback, {});
+
+	if (!simulate_feedback_)
+	{
+		return feedback;
+	}
+
+	const auto surface_extent = render_context_->get_surface_extent();
+
+	CalculateMipLevelData mip_data(rendering::vulkan_style_projection(camera_->get_projection()) * camera_->get_view() * get_quad_transform(),
+	                               vk::Extent2D{static_cast<uint32_t>(virtual_texture_.width), static_cast<uint32_t>(virtual_texture_.height)},
+	                               surface_extent, kFeedbackBlocks, kFeedbackBlocks, virtual_texture_.mip_levels);
+	mip_data.calculate_mesh_coordinates();
+	mip_data.calculate_mip_levels();
+
+	return simulate_feedback(mip_data, virtual_texture_);
 }
-}        // namespace xihe
\ No newline at end of file
+}        // namespace xihe
@@ -1,21 +1,36 @@
 #pragma once
 
+#include <unordered_map>
+
 #include "virtual_texture.h"
 #include "xihe_app.h"
 #include "rendering/passes/render_pass.h"
 
 namespace xihe
 {
-
+namespace sg
+{
+class Camera;
+}
+
+/**
+ * \brief Draws the virtual texture on a quad, each fragment falls back to the finest resident level and records the
+ *        page it wanted in a feedback buffer. The buffer of a render frame is read back into the feedback of the
+ *        virtual texture the next time the frame is used, once its GPU work completed.
+ */
 class SparseImagePass : public rendering::RenderPass
 {
   public:
-	SparseImagePass(backend::Device &device);
+	SparseImagePass(backend::Device &device, VirtualTexture &virtual_texture, sg::Camera &camera);
 
 	~SparseImagePass() override = default;
 
 	void execute(backend::CommandBuffer &command_buffer, rendering::RenderFrame &active_frame, std::vector<rendering::ShaderBindable> input_bindables) override;
 
+	void end_execute(backend::CommandBuffer &command_buffer, rendering::RenderFrame &active_frame) override;
+
+	void set_color_highlight(bool color_highlight);
+
   private:
 	struct SimpleVertex
 	{
@@ -23,14 +38,20 @@ class SparseImagePass : public rendering::RenderPass
 		glm::vec2 uv;
 	};
 
-	void create_sparse_texture_image(backend::Device &device);
+	backend::Buffer &request_feedback_buffer(backend::Device &device, rendering::RenderFrame &active_frame);
 
-	VirtualTexture virtual_texture_;
+	VirtualTexture &virtual_texture_;
+
+	sg::Camera &camera_;
+
+	bool color_highlight_{false};
 
 	std::unique_ptr<backend::Buffer> vertex_buffer_;
 	std::unique_ptr<backend::Buffer> index_buffer_;
 
 	uint32_t index_count_{};
+
+	std::unordered_map<const rendering::RenderFrame *, std::unique_ptr<backend::Buffer>> feedback_buffers_;
 };
 
 class TestApp : public XiheApp
@@ -49,6 +70,21 @@ class TestApp : public XiheApp
   private:
 	void draw_gui() override;
 
+	void create_camera();
+
+	std::vector<PageIndex> gather_feedback();
+
 	VirtualTexture virtual_texture_;
+
+	sg::Camera *camera_{nullptr};
+
+	SparseImagePass *sparse_image_pass_{nullptr};
+
+	// Without sparse residency the pages are only tracked, from simulated feedback
+	bool sparse_supported_{false};
+
+	bool simulate_feedback_{false};
+
+	bool color_highlight_{false};
 };
 }        // namespace xihe
@@ -0,0 +1,543 @@
+#include "texture_streamer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "backend/device.h"
+#include "common/logging.h"
+#include "common/trace.h"
+#include "gpu_scene.h"
+#include "rendering/render_context.h"
+#include "scene_graph/components/camera.h"
+#include "scene_graph/components/material.h"
+#include "scene_graph/components/mesh.h"
+#include "scene_graph/components/sub_mesh.h"
+#include "scene_graph/components/texture.h"
+#include "scene_graph/node.h"
+#include "scene_graph/scene.h"
+
+namespace xihe
+{
+namespace
+{
+/// Releases a bindless slot once the frames that sampled it retired, see RenderContext::release_deferred
+struct BindlessSlot
+{
+	BindlessSlot(backend::BindlessDescriptorSet &descriptor_set, uint32_t index) :
+	    descriptor_set{descriptor_set}, index{index}
+	{}
+
+	~BindlessSlot()
+	{
+		descriptor_set.release(index);
+	}
+
+	backend::BindlessDescriptorSet &descriptor_set;
+	uint32_t                        index;
+};
+}        // namespace
+
+TextureStreamer::TextureStreamer(backend::Device &device, rendering::RenderContext &render_context, sg::Scene &scene, const TextureStreamingConfig &config) :
+    device_{device}, render_context_{render_context}, config_{config}, scene_{scene}
+{
+	for (auto *image : scene_.get_components<sg::Image>())
+	{
+		if (image->get_resident_mip() == 0)
+		{
+			continue;
+		}
+
+		StreamedImage streamed{};
+		streamed.image      = image;
+		streamed.tail_mip   = image->get_resident_mip();
+		streamed.target_mip = streamed.tail_mip;
+		streamed.wanted_mip = streamed.tail_mip;
+
+		committed_size_ += get_size(streamed, streamed.tail_mip);
+
+		image_indices_[image] = images_.size();
+		images_.push_back(std::move(streamed));
+	}
+
+	if (scene_.has_component<sg::BindlessTextures>())
+	{
+		const auto textures = scene_.get_components<sg::BindlessTextures>()[0]->get_textures();
+		for (uint32_t i = 0; i < textures.size(); ++i)
+		{
+			auto it = image_indices_.find(textures[i]->get_image());
+			if (it != image_indices_.end())
+			{
+				images_[it->second].textures.emplace_back(i, textures[i]);
+			}
+		}
+	}
+
+	LOGI("Streaming {} images, {:.1f} MiB of mip tails", images_.size(), static_cast<double>(committed_size_) / (1024.0 * 1024.0));
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	for (auto &batch : batches_)
+	{
+		(void) device_.get_handle().waitForFences(batch.fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+		device_.get_handle().destroyFence(batch.fence);
+	}
+	for (auto fence : free_fences_)
+	{
+		device_.get_handle().destroyFence(fence);
+	}
+}
+
+void TextureStreamer::set_camera(sg::Camera *camera)
+{
+	camera_ = camera;
+}
+
+void TextureStreamer::set_gpu_scene(GpuScene *gpu_scene)
+{
+	gpu_scene_ = gpu_scene;
+}
+
+void TextureStreamer::update()
+{
+	XIHE_TRACE_ZONE("Texture streaming");
+
+	++frame_;
+
+	complete_uploads();
+
+	if (images_.empty())
+	{
+		return;
+	}
+
+	update_wanted_mips();
+
+	StreamRequests requests;
+
+	// The budget may have been lowered since the last frame
+	if (committed_size_ > config_.budget)
+	{
+		make_room(0, true, requests);
+	}
+
+	std::vector<size_t> promotions;
+	for (size_t i = 0; i < images_.size(); ++i)
+	{
+		if (!images_[i].pending && images_[i].wanted_mip < images_[i].target_mip)
+		{
+			promotions.push_back(i);
+		}
+	}
+
+	// The images furthest from the level they want go first
+	std::ranges::sort(promotions, [this](size_t lhs, size_t rhs) {
+		return images_[lhs].target_mip - images_[lhs].wanted_mip > images_[rhs].target_mip - images_[rhs].wanted_mip;
+	});
+
+	vk::DeviceSize upload_size = 0;
+	for (auto index : promotions)
+	{
+		auto &streamed = images_[index];
+
+		const auto size = get_size(streamed, streamed.wanted_mip);
+		if (upload_size > 0 && upload_size + size > config_.upload_bytes_per_frame)
+		{
+			break;
+		}
+
+		const auto growth = size - get_size(streamed, streamed.target_mip);
+		if (committed_size_ + growth > config_.budget && !make_room(growth, false, requests))
+		{
+			continue;
+		}
+
+		request(index, streamed.wanted_mip, requests);
+		upload_size += size;
+	}
+
+	start_uploads(requests);
+}
+
+vk::DeviceSize TextureStreamer::release(backend::MemoryPressure pressure, vk::DeviceSize bytes)
+{
+	if (pressure == backend::MemoryPressure::kNone)
+	{
+		return 0;
+	}
+
+	std::vector<size_t> candidates;
+	for (size_t i = 0; i < images_.size(); ++i)
+	{
+		if (!images_[i].pending && images_[i].target_mip < images_[i].tail_mip)
+		{
+			candidates.push_back(i);
+		}
+	}
+	std::ranges::sort(candidates, {}, [this](size_t index) { return images_[index].last_used_frame; });
+
+	StreamRequests requests;
+
+	vk::DeviceSize released = 0;
+	for (auto index : candidates)
+	{
+		if (released >= bytes)
+		{
+			break;
+		}
+
+		const auto &streamed = images_[index];
+		const auto  mip      = pressure == backend::MemoryPressure::kEvict ? streamed.tail_mip : streamed.target_mip + 1;
+
+		released += get_size(streamed, streamed.target_mip) - get_size(streamed, mip);
+		request(index, mip, requests);
+	}
+
+	start_uploads(requests);
+
+	// Otherwise the next update would stream the released levels right back in
+	config_.budget = std::min(config_.budget, committed_size_);
+
+	LOGW("Texture streaming released {:.1f} MiB, budget lowered to {:.1f} MiB", static_cast<double>(released) / (1024.0 * 1024.0),
+	     static_cast<double>(config_.budget) / (1024.0 * 1024.0));
+
+	return released;
+}
+
+void TextureStreamer::set_budget(vk::DeviceSize budget)
+{
+	config_.budget = budget;
+}
+
+vk::DeviceSize TextureStreamer::get_budget() const
+{
+	return config_.budget;
+}
+
+vk::DeviceSize TextureStreamer::get_committed_size() const
+{
+	return committed_size_;
+}
+
+size_t TextureStreamer::get_streamed_image_count() const
+{
+	return images_.size();
+}
+
+size_t TextureStreamer::get_pending_count() const
+{
+	size_t count = 0;
+	for (const auto &batch : batches_)
+	{
+		count += batch.images.size();
+	}
+	return count;
+}
+
+void TextureStreamer::complete_uploads()
+{
+	auto &bindless_descriptor_set = device_.get_resource_cache().request_bindless_descriptor_set();
+
+	// Frames in flight sample the current slots of the textures, so the new views are written to other slots and the
+	// materials are pointed to them
+	std::unordered_map<uint32_t, uint32_t> remapped_indices;
+
+	// Batches are submitted to the same queue, so they complete in order
+	while (!batches_.empty() && device_.get_handle().getFenceStatus(batches_.front().fence) == vk::Result::eSuccess)
+	{
+		auto &batch = batches_.front();
+
+		size_t slot_count = 0;
+		for (const auto &pending : batch.images)
+		{
+			slot_count += images_[pending.index].textures.size();
+		}
+
+		// The slots of the replaced views come back as the frames in flight retire
+		if (slot_count > bindless_descriptor_set.get_available_count())
+		{
+			break;
+		}
+
+		for (auto &pending : batch.images)
+		{
+			auto &streamed = images_[pending.index];
+
+			auto replaced = streamed.image->swap_vk_image(std::move(pending.gpu_image), pending.resident_mip);
+
+			// Frames in flight may still sample the replaced image
+			render_context_.release_deferred(std::move(replaced.image_view));
+			render_context_.release_deferred(std::move(replaced.image));
+
+			for (auto &[index, texture] : streamed.textures)
+			{
+				const auto slot = bindless_descriptor_set.allocate(texture->get_descriptor_image_info());
+				render_context_.release_deferred(std::make_unique<BindlessSlot>(bindless_descriptor_set, index));
+
+				remapped_indices[index] = slot;
+				index                   = slot;
+			}
+
+			streamed.pending = false;
+		}
+
+		batch.command_pool->reset_pool();
+		device_.get_handle().resetFences(batch.fence);
+
+		free_command_pools_.push_back(std::move(batch.command_pool));
+		free_fences_.push_back(batch.fence);
+
+		batches_.pop_front();
+	}
+
+	if (remapped_indices.empty())
+	{
+		return;
+	}
+
+	// Read into the per draw uniforms each frame
+	for (auto *material : scene_.get_components<sg::PbrMaterial>())
+	{
+		for (glm::length_t i = 0; i < material->texture_indices.length(); ++i)
+		{
+			auto it = remapped_indices.find(material->texture_indices[i]);
+			if (it != remapped_indices.end())
+			{
+				material->texture_indices[i] = it->second;
+			}
+		}
+	}
+
+	if (gpu_scene_)
+	{
+		render_context_.release_deferred(gpu_scene_->remap_texture_indices(remapped_indices));
+	}
+}
+
+void TextureStreamer::update_wanted_mips()
+{
+	for (auto &streamed : images_)
+	{
+		streamed.wanted_mip = streamed.tail_mip;
+	}
+
+	if (!camera_)
+	{
+		return;
+	}
+
+	const auto view       = camera_->get_view();
+	const auto projection = camera_->get_projection();
+	const auto height     = static_cast<float>(render_context_.get_surface_extent().height);
+
+	std::vector<size_t> mesh_images;
+
+	for (auto *mesh : scene_.get_components<sg::Mesh>())
+	{
+		mesh_images.clear();
+
+		const auto add_material = [&](const sg::Material *material) {
+			if (!material)
+			{
+				return;
+			}
+			for (const auto &[name, texture] : material->textures)
+			{
+				auto it = image_indices_.find(texture->get_image());
+				if (it != image_indices_.end())
+				{
+					mesh_images.push_back(it->second);
+				}
+			}
+		};
+
+		for (const auto *submesh : mesh->get_submeshes())
+		{
+			add_material(submesh->get_material());
+		}
+		for (const auto &submesh_data : mesh->get_submeshes_data())
+		{
+			add_material(submesh_data.material);
+		}
+
+		if (mesh_images.empty())
+		{
+			continue;
+		}
+
+		for (auto *node : mesh->get_nodes())
+		{
+			auto world_matrix = node->get_transform().get_world_matrix();
+
+			sg::AABB bounds{mesh->get_bounds().get_min(), mesh->get_bounds().get_max()};
+			bounds.transform(world_matrix);
+
+			const auto radius   = 0.5f * glm::length(bounds.get_max() - bounds.get_min());
+			const auto distance = -(view * glm::vec4(bounds.get_center(), 1.0f)).z;
+
+			// Behind the camera
+			if (distance + radius <= 0.0f)
+			{
+				continue;
+			}
+
+			// Screen height of the bounding sphere in pixels
+			const auto pixels = radius * projection[1][1] * height / std::max(distance, 1e-3f);
+
+			for (auto index : mesh_images)
+			{
+				auto &streamed = images_[index];
+
+				const auto &extent    = streamed.image->get_extent();
+				const auto  texels    = static_cast<float>(std::max(extent.width, extent.height));
+				const auto  mip_level = std::floor(std::log2(texels / std::max(pixels, 1.0f)) + config_.mip_bias);
+
+				const auto mip      = static_cast<uint32_t>(std::clamp(mip_level, 0.0f, static_cast<float>(streamed.tail_mip)));
+				streamed.wanted_mip = std::min(streamed.wanted_mip, mip);
+
+				streamed.last_used_frame = frame_;
+			}
+		}
+	}
+}
+
+bool TextureStreamer::make_room(vk::DeviceSize bytes, bool partial, StreamRequests &requests)
+{
+	std::vector<size_t> candidates;
+	for (size_t i = 0; i < images_.size(); ++i)
+	{
+		if (!images_[i].pending && images_[i].target_mip < images_[i].wanted_mip)
+		{
+			candidates.push_back(i);
+		}
+	}
+	std::ranges::sort(candidates, {}, [this](size_t index) { return images_[index].last_used_frame; });
+
+	vk::DeviceSize released = 0;
+	size_t         count    = 0;
+	while (count < candidates.size() && committed_size_ + bytes > config_.budget + released)
+	{
+		const auto &streamed = images_[candidates[count++]];
+		released += get_size(streamed, streamed.target_mip) - get_size(streamed, streamed.wanted_mip);
+	}
+
+	const bool fits = committed_size_ + bytes <= config_.budget + released;
+	if (!fits && !partial)
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		request(candidates[i], images_[candidates[i]].wanted_mip, requests);
+	}
+
+	return fits;
+}
+
+void TextureStreamer::request(size_t index, uint32_t mip, StreamRequests &requests)
+{
+	auto &streamed = images_[index];
+
+	committed_size_ = committed_size_ + get_size(streamed, mip) - get_size(streamed, streamed.target_mip);
+
+	streamed.target_mip = mip;
+	streamed.pending    = true;
+
+	requests.emplace_back(index, mip);
+}
+
+void TextureStreamer::start_uploads(const StreamRequests &requests)
+{
+	if (requests.empty())
+	{
+		return;
+	}
+
+	XIHE_TRACE_ZONE("Start texture uploads");
+
+	const auto &queue = device_.get_queue_by_flags(vk::QueueFlagBits::eGraphics, 0);
+
+	UploadBatch batch;
+	if (!free_command_pools_.empty())
+	{
+		batch.command_pool = std::move(free_command_pools_.back());
+		free_command_pools_.pop_back();
+	}
+	else
+	{
+		batch.command_pool = std::make_unique<backend::CommandPool>(device_, queue.get_family_index());
+	}
+
+	if (!free_fences_.empty())
+	{
+		batch.fence = free_fences_.back();
+		free_fences_.pop_back();
+	}
+	else
+	{
+		batch.fence = device_.get_handle().createFence({});
+	}
+
+	auto &command_buffer = batch.command_pool->request_command_buffer();
+	command_buffer.begin(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+
+	for (const auto &[index, mip] : requests)
+	{
+		auto &image   = *images_[index].image;
+		auto &mipmaps = image.get_mipmaps();
+
+		auto gpu_image = image.build_vk_image(device_, mip);
+		auto &view     = *gpu_image.image_view;
+
+		batch.staging_buffers.push_back(backend::Buffer::create_staging_buffer(device_, image.get_data_size(mip), image.get_data().data() + mipmaps[mip].offset));
+
+		{
+			common::ImageMemoryBarrier memory_barrier{};
+			memory_barrier.old_layout      = vk::ImageLayout::eUndefined;
+			memory_barrier.new_layout      = vk::ImageLayout::eTransferDstOptimal;
+			memory_barrier.dst_access_mask = vk::AccessFlagBits2::eTransferWrite;
+			memory_barrier.src_stage_mask  = vk::PipelineStageFlagBits2::eHost;
+			memory_barrier.dst_stage_mask  = vk::PipelineStageFlagBits2::eTransfer;
+			command_buffer.image_memory_barrier(view, memory_barrier);
+		}
+
+		std::vector<vk::BufferImageCopy> buffer_copy_regions(mipmaps.size() - mip);
+		for (size_t level = mip; level < mipmaps.size(); ++level)
+		{
+			auto &copy_region                     = buffer_copy_regions[level - mip];
+			copy_region.bufferOffset              = mipmaps[level].offset - mipmaps[mip].offset;
+			copy_region.imageSubresource          = view.get_subresource_layers();
+			copy_region.imageSubresource.mipLevel = mipmaps[level].level - mip;
+			copy_region.imageExtent               = mipmaps[level].extent;
+		}
+
+		command_buffer.copy_buffer_to_image(batch.staging_buffers.back(), *gpu_image.image, buffer_copy_regions);
+
+		{
+			common::ImageMemoryBarrier memory_barrier{};
+			memory_barrier.old_layout      = vk::ImageLayout::eTransferDstOptimal;
+			memory_barrier.new_layout      = vk::ImageLayout::eShaderReadOnlyOptimal;
+			memory_barrier.src_access_mask = vk::AccessFlagBits2::eTransferWrite;
+			memory_barrier.dst_access_mask = vk::AccessFlagBits2::eShaderRead;
+			memory_barrier.src_stage_mask  = vk::PipelineStageFlagBits2::eTransfer;
+			memory_barrier.dst_stage_mask  = vk::PipelineStageFlagBits2::eFragmentShader;
+			command_buffer.image_memory_barrier(view, memory_barrier);
+		}
+
+		batch.images.push_back({index, mip, std::move(gpu_image)});
+	}
+
+	command_buffer.end();
+
+	queue.submit(command_buffer, batch.fence);
+
+	batches_.push_back(std::move(batch));
+}
+
+vk::DeviceSize TextureStreamer::get_size(const StreamedImage &streamed, uint32_t mip) const
+{
+	return streamed.image->get_data_size(mip);
+}
+}        // namespace xihe
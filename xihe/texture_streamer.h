@@ -0,0 +1,171 @@
+#pragma once
+
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+#include "backend/buffer.h"
+#include "backend/command_pool.h"
+#include "backend/memory_budget_policy.h"
+#include "scene_graph/components/image.h"
+
+namespace xihe
+{
+namespace rendering
+{
+class RenderContext;
+}
+
+class GpuScene;
+
+namespace sg
+{
+class Camera;
+class Scene;
+class Texture;
+}        // namespace sg
+
+struct TextureStreamingConfig
+{
+	/// Device memory of the streamed images together, their mip tails included
+	vk::DeviceSize budget{512ull * 1024 * 1024};
+
+	/// Levels that fit within this extent are uploaded with the scene and never streamed out
+	uint32_t mip_tail_extent{128};
+
+	/// Data uploaded per frame, the promotions beyond it wait for the next frames
+	vk::DeviceSize upload_bytes_per_frame{16ull * 1024 * 1024};
+
+	/// Added to the level the texel density asks for, negative values stream finer levels in earlier
+	float mip_bias{0.0f};
+};
+
+/**
+ * \brief Streams the levels of the scene images in front of their mip tail in and out. Images are loaded with their
+ *        mip tail only, see GltfLoader::set_streamed_mip_tail_extent, and keep their data on the CPU.
+ *
+ *        Each frame the level an image needs is estimated from the screen size of the bounds of the meshes sampling
+ *        it, assuming the texture is mapped once across them. A promoted image is uploaded into a new Vulkan image
+ *        without waiting, it is swapped in once the upload completed. Its new view is written to a free bindless slot
+ *        and the materials are pointed to it, the previous slot is released once the frames in flight sampling it
+ *        retired. When a promotion does not fit in the budget, the least recently used images are demoted to make room.
+ */
+class TextureStreamer
+{
+  public:
+	TextureStreamer(backend::Device &device, rendering::RenderContext &render_context, sg::Scene &scene, const TextureStreamingConfig &config = {});
+
+	~TextureStreamer();
+
+	TextureStreamer(const TextureStreamer &)            = delete;
+	TextureStreamer &operator=(const TextureStreamer &) = delete;
+
+	/// The texel density is measured from the camera, without one images are only demoted
+	void set_camera(sg::Camera *camera);
+
+	/// The mesh draws of the scene sample the streamed textures through their bindless slots too
+	void set_gpu_scene(GpuScene *gpu_scene);
+
+	/// Swaps the images whose upload completed in and starts the uploads of the next levels, once per frame before rendering
+	void update();
+
+	/**
+	 * \brief Demotes the least recently used images and lowers the budget to what remains, for the memory budget policy
+	 * \return The bytes released once the frames in flight retire
+	 */
+	vk::DeviceSize release(backend::MemoryPressure pressure, vk::DeviceSize bytes);
+
+	void set_budget(vk::DeviceSize budget);
+
+	vk::DeviceSize get_budget() const;
+
+	/// Memory of the levels resident or being streamed in
+	vk::DeviceSize get_committed_size() const;
+
+	size_t get_streamed_image_count() const;
+
+	size_t get_pending_count() const;
+
+  private:
+	struct StreamedImage
+	{
+		sg::Image *image{nullptr};
+
+		// Textures sampling the image, with their current slot in the bindless descriptor set
+		std::vector<std::pair<uint32_t, sg::Texture *>> textures;
+
+		uint32_t tail_mip{0};
+
+		// First level of the Vulkan image once the upload in flight completed
+		uint32_t target_mip{0};
+
+		// Estimated by the last update
+		uint32_t wanted_mip{0};
+
+		uint64_t last_used_frame{0};
+
+		bool pending{false};
+	};
+
+	struct PendingImage
+	{
+		size_t              index{0};
+		uint32_t            resident_mip{0};
+		sg::Image::GpuImage gpu_image;
+	};
+
+	struct UploadBatch
+	{
+		std::unique_ptr<backend::CommandPool> command_pool;
+		vk::Fence                             fence;
+		std::vector<backend::Buffer>          staging_buffers;
+		std::vector<PendingImage>             images;
+	};
+
+	/// First level each image is to start at
+	using StreamRequests = std::vector<std::pair<size_t, uint32_t>>;
+
+	void complete_uploads();
+
+	void update_wanted_mips();
+
+	/**
+	 * \brief Demotes the least recently used images holding finer levels than they want, until the committed size
+	 *        plus the bytes fits in the budget
+	 * \param partial Demotes what it can even when the room cannot be made, otherwise no image is demoted then
+	 */
+	bool make_room(vk::DeviceSize bytes, bool partial, StreamRequests &requests);
+
+	void request(size_t index, uint32_t mip, StreamRequests &requests);
+
+	void start_uploads(const StreamRequests &requests);
+
+	vk::DeviceSize get_size(const StreamedImage &streamed, uint32_t mip) const;
+
+	backend::Device &device_;
+
+	rendering::RenderContext &render_context_;
+
+	TextureStreamingConfig config_;
+
+	sg::Camera *camera_{nullptr};
+
+	GpuScene *gpu_scene_{nullptr};
+
+	std::vector<StreamedImage> images_;
+
+	std::unordered_map<const sg::Image *, size_t> image_indices_;
+
+	vk::DeviceSize committed_size_{0};
+
+	uint64_t frame_{0};
+
+	std::deque<UploadBatch> batches_;
+
+	// Of completed batches, reused by the next ones
+	std::vector<std::unique_ptr<backend::CommandPool>> free_command_pools_;
+	std::vector<vk::Fence>                             free_fences_;
+
+	sg::Scene &scene_;
+};
+}        // namespace xihe
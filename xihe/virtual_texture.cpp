@@ -1,7 +1,168 @@
 #include "virtual_texture.h"
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <optional>
+#include <unordered_map>
+
+#include "backend/buffer.h"
+#include "backend/device.h"
+#include "backend/image_view.h"
+#include "backend/queue.h"
+#include "common/trace.h"
+
 namespace xihe
 {
+namespace
+{
+// Sparse pages are allocated from device memory blocks of this many pages
+constexpr uint32_t kPagesPerAllocation = 16;
+
+size_t get_full_mip_count(size_t width, size_t height)
+{
+	size_t count = 1;
+	for (auto size = std::max(width, height); size > 1; size /= 2)
+	{
+		++count;
+	}
+	return count;
+}
+
+uint32_t find_memory_type(const backend::Device &device, uint32_t type_bits, vk::MemoryPropertyFlags properties)
+{
+	const auto memory_properties = device.get_gpu().get_handle().getMemoryProperties();
+	for (uint32_t i = 0; i < memory_properties.memoryTypeCount; ++i)
+	{
+		if ((type_bits & (1u << i)) && (memory_properties.memoryTypes[i].propertyFlags & properties) == properties)
+		{
+			return i;
+		}
+	}
+	throw std::runtime_error{"No memory type for the sparse texture pages"};
+}
+
+bool is_behind_camera(const Point &point)
+{
+	return std::isnan(point.x);
+}
+}        // namespace
+
+PageResidency::PageResidency(std::vector<uint8_t> page_mip_levels, size_t resident_budget, size_t uploads_per_frame) :
+    page_mip_levels_{std::move(page_mip_levels)},
+    resident_budget_{resident_budget},
+    uploads_per_frame_{uploads_per_frame},
+    last_requested_(page_mip_levels_.size(), 0),
+    lru_positions_(page_mip_levels_.size()),
+    resident_(page_mip_levels_.size(), false)
+{}
+
+ResidencyUpdate PageResidency::update(const std::vector<PageIndex> &requests)
+{
+	++frame_;
+
+	std::unordered_map<PageIndex, uint32_t> missing_pages;
+	for (auto page : requests)
+	{
+		assert(page < resident_.size());
+
+		if (resident_[page])
+		{
+			lru_.splice(lru_.begin(), lru_, lru_positions_[page]);
+		}
+		else
+		{
+			++missing_pages[page];
+		}
+		last_requested_[page] = frame_;
+	}
+
+	// Coarse pages first, they cover the most screen until the finer ones arrive
+	std::vector<std::pair<PageIndex, uint32_t>> candidates(missing_pages.begin(), missing_pages.end());
+	std::sort(candidates.begin(), candidates.end(), [this](const auto &left, const auto &right) {
+		if (page_mip_levels_[left.first] != page_mip_levels_[right.first])
+		{
+			return page_mip_levels_[left.first] > page_mip_levels_[right.first];
+		}
+		if (left.second != right.second)
+		{
+			return left.second > right.second;
+		}
+		return left.first < right.first;
+	});
+
+	ResidencyUpdate update;
+
+	auto evict_least_recent = [this, &update]() {
+		if (lru_.empty() || last_requested_[lru_.back()] == frame_)
+		{
+			return false;
+		}
+		resident_[lru_.back()] = false;
+		update.evictions.push_back(lru_.back());
+		lru_.pop_back();
+		return true;
+	};
+
+	// The budget may have been lowered since the last update
+	while (lru_.size() > resident_budget_ && evict_least_recent())
+	{
+	}
+
+	for (const auto &[page, request_count] : candidates)
+	{
+		if (update.loads.size() >= uploads_per_frame_)
+		{
+			break;
+		}
+		if (lru_.size() >= resident_budget_ && !evict_least_recent())
+		{
+			// Everything resident is visible, the rest waits until the view changes
+			break;
+		}
+
+		lru_.push_front(page);
+		lru_positions_[page] = lru_.begin();
+		resident_[page]      = true;
+		update.loads.push_back(page);
+	}
+
+	pending_count_ = candidates.size() - update.loads.size();
+
+	return update;
+}
+
+void PageResidency::set_resident_budget(size_t resident_budget)
+{
+	resident_budget_ = resident_budget;
+}
+
+void PageResidency::set_uploads_per_frame(size_t uploads_per_frame)
+{
+	uploads_per_frame_ = uploads_per_frame;
+}
+
+bool PageResidency::is_resident(PageIndex page) const
+{
+	return resident_[page];
+}
+
+size_t PageResidency::get_resident_count() const
+{
+	return lru_.size();
+}
+
+size_t PageResidency::get_resident_budget() const
+{
+	return resident_budget_;
+}
+
+size_t PageResidency::get_pending_count() const
+{
+	return pending_count_;
+}
+
 bool TextureBlock::operator<(TextureBlock const &other) const
 {
 	if (new_mip_level == other.new_mip_level)
@@ -15,110 +176,414 @@ bool TextureBlock::operator<(TextureBlock const &other) const
 	return new_mip_level < other.new_mip_level;
 }
 
-void MemAllocInfo::get_allocation(PageInfo &page_memory_info, size_t page_index)
+void VirtualTexture::create_page_layout(vk::Extent3D extent, uint8_t mip_tail_first_lod, size_t resident_budget, size_t uploads_per_frame)
 {
-	// Check if we need to create a new memory sector:
-	// - First allocation: no memory sectors yet
-	// - Invalid sector: previous sector was released
-	// - Full sector: no available space in current sector
-	if (memory_sectors.empty() || memory_sectors.front().expired() || memory_sectors.front().lock()->available_offsets.empty())
+	page_extent = extent;
+	mip_levels  = static_cast<uint8_t>(get_full_mip_count(width, height));
+
+	mip_properties.clear();
+
+	size_t               page_count = 0;
+	std::vector<uint8_t> page_mip_levels;
+	for (uint8_t mip = 0; mip < std::min(mip_tail_first_lod, mip_levels); ++mip)
 	{
-		// Create new memory sector and allocate from it
-		page_memory_info.memory_sector = std::make_shared<MemSector>(*this);
-		page_memory_info.offset        = *(page_memory_info.memory_sector->available_offsets.begin());
+		MipProperties properties{};
+		properties.width               = std::max<size_t>(1, width >> mip);
+		properties.height              = std::max<size_t>(1, height >> mip);
+		properties.num_columns         = (properties.width + page_extent.width - 1) / page_extent.width;
+		properties.num_rows            = (properties.height + page_extent.height - 1) / page_extent.height;
+		properties.mip_num_pages       = properties.num_columns * properties.num_rows;
+		properties.mip_base_page_index = page_count;
 
-		page_memory_info.memory_sector->available_offsets.erase(page_memory_info.offset);
-		page_memory_info.memory_sector->virtual_page_indices.insert(page_index);
+		page_count += properties.mip_num_pages;
+		page_mip_levels.insert(page_mip_levels.end(), properties.mip_num_pages, mip);
 
-		memory_sectors.push_front(page_memory_info.memory_sector);
+		mip_properties.push_back(properties);
 	}
-	else
+
+	page_tables.clear();
+	page_tables.resize(page_count);
+	pending_unbinds.clear();
+	residency_update_count = 0;
+
+	residency = std::make_unique<PageResidency>(std::move(page_mip_levels), resident_budget, uploads_per_frame);
+}
+
+void VirtualTexture::create_sparse_texture_image(backend::Device &device, const backend::Queue &sparse_queue, size_t resident_budget, size_t uploads_per_frame)
+{
+	assert(raw_data_image && raw_data_image->get_mipmaps().size() == get_full_mip_count(width, height) && "The raw data needs its full mip chain");
+
+	this->device = &device;
+
+	base_mip_level = 0U;
+	mip_levels     = static_cast<uint8_t>(get_full_mip_count(width, height));
+
 	{
-		// Reuse existing memory sector
-		const auto ptr = memory_sectors.front().lock();
+		backend::ImageBuilder image_builder(width, height);
+
+		image_builder.with_usage(vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eSampled);
+		image_builder.with_flags(vk::ImageCreateFlagBits::eSparseBinding | vk::ImageCreateFlagBits::eSparseResidency);
+		image_builder.with_format(raw_data_image->get_format());
 
-		page_memory_info.memory_sector = ptr;
-		page_memory_info.offset        = *(page_memory_info.memory_sector->available_offsets.begin());
+		image_builder.with_mip_levels(mip_levels);
+		image_builder.with_sample_count(vk::SampleCountFlagBits::e1);
+		image_builder.with_tiling(vk::ImageTiling::eOptimal);
+		image_builder.with_sharing_mode(vk::SharingMode::eExclusive);
+		image_builder.with_memory_category(backend::allocated::MemoryCategory::kTexture);
 
-		page_memory_info.memory_sector->available_offsets.erase(page_memory_info.offset);
-		page_memory_info.memory_sector->virtual_page_indices.insert(page_index);
+		texture_image = image_builder.build_unique(device);
 	}
+
+	auto sparse_image_memory_requirements = device.get_handle().getImageSparseMemoryRequirements(texture_image->get_handle());
+
+	auto color_requirements = std::find_if(sparse_image_memory_requirements.begin(), sparse_image_memory_requirements.end(), [](const auto &requirements) {
+		return static_cast<bool>(requirements.formatProperties.aspectMask & vk::ImageAspectFlagBits::eColor);
+	});
+	if (color_requirements == sparse_image_memory_requirements.end())
+	{
+		throw std::runtime_error{"Sparse texture has no memory requirements for its color aspect"};
+	}
+	format_properties = color_requirements->formatProperties;
+
+	auto memory_requirements = device.get_handle().getImageMemoryRequirements(texture_image->get_handle());
+
+	const auto memory_type_index = find_memory_type(device, memory_requirements.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal);
+	page_pool                    = std::make_unique<backend::SparsePagePool>(device, memory_requirements.alignment, memory_type_index, kPagesPerAllocation);
+
+	const auto mip_tail_first_lod = static_cast<uint8_t>(std::min<uint32_t>(color_requirements->imageMipTailFirstLod, mip_levels));
+	create_page_layout(format_properties.imageGranularity, mip_tail_first_lod, resident_budget, uploads_per_frame);
+
+	texture_image_view = std::make_unique<backend::ImageView>(*texture_image, vk::ImageViewType::e2D);
+
+	vk::SamplerCreateInfo sampler_info{};
+	sampler_info.magFilter    = vk::Filter::eLinear;
+	sampler_info.minFilter    = vk::Filter::eLinear;
+	sampler_info.mipmapMode   = vk::SamplerMipmapMode::eLinear;
+	sampler_info.addressModeU = vk::SamplerAddressMode::eClampToEdge;
+	sampler_info.addressModeV = vk::SamplerAddressMode::eClampToEdge;
+	sampler_info.addressModeW = vk::SamplerAddressMode::eClampToEdge;
+	sampler_info.maxLod       = static_cast<float>(mip_levels);
+	sampler_info.borderColor  = vk::BorderColor::eFloatOpaqueWhite;
+	sampler                   = std::make_unique<backend::Sampler>(device, sampler_info);
+
+	// The mip tail is bound once for the lifetime of the texture, so a resident level can always be sampled
+	if (mip_tail_first_lod < mip_levels)
+	{
+		vk::MemoryAllocateInfo memory_allocate_info{color_requirements->imageMipTailSize, memory_type_index};
+		mip_tail_memory = device.get_handle().allocateMemory(memory_allocate_info);
+
+		vk::SparseMemoryBind              mip_tail_bind{color_requirements->imageMipTailOffset, color_requirements->imageMipTailSize, mip_tail_memory, 0};
+		vk::SparseImageOpaqueMemoryBindInfo opaque_bind_info{texture_image->get_handle(), mip_tail_bind};
+
+		vk::BindSparseInfo bind_sparse_info{};
+		bind_sparse_info.setImageOpaqueBinds(opaque_bind_info);
+
+		sparse_queue.get_handle().bindSparse(bind_sparse_info, device.request_fence());
+		device.get_fence_pool().wait();
+		device.get_fence_pool().reset();
+	}
+
+	upload_mip_tail();
 }
 
-uint32_t MemAllocInfo::get_size() const
+bool VirtualTexture::is_created() const
 {
-	return static_cast<uint32_t>(memory_sectors.size());
+	return texture_image != nullptr;
 }
 
-std::list<std::weak_ptr<MemSector>> &MemAllocInfo::get_memory_sectors()
+size_t VirtualTexture::get_page_count() const
 {
-	return memory_sectors;
+	return page_tables.size();
 }
 
-MemSector::MemSector(MemAllocInfo &mem_alloc_info) :
-    MemAllocInfo(mem_alloc_info)
+vk::DeviceSize VirtualTexture::get_resident_size() const
 {
-	vk::MemoryAllocateInfo memory_allocate_info;
-	memory_allocate_info.allocationSize  = page_size * pages_per_allocation;
-	memory_allocate_info.memoryTypeIndex = memory_type_index;
+	if (!residency)
+	{
+		return 0;
+	}
 
-	memory = device.allocateMemory(memory_allocate_info, nullptr);
+	// Without the sparse image a page is as large as its texels
+	const vk::DeviceSize page_size = page_pool ? page_pool->get_page_size() : vk::DeviceSize{page_extent.width} * page_extent.height * 4;
+	return residency->get_resident_count() * page_size;
+}
+
+PageIndex VirtualTexture::get_page_index(uint8_t mip_level, double u, double v) const
+{
+	assert(mip_level < mip_properties.size());
+
+	const auto &mip    = mip_properties[mip_level];
+	const auto  column = std::min(mip.num_columns - 1, static_cast<size_t>(std::max(u, 0.0) * mip.width / page_extent.width));
+	const auto  row    = std::min(mip.num_rows - 1, static_cast<size_t>(std::max(v, 0.0) * mip.height / page_extent.height));
+
+	return mip.mip_base_page_index + row * mip.num_columns + column;
+}
+
+void VirtualTexture::apply(const ResidencyUpdate &update, const backend::Queue &sparse_queue, uint32_t frames_in_flight)
+{
+	XIHE_TRACE_ZONE("Apply virtual texture residency");
+
+	auto [binds, unbinds] = schedule_bindings(update, frames_in_flight);
+
+	if (!texture_image)
+	{
+		// Only the residency is simulated
+		for (auto page : binds)
+		{
+			page_tables[page].valid = true;
+		}
+		for (auto page : unbinds)
+		{
+			page_tables[page].valid = false;
+		}
+		return;
+	}
 
-	for (size_t i = 0; i < pages_per_allocation; ++i)
+	if (!binds.empty() || !unbinds.empty())
 	{
-		available_offsets.insert(static_cast<uint32_t>(i * page_size));
+		bind_pages(sparse_queue, binds, unbinds);
 	}
+
+	if (!binds.empty())
+	{
+		upload_pages(binds);
+	}
+}
+
+PageBindings VirtualTexture::schedule_bindings(const ResidencyUpdate &update, uint32_t frames_in_flight)
+{
+	++residency_update_count;
+
+	PageBindings bindings;
+	for (auto page : update.loads)
+	{
+		if (page_tables[page].evicting)
+		{
+			page_tables[page].evicting = false;
+		}
+		else
+		{
+			bindings.binds.push_back(page);
+		}
+	}
+
+	for (auto page : update.evictions)
+	{
+		page_tables[page].evicting        = true;
+		page_tables[page].eviction_update = residency_update_count;
+	}
+	pending_unbinds.emplace_back(residency_update_count, update.evictions);
+
+	while (pending_unbinds.size() > frames_in_flight)
+	{
+		const auto &[eviction_update, pages] = pending_unbinds.front();
+		for (auto page : pages)
+		{
+			// Evicted again since, the later eviction unbinds it
+			if (page_tables[page].evicting && page_tables[page].eviction_update == eviction_update)
+			{
+				page_tables[page].evicting = false;
+				bindings.unbinds.push_back(page);
+			}
+		}
+		pending_unbinds.pop_front();
+	}
+
+	return bindings;
 }
 
-MemSector::~MemSector()
+vk::SparseImageMemoryBind VirtualTexture::get_page_bind(PageIndex page) const
 {
-	device.waitIdle();
-	device.freeMemory(memory, nullptr);
+	auto mip_it = std::find_if(mip_properties.begin(), mip_properties.end(), [page](const MipProperties &mip) {
+		return page < mip.mip_base_page_index + mip.mip_num_pages;
+	});
+	assert(mip_it != mip_properties.end() && "Page is in the mip tail");
+
+	const auto local_index = page - mip_it->mip_base_page_index;
+	const auto column      = static_cast<uint32_t>(local_index % mip_it->num_columns);
+	const auto row         = static_cast<uint32_t>(local_index / mip_it->num_columns);
+
+	vk::SparseImageMemoryBind bind{};
+	bind.subresource = vk::ImageSubresource{vk::ImageAspectFlagBits::eColor, static_cast<uint32_t>(mip_it - mip_properties.begin()), 0};
+	bind.offset      = vk::Offset3D{static_cast<int32_t>(column * page_extent.width), static_cast<int32_t>(row * page_extent.height), 0};
+	bind.extent      = vk::Extent3D{std::min(page_extent.width, static_cast<uint32_t>(mip_it->width) - column * page_extent.width),
+                               std::min(page_extent.height, static_cast<uint32_t>(mip_it->height) - row * page_extent.height),
+                               1};
+	return bind;
 }
 
-bool MemSectorCompare::operator()(const std::weak_ptr<MemSector> &left, const std::weak_ptr<MemSector> &right)
+void VirtualTexture::bind_pages(const backend::Queue &sparse_queue, const std::vector<PageIndex> &binds, const std::vector<PageIndex> &unbinds)
 {
-	if (left.expired())
+	XIHE_TRACE_ZONE("Bind virtual texture pages");
+
+	sparse_image_memory_binds.clear();
+	sparse_image_memory_binds.reserve(binds.size() + unbinds.size());
+
+	for (auto page : unbinds)
 	{
-		return false;
+		sparse_image_memory_binds.push_back(get_page_bind(page));
 	}
-	else if (right.expired())
+
+	for (auto page : binds)
 	{
-		return true;
+		auto &page_table     = page_tables[page];
+		page_table.page_slot = page_pool->allocate();
+
+		const auto pool_page = page_pool->get_page(page_table.page_slot);
+
+		auto page_bind         = get_page_bind(page);
+		page_bind.memory       = pool_page.memory;
+		page_bind.memoryOffset = pool_page.offset;
+		sparse_image_memory_binds.push_back(page_bind);
+	}
+
+	vk::SparseImageMemoryBindInfo image_bind_info{texture_image->get_handle(), sparse_image_memory_binds};
+
+	vk::BindSparseInfo bind_sparse_info{};
+	bind_sparse_info.setImageBinds(image_bind_info);
+
+	sparse_queue.get_handle().bindSparse(bind_sparse_info, device->request_fence());
+	device->get_fence_pool().wait();
+	device->get_fence_pool().reset();
+
+	for (auto page : binds)
+	{
+		page_tables[page].valid = true;
+	}
+
+	// Freed after the binds were allocated, so no memory is bound to two pages within the batch
+	for (auto page : unbinds)
+	{
+		auto &page_table = page_tables[page];
+		page_table.valid = false;
+
+		page_pool->free(page_table.page_slot);
+		page_table.page_slot = backend::PageBitmap::kInvalidPage;
+	}
+
+	if (!unbinds.empty())
+	{
+		// The unbinds completed, blocks left without pages are given back
+		page_pool->release_empty_blocks();
 	}
-	return left.lock()->available_offsets.size() > right.lock()->available_offsets.size();
 }
 
-void VirtualTexture::create_sparse_texture_image(backend::Device &device)
+void VirtualTexture::upload_pages(const std::vector<PageIndex> &pages)
 {
+	XIHE_TRACE_ZONE("Upload virtual texture pages");
+
+	std::vector<uint8_t>             staging_data;
+	std::vector<vk::BufferImageCopy> regions;
+
+	for (auto page : pages)
 	{
-		backend::ImageBuilder image_builder(width, height);
+		const auto  page_bind = get_page_bind(page);
+		const auto &mipmap    = raw_data_image->get_mipmaps()[page_bind.subresource.mipLevel];
+		const auto *mip_data  = raw_data_image->get_data().data() + mipmap.offset;
 
-		image_builder.with_usage(vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eSampled);
-		image_builder.with_flags(vk::ImageCreateFlagBits::eSparseBinding | vk::ImageCreateFlagBits::eSparseResidency);
-		image_builder.with_format(raw_data_image->get_format());
+		vk::BufferImageCopy region{};
+		region.bufferOffset     = staging_data.size();
+		region.imageSubresource = vk::ImageSubresourceLayers{vk::ImageAspectFlagBits::eColor, page_bind.subresource.mipLevel, 0, 1};
+		region.imageOffset      = page_bind.offset;
+		region.imageExtent      = page_bind.extent;
+		regions.push_back(region);
 
-		base_mip_level = 0U;
-		mip_levels     = 5U;
+		for (uint32_t y = 0; y < page_bind.extent.height; ++y)
+		{
+			const auto *row = mip_data + ((page_bind.offset.y + y) * mipmap.extent.width + page_bind.offset.x) * 4;
+			staging_data.insert(staging_data.end(), row, row + page_bind.extent.width * 4);
+		}
+	}
 
-		image_builder.with_mip_levels(mip_levels);
-		image_builder.with_sample_count(vk::SampleCountFlagBits::e1);
-		image_builder.with_tiling(vk::ImageTiling::eOptimal);
-		image_builder.with_sharing_mode(vk::SharingMode::eExclusive);
+	record_upload(staging_data, regions, vk::ImageLayout::eShaderReadOnlyOptimal);
+}
 
-		texture_image = image_builder.build_unique(device);
+void VirtualTexture::upload_mip_tail()
+{
+	std::vector<uint8_t>             staging_data;
+	std::vector<vk::BufferImageCopy> regions;
+
+	const auto &mipmaps = raw_data_image->get_mipmaps();
+	for (auto mip = static_cast<uint32_t>(mip_properties.size()); mip < mip_levels; ++mip)
+	{
+		const auto &mipmap    = mipmaps[mip];
+		const auto  data_size = mipmap.extent.width * mipmap.extent.height * 4;
+		const auto *mip_data  = raw_data_image->get_data().data() + mipmap.offset;
+
+		vk::BufferImageCopy region{};
+		region.bufferOffset     = staging_data.size();
+		region.imageSubresource = vk::ImageSubresourceLayers{vk::ImageAspectFlagBits::eColor, mip, 0, 1};
+		region.imageExtent      = mipmap.extent;
+		regions.push_back(region);
+
+		staging_data.insert(staging_data.end(), mip_data, mip_data + data_size);
 	}
 
-	std::vector<vk::SparseImageMemoryRequirements> sparse_image_memory_requirements;
-	vk::MemoryRequirements                         memory_requirements;
+	record_upload(staging_data, regions, vk::ImageLayout::eUndefined);
+}
+
+void VirtualTexture::record_upload(const std::vector<uint8_t> &staging_data, const std::vector<vk::BufferImageCopy> &regions, vk::ImageLayout old_layout)
+{
+	const vk::ImageSubresourceRange subresource_range{vk::ImageAspectFlagBits::eColor, 0, mip_levels, 0, 1};
+
+	std::optional<backend::Buffer> staging_buffer;
+	if (!staging_data.empty())
+	{
+		staging_buffer.emplace(backend::Buffer::create_staging_buffer(*device, staging_data));
+	}
+
+	auto &command_buffer = device->request_command_buffer();
+	command_buffer.begin(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+
+	{
+		common::ImageMemoryBarrier memory_barrier{};
+		memory_barrier.old_layout = old_layout;
+		memory_barrier.new_layout = vk::ImageLayout::eTransferDstOptimal;
+		// Frames submitted before may still sample the texture
+		memory_barrier.src_stage_mask  = old_layout == vk::ImageLayout::eUndefined ? vk::PipelineStageFlagBits2::eHost : vk::PipelineStageFlagBits2::eFragmentShader;
+		memory_barrier.dst_stage_mask  = vk::PipelineStageFlagBits2::eTransfer;
+		memory_barrier.dst_access_mask = vk::AccessFlagBits2::eTransferWrite;
+		common::image_layout_transition(command_buffer.get_handle(), texture_image->get_handle(), memory_barrier, subresource_range);
+	}
+
+	if (staging_buffer)
+	{
+		command_buffer.get_handle().copyBufferToImage(staging_buffer->get_handle(), texture_image->get_handle(), vk::ImageLayout::eTransferDstOptimal, regions);
+	}
+
+	{
+		common::ImageMemoryBarrier memory_barrier{};
+		memory_barrier.old_layout      = vk::ImageLayout::eTransferDstOptimal;
+		memory_barrier.new_layout      = vk::ImageLayout::eShaderReadOnlyOptimal;
+		memory_barrier.src_stage_mask  = vk::PipelineStageFlagBits2::eTransfer;
+		memory_barrier.src_access_mask = vk::AccessFlagBits2::eTransferWrite;
+		memory_barrier.dst_stage_mask  = vk::PipelineStageFlagBits2::eFragmentShader;
+		memory_barrier.dst_access_mask = vk::AccessFlagBits2::eShaderRead;
+		common::image_layout_transition(command_buffer.get_handle(), texture_image->get_handle(), memory_barrier, subresource_range);
+	}
 
-	uint32_t sparse_image_requirement_count = 0U;
+	command_buffer.end();
 
-	device.get_handle().getImageSparseMemoryRequirements(texture_image->get_handle(), &sparse_image_requirement_count, sparse_image_memory_requirements.data());
-	sparse_image_memory_requirements.resize(sparse_image_requirement_count);
-	device.get_handle().getImageSparseMemoryRequirements(texture_image->get_handle(), &sparse_image_requirement_count, sparse_image_memory_requirements.data());
+	const auto &queue = device->get_queue_by_flags(vk::QueueFlagBits::eGraphics, 0);
+	queue.submit(command_buffer, device->request_fence());
 
-	// device.get_handle().getBufferMemoryRequirements(texture_image->get_handle(), &memory_requirements);
+	device->get_fence_pool().wait();
+	device->get_fence_pool().reset();
+	device->get_command_pool().reset_pool();
+}
+
+VirtualTexture::~VirtualTexture()
+{
+	if (device)
+	{
+		device->get_handle().waitIdle();
+		texture_image.reset();
+		page_pool.reset();
+		if (mip_tail_memory)
+		{
+			device->get_handle().freeMemory(mip_tail_memory);
+		}
+	}
 }
 
 CalculateMipLevelData::CalculateMipLevelData(const glm::mat4 &mvp_transform, const vk::Extent2D &texture_base_dim, const vk::Extent2D &screen_base_dim, uint32_t vertical_num_blocks, uint32_t horizontal_num_blocks, uint8_t mip_levels) :
@@ -137,4 +602,121 @@ CalculateMipLevelData::CalculateMipLevelData(const glm::mat4 &mvp_transform, con
 		row.resize(horizontal_num_blocks + 1U);
 	}
 }
+
+void CalculateMipLevelData::calculate_mesh_coordinates()
+{
+	for (uint32_t row = 0; row <= vertical_num_blocks; ++row)
+	{
+		for (uint32_t column = 0; column <= horizontal_num_blocks; ++column)
+		{
+			const glm::vec4 texture_position{static_cast<float>(column) / horizontal_num_blocks, static_cast<float>(row) / vertical_num_blocks, 0.0f, 1.0f};
+			const glm::vec4 clip_position = mvp_transform * texture_position;
+
+			auto &point = mesh[row][column];
+			if (clip_position.w <= 0.0f)
+			{
+				point = {std::numeric_limits<double>::quiet_NaN(), std::numeric_limits<double>::quiet_NaN(), false};
+				continue;
+			}
+
+			const auto ndc  = glm::vec3(clip_position) / clip_position.w;
+			point.x         = (ndc.x * 0.5 + 0.5) * screen_base_dim.width;
+			point.y         = (ndc.y * 0.5 + 0.5) * screen_base_dim.height;
+			point.on_screen = std::abs(ndc.x) <= 1.0f && std::abs(ndc.y) <= 1.0f && ndc.z >= 0.0f && ndc.z <= 1.0f;
+		}
+	}
+}
+
+void CalculateMipLevelData::calculate_mip_levels()
+{
+	mip_table.assign(vertical_num_blocks, std::vector<MipBlock>(horizontal_num_blocks));
+
+	const double block_texels_u = static_cast<double>(texture_base_dim.width) / horizontal_num_blocks;
+	const double block_texels_v = static_cast<double>(texture_base_dim.height) / vertical_num_blocks;
+
+	auto distance = [](const Point &a, const Point &b) {
+		return std::hypot(a.x - b.x, a.y - b.y);
+	};
+
+	for (uint32_t row = 0; row < vertical_num_blocks; ++row)
+	{
+		for (uint32_t column = 0; column < horizontal_num_blocks; ++column)
+		{
+			const std::array<const Point *, 4> corners{&mesh[row][column], &mesh[row][column + 1], &mesh[row + 1][column], &mesh[row + 1][column + 1]};
+
+			auto &block = mip_table[row][column];
+
+			const bool any_behind = std::any_of(corners.begin(), corners.end(), [](const Point *point) { return is_behind_camera(*point); });
+			if (any_behind)
+			{
+				// The block crosses the camera plane, it is as close as it gets
+				block.on_screen = std::any_of(corners.begin(), corners.end(), [](const Point *point) { return point->on_screen; });
+				block.mip_level = 0.0;
+				continue;
+			}
+
+			// A block larger than the screen may cover it without any of its corners on it
+			double min_x = corners[0]->x, max_x = corners[0]->x, min_y = corners[0]->y, max_y = corners[0]->y;
+			for (const auto *corner : corners)
+			{
+				min_x = std::min(min_x, corner->x);
+				max_x = std::max(max_x, corner->x);
+				min_y = std::min(min_y, corner->y);
+				max_y = std::max(max_y, corner->y);
+			}
+			block.on_screen = max_x >= 0.0 && min_x <= screen_base_dim.width && max_y >= 0.0 && min_y <= screen_base_dim.height;
+
+			const double pixels_u = std::max(distance(*corners[0], *corners[1]), distance(*corners[2], *corners[3]));
+			const double pixels_v = std::max(distance(*corners[0], *corners[2]), distance(*corners[1], *corners[3]));
+
+			const double texels_per_pixel = std::max(block_texels_u / std::max(pixels_u, 1e-6), block_texels_v / std::max(pixels_v, 1e-6));
+
+			block.mip_level = std::clamp(std::log2(texels_per_pixel), 0.0, static_cast<double>(mip_levels - 1));
+		}
+	}
+}
+
+std::vector<PageIndex> simulate_feedback(const CalculateMipLevelData &mip_data, const VirtualTexture &virtual_texture)
+{
+	std::vector<PageIndex> requests;
+
+	for (uint32_t row = 0; row < mip_data.vertical_num_blocks; ++row)
+	{
+		for (uint32_t column = 0; column < mip_data.horizontal_num_blocks; ++column)
+		{
+			const auto &block = mip_data.mip_table[row][column];
+
+			const auto mip_level = static_cast<uint8_t>(block.mip_level);
+			if (!block.on_screen || mip_level >= virtual_texture.mip_properties.size())
+			{
+				// The mip tail is always resident
+				continue;
+			}
+
+			const double u0 = static_cast<double>(column) / mip_data.horizontal_num_blocks;
+			const double u1 = static_cast<double>(column + 1) / mip_data.horizontal_num_blocks;
+			const double v0 = static_cast<double>(row) / mip_data.vertical_num_blocks;
+			const double v1 = static_cast<double>(row + 1) / mip_data.vertical_num_blocks;
+
+			// Every page the block overlaps, the far edge belongs to the next block
+			const auto first_page = virtual_texture.get_page_index(mip_level, u0, v0);
+			const auto last_page  = virtual_texture.get_page_index(mip_level, std::nextafter(u1, 0.0), std::nextafter(v1, 0.0));
+
+			const auto &mip          = virtual_texture.mip_properties[mip_level];
+			const auto  first_column = (first_page - mip.mip_base_page_index) % mip.num_columns;
+			const auto  last_column  = (last_page - mip.mip_base_page_index) % mip.num_columns;
+
+			for (auto page_row = first_page; page_row <= last_page; page_row += mip.num_columns)
+			{
+				const auto row_start = page_row - first_column;
+				for (auto page_column = first_column; page_column <= last_column; ++page_column)
+				{
+					requests.push_back(row_start + page_column);
+				}
+			}
+		}
+	}
+
+	return requests;
+}
 }        // namespace xihe
@@ -1,8 +1,22 @@
 #pragma once
+
+#include <deque>
+#include <list>
+#include <set>
+
+#include "backend/sampler.h"
+#include "backend/sparse_page_pool.h"
 #include "scene_graph/components/image.h"
 
 namespace xihe
 {
+namespace backend
+{
+class Queue;
+}
+
+/// Page of a virtual texture, numbered across the mip levels in front of the mip tail
+using PageIndex = size_t;
 struct MipProperties
 {
 	size_t num_rows;
@@ -44,96 +58,96 @@ struct MipBlock
 	bool   on_screen;
 };
 
-struct MemSector;
-
-struct PageInfo
-{
-	std::shared_ptr<MemSector> memory_sector{nullptr};
-	uint32_t                   offset = 0U;
-};
-
 struct PageTable
 {
 	bool valid{false};        // bound via queueBindSparse
 
+	// Evicted but still bound, the frames in flight may sample it until it is unbound
+	bool evicting{false};
+
+	// Residency update of the last eviction, a page reloaded and evicted again waits for the frames of the later one
+	uint64_t eviction_update{0};
+
 	bool     gen_mip_required{false};
 	bool     fixed{false};
-	PageInfo page_memory_info;
+	uint32_t page_slot{backend::PageBitmap::kInvalidPage};        // in the page pool, while bound
 
 	std::set<std::tuple<uint8_t, size_t, size_t>> render_required_set;
 };
 
-/**
- * \brief Memory pool allocator designed for Sparse Binding in virtual texturing system.
- * This allocator manages continuous GPU memory blocks (MemSector) divided into fixed-size pages.
- * It uses a LIFO strategy for memory allocation to maintain memory locality and efficient reuse.
- */
-struct MemAllocInfo
+/// Pages to stream in and out after a residency update
+struct ResidencyUpdate
 {
-	vk::Device device{VK_NULL_HANDLE};
-	uint64_t   page_size{0U};
-	uint32_t   memory_type_index{0U};
-	size_t     pages_per_allocation{0U};
-
-	/**
-	 * Memory allocation strategy:
-	 * 1. Tries to reuse existing memory sectors first (LIFO order)
-	 * 2. Creates new memory sector when necessary
-	 * 3. Updates mapping between virtual pages and physical memory
-	 */
-	void get_allocation(PageInfo &page_memory_info, size_t page_index);
-
-	uint32_t get_size() const;
-
-	std::list<std::weak_ptr<MemSector>> &get_memory_sectors();
+	std::vector<PageIndex> loads;
+	std::vector<PageIndex> evictions;
+};
 
-  private:
-	// Use weak_ptr for memory sectors to allow automatic cleanup
-	// when memory sectors are no longer needed
-	std::list<std::weak_ptr<MemSector>> memory_sectors;
+/// Pages to bind and to unbind for a residency update, once the frames in flight no longer sample them
+struct PageBindings
+{
+	std::vector<PageIndex> binds;
+	std::vector<PageIndex> unbinds;
 };
 
 /**
- * \brief Represents a continuous block of GPU memory for sparse binding
+ * \brief Decides which pages of a virtual texture are resident from the pages each frame requested. It holds no
+ *        Vulkan objects, so the same logic runs on GPU feedback and on simulate_feedback.
  *
- * MemSector manages a fixed-size block of GPU memory divided into pages.
- * It tracks both available memory locations and their usage by virtual pages.
+ *        Missing pages are loaded coarsest mip first, then by how often they were requested, up to a fixed number
+ *        of uploads per frame. At the resident budget the least recently requested pages are evicted, pages the
+ *        current frame requested never are.
  */
-struct MemSector : public MemAllocInfo
+class PageResidency
 {
-	vk::DeviceMemory memory{VK_NULL_HANDLE};
+  public:
+	/// \param page_mip_levels Mip level of each page
+	PageResidency(std::vector<uint8_t> page_mip_levels, size_t resident_budget, size_t uploads_per_frame);
 
-	/**
-	 * \brief Tracks available offsets in this memory sector
-	 * - Each offset represents the starting position of a page in the continuous memory block
-	 * - Offsets are removed when pages are allocated and added back when pages are freed
-	 * - The distance between offsets equals page_size
-	 */
-	std::set<uint32_t> available_offsets;
+	/// \param requests Pages a frame requested, a page may be requested several times
+	ResidencyUpdate update(const std::vector<PageIndex> &requests);
 
-	/**
-	 * \brief Tracks which virtual pages are using this memory sector
-	 * - Maps physical memory pages to virtual texture pages
-	 * - Used for resource management and cleanup
-	 * - Helps maintain the relationship between virtual pages and physical memory
-	 */
-	std::set<size_t> virtual_page_indices;
+	void set_resident_budget(size_t resident_budget);
 
-	MemSector(MemAllocInfo &mem_alloc_info);
+	void set_uploads_per_frame(size_t uploads_per_frame);
 
-	~MemSector();
-};
+	bool is_resident(PageIndex page) const;
 
-struct MemSectorCompare
-{
-	bool operator()(const std::weak_ptr<MemSector> &left, const std::weak_ptr<MemSector> &right);
+	size_t get_resident_count() const;
+
+	size_t get_resident_budget() const;
+
+	/// Pages the last frame requested that are still not resident
+	size_t get_pending_count() const;
+
+  private:
+	std::vector<uint8_t> page_mip_levels_;
+
+	size_t resident_budget_;
+	size_t uploads_per_frame_;
+
+	uint64_t frame_{0};
+
+	// Frame each page was last requested in, plus one so 0 means never
+	std::vector<uint64_t> last_requested_;
+
+	// Resident pages, most recently requested first
+	std::list<PageIndex>                        lru_;
+	std::vector<std::list<PageIndex>::iterator> lru_positions_;
+	std::vector<bool>                           resident_;
+
+	size_t pending_count_{0};
 };
 
 struct VirtualTexture
 {
-	std::unique_ptr<backend::Image>     texture_image;
-	vk::ImageView texture_image_view = VK_NULL_HANDLE;
-	MemAllocInfo  memory_allocations;
+	~VirtualTexture();
+
+	backend::Device *device{nullptr};
+
+	std::unique_ptr<backend::Image>          texture_image;
+	std::unique_ptr<backend::ImageView>      texture_image_view;
+	std::unique_ptr<backend::Sampler>        sampler;
+	std::unique_ptr<backend::SparsePagePool> page_pool;
 
 	size_t width  = 0U;
 	size_t height = 0U;
@@ -142,7 +156,11 @@ struct VirtualTexture
 
 	uint8_t                    base_mip_level = 0U;
 	uint8_t                    mip_levels     = 0U;
-	std::vector<MipProperties> mip_properties;
+	std::vector<MipProperties> mip_properties;        // Levels in front of the mip tail, which is always resident
+
+	vk::Extent3D page_extent{};
+
+	vk::DeviceMemory mip_tail_memory{VK_NULL_HANDLE};
 
 	std::vector<std::vector<MipBlock>> current_mip_table;
 	std::vector<std::vector<MipBlock>> new_mip_table;
@@ -159,7 +177,60 @@ struct VirtualTexture
 
 	std::vector<vk::SparseImageMemoryBind> sparse_image_memory_binds;
 
-	void create_sparse_texture_image(backend::Device &device);
+	std::unique_ptr<PageResidency> residency;
+
+	// Evicted pages are unbound once the frames that may still sample them completed, by residency update
+	std::deque<std::pair<uint64_t, std::vector<PageIndex>>> pending_unbinds;
+
+	uint64_t residency_update_count{0};
+
+	// Pages the feedback shader requested since the last residency update, once per frame that requested them
+	std::vector<PageIndex> feedback;
+
+	/**
+	 * \brief Lays the pages of the full mip chain of raw_data_image out and creates the residency over them.
+	 *        Called on its own it only runs the residency logic, for devices without sparse residency.
+	 */
+	void create_page_layout(vk::Extent3D page_extent, uint8_t mip_tail_first_lod, size_t resident_budget, size_t uploads_per_frame);
+
+	/**
+	 * \brief Creates the sparse image with a full mip chain over raw_data_image, binds and uploads its mip tail
+	 * \param resident_budget Pages in front of the mip tail that may be resident at once
+	 */
+	void create_sparse_texture_image(backend::Device &device, const backend::Queue &sparse_queue, size_t resident_budget, size_t uploads_per_frame);
+
+	bool is_created() const;
+
+	size_t get_page_count() const;
+
+	vk::DeviceSize get_resident_size() const;
+
+	/// Page of the texel at the normalized coordinates in the mip level, which must be in front of the mip tail
+	PageIndex get_page_index(uint8_t mip_level, double u, double v) const;
+
+	/**
+	 * \brief Binds and uploads the pages the update loads and unbinds the pages evicted frames_in_flight updates ago.
+	 *        All of them go to a single bind, the bind and the upload are waited for, their cost is bounded by the
+	 *        uploads per frame.
+	 */
+	void apply(const ResidencyUpdate &update, const backend::Queue &sparse_queue, uint32_t frames_in_flight);
+
+	/**
+	 * \brief The pages apply binds and unbinds for the update. Pages loaded again before they were unbound keep their
+	 *        memory and content and are not bound again.
+	 */
+	PageBindings schedule_bindings(const ResidencyUpdate &update, uint32_t frames_in_flight);
+
+  private:
+	void bind_pages(const backend::Queue &sparse_queue, const std::vector<PageIndex> &binds, const std::vector<PageIndex> &unbinds);
+
+	void upload_pages(const std::vector<PageIndex> &pages);
+
+	void upload_mip_tail();
+
+	void record_upload(const std::vector<uint8_t> &staging_data, const std::vector<vk::BufferImageCopy> &regions, vk::ImageLayout old_layout);
+
+	vk::SparseImageMemoryBind get_page_bind(PageIndex page) const;
 };
 
 struct CalculateMipLevelData
@@ -184,7 +255,16 @@ struct CalculateMipLevelData
 
 	CalculateMipLevelData(const glm::mat4 &mvp_transform, const vk::Extent2D &texture_base_dim, const vk::Extent2D &screen_base_dim, uint32_t vertical_num_blocks, uint32_t horizontal_num_blocks, uint8_t mip_levels);
 
+	/// Projects the grid over the texture with the transform, which maps the texture coordinates at z = 0 to clip space
 	void calculate_mesh_coordinates();
+
+	/// Mip level each block of the grid is sampled at, from the screen size of its edges
 	void calculate_mip_levels();
 };
+
+/**
+ * \brief Page requests of a frame derived on the CPU from the mip levels of the grid over the texture, the same
+ *        requests the feedback shader records, so the residency logic runs on devices without sparse residency
+ */
+std::vector<PageIndex> simulate_feedback(const CalculateMipLevelData &mip_data, const VirtualTexture &virtual_texture);
 }        // namespace xihe
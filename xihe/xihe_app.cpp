@@ -1,10 +1,12 @@
 #include "xihe_app.h"
 
+#include "scene_graph/components/image.h"
 #include "scene_graph/components/texture.h"
 #include "scene_graph/gltf_loader.h"
 #include "scene_graph/script.h"
 
 #include <cassert>
+#include <chrono>
 
 #include <volk.h>
 #include <vulkan/vulkan.hpp>
@@ -13,6 +15,9 @@ VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
 #include "backend/debug.h"
 #include "common/error.h"
 #include "common/logging.h"
+#include "common/trace.h"
+#include "platform/filesystem.h"
+#include "rendering/frame_capture.h"
 #include "rendering/render_frame.h"
 #include "stats/stats.h"
 
@@ -30,6 +35,13 @@ XiheApp::XiheApp()
 
 	add_device_extension(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
 	add_device_extension(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+
+	// Real usage and budget of each heap, VMA falls back to estimating them without it
+	add_device_extension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME, /*optional=*/true);
+
+	// Lets the frame pacer wait for frames to be displayed, it falls back to the GPU timeline without them
+	add_device_extension(VK_KHR_PRESENT_ID_EXTENSION_NAME, /*optional=*/true);
+	add_device_extension(VK_KHR_PRESENT_WAIT_EXTENSION_NAME, /*optional=*/true);
 }
 
 XiheApp::~XiheApp()
@@ -39,9 +51,12 @@ XiheApp::~XiheApp()
 		device_->get_handle().waitIdle();
 	}
 
+	texture_streamer_.reset();
 	scene_.reset();
 	gpu_scene_.reset();
 
+	shader_reloader_.reset();
+	memory_budget_policy_.reset();
 	render_graph_.reset();
 	stats_.reset();
 	gui_.reset();
@@ -65,6 +80,8 @@ bool XiheApp::prepare(Window *window)
 
 	LOGI("XiheApp init");
 
+	XIHE_TRACE_THREAD_NAME("Main");
+
 	// initialize function pointers
 	static vk::DynamicLoader dl;
 	VULKAN_HPP_DEFAULT_DISPATCHER.init(dl.getProcAddress<PFN_vkGetInstanceProcAddr>("vkGetInstanceProcAddr"));
@@ -154,23 +171,34 @@ bool XiheApp::prepare(Window *window)
 	VULKAN_HPP_DEFAULT_DISPATCHER.init(get_device()->get_handle());
 
 	create_render_context();
+	render_context_->get_frame_pacer().set_present_wait_enabled(present_wait_supported_ &&
+	                                                            device_->is_enabled(VK_KHR_PRESENT_ID_EXTENSION_NAME) &&
+	                                                            device_->is_enabled(VK_KHR_PRESENT_WAIT_EXTENSION_NAME));
 	// todo
 	render_context_->prepare(8);
 
 	render_graph_  = std::make_unique<rendering::RenderGraph>(*render_context_);
 	graph_builder_ = std::make_unique<rendering::GraphBuilder>(*render_graph_, *render_context_);
 
+	shader_reloader_ = std::make_unique<rendering::ShaderReloader>(*device_, *render_graph_, *graph_builder_);
+
 	stats_ = std::make_unique<stats::Stats>(*render_context_);
-	stats_->request_stats({stats::StatIndex::kFrameTimes});
+	stats_->request_stats({stats::StatIndex::kFrameTimes, stats::StatIndex::kGpuFrameTimes, stats::StatIndex::kDeviceMemoryUsage, stats::StatIndex::kInputLatency}, stats_sampling_config_);
+
+	memory_budget_policy_ = std::make_unique<backend::MemoryBudgetPolicy>();
 
 	return true;
 }
 
 void XiheApp::update(float delta_time)
 {
+	XIHE_TRACE_ZONE("Frame");
+
 	update_scene(delta_time);
 	if (gui_)
 	{
+		XIHE_TRACE_ZONE("Update GUI");
+
 		gui_->new_frame();
 
 		draw_gui();
@@ -196,7 +224,33 @@ void XiheApp::update(float delta_time)
 
 	// update_bindless_descriptor_sets();
 
-	render_graph_->execute();
+	if (shader_reloader_)
+	{
+		shader_reloader_->update();
+	}
+
+	if (memory_budget_policy_)
+	{
+		memory_budget_policy_->update();
+	}
+
+	if (texture_streamer_)
+	{
+		texture_streamer_->update();
+	}
+
+	// Picks up passes whose enabled predicate changed, otherwise a no-op
+	graph_builder_->build();
+
+	if (frame_capture_requested_)
+	{
+		frame_capture_requested_ = false;
+		execute_captured_frame();
+	}
+	else
+	{
+		render_graph_->execute();
+	}
 
 	// command_buffer.end();
 
@@ -205,10 +259,40 @@ void XiheApp::update(float delta_time)
 	// render_context_->reset_bindless_index();
 }
 
+void XiheApp::wait_before_input()
+{
+	if (render_context_)
+	{
+		render_context_->get_frame_pacer().wait_before_input();
+	}
+}
+
 void XiheApp::input_event(const InputEvent &input_event)
 {
 	Application::input_event(input_event);
 
+	if (input_event.get_source() == EventSource::Keyboard)
+	{
+		const auto &key_event = static_cast<const KeyInputEvent &>(input_event);
+
+		if (key_event.get_code() == KeyCode::F9 && key_event.get_action() == KeyAction::Down)
+		{
+			dump_trace();
+		}
+		else if (key_event.get_code() == KeyCode::F10 && key_event.get_action() == KeyAction::Down)
+		{
+			dump_stats();
+		}
+		else if (key_event.get_code() == KeyCode::F11 && key_event.get_action() == KeyAction::Down)
+		{
+			dump_memory_map();
+		}
+		else if (key_event.get_code() == KeyCode::F12 && key_event.get_action() == KeyAction::Down)
+		{
+			capture_frame();
+		}
+	}
+
 	bool gui_captures_event = false;
 
 	if (gui_)
@@ -306,8 +390,31 @@ void XiheApp::add_post_scene_update_callback(const PostSceneUpdateCallback &call
 
 void XiheApp::load_scene(const std::string &path)
 {
+	XIHE_TRACE_ZONE("Load scene");
+
 	xihe::GltfLoader loader(*device_);
 
+	if (texture_streaming_config_)
+	{
+		loader.set_streamed_mip_tail_extent(texture_streaming_config_->mip_tail_extent);
+	}
+
+	if (texture_packing_config_)
+	{
+		loader.set_texture_packing(*texture_packing_config_);
+	}
+
+	if (texture_compression_config_)
+	{
+		loader.set_texture_compression(*texture_compression_config_);
+	}
+
+	if (texture_streamer_)
+	{
+		memory_budget_policy_->remove_resource(texture_streamer_resource_id_);
+		texture_streamer_.reset();
+	}
+
 	scene_ = loader.read_scene_from_file(path);
 
 	if (!scene_)
@@ -315,10 +422,125 @@ void XiheApp::load_scene(const std::string &path)
 		LOGE("Cannot load scene: {}", path.c_str());
 		throw std::runtime_error("Cannot load scene: " + path);
 	}
+
+	if (texture_streaming_config_)
+	{
+		texture_streamer_ = std::make_unique<TextureStreamer>(*device_, *render_context_, *scene_, *texture_streaming_config_);
+
+		texture_streamer_resource_id_ = get_memory_budget_policy().add_resource(
+		    {"Streamed textures", 0, [this](backend::MemoryPressure pressure, vk::DeviceSize bytes) { return texture_streamer_->release(pressure, bytes); }});
+	}
+}
+
+void XiheApp::enable_texture_streaming(const TextureStreamingConfig &config)
+{
+	texture_streaming_config_ = config;
+}
+
+void XiheApp::enable_texture_packing(const TexturePackingConfig &config)
+{
+	texture_packing_config_ = config;
+}
+
+void XiheApp::enable_texture_compression(const TextureCompressionConfig &config)
+{
+	texture_compression_config_ = config;
+}
+
+void XiheApp::set_stats_sampling(const stats::CounterSamplingConfig &config)
+{
+	stats_sampling_config_ = config;
+}
+
+void XiheApp::dump_trace() const
+{
+#ifndef XIHE_DISABLE_TRACE
+	const auto timestamp = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	trace::write_chrome_trace(fs::path::get(fs::path::Type::kLogs, fmt::format("trace_{}.json", timestamp)).string());
+#else
+	LOGW("Tracing was compiled out, configure with XIHE_TRACE=ON to dump traces");
+#endif
+}
+
+void XiheApp::dump_stats() const
+{
+	if (!stats_)
+	{
+		return;
+	}
+
+	const auto timestamp = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	stats_->write_json(fs::path::get(fs::path::Type::kLogs, fmt::format("stats_{}.json", timestamp)).string());
+	stats_->write_csv(fs::path::get(fs::path::Type::kLogs, fmt::format("stats_{}.csv", timestamp)).string());
+}
+
+void XiheApp::dump_memory_map() const
+{
+	if (!device_)
+	{
+		return;
+	}
+
+	for (auto category = 0u; category < static_cast<uint32_t>(backend::allocated::MemoryCategory::kCount); ++category)
+	{
+		const auto memory_category = static_cast<backend::allocated::MemoryCategory>(category);
+		const auto statistics      = backend::allocated::get_category_statistics(memory_category);
+		LOGI("{}: {} allocations, {:.1f} MiB", backend::allocated::to_string(memory_category), statistics.allocation_count,
+		     static_cast<double>(statistics.allocation_bytes) / (1024.0 * 1024.0));
+	}
+
+	const auto timestamp = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	backend::allocated::write_detailed_map(fs::path::get(fs::path::Type::kLogs, fmt::format("memory_{}.json", timestamp)).string());
+}
+
+backend::MemoryBudgetPolicy &XiheApp::get_memory_budget_policy()
+{
+	assert(memory_budget_policy_ && "Memory budget policy is created in prepare");
+	return *memory_budget_policy_;
+}
+
+TextureStreamer *XiheApp::get_texture_streamer()
+{
+	return texture_streamer_.get();
+}
+
+void XiheApp::capture_frame()
+{
+	frame_capture_requested_ = true;
+}
+
+void XiheApp::execute_captured_frame()
+{
+	XIHE_TRACE_ZONE("Capture frame");
+
+	rendering::FrameCapture frame_capture{*device_};
+
+	if (scene_ && scene_->has_component<sg::BindlessTextures>())
+	{
+		const auto textures = scene_->get_components<sg::BindlessTextures>()[0]->get_textures();
+
+		for (uint32_t i = 0; i < textures.size(); ++i)
+		{
+			frame_capture.add_bindless_texture(i, textures[i]->get_image()->get_vk_image_view(), textures[i]->get_sampler()->vk_sampler_);
+		}
+	}
+
+	render_graph_->set_frame_capture(&frame_capture);
+	render_graph_->execute();
+	render_graph_->set_frame_capture(nullptr);
+
+	// Contents are read back once the frame completed
+	device_->wait_idle();
+	frame_capture.read_back_contents();
+
+	const auto timestamp = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	frame_capture.save(fs::path::get(fs::path::Type::kLogs, fmt::format("capture_{}.xcap", timestamp)).string());
 }
 
 void XiheApp::update_scene(float delta_time)
 {
+	XIHE_TRACE_ZONE("Update scene");
+
 	if (scene_)
 	{
 		if (scene_->has_component<sg::Script>())
@@ -373,6 +595,18 @@ void XiheApp::request_gpu_features(backend::PhysicalDevice &gpu)
 		gpu.get_mutable_requested_features().samplerAnisotropy = VK_TRUE;
 	}
 
+	// Used by the GPU profiler of each render frame
+	if (gpu.get_features().pipelineStatisticsQuery)
+	{
+		gpu.get_mutable_requested_features().pipelineStatisticsQuery = VK_TRUE;
+	}
+
+	// Basis Universal textures are transcoded to whichever of these the device samples
+	gpu.get_mutable_requested_features().textureCompressionBC       = gpu.get_features().textureCompressionBC;
+	gpu.get_mutable_requested_features().textureCompressionASTC_LDR = gpu.get_features().textureCompressionASTC_LDR;
+	gpu.get_mutable_requested_features().textureCompressionETC2     = gpu.get_features().textureCompressionETC2;
+	REQUEST_OPTIONAL_FEATURE(gpu, vk::PhysicalDeviceHostQueryResetFeatures, hostQueryReset);
+
 	REQUEST_REQUIRED_FEATURE(gpu, vk::PhysicalDeviceDynamicRenderingFeatures, dynamicRendering);
 
 	REQUEST_REQUIRED_FEATURE(gpu, vk::PhysicalDeviceDescriptorIndexingFeaturesEXT, shaderSampledImageArrayNonUniformIndexing);
@@ -385,6 +619,13 @@ void XiheApp::request_gpu_features(backend::PhysicalDevice &gpu)
 
 	REQUEST_REQUIRED_FEATURE(gpu, vk::PhysicalDeviceSynchronization2FeaturesKHR, synchronization2);
 	REQUEST_REQUIRED_FEATURE(gpu, vk::PhysicalDeviceTimelineSemaphoreFeatures, timelineSemaphore);
+
+	if (gpu.is_extension_supported(VK_KHR_PRESENT_ID_EXTENSION_NAME) && gpu.is_extension_supported(VK_KHR_PRESENT_WAIT_EXTENSION_NAME))
+	{
+		const bool present_id   = REQUEST_OPTIONAL_FEATURE(gpu, vk::PhysicalDevicePresentIdFeaturesKHR, presentId);
+		const bool present_wait = REQUEST_OPTIONAL_FEATURE(gpu, vk::PhysicalDevicePresentWaitFeaturesKHR, presentWait);
+		present_wait_supported_ = present_id && present_wait;
+	}
 }
 
 void XiheApp::draw_gui()
@@ -2,19 +2,24 @@
 
 #include "gpu_scene.h"
 #include "gui.h"
+#include "texture_streamer.h"
 
 #include <memory>
+#include <optional>
 #include <unordered_map>
 
 #include "backend/debug.h"
 #include "backend/device.h"
 #include "backend/instance.h"
+#include "backend/memory_budget_policy.h"
 #include "backend/physical_device.h"
 #include "platform/application.h"
 #include "platform/window.h"
 #include "rendering/render_context.h"
 #include "rendering/render_graph/graph_builder.h"
+#include "rendering/shader_reloader.h"
 #include "scene_graph/scene.h"
+#include "scene_graph/texture_packer.h"
 
 namespace xihe
 {
@@ -37,6 +42,8 @@ class XiheApp : public Application
 
 	void input_event(const InputEvent &input_event) override;
 
+	void wait_before_input() override;
+
 	void finish() override;
 
 	const std::string &get_name() const;
@@ -55,6 +62,21 @@ class XiheApp : public Application
 
 	void add_post_scene_update_callback(const PostSceneUpdateCallback &callback);
 
+	/**
+	 * @brief Streamable resources register here to be trimmed when device memory usage approaches the budget
+	 */
+	backend::MemoryBudgetPolicy &get_memory_budget_policy();
+
+	/**
+	 * @brief Null unless texture streaming was enabled before the scene was loaded
+	 */
+	TextureStreamer *get_texture_streamer();
+
+	/**
+	 * @brief Records the next frame with its resources to the logs folder, to be replayed by xihe_replay, bound to F12
+	 */
+	void capture_frame();
+
   protected:
 	/**
 	 * @brief Request features from the gpu based on what is supported
@@ -63,10 +85,48 @@ class XiheApp : public Application
 
 	virtual void draw_gui();
 
+	/**
+	 * @brief Scenes loaded afterwards keep only the mip tails of their images resident and stream the finer levels in
+	 */
+	void enable_texture_streaming(const TextureStreamingConfig &config = {});
+
+	/**
+	 * @brief Scenes loaded afterwards pack their small images into arrays, see GltfLoader::set_texture_packing
+	 */
+	void enable_texture_packing(const TexturePackingConfig &config = {});
+
+	/**
+	 * @brief Scenes loaded afterwards block compress their PNG and JPEG images, cached across runs, see GltfLoader::set_texture_compression
+	 */
+	void enable_texture_compression(const TextureCompressionConfig &config = {});
+
+	/**
+	 * @brief Selects how the stats are sampled, must be called before prepare. In CounterSamplingMode::kContinuous, frame
+	 *        and GPU times are sampled on a thread at the configured interval
+	 */
+	void set_stats_sampling(const stats::CounterSamplingConfig &config);
+
 	void load_scene(const std::string &path);
 
 	void update_scene(float delta_time);
 
+	/**
+	 * @brief Writes the CPU and GPU zones recorded so far as a Chrome trace to the logs folder, bound to F9
+	 */
+	void dump_trace() const;
+
+	/**
+	 * @brief Writes the summaries and raw samples of the requested stats as JSON and CSV to the logs folder, bound to F10
+	 */
+	void dump_stats() const;
+
+	/**
+	 * @brief Logs the memory allocated per category and writes the detailed VMA map as JSON to the logs folder, bound to F11
+	 */
+	void dump_memory_map() const;
+
+	void execute_captured_frame();
+
 	// virtual std::unique_ptr<rendering::RenderTarget> create_render_target(backend::Image &&swapchain_image);
 
 	static void set_viewport_and_scissor(backend::CommandBuffer const &command_buffer, vk::Extent2D const &extent);
@@ -88,14 +148,28 @@ class XiheApp : public Application
 	std::unique_ptr<rendering::GraphBuilder> graph_builder_;
 	std::unique_ptr<rendering::RenderGraph>   render_graph_;
 
+	std::unique_ptr<rendering::ShaderReloader> shader_reloader_;
+
 	std::unique_ptr<sg::Scene> scene_;
 
 	std::unique_ptr<GpuScene> gpu_scene_;
 
+	std::optional<TextureStreamingConfig> texture_streaming_config_;
+	std::unique_ptr<TextureStreamer>      texture_streamer_;
+	uint32_t                              texture_streamer_resource_id_{0};
+
+	std::optional<TexturePackingConfig> texture_packing_config_;
+
+	std::optional<TextureCompressionConfig> texture_compression_config_;
+
 	std::unique_ptr<Gui> gui_;
 
 	std::unique_ptr<stats::Stats> stats_;
 
+	stats::CounterSamplingConfig stats_sampling_config_{stats::CounterSamplingMode::kPolling};
+
+	std::unique_ptr<backend::MemoryBudgetPolicy> memory_budget_policy_;
+
 	std::string name_{};
 
 	uint32_t api_version_ = VK_API_VERSION_1_3;
@@ -110,5 +184,9 @@ class XiheApp : public Application
 	vk::PhysicalDeviceDescriptorIndexingPropertiesEXT descriptor_indexing_properties_{};
 
 	std::vector<PostSceneUpdateCallback> post_scene_update_callbacks_{};
+
+	bool frame_capture_requested_{false};
+
+	bool present_wait_supported_{false};
 };
 }        // namespace xihe